@@ -0,0 +1,574 @@
+// Headless benchmarks for the core utilities and the scene workloads that run every frame.
+// This never opens a window, so nothing in here is allowed to touch the GPU: synthetic objects
+// get CPU-only sprites and collision maps instead of assets.
+//
+// Run it from anywhere below the repository, the results are printed as JSON to stdout,
+// or written to the file given as the first argument. The keys and their order never change,
+// and everything is seeded, so two result files can be diffed directly.
+
+// The scene code is all in main.cpp, and most of it is file-local, so we just compile it into this translation unit.
+#include "../src/main.cpp"
+#include <chrono>
+#include <stdio.h>
+#include <stdlib.h>
+
+// runtime.cpp isn't part of the benchmark, since it has its own main and opens a window.
+// These stand in for the parts of it that the scene code uses.
+extern "C" float GetRenderInterpolation(void)
+{
+	return 1;
+}
+
+extern "C" bool IsDevGuiVisible(void)
+{
+	return false;
+}
+
+extern "C" float GetResolutionScale(void)
+{
+	return 1;
+}
+
+extern "C" void SetDynamicResolution(bool enable)
+{
+	UNUSED(enable);
+}
+
+extern "C" double GetAverageFrameTime(void)
+{
+	return FRAME_TIME;
+}
+
+#define BENCHMARK_RESULTS_VERSION 1 // Increase this every time the meaning of the results changes.
+#define BENCHMARK_SEED 1234
+#define BENCHMARK_NUM_SAMPLES 15 // Every benchmark runs once to warm up, and then this many times.
+#define BENCHMARK_NUM_OBJECTS 4096
+#define BENCHMARK_NUM_STAIRS 64
+#define BENCHMARK_NUM_PARTICLE_UPDATES 10
+#define BENCHMARK_SCRIPT_REPEATS 20 // How many copies of example-script.txt go into the script we load.
+#define BENCHMARK_SCRIPT_PATH "benchmark-script.txt"
+#define BENCHMARK_SCENE_PATH "benchmark.scene"
+
+STRUCT(Benchmark)
+{
+	const char *name;
+	int numOps; // What one sample does, so that results are comparable per operation.
+	void (*prepare)(void); // Runs before every sample, and isn't timed.
+	uint64_t (*run)(void); // Returns a checksum of what it did, so that the work can't be optimized away.
+};
+
+static Random rng;
+static int tempAllocSizes[10000];
+static char *hashStrings[1000];
+static char *scriptText;
+static SlabAllocator slab;
+static Sprite fakeSprite;
+static SpriteFrame fakeFrame;
+static CollisionMap fakeCollisionMap;
+static Vector2 collisionQueries[10000];
+static ParticleEmitter *particleEmitter;
+
+static int64_t GetNanoseconds(void)
+{
+	auto now = std::chrono::steady_clock::now().time_since_epoch();
+	return (int64_t)std::chrono::duration_cast<std::chrono::nanoseconds>(now).count();
+}
+
+static uint64_t FloatChecksum(double sum)
+{
+	return (uint64_t)(int64_t)(sum * 1000);
+}
+
+//
+// Core utilities
+//
+
+static uint64_t TempAllocBenchmark(void)
+{
+	uint64_t checksum = 0;
+	TempReset(0);
+	for (int i = 0; i < COUNTOF(tempAllocSizes); ++i)
+	{
+		char *p = (char *)TempAlloc(tempAllocSizes[i]);
+		p[0] = (char)i;
+		checksum += (unsigned char)p[0];
+	}
+	TempReset(0);
+	return checksum;
+}
+
+static uint64_t SlabAllocatorBenchmark(void)
+{
+	uint64_t checksum = 0;
+	for (int i = 0; i < COUNTOF(tempAllocSizes); ++i)
+	{
+		char *p = (char *)AllocateFromSlabAllocator(&slab, tempAllocSizes[i]);
+		p[0] = (char)i;
+		checksum += (unsigned char)p[0];
+	}
+	ResetSlabAllocator(&slab, 0);
+	return checksum;
+}
+
+static uint64_t ListBenchmark(void)
+{
+	List(int) list = NULL;
+	for (int i = 0; i < 100000; ++i)
+		ListAdd(&list, i);
+	uint64_t checksum = 0;
+	while (ListCount(list) > 0)
+		checksum += ListPop(&list);
+	ListDestroy((void **)&list);
+	return checksum;
+}
+
+static uint64_t HashStringBenchmark(void)
+{
+	uint64_t checksum = 0;
+	for (int i = 0; i < COUNTOF(hashStrings); ++i)
+		checksum += HashString(hashStrings[i]);
+	return checksum;
+}
+
+static uint64_t SplitByWhitespaceBenchmark(void)
+{
+	TempReset(0);
+	List(char *) words = SplitByWhitespace(scriptText);
+	uint64_t checksum = (uint64_t)ListCount(words);
+	TempReset(0);
+	return checksum;
+}
+
+static uint64_t PerlinNoise2Benchmark(void)
+{
+	double sum = 0;
+	for (int y = 0; y < 256; ++y)
+		for (int x = 0; x < 256; ++x)
+			sum += PerlinNoise2(BENCHMARK_SEED, 0.1f * x, 0.1f * y);
+	return FloatChecksum(sum);
+}
+
+static uint64_t PerlinNoise3Benchmark(void)
+{
+	double sum = 0;
+	for (int z = 0; z < 16; ++z)
+		for (int y = 0; y < 64; ++y)
+			for (int x = 0; x < 64; ++x)
+				sum += PerlinNoise3(BENCHMARK_SEED, 0.1f * x, 0.1f * y, 0.1f * z);
+	return FloatChecksum(sum);
+}
+
+static float noiseGrid[256 * 256];
+
+static uint64_t PerlinNoise2GridBenchmark(void)
+{
+	PerlinNoise2Grid(BENCHMARK_SEED, 0, 0, 0.1f, 256, 256, noiseGrid);
+	double sum = 0;
+	for (int i = 0; i < COUNTOF(noiseGrid); ++i)
+		sum += noiseGrid[i];
+	return FloatChecksum(sum); // Same as perlin_noise2.
+}
+
+static uint64_t PerlinNoise3GridBenchmark(void)
+{
+	double sum = 0;
+	for (int z = 0; z < 16; ++z)
+	{
+		PerlinNoise3Grid(BENCHMARK_SEED, 0, 0, 0.1f * z, 0.1f, 64, 64, noiseGrid);
+		for (int i = 0; i < 64 * 64; ++i)
+			sum += noiseGrid[i];
+	}
+	return FloatChecksum(sum); // Same as perlin_noise3.
+}
+
+//
+// Particles
+//
+
+// A full emitter with turbulence, which is the most expensive thing an emitter can do.
+static void PrepareParticles(void)
+{
+	ParticleEmitterSettings settings = { 0 };
+	settings.budget = MAX_PARTICLES_PER_EMITTER;
+	settings.rate = MAX_PARTICLES_PER_EMITTER * FPS; // Fills up the budget in a single update.
+	settings.lifetime = 100;
+	settings.spawnRadius = 500;
+	settings.velocitySpread = 50;
+	settings.acceleration = Vector2{ 0, 10 };
+	settings.turbulence = 100;
+	settings.turbulenceScale = 64;
+
+	DestroyParticleEmitter(particleEmitter);
+	particleEmitter = CreateParticleEmitter(settings, BENCHMARK_SEED);
+	UpdateParticleEmitter(particleEmitter, Vector2{ 0, 0 }, FRAME_TIME);
+}
+
+static uint64_t ParticlesBenchmark(void)
+{
+	for (int i = 0; i < BENCHMARK_NUM_PARTICLE_UPDATES; ++i)
+		UpdateParticleEmitter(particleEmitter, Vector2{ 0, 0 }, FRAME_TIME);
+	double sum = 0;
+	for (int i = 0; i < particleEmitter->numParticles; ++i)
+		sum += particleEmitter->x[i] + particleEmitter->y[i];
+	return FloatChecksum(sum);
+}
+
+//
+// Scripts
+//
+
+static void RemoveScriptCache(void)
+{
+	remove(BENCHMARK_SCRIPT_PATH ".compiled");
+}
+
+static uint64_t LoadScriptBenchmark(void)
+{
+	FontFace font = { 0 }; // Loading doesn't lay out any text, so the fonts are only stored.
+	Script script = LoadScript(BENCHMARK_SCRIPT_PATH, font, font, font, font);
+	uint64_t checksum = (uint64_t)script.numParagraphs + (uint64_t)script.numCodepoints;
+	UnloadScript(&script);
+	TempReset(0);
+	return checksum;
+}
+
+//
+// Scenes
+//
+
+// Synthetic objects point at CPU-only sprites and collision maps that belong to us, and those aren't assets,
+// so they have to be taken away before the objects get destroyed.
+static void RemoveSyntheticObjects(void)
+{
+	for (int i = 0; i < numObjects; ++i)
+	{
+		Object *object = GetObject(i);
+		object->collisionMap = NULL;
+		for (int direction = 0; direction < DIRECTION_ENUM_COUNT; ++direction)
+			object->sprites[direction] = NULL;
+	}
+	RemoveAllObjects();
+	UpdateAllObjectBounds();
+	ListClear(dirtyNavAreas);
+	ListClear(drawOrder);
+}
+
+static void AddSyntheticObjects(bool withSpritesAndCollision)
+{
+	RemoveSyntheticObjects();
+	ListClear(stairs);
+
+	rng.seed = BENCHMARK_SEED;
+	rng.index = 0;
+	float worldSize = 200 * sqrtf((float)BENCHMARK_NUM_OBJECTS);
+	for (int i = 0; i < BENCHMARK_NUM_OBJECTS; ++i)
+	{
+		Object *object = AddObject();
+		snprintf(object->details->name, sizeof object->details->name, "object%d", i);
+		object->position.x = RandomFloat(&rng, 0, worldSize);
+		object->position.y = RandomFloat(&rng, 0, worldSize);
+		object->previousPosition = object->position;
+		object->zOffset = RandomFloat(&rng, -10, 10);
+		object->direction = (Direction)RandomInt(&rng, 0, DIRECTION_ENUM_COUNT);
+		object->animationFps = 10;
+		object->talkRange = 100;
+		if (withSpritesAndCollision)
+		{
+			object->sprites[DIRECTION_DOWN] = &fakeSprite;
+			object->direction = DIRECTION_DOWN;
+			object->collisionMap = &fakeCollisionMap;
+		}
+	}
+	for (int i = 0; i < BENCHMARK_NUM_STAIRS; ++i)
+	{
+		Stair stair;
+		stair.x0 = RandomInt(&rng, 0, 100);
+		stair.y0 = RandomInt(&rng, 0, 100);
+		stair.x1 = stair.x0 + RandomInt(&rng, 1, 8);
+		stair.y1 = stair.y0 + RandomInt(&rng, 1, 8);
+		stair.elevation = RandomInt(&rng, 1, 4);
+		ListAdd(&stairs, stair);
+	}
+	RebuildElevationMap();
+	areObjectBoundsDirty = true;
+}
+
+static void PrepareSceneRoundTrip(void)
+{
+	AddSyntheticObjects(false);
+}
+
+static uint64_t SceneRoundTripBenchmark(void)
+{
+	SaveScene(BENCHMARK_SCENE_PATH);
+	LoadScene(BENCHMARK_SCENE_PATH);
+	TempReset(0);
+	return (uint64_t)numObjects + (uint64_t)ListCount(stairs);
+}
+
+// The bounds, collision and z sort benchmarks all share one scene, which only has to be made once.
+static void PrepareSyntheticScene(void)
+{
+	if (numObjects == BENCHMARK_NUM_OBJECTS and GetObject(0)->collisionMap == &fakeCollisionMap)
+		return;
+	AddSyntheticObjects(true);
+	UpdateAllObjectBounds();
+	ListClear(dirtyNavAreas);
+}
+
+static uint64_t ObjectBoundsBenchmark(void)
+{
+	UpdateAllObjectBounds();
+	ListClear(dirtyNavAreas);
+	return (uint64_t)ListCount(outlineGrid.items);
+}
+
+static uint64_t CollisionBenchmark(void)
+{
+	uint64_t checksum = 0;
+	Vector2 velocity = { 5, 3 };
+	for (int i = 0; i < COUNTOF(collisionQueries); ++i)
+	{
+		Vector2 moved = MovePointWithCollisions(collisionQueries[i], velocity);
+		checksum += moved.x == collisionQueries[i].x; // Counts the blocked moves.
+		TempReset(0);
+	}
+	return checksum;
+}
+
+static uint64_t DrawOrderChecksum(List(Object *) visible)
+{
+	uint64_t checksum = (uint64_t)ListCount(visible);
+	for (int i = 0; i < ListCount(visible); ++i)
+		checksum += (uint64_t)i * (uint64_t)GetObjectIndex(visible[i]);
+	return checksum;
+}
+
+// Moves a couple of objects, like a normal frame does.
+static void PrepareZSortFewMoved(void)
+{
+	PrepareSyntheticScene();
+	for (int i = 0; i < numObjects / 100; ++i)
+	{
+		Object *object = GetObject(RandomInt(&rng, 0, numObjects));
+		object->position.y += RandomFloat(&rng, -20, 20);
+		UpdateObjectBounds(object);
+	}
+	ListClear(dirtyNavAreas);
+}
+
+// Shuffles the draw order, like after loading a scene or moving a lot of objects in the editor.
+static void PrepareZSortShuffled(void)
+{
+	PrepareSyntheticScene();
+	UpdateDrawOrder();
+	for (int i = ListCount(drawOrder) - 1; i > 0; --i)
+	{
+		int j = RandomInt(&rng, 0, i + 1);
+		int swap = drawOrder[i];
+		drawOrder[i] = drawOrder[j];
+		drawOrder[j] = swap;
+	}
+}
+
+// Forgets the draw order, like loading a scene or adding an object does.
+static void PrepareZSortRebuild(void)
+{
+	PrepareSyntheticScene();
+	ListClear(drawOrder);
+}
+
+static uint64_t ZSortBenchmark(void)
+{
+	Camera2D view = { 0 };
+	view.target = Vector2{ 100 * sqrtf((float)BENCHMARK_NUM_OBJECTS), 100 * sqrtf((float)BENCHMARK_NUM_OBJECTS) };
+	view.offset = Vector2{ WINDOW_CENTER_X, WINDOW_CENTER_Y };
+	view.zoom = 0.25f;
+	uint64_t checksum = DrawOrderChecksum(GetVisibleZSortedObjects(view));
+	TempReset(0);
+	return checksum;
+}
+
+//
+// Setup
+//
+
+static void InitBenchmarkData(void)
+{
+	rng.seed = BENCHMARK_SEED;
+	for (int i = 0; i < COUNTOF(tempAllocSizes); ++i)
+		tempAllocSizes[i] = RandomInt(&rng, 16, 257);
+	for (int i = 0; i < COUNTOF(hashStrings); ++i)
+	{
+		int length = RandomInt(&rng, 4, 64);
+		hashStrings[i] = (char *)MemAlloc(length + 1);
+		for (int j = 0; j < length; ++j)
+			hashStrings[i][j] = (char)RandomInt(&rng, 'a', 'z' + 1);
+		hashStrings[i][length] = 0;
+	}
+
+	// A script that's a couple of times bigger than the ones we actually have.
+	char *example = LoadFileText("example-script.txt");
+	if (not example)
+		Crash("Benchmarks need res/example-script.txt.");
+	int exampleLength = StringLength(example);
+	scriptText = (char *)MemAlloc(BENCHMARK_SCRIPT_REPEATS * (exampleLength + 2) + 1);
+	int length = 0;
+	for (int i = 0; i < BENCHMARK_SCRIPT_REPEATS; ++i)
+	{
+		CopyBytes(scriptText + length, example, exampleLength);
+		length += exampleLength;
+		CopyBytes(scriptText + length, "\n\n", 2);
+		length += 2;
+	}
+	scriptText[length] = 0;
+	UnloadFileText(example);
+	if (not SaveFileText(BENCHMARK_SCRIPT_PATH, scriptText))
+		Crash("Couldn't write '%s'.", BENCHMARK_SCRIPT_PATH);
+
+	// Every object gets the same 64x64 sprite, and a collision map that's solid 4 pixels in from the edge.
+	fakeFrame.source = Rectangle{ 0, 0, 64, 64 };
+	fakeSprite.numFrames = 1;
+	fakeSprite.frames = &fakeFrame;
+	fakeCollisionMap.width = 64;
+	fakeCollisionMap.height = 64;
+	fakeCollisionMap.wordsPerRow = 2;
+	fakeCollisionMap.bits = (uint32_t *)MemAlloc(fakeCollisionMap.wordsPerRow * fakeCollisionMap.height * sizeof fakeCollisionMap.bits[0]);
+	for (int y = 0; y < fakeCollisionMap.height; ++y)
+		for (int x = 0; x < fakeCollisionMap.width; ++x)
+			if (x < 4 or y < 4 or x >= 60 or y >= 60)
+				fakeCollisionMap.bits[y * fakeCollisionMap.wordsPerRow + x / 32] |= 1u << (x % 32);
+
+	float worldSize = 200 * sqrtf((float)BENCHMARK_NUM_OBJECTS);
+	for (int i = 0; i < COUNTOF(collisionQueries); ++i)
+	{
+		collisionQueries[i].x = RandomFloat(&rng, 0, worldSize);
+		collisionQueries[i].y = RandomFloat(&rng, 0, worldSize);
+	}
+
+	collisionGrid = CreateSpatialGrid(SPATIAL_GRID_CELL_SIZE);
+	outlineGrid = CreateSpatialGrid(SPATIAL_GRID_CELL_SIZE);
+	talkGrid = CreateSpatialGrid(SPATIAL_GRID_CELL_SIZE);
+	navGrid = CreateNavGrid();
+	EnsurePlayer();
+}
+
+static void DeinitBenchmarkData(void)
+{
+	RemoveSyntheticObjects();
+	remove(BENCHMARK_SCRIPT_PATH);
+	RemoveScriptCache();
+	remove(BENCHMARK_SCENE_PATH);
+	for (int i = 0; i < COUNTOF(hashStrings); ++i)
+		MemFree(hashStrings[i]);
+	MemFree(scriptText);
+	MemFree(fakeCollisionMap.bits);
+	DestroyParticleEmitter(particleEmitter);
+}
+
+static int CompareInt64(const void *a, const void *b)
+{
+	int64_t x = *(const int64_t *)a;
+	int64_t y = *(const int64_t *)b;
+	return (x > y) - (x < y);
+}
+
+static void RunBenchmark(FILE *out, const Benchmark *benchmark, bool isLast)
+{
+	int64_t samples[BENCHMARK_NUM_SAMPLES];
+	uint64_t checksum = 0;
+	for (int i = -1; i < BENCHMARK_NUM_SAMPLES; ++i)
+	{
+		if (benchmark->prepare)
+			benchmark->prepare();
+		int64_t start = GetNanoseconds();
+		checksum = benchmark->run();
+		int64_t elapsed = GetNanoseconds() - start;
+		if (i >= 0)
+			samples[i] = elapsed;
+	}
+	FlushLog();
+
+	qsort(samples, BENCHMARK_NUM_SAMPLES, sizeof samples[0], CompareInt64);
+	int64_t median = samples[BENCHMARK_NUM_SAMPLES / 2];
+	fprintf(out, "\t\t{ \"name\": \"%s\", \"ops\": %d, \"min_ns\": %lld, \"median_ns\": %lld, \"median_ns_per_op\": %.3f, \"checksum\": %llu }%s\n",
+		benchmark->name, benchmark->numOps, (long long)samples[0], (long long)median,
+		(double)median / benchmark->numOps, (unsigned long long)checksum, isLast ? "" : ",");
+}
+
+int main(int argc, char **argv)
+{
+	// The output path is relative to where we were started, so it has to be opened before we go looking for 'res'.
+	FILE *out = stdout;
+	if (argc > 1)
+	{
+		out = fopen(argv[1], "w");
+		if (not out)
+		{
+			fprintf(stderr, "Couldn't open '%s' for writing.\n", argv[1]);
+			return 1;
+		}
+	}
+
+	// Same as the game, except that we give up once we reach the root.
+	ChangeDirectory(GetApplicationDirectory());
+	while (not DirectoryExists("res"))
+	{
+		char *previousDir = TempFormat("%s", GetWorkingDirectory());
+		ChangeDirectory("..");
+		bool isAtRoot = StringsEqual(previousDir, GetWorkingDirectory());
+		TempFree(previousDir);
+		if (isAtRoot)
+		{
+			fprintf(stderr, "Couldn't find the 'res' directory.\n");
+			return 1;
+		}
+	}
+	ChangeDirectory("res");
+
+	// Only problems get printed, so that stdout stays valid JSON.
+	SetTraceLogLevel(LOG_WARNING);
+	for (int i = 0; i < LOG_CATEGORY_ENUM_COUNT; ++i)
+		SetLogCategoryLevel((LogCategory)i, LOG_WARNING);
+
+	InitBenchmarkData();
+
+	const Benchmark benchmarks[] = {
+		{ "temp_alloc",            COUNTOF(tempAllocSizes),   NULL,                  TempAllocBenchmark },
+		{ "slab_alloc_reset",      COUNTOF(tempAllocSizes),   NULL,                  SlabAllocatorBenchmark },
+		{ "list_add_pop",          100000,                    NULL,                  ListBenchmark },
+		{ "hash_string",           COUNTOF(hashStrings),      NULL,                  HashStringBenchmark },
+		{ "split_by_whitespace",   1,                         NULL,                  SplitByWhitespaceBenchmark },
+		{ "perlin_noise2",         256 * 256,                 NULL,                  PerlinNoise2Benchmark },
+		{ "perlin_noise3",         64 * 64 * 16,              NULL,                  PerlinNoise3Benchmark },
+		{ "perlin_noise2_grid",    256 * 256,                 NULL,                  PerlinNoise2GridBenchmark },
+		{ "perlin_noise3_grid",    64 * 64 * 16,              NULL,                  PerlinNoise3GridBenchmark },
+		{ "particles_update",      MAX_PARTICLES_PER_EMITTER * BENCHMARK_NUM_PARTICLE_UPDATES, PrepareParticles, ParticlesBenchmark },
+		// Without the cache, loading parses the text and converts it to codepoints, which is what we want to measure.
+		{ "load_script_parse",     1,                         RemoveScriptCache,     LoadScriptBenchmark },
+		{ "load_script_cached",    1,                         NULL,                  LoadScriptBenchmark },
+		{ "scene_save_load",       BENCHMARK_NUM_OBJECTS,     PrepareSceneRoundTrip, SceneRoundTripBenchmark },
+		{ "object_bounds",         BENCHMARK_NUM_OBJECTS,     PrepareSyntheticScene, ObjectBoundsBenchmark },
+		{ "collision_queries",     COUNTOF(collisionQueries), PrepareSyntheticScene, CollisionBenchmark },
+		{ "z_sort_few_moved",      BENCHMARK_NUM_OBJECTS,     PrepareZSortFewMoved,  ZSortBenchmark },
+		{ "z_sort_shuffled",       BENCHMARK_NUM_OBJECTS,     PrepareZSortShuffled,  ZSortBenchmark },
+		{ "z_sort_rebuild",        BENCHMARK_NUM_OBJECTS,     PrepareZSortRebuild,   ZSortBenchmark },
+	};
+
+	fprintf(out, "{\n");
+	fprintf(out, "\t\"version\": %d,\n", BENCHMARK_RESULTS_VERSION);
+	fprintf(out, "\t\"seed\": %d,\n", BENCHMARK_SEED);
+	fprintf(out, "\t\"samples\": %d,\n", BENCHMARK_NUM_SAMPLES);
+	fprintf(out, "\t\"objects\": %d,\n", BENCHMARK_NUM_OBJECTS);
+	fprintf(out, "\t\"benchmarks\": [\n");
+	for (int i = 0; i < COUNTOF(benchmarks); ++i)
+		RunBenchmark(out, &benchmarks[i], i == COUNTOF(benchmarks) - 1);
+	fprintf(out, "\t]\n");
+	fprintf(out, "}\n");
+
+	DeinitBenchmarkData();
+	FlushLog();
+	if (out != stdout)
+		fclose(out);
+	return 0;
+}
@@ -10,12 +10,21 @@ rem emsdk update
 rem emsdk install latest
 call emsdk activate latest
 
-rem # Collect all .c and .cpp files for compilation into the 'input' variable.
-for /f %%a in ('forfiles /s /m *.c /c "cmd /c echo @relpath"') do set input=!input! "%%~a"
-for /f %%a in ('forfiles /s /m *.cpp /c "cmd /c echo @relpath"') do set input=!input! "%%~a"
+rem # Collect all .c and .cpp files in src for compilation into the 'input' variable.
+rem # The benchmarks have a main of their own, so they stay out of the game.
+for /f %%a in ('forfiles /p src /s /m *.c /c "cmd /c echo @relpath"') do set input=!input! "src\%%~a"
+for /f %%a in ('forfiles /p src /s /m *.cpp /c "cmd /c echo @relpath"') do set input=!input! "src\%%~a"
+
+rem # The game only preloads the base pack and downloads the scene packs when it needs them.
+rem # Bake the packs in a desktop build first, with the "pack" console command, see the README.
+if not exist "bin\web\base.pack" (
+	echo Missing bin/web/base.pack, run the "pack" console command in a desktop build first.
+	pause
+	exit /b 1
+)
 
 rem # Compile and link
-call emcc -o bin/web/index.html -Os -flto -Wall -L./lib -lraylib_web -s USE_GLFW=3 -s TOTAL_MEMORY=268435456 --shell-file webshell.html --preload-file res %input%
+call emcc -o bin/web/index.html -Os -flto -ffp-contract=off -Wall -L./lib -lraylib_web -s USE_GLFW=3 -s TOTAL_MEMORY=268435456 --shell-file webshell.html --preload-file bin/web/base.pack@res/base.pack %input%
 
 rem # Copy the favicon
 copy /y "icon.ico" "bin/web/favicon.ico"
@@ -18,17 +18,17 @@ if [ "$recompile" = false ];
 then
 	echo "Recompile not needed."
 else
-	for file in $(find . -name '*.c')
+	for file in $(find src -name '*.c')
 	do
 		echo "Compiling C file $file..."
-		clang -std=c11 -c $file -o ${file}_arm.o -target arm64-apple-macos11
-		clang -std=c11 -c $file -o ${file}_x64.o -target x86_64-apple-macos10.12
+		clang -std=c11 -ffp-contract=off -c $file -o ${file}_arm.o -target arm64-apple-macos11
+		clang -std=c11 -ffp-contract=off -c $file -o ${file}_x64.o -target x86_64-apple-macos10.12
 	done
-	for file in $(find . -name '*.cpp')
+	for file in $(find src -name '*.cpp')
 	do
 		echo "Compiling C++ file $file..."
-		clang++ -std=c++17 -c $file -o ${file}_arm.o -target arm64-apple-macos11
-		clang++ -std=c++17 -c $file -o ${file}_x64.o -target x86_64-apple-macos10.12
+		clang++ -std=c++17 -ffp-contract=off -c $file -o ${file}_arm.o -target arm64-apple-macos11
+		clang++ -std=c++17 -ffp-contract=off -c $file -o ${file}_x64.o -target x86_64-apple-macos10.12
 	done
 
 	echo "Linking..."
@@ -61,11 +61,21 @@ extern "C" {
 // Concatenates two tokens while expanding macro arguments. E.g. PASTE(a, __LINE__) -> a42
 #define PASTE(a, b) PASTE_NOEXPAND(a, b)
 
+// Use this on global variables that every thread should get its own copy of.
+#ifdef _MSC_VER
+#	define THREAD_LOCAL __declspec(thread)
+#elif defined(__cplusplus)
+#	define THREAD_LOCAL thread_local
+#else
+#	define THREAD_LOCAL _Thread_local
+#endif
+
 //
 // Constants
 //
 
-// (Fixed) frames per second the game runs at. You can assume that this never changes.
+// (Fixed) updates per second the game runs at. You can assume that this never changes.
+// Rendering isn't tied to this, see GetRenderInterpolation.
 #define FPS 60
 
 // (Fixed) amount of time that advanced between frames. The game must always hit this frame time, otherwise it will slow down.
@@ -81,6 +91,21 @@ extern "C" {
 // Sets the allocator used by the list. By default, lists use MemRealloc and MemFree (heap allocation).
 void ListSetAllocator(List(void) *listPointer, void *(*realloc)(void *block, int newSize), void(*free)(void *block));
 
+// Makes the list reserve space for at least this many items when it first grows, instead of 64.
+// Use a small number for lists that usually stay short. Call this after ListSetAllocator.
+void ListSetMinCapacity(List(void) *listPointer, int minCapacity);
+
+// The most bytes that a list keeps in front of its items.
+#define LIST_HEADER_SIZE 32
+
+// Declares a buffer that fits a list of count items, e.g. ListBuffer(const char *, argsBuffer, 8); Use it with ListSetBuffer.
+#define ListBuffer(T, name, count) uint64_t name[(LIST_HEADER_SIZE + (count) * sizeof(T) + 7) / 8]
+
+// Makes an empty (NULL) list use the buffer from ListBuffer for its items, so it doesn't allocate until it outgrows the buffer.
+// The list doesn't own the buffer, so it must outlive the list. You still have to ListDestroy the list in case it grew.
+#define ListSetBuffer(listPointer, buffer)\
+	private_ListSetBuffer((List(void)*)(listPointer), (buffer), (int)sizeof (buffer), sizeof (*listPointer)[0])
+
 // Returns the number of items in the list.
 int ListCount(const List(void) list);
 
@@ -90,6 +115,12 @@ int ListCapacity(const List(void) list);
 // Deallocates all memory held by the list.
 void ListDestroy(List(void) *listPointer);
 
+// Removes all items from the list, but keeps its memory around so it can be filled up again.
+void ListClear(List(void) list);
+
+// Removes all items from the given count on, but keeps the memory around. The list can't get longer this way.
+void ListTruncate(List(void) list, int count);
+
 // Ensures that the list has space for at least the given number of elements.
 #define ListReserve(listPointer, neededCapacity)\
 	private_ListReserve((List(void)*)(listPointer), (neededCapacity), sizeof (*listPointer)[0])
@@ -116,7 +147,7 @@ void ListDestroy(List(void) *listPointer);
 
 // Removes the last item in the list and returns it.
 #define ListPop(listPointer)\
-	(private_ListPop(listPointer), (*listPointer)[ListCount(*listPointer)])
+	(private_ListPop((List(void) *)(listPointer)), (*listPointer)[ListCount(*listPointer)])
 
 // Removes the item at the given index in the list by swapping it with the last item in the list.
 // This will destroy the order of the list, but if you don't care about the order, it's very fast.
@@ -128,12 +159,42 @@ void ListDestroy(List(void) *listPointer);
 // Implementation details..
 void private_ListReserve(List(void) *listPointer, int neededCapacity, int sizeOfOneItem);
 void private_ListPop(List(void) *listPointer);
+void private_ListSetBuffer(List(void) *listPointer, void *buffer, int bufferSize, int sizeOfOneItem);
 
 //
 // Logging
 //
 
-// Logs an informational message. You can use this like printf.
+// Longer messages get cut off.
+#define LOG_MESSAGE_SIZE 512
+
+// Every category has its own log level, so that you can turn on the chatty messages of one system without drowning in everyone else's.
+ENUM(LogCategory)
+{
+	LOG_CATEGORY_GENERAL,
+	LOG_CATEGORY_ASSETS,
+	LOG_CATEGORY_SCRIPTS,
+	LOG_CATEGORY_SCENES,
+	LOG_CATEGORY_CONSOLE, // Only shows up in the console window.
+	LOG_CATEGORY_RAYLIB, // raylib's own messages, see CaptureRaylibLog.
+	LOG_CATEGORY_ENUM_COUNT,
+};
+
+// A logged message. Repeats of the same message are collapsed into one entry.
+STRUCT(LogEntry)
+{
+	double time; // Of the latest repeat.
+	int level;
+	LogCategory category;
+	int count; // How many times the message was logged in a row.
+	char text[LOG_MESSAGE_SIZE];
+};
+
+// Logs a message in the category, unless the level is below the category's log level. You can use this like printf.
+// Messages are only printed when the log gets flushed at the end of the frame, so logging never waits on the console. Safe to call from any thread.
+void LogMessage(LogCategory category, int logLevel, FORMAT_STRING message, ...);
+
+// Logs an informational message in the general category. You can use this like printf.
 void LogInfo(FORMAT_STRING message, ...);
 
 // Logs a warning message. For example when you detect something that could lead to problems in the future.
@@ -145,6 +206,31 @@ void LogError(FORMAT_STRING message, ...);
 // Immediately terminates the program and displays an error message.
 void Crash(FORMAT_STRING message, ...);
 
+// Sends raylib's own messages (TraceLog) to the raylib log category instead of printing them, so they're filtered
+// by that category's level like any other message. Call this first thing in main.
+void CaptureRaylibLog(void);
+
+// Messages below the level (LOG_INFO by default) are thrown away before they're even formatted.
+void SetLogCategoryLevel(LogCategory category, int logLevel);
+
+int GetLogCategoryLevel(LogCategory category);
+
+// Returns the lowercase name of the category, e.g. "scripts".
+const char *GetLogCategoryName(LogCategory category);
+
+// Moves all messages that were logged since the last flush into the log history, and prints them.
+// Repeated messages are printed as one line with "(xN)", and noisy categories are rate limited. MAIN THREAD ONLY.
+void FlushLog(void);
+
+// Returns the number of messages in the log history. The history only holds the latest messages.
+int GetNumLogEntries(void);
+
+// Returns a message from the log history, 0 being the oldest. The entry is only valid until the next flush. MAIN THREAD ONLY.
+const LogEntry *GetLogEntry(int index);
+
+// Forgets all messages in the log history. MAIN THREAD ONLY.
+void ClearLogHistory(void);
+
 // Use this to make sure that a condition holds. If it doesn't you'll be brought into the debugger, as if by a breakpoint.
 #define ASSERT(condition)do{\
 	if (!(condition)) {\
@@ -169,6 +255,9 @@ void SetInts(int *ints, int value, int count);
 // Sets all of the floats to a given value.
 void SetFloats(float *floats, float value, int count);
 
+// Returns the index of the first int equal to value, or -1 if there isn't one.
+int FindInt(const int *ints, int value, int count);
+
 // Copies the given number of bytes from one memory location to another.
 void CopyBytes(void *to, const void *from, int numBytes);
 
@@ -181,6 +270,10 @@ bool BytesEqual(const void *a, const void *b, int numBytes);
 // Quick sorts items in place (non-stable).
 void Sort(void *items, int numItems, int sizeofOneItem, int(*compare)(const void *left, const void *right));
 
+// Radix sorts the keys from smallest to largest, and moves each value along with its key. This is stable, so values with equal keys keep their order.
+// Much faster than Sort for lots of items, e.g. sorting object indices by depth.
+void RadixSortByFloatKeys(float *keys, int *values, int count);
+
 //
 // Char utilities
 //
@@ -234,6 +327,17 @@ List(char *) SplitByChar(const char *string, const char* spacer);
 // Temporary allocator
 //
 
+// Every thread has its own temporary storage, so all of these are safe to call from any thread.
+// The main thread's temporary storage is reset at the start of every frame. Other threads have to call TempReset(0)
+// themselves when they're done with a job, and DestroyTempStorage before they exit.
+
+STRUCT(TempStorageStats)
+{
+	int peakBytes;    // Most bytes that were ever in use at the same time, including padding and slabs skipped over.
+	int numSlabs;     // Including the first slab.
+	int numOverflows; // Allocations that didn't fit into the first slab. If this isn't 0, the first slab is too small.
+};
+
 // Allocates the given number of bytes from temporary storage. The returned pointer's lifetime is only valid in the current frame. 
 // At the end of the frame, the pointer is automatically freed. DO NOT KEEP A TEMPORARY STORAGE POINTER BETWEEN FRAMES!
 // You can call TempRealloc, TempFree, or TempReset to free the pointer earlier, if you want to conserve space.
@@ -253,6 +357,12 @@ int TempMark(void);
 // Call TempReset(0) to free all allocated temporary memory. This is done once at the start of each frame.
 void TempReset(int mark);
 
+// Frees all of the calling thread's temporary storage, including the slabs. Worker threads should call this before they exit.
+void DestroyTempStorage(void);
+
+// Returns usage statistics of the calling thread's temporary storage.
+TempStorageStats GetTempStorageStats(void);
+
 // Copies the given bytes to temporary storage.
 void *TempCopy(const void *bytes, int numBytes);
 
@@ -304,8 +414,10 @@ void AppendFormatVa(StringBuilder *builder, FORMAT_STRING format, va_list args);
 STRUCT(BinaryStream)
 {
 	void *buffer;
-	int size;   // Size of the buffer.
-	int cursor; // Read/write cursor.
+	int size;     // Size of the buffer.
+	int cursor;   // Read/write cursor.
+	bool canGrow; // Writes reallocate the buffer with MemRealloc when it runs out of space, instead of failing. Free it with MemFree.
+	bool hasFailed; // Set when a write didn't fit and the buffer couldn't grow. Everything written after that is dropped too.
 };
 
 // Reads a 32-bit integer from the stream and advances the cursor by 4 bytes.
@@ -339,35 +451,95 @@ void WriteFloat(BinaryStream *stream, float f);
 void WriteString(BinaryStream *stream, const char *s);
 
 // Writes a fixed number of bytes to the stream and advances the cursor by however many bytes were written.
+// If they don't fit, nothing is written and hasFailed is set.
 void WriteBytes(BinaryStream *stream, const void *bytes, int numBytesToWrite);
 
+// Writes 0 bytes to the stream until the cursor is a multiple of the alignment.
+void WritePadding(BinaryStream *stream, int alignment);
+
+//
+// File writer
+//
+
+// Writes the data to a file on a job thread, so the caller never waits on the disk. Takes over the data, which has to come from MemAlloc.
+// The file is written next to the path first and then renamed over it, so it never ends up half written. Saving a path that's
+// still waiting to be written just replaces the waiting data. Errors are logged once the write is done.
+void SaveFileDataInBackground(const char *path, void *data, int size);
+
+// Returns true while any files are still waiting to be written.
+bool IsSavingFiles(void);
+
+// Waits until all files are written. Call this before the game exits.
+void WaitForSavedFiles(void);
+
 //
 // Script
 //
 
+// A glyph or a command in a paragraph that's already been laid out inside of a text box.
+STRUCT(ParagraphItem)
+{
+	float revealTime; // The item shows up once the paragraph time is past this.
+	Vector2 position; // Relative to the top left corner of the text box.
+	int codepoint;    // 0 for commands.
+	int data;         // The style for glyphs, the index into Script::commands for commands.
+};
+
+// The speaker's expression changes at this time in the paragraph.
+STRUCT(ExpressionChange)
+{
+	float time;
+	int stringIndex; // Index into the string pool, or -1 for the default expression.
+};
+
 STRUCT(Paragraph)
 {
-	char *speaker;
+	const char *speaker; // Points into the string pool, NULL for the default name.
+	int speakerIndex;    // Index into the string pool, or -1 for the default name. Speakers are interned, so comparing these is enough.
 	char *text; // [textLength] NOT 0 TERMINATED!
 	int textLength;
 	float duration;
-	List(int) codepoints;
+	int firstCodepoint; // Index into Script::codepoints.
+	int numCodepoints;
+	int startExpression; // The expression at the start of the paragraph, same as ExpressionChange::stringIndex.
+	int firstExpressionChange; // Index into Script::expressionChanges, which are sorted by time within each paragraph.
+	int numExpressionChanges;
+	List(ParagraphItem) layout; // Cached by DrawScriptParagraph for the text box width and font size below.
+	float layoutWidth;
+	float layoutFontSize;
+};
+
+typedef struct CompiledCommand CompiledCommand;
+
+// A font loaded with LoadFontFace.
+STRUCT(FontFace)
+{
+	int id; // 0 means no font.
 };
 
 STRUCT(Script)
 {
-	Font font;
-	Font boldFont;
-	Font italicFont;
-	Font boldItalicFont;
+	FontFace font;
+	FontFace boldFont;
+	FontFace italicFont;
+	FontFace boldItalicFont;
 	int commandIndex; // Keeps track of which commands have already run so they don't run twice.
 	char *text;
-	List(char) stringPool; // This is where all expressions and speaker names are stored.
-	List(Paragraph) paragraphs;
+	void *arena; // The paragraphs, codepoints, expression changes and string pool are all in this one allocation.
+	Paragraph *paragraphs;
+	int numParagraphs;
+	int *codepoints; // The codepoints of all paragraphs, one after the other.
+	int numCodepoints;
+	ExpressionChange *expressionChanges;
+	int numExpressionChanges;
+	char *stringPool; // This is where all expressions and speaker names are stored.
+	int stringPoolSize;
+	List(CompiledCommand) commands; // The {commands} in the text, compiled when the script is loaded.
 };
 
-// Loads a script from the given text file.
-Script LoadScript(const char *path, Font regular, Font bold, Font italic, Font boldItalic);
+// Loads a script from the given text file. Parsed scripts are cached in "<path>.compiled" next to the text file,
+// and the cache is used instead of parsing again for as long as the text doesn't change.
+Script LoadScript(const char *path, FontFace regular, FontFace bold, FontFace italic, FontFace boldItalic);
 
 // Unloads all script memory and nullifies the script.
 void UnloadScript(Script *script);
@@ -376,7 +548,46 @@ void UnloadScript(Script *script);
 void DrawScriptParagraph(Script *script, int paragraphIndex, Rectangle textBox, float fontSize, Color color, Color shadowColor, float time);
 
 // Gets the current speaker expression at the given time in the paragraph.
-const char *GetScriptExpression(Script script, int paragratphIndex, float time);
+const char *GetScriptExpression(Script script, int paragraphIndex, float time);
+
+//
+// Texture compression
+//
+
+// Block-compresses the image into BC1 if it's opaque, or into BC3 if it has any transparency. The image is not unloaded.
+Image CompressImage(Image image);
+
+// Loads the image, or its baked compressed version if there's an up to date one that the GPU supports.
+// The compressed version is never decoded, so only use this for images that go to the GPU. Safe to call from any thread.
+Image LoadTextureImage(const char *path);
+
+// Same as LoadTextureFromImage, but compressed images get uploaded as they are, with their size rounded up to whole blocks. MAIN THREAD ONLY.
+Texture UploadTextureImage(Image image);
+
+// Bakes a compressed version of a big image file next to it ('<path>.dds'), unless there already is an up to date one.
+// Returns true if the image has an up to date compressed version afterwards. Does nothing on the web.
+bool BakeCompressedTexture(const char *path);
+
+//
+// Texture atlas
+//
+
+// An image inside of a shared atlas page. Drawing many frames from the same page only takes a single draw call.
+STRUCT(SpriteFrame)
+{
+	Texture texture;  // The whole atlas page.
+	Rectangle source; // Where the image is inside of the page.
+};
+
+// Copies the image into an atlas page, or into a new page if it doesn't fit in any of the existing ones.
+// Compressed images always get a page of their own. MAIN THREAD ONLY.
+SpriteFrame AddImageToAtlas(Image image);
+
+// Gives the frame's space back. The page is unloaded once all frames in it were removed.
+void RemoveFromAtlas(SpriteFrame frame);
+
+// Returns the number of atlas pages that are currently loaded.
+int GetNumAtlasPages(void);
 
 //
 // Sprite
@@ -385,13 +596,52 @@ const char *GetScriptExpression(Script script, int paragratphIndex, float time);
 STRUCT(Sprite)
 {
 	int numFrames;
-	Texture *frames;
+	SpriteFrame *frames;
 };
 
 Sprite LoadSprite(const char *path);
 
+// Decodes all sprite frames from a file or directory into CPU memory. This doesn't touch the GPU so it's safe to call from any thread.
+// Frames with a baked compressed version are loaded with LoadTextureImage, so they stay compressed.
+// The returned list is heap allocated, you need to unload the images and destroy the list yourself.
+List(Image) LoadSpriteImages(const char *path);
+
+// Packs already decoded frames into the texture atlas. The images are not unloaded. MAIN THREAD ONLY.
+Sprite LoadSpriteFromImages(const Image images[], int numImages);
+
 void UnloadSprite(Sprite sprite);
 
+//
+// Collision maps
+//
+
+// A 1-bit-per-pixel mask of where things are solid.
+STRUCT(CollisionMap)
+{
+	int width;
+	int height;
+	int wordsPerRow;
+	uint32_t *bits;
+	unsigned generation; // Set by the asset manager whenever it loads new contents into the map, see GetCollisionMapGeneration.
+};
+
+// Converts an image to a collision map. Pixels darker than 50% gray are solid. This doesn't touch the GPU so it's safe to call from any thread.
+CollisionMap LoadCollisionMapFromImage(Image image);
+
+// Loads an image file as a collision map. Safe to call from any thread.
+CollisionMap LoadCollisionMap(const char *path);
+
+void UnloadCollisionMap(CollisionMap map);
+
+// Returns true if the pixel is solid. Pixels outside of the map are never solid.
+bool IsCollisionMapPixelSolid(CollisionMap map, int x, int y);
+
+// Returns true if the pixel below the point is solid.
+bool CheckCollisionMapPoint(CollisionMap map, Vector2 point);
+
+// Returns true if any of the pixels that the segment passes through is solid, so that fast movement can't skip over thin walls.
+bool CheckCollisionMapSegment(CollisionMap map, Vector2 from, Vector2 to);
+
 //
 // Sounds
 //
@@ -402,15 +652,81 @@ void PlayTemporarySound(const char *path);
 // Plays a temporary sound with a given volume and pitch. 1 is the default for both.
 void PlayTemporarySoundEx(const char *path, float volume, float pitch);
 
-// Releases all temporary sounds that finished playing. Called once at the end of every frame.
+// Plays a temporary sound on one of a fixed number of voices. If they're all busy, the sound interrupts the one with the lowest priority,
+// as long as that isn't higher than this sound's priority. PlayTemporarySound and PlayTemporarySoundEx use priority 0.
+void PlayTemporarySoundWithPriority(const char *path, float volume, float pitch, int priority);
+
+// Frees the sounds of voices that haven't played in a while, and streams the music. Called once at the end of every frame.
 void UpdateTemporarySounds(void);
 
+// Stops all sounds and music and frees everything they hold on to.
+void UnloadTemporarySounds(void);
+
+// Starts streaming a music track, and loops it until StopMusic or playing another track. Playing the track that's already playing only changes the volume.
+void PlayMusic(const char *path, float volume);
+
+// Stops the music.
+void StopMusic(void);
+
+// Returns true if there's a music track playing.
+bool IsMusicPlaying(void);
+
+//
+// File watcher
+//
+
+// Starts watching a directory and everything inside of it for changes on a background thread.
+// Returns false if the platform can't do this (e.g. on the web), in which case you have to poll for changes yourself.
+bool StartWatchingDirectory(const char *path);
+
+// Pops the next changed file from the queue. The path is relative to the watched directory and always uses '/'.
+// Returns false if nothing changed since the last call.
+bool PollChangedFile(char *buffer, int bufferSize);
+
+//
+// Resource packs
+//
+
+// A pack is a single file with a bunch of resource files inside of it, so the web build can download them in one go, and only once they're needed.
+// While a pack is mounted, raylib's LoadFileData and LoadFileText (and with them LoadImage, LoadFontEx, LoadSound...) find the files inside of it
+// as if they were loose files in the working directory. Files that aren't in any mounted pack are still read from disk, so desktop builds
+// that don't mount anything load and hot reload loose files like before. Everything here is safe to call from any thread, except for FetchPack.
+
+// Writes the files at the given paths, and everything inside of the directories at the given paths, into a new pack.
+// Files are stored compressed if that makes them a good bit smaller, and the data of every file is 16-byte aligned.
+bool BuildPack(const char *packPath, const char *const paths[], int numPaths);
+
+// Reads a whole pack file into memory and mounts it. If a pack with the same path was already mounted, it's replaced.
+bool MountPack(const char *packPath);
+
+// Mounts a pack that's already in memory. The pack takes over the data, which has to come from MemAlloc, even if mounting fails.
+bool MountPackFromMemory(const char *packPath, void *data, int size);
+
+// Unmounts a pack. Files that are being read from the pack right now still finish loading.
+void UnmountPack(const char *packPath);
+
+// Returns true if the pack is currently mounted.
+bool IsPackMounted(const char *packPath);
+
+// Mounts a pack, and calls onFinished once it's done. On the web the pack is downloaded in the background from a URL relative to the page,
+// and onFinished is called from the browser's event loop, on desktop the pack is read from disk and onFinished is called right away. MAIN THREAD ONLY.
+void FetchPack(const char *packPath, void (*onFinished)(const char *packPath, bool success, void *userData), void *userData);
+
+// Same as FileExists, but also finds files and directories in mounted packs.
+bool ResourceExists(const char *path);
+
+// Same as IsPathFile, but also works for files and directories in mounted packs.
+bool IsResourceFile(const char *path);
+
+// Same as LoadDirectoryFiles, but if the directory is in a mounted pack, the files are listed from there, sorted by name. Unload the list with UnloadDirectoryFiles.
+FilePathList LoadResourceDirectoryFiles(const char *path);
+
 //
 // Asset manager
 //
 
-// Loads a collision map asset - currently a grayscale image.
-Image *AcquireCollisionMap(const char *path);
+// Loads a collision map asset from a grayscale image.
+CollisionMap *AcquireCollisionMap(const char *path);
 
 // Loads a texture asset - we might remove this later and just use sprites.
 Texture *AcquireTexture(const char *path);
@@ -418,15 +734,21 @@ Texture *AcquireTexture(const char *path);
 Sprite *AcquireSprite(const char *path);
 
 // Loads a script asset.
-Script *AcquireScript(const char *path, Font regular, Font bold, Font italic, Font boldItalic);
+Script *AcquireScript(const char *path, FontFace regular, FontFace bold, FontFace italic, FontFace boldItalic);
 
+// Loads a music asset, which is streamed from the compressed file while it plays. Call UpdateMusicStream every frame while it's playing.
 Music *AcquireMusic(const char *path);
 
+// Loads a sound asset, which is decoded into memory completely. While it's streaming in, its frameCount is 0.
 Sound *AcquireSound(const char *path);
 
-// Releases any asset.
+// Releases any asset. Assets that aren't used anymore stay loaded for a while, in case they get acquired again.
 void ReleaseAsset(void *asset);
 
+// Released assets are unloaded, the ones released the longest ago first, once they take up more than this many bytes
+// of CPU memory or VRAM. Use 0 to unload assets as soon as they're released. The default is 64 MB of CPU memory and 128 MB of VRAM.
+void SetAssetCacheBudget(int64_t cpuBytes, int64_t vramBytes);
+
 // Completely clones an asset, as if you has acquired it from scratch.
 void *CloneAsset(void *asset);
 
@@ -434,8 +756,33 @@ void *CloneAsset(void *asset);
 const char *GetAssetPath(const void *asset);
 
 // Hot-reloads any changed assets. This called once at the end of every frame.
+// Only the assets that the file watcher reported as changed are checked. Hot reloading is disabled on the web.
 void UpdateAllChangedAssets(void);
 
+// When streaming is on, AcquireTexture, AcquireSprite, AcquireCollisionMap and AcquireSound return immediately with a placeholder,
+// and the files are read and decoded on a background thread. The placeholder is swapped out in UpdateStreamingAssets.
+void SetAssetStreaming(bool enabled);
+
+// Finishes loading streamed assets that were decoded in the background (e.g. uploads them to the GPU).
+// Returns once there's nothing left to finish, or after spending timeBudget seconds. Called once every frame.
+void UpdateStreamingAssets(double timeBudget);
+
+// Returns the number of streamed assets that haven't finished loading yet.
+int GetNumStreamingAssets(void);
+
+// Returns true if the asset is still a placeholder, because it hasn't finished streaming in yet.
+bool IsAssetStreaming(const void *asset);
+
+// Returns a number that changes every time any loaded asset changes, because it finished streaming in or was hot reloaded.
+unsigned GetAssetGeneration(void);
+
+// Returns a number that goes up every time a collision map finished streaming in or was hot reloaded.
+// That collision map's generation is then set to the new number, so you can tell which ones changed since you last looked.
+unsigned GetCollisionMapGeneration(void);
+
+// Shows how many assets of every kind are loaded, and how much memory they take up. Not available in shipping builds.
+void ShowAssetWindow(void);
+
 //
 // Random
 //
@@ -512,6 +859,16 @@ float PerlinNoise3(unsigned seed, float x, float y, float z);
 float PerlinNoise2V(unsigned seed, Vector2 position);
 float PerlinNoise3V(unsigned seed, Vector3 position);
 
+// Same as calling PerlinNoise2 or PerlinNoise3 for every point, bit for bit, but a lot faster for many points that are close together.
+// Neighbouring points share their lattice gradients, and 4 points are interpolated at once with SIMD.
+void PerlinNoise2Batch(unsigned seed, const float xs[], const float ys[], float out[], int count);
+void PerlinNoise3Batch(unsigned seed, const float xs[], const float ys[], const float zs[], float out[], int count);
+
+// Fills a width x height grid, row by row, with PerlinNoise2(seed, x + (float)i * step, y + (float)j * step),
+// or with PerlinNoise3 of a slice at the given z. Same results as the scalar functions, but faster than the batch ones.
+void PerlinNoise2Grid(unsigned seed, float x, float y, float step, int width, int height, float out[]);
+void PerlinNoise3Grid(unsigned seed, float x, float y, float z, float step, int width, int height, float out[]);
+
 //
 // Math
 //
@@ -624,6 +981,14 @@ Color HeatmapPalette(float x);
 // Drawing
 //
 
+// Lets our fragment shaders compile for both GLSL 330 on desktop and GLSL ES 100 on the web.
+// Derivatives (fwidth..) are an extension in GLSL ES 100, so that's enabled too.
+#ifdef __EMSCRIPTEN__
+#	define GLSL_FRAGMENT_HEADER "#version 100\n#extension GL_OES_standard_derivatives : enable\nprecision highp float;\n#define IN varying\n#define OUT_COLOR gl_FragColor\n#define TEXTURE texture2D\n"
+#else
+#	define GLSL_FRAGMENT_HEADER "#version 330\n#define IN in\nout vec4 finalColor;\n#define OUT_COLOR finalColor\n#define TEXTURE texture\n"
+#endif
+
 // Sets the current rlgl color.
 void rlColor(Color color);
 
@@ -644,32 +1009,149 @@ void DrawTextureCenteredAndFlippedVertically(Texture texture, Vector2 position,
 
 void DrawTextureCenteredScaled(Texture texture, Vector2 position, float scale, Color tint);
 
+// Draws a sprite frame centered at the given point.
+void DrawSpriteFrameCentered(SpriteFrame frame, Vector2 position, Color tint);
+
+// Draws a sprite frame centered at the given point and flipped vertically.
+void DrawSpriteFrameCenteredAndFlippedVertically(SpriteFrame frame, Vector2 position, Color tint);
+
+// Same as BeginTextureMode, except that these can be nested: EndRenderTexture goes back to rendering into the render texture
+// that was being rendered into before, instead of always going back to the screen. Neither can be called between BeginMode2D and EndMode2D.
+void BeginRenderTexture(RenderTexture target);
+
+// Ends the innermost BeginRenderTexture.
+void EndRenderTexture(void);
+
+// Returns the width of what's being rendered into right now, either the innermost render texture or the screen.
+int GetRenderTargetWidth(void);
+
+// Returns the height of what's being rendered into right now, either the innermost render texture or the screen.
+int GetRenderTargetHeight(void);
+
+//
+// Particles
+//
+
+// An emitter never has more than this many particles alive, no matter what its budget says.
+#define MAX_PARTICLES_PER_EMITTER 4096
+
+// How an emitter spawns and moves its particles. All times are in seconds, all distances in world units.
+STRUCT(ParticleEmitterSettings)
+{
+	Sprite *sprite;         // Every particle picks a random frame. NULL draws plain squares. The emitter doesn't own the sprite.
+	int budget;             // The most particles that can be alive at once. Once it's reached, no new particles spawn until old ones die.
+	float rate;             // Particles spawned per second.
+	float lifetime;
+	float lifetimeVariance; // Every particle lives for lifetime +- this.
+	float spawnRadius;      // Particles spawn anywhere in a circle around the emitter.
+	Vector2 velocity;       // Per second.
+	float velocitySpread;   // Every particle gets a random velocity of up to this much added, in any direction.
+	Vector2 acceleration;   // Per second squared, e.g. gravity or wind.
+	float turbulence;       // How hard Perlin noise pushes the particles around, per second squared.
+	float turbulenceScale;  // How big the swirls of the turbulence are.
+	float startSize;        // Scale of the sprite frame when the particle spawns, or the size of the square without a sprite.
+	float endSize;          // Scale of the sprite frame when the particle dies.
+	Color startColor;
+	Color endColor;
+};
+
+// Particles are stored as a structure of arrays, so updating them is a handful of tight loops over floats that the compiler can vectorize.
+// All of the arrays are in a single allocation that's sized for the budget, so an emitter never allocates after it's created.
+STRUCT(ParticleEmitter)
+{
+	ParticleEmitterSettings settings;
+	Random random;
+	unsigned noiseSeed;
+	float time;
+	float spawnAccumulator;
+	int numParticles;
+	int capacity;
+	float *x;
+	float *y;
+	float *previousX; // Position before the last update, so that rendering can interpolate between the two.
+	float *previousY;
+	float *velocityX;
+	float *velocityY;
+	float *age;
+	float *lifetime;
+	int *frame;
+	Rectangle bounds; // Everything the living particles cover, as of the last update. Only meaningful if there are any.
+};
+
+// Creates an emitter without any particles. The seed decides all of the randomness, so emitters with the same seed behave the same.
+ParticleEmitter *CreateParticleEmitter(ParticleEmitterSettings settings, unsigned seed);
+
+// Changes the settings of the emitter. If the budget shrank, the newest particles are thrown away.
+void SetParticleEmitterSettings(ParticleEmitter *emitter, ParticleEmitterSettings settings);
+
+// Destroys the emitter and all of its particles.
+void DestroyParticleEmitter(ParticleEmitter *emitter);
+
+// Spawns, moves and kills particles, and updates the bounds. Every emitter only touches its own data, so different emitters can be updated on different threads.
+void UpdateParticleEmitter(ParticleEmitter *emitter, Vector2 position, float deltaTime);
+
+// Draws all particles of the emitter as quads in the current batch, so they only take a single draw call as long as the sprite's
+// frames are in the same atlas page. Interpolation is how far between the previous and the current update the particles are drawn.
+void DrawParticles(const ParticleEmitter *emitter, float interpolation);
+
 //
 // Text
 //
 
-// Loads all ASCII glyphs from the given .ttf file.
-Font LoadFontAscii(const char *path, int fontSize);
+// How a run of glyphs is drawn.
+STRUCT(TextStyle)
+{
+	FontFace font;
+	float fontSize;
+	Color color;
+	Color shadowColor; // Use BLANK for no shadow.
+	Vector2 shadowOffset;
+};
+
+// Loads a .ttf file. SDF fonts keep a single distance field per glyph that's drawn sharp at any size,
+// bitmap fonts rasterize every glyph again for every font size they're drawn at.
+FontFace LoadFontFace(const char *path, bool isSdf);
+
+// Unloads the font, throws its glyphs out of the glyph pages, and nullifies it.
+void UnloadFontFace(FontFace *font);
+
+// Returns the number of glyph pages that are currently loaded.
+int GetNumGlyphPages(void);
 
 // Returns the line height of a font for a particular font size.
-float GetLineHeight(Font font, float fontSize);
+float GetLineHeight(FontFace font, float fontSize);
+
+// Returns how far the pen moves after drawing the codepoint. Codepoints the font doesn't have are drawn as '?'.
+float GetGlyphAdvance(FontFace font, float fontSize, int codepoint);
+
+// Draws a run of glyphs straight into the current rlgl batch - first all of the shadows, then all of the glyphs on top.
+// SDF fonts are drawn with their own shader, so they can't be drawn inside of BeginShaderMode.
+// If offsets is NULL the glyphs are laid out like a normal string starting at position (with '\n' starting a new line),
+// otherwise glyph i is drawn at position + offsets[i].
+void DrawGlyphRun(TextStyle style, const int codepoints[], const Vector2 offsets[], int numGlyphs, Vector2 position);
 
 // Draws a formatted string starting at (x, y) and going right and down.
-void DrawFormat(Font font, float x, float y, float fontSize, Color color, FORMAT_STRING format, ...);
+void DrawFormat(FontFace font, float x, float y, float fontSize, Color color, FORMAT_STRING format, ...);
 
 // Same as DrawFormat but takes an explicit varargs pack.
-void DrawFormatVa(Font font, float x, float y, float fontSize, Color color, FORMAT_STRING format, va_list args);
+void DrawFormatVa(FontFace font, float x, float y, float fontSize, Color color, FORMAT_STRING format, va_list args);
 
 // Draws a formatted string centered at (x, y).
-void DrawFormatCentered(Font font, float x, float y, float fontSize, Color color, FORMAT_STRING format, ...);
+void DrawFormatCentered(FontFace font, float x, float y, float fontSize, Color color, FORMAT_STRING format, ...);
 
 // Same as DrawFormatCentered but takes an explicit varargs pack.
-void DrawFormatCenteredVa(Font font, float x, float y, float fontSize, Color color, FORMAT_STRING format, va_list args);
+void DrawFormatCenteredVa(FontFace font, float x, float y, float fontSize, Color color, FORMAT_STRING format, va_list args);
 
 //
 // Slab allocator
 //
 
+// Debug builds guard every allocation with magic bytes to catch overruns, and zero all memory as soon as it's freed.
+// Release and web builds skip all of that, and allocation is just a pointer bump.
+#if !defined(NDEBUG) && !defined(__EMSCRIPTEN__)
+#	define SLAB_ALLOCATOR_CHECKS
+#endif
+
 STRUCT(Slab)
 {
 	Slab *prev;
@@ -684,13 +1166,16 @@ STRUCT(SlabAllocator)
 	char magic[4];
 	Slab *slab;
 	int cursor;
+	int peakCursor;   // Highest the cursor has ever been.
+	int numNewSlabs;  // Slabs that had to be allocated because all of the existing ones were full.
+	int numOverflows; // Allocations that were made from a slab other than the first one.
 };
 
 // Allocates memory from the allocator. The returned pointer will be aligned to a 16-byte boundary.
-// The returned memory will be zeroed. If the requested byte count is 0 or negative, a 0 sized valid pointer is returned.
+// The returned memory is only zeroed with SLAB_ALLOCATOR_CHECKS, so don't count on it. If the requested byte count is 0 or negative, a 0 sized valid pointer is returned.
 void *AllocateFromSlabAllocator(SlabAllocator *allocator, int numBytes);
 
-// Reallocates a previously allocated memory block with a new size. If the memory block grows, the new bytes will be zeroed.
+// Reallocates a previously allocated memory block with a new size. Like with AllocateFromSlabAllocator, new bytes are only zeroed with SLAB_ALLOCATOR_CHECKS.
 // If `block` is NULL, the call is equivalent to AllocateFromSlabAllocator(allocator, numBytes).
 void *ReallocateFromSlabAllocator(SlabAllocator *allocator, void *block, int numBytes);
 
@@ -700,6 +1185,118 @@ void FreeFromSlabAllocator(SlabAllocator *allocator, void *block);
 // Frees all memory allocated from the allocator after the given cursor.
 void ResetSlabAllocator(SlabAllocator *allocator, int cursor);
 
+//
+// Spatial grid
+//
+
+// Number of hash buckets in every spatial grid. Must be a power of 2.
+#define SPATIAL_GRID_NUM_BUCKETS 1024
+
+STRUCT(SpatialGridItem)
+{
+	bool isInGrid;
+	Rectangle bounds;
+	int x0, y0, x1, y1; // Range of cells that the bounds touch.
+	unsigned queryStamp;
+};
+
+// Finds all items near a point or area without looking at every single item. Items are identified by non-negative integer IDs.
+STRUCT(SpatialGrid)
+{
+	float cellSize;
+	List(int) *buckets;
+	List(SpatialGridItem) items; // Indexed by item ID.
+	unsigned queryStamp;
+};
+
+// Creates an empty grid. The cell size should be a bit bigger than the typical item.
+SpatialGrid CreateSpatialGrid(float cellSize);
+
+// Frees all memory held by the grid.
+void DestroySpatialGrid(SpatialGrid *grid);
+
+// Adds an item to the grid, or moves it if it's already in the grid. This is very cheap if the item stays in the same cells.
+void UpdateSpatialGridItem(SpatialGrid *grid, int id, Rectangle bounds);
+
+// Removes an item from the grid. Does nothing if the item isn't in the grid.
+void RemoveSpatialGridItem(SpatialGrid *grid, int id);
+
+// Returns the IDs of all items whose bounds overlap the area, in no particular order. The result is allocated from temporary storage.
+List(int) QuerySpatialGrid(SpatialGrid *grid, Rectangle area);
+
+// Returns the IDs of all items whose bounds contain the point, in no particular order. The result is allocated from temporary storage.
+List(int) QuerySpatialGridPoint(SpatialGrid *grid, Vector2 point);
+
+//
+// Navigation grid
+//
+
+STRUCT(NavCell)
+{
+	int x;
+	int y;
+};
+
+ENUM(NavPathStatus)
+{
+	NAV_PATH_INVALID, // The request doesn't exist (anymore).
+	NAV_PATH_PENDING, // Still searching, try again after the next UpdateNavPaths.
+	NAV_PATH_FOUND,
+	NAV_PATH_PARTIAL, // The goal can't be reached, so the path goes as close to the goal as possible.
+};
+
+STRUCT(NavPathRequest)
+{
+	int id;
+	NavCell start;
+	NavCell goal;
+	NavPathStatus status;
+	List(NavCell) path;
+};
+
+typedef struct NavSearch NavSearch;
+
+// Cells that are either walkable or blocked, that paths can be found through with A*.
+// Only the cells inside of the bounds are stored, everything outside of them is walkable.
+// Path requests are queued up and searched a few cells at a time, so that many paths can be found without missing the frame time.
+STRUCT(NavGrid)
+{
+	int x0, y0; // First cell inside of the bounds.
+	int width, height;
+	uint8_t *blocked; // Indexed by (y - y0) * width + (x - x0).
+	List(NavPathRequest) requests; // In the order they get searched.
+	NavSearch *search; // The search of requests[0], if it started yet.
+	int nextRequestId;
+};
+
+// Creates a grid without any cells in it, so everything is walkable.
+NavGrid CreateNavGrid(void);
+
+// Frees all memory held by the grid, and cancels all path requests.
+void DestroyNavGrid(NavGrid *grid);
+
+// Changes the bounds of the grid and makes all cells walkable again. Searches that were in progress start over.
+void ResizeNavGrid(NavGrid *grid, int x0, int y0, int width, int height);
+
+// Changes whether a cell is blocked. Cells outside of the bounds are always walkable, so this does nothing for them.
+void SetNavCellBlocked(NavGrid *grid, int x, int y, bool isBlocked);
+
+// Returns true if the cell is inside of the bounds and blocked.
+bool IsNavCellBlocked(const NavGrid *grid, int x, int y);
+
+// Queues up a search for a path between two cells, and returns its ID (never 0). If the start is blocked, the path first walks out of the blocked cells.
+int RequestNavPath(NavGrid *grid, NavCell start, NavCell goal);
+
+// Forgets a path request, whether it finished or not.
+void CancelNavPath(NavGrid *grid, int id);
+
+// When the request is finished, moves its path (without the start cell, and with only the cells where the path turns) to outPath and forgets the request.
+// Free the path with ListDestroy once you're done with it.
+NavPathStatus GetNavPath(NavGrid *grid, int id, List(NavCell) *outPath);
+
+// Works on the queued up requests, in order, until maxSteps cells were looked at in total or there are no more requests.
+void UpdateNavPaths(NavGrid *grid, int maxSteps);
+
 //
 // Game states
 //
@@ -725,6 +1322,19 @@ void SetCurrentGameState(int state, void *parameter);
 // Calls the render function of the game state on top of the game state stack. The call is performed as if that game state was current.
 void CallPreviousGameStateRender(void);
 
+// Same as CallPreviousGameStateRender, for game states that freeze the one underneath them. The first call after the game state
+// becomes current renders the previous game state into a snapshot, and after that the snapshot is drawn instead.
+void CallPreviousGameStateRenderFrozen(void);
+
+// Makes the next CallPreviousGameStateRenderFrozen render the previous game state again, e.g. because it changed after all.
+void InvalidateGameStateSnapshot(void);
+
+// Returns true while CallPreviousGameStateRenderFrozen is rendering into the snapshot.
+bool IsTakingGameStateSnapshot(void);
+
+// Returns true while inside of CallPreviousGameStateRender, i.e. when another game state is drawing this one underneath itself.
+bool IsRenderingPreviousGameState(void);
+
 // Calls the update function of the current game state.
 void UpdateCurrentGameState(void);
 
@@ -788,8 +1398,32 @@ void MapGamepadAxisToInputButton(GamepadAxis gamepadAxis, InputButton *button, f
 
 void MapGamepadAxisToInputAxis(GamepadAxis gamepadAxis, InputAxis *axis);
 
+// Updates all mapped buttons and axes. This is called once per rendered frame. Button presses and releases stay
+// latched until ClearInputPresses, so that they're neither lost nor seen twice when a frame runs 0 or several updates.
 void UpdateInputMappings(void);
 
+// Clears the wasPressed and wasReleased flags of all mapped buttons. This is called after every update.
+void ClearInputPresses(void);
+
+// Starts recording the state of all mapped buttons and axes at every update. The command runs when the recording is replayed,
+// so that the replay starts at the same place, e.g. "load test.scene".
+void StartInputRecording(const char *startCommand);
+
+// Stops recording and saves the recording to a file. Returns false if we weren't recording or the file couldn't be saved.
+bool StopInputRecording(const char *path);
+
+bool IsRecordingInput(void);
+
+// Runs the start command of a recording, and then replaces the live input with the recorded input at every update until
+// the recording runs out. Fails if the recording was made with different input mappings.
+bool StartInputReplay(const char *path);
+
+// Returns false again once the recording ran out.
+bool IsReplayingInput(void);
+
+// Records or replays the input of one update. This is called before every update.
+void UpdateInputRecording(void);
+
 //
 // Console
 //
@@ -806,10 +1440,100 @@ void AddCommand(const char *command, CommandHandler handle, const char *help);
 
 void ExecuteCommand(const char *command);
 
+// A command that's already split up into its arguments, so that running it over and over doesn't have to parse or allocate anything.
+STRUCT(CompiledCommand)
+{
+	char *text; // The words of the command, each one 0 terminated.
+	const char *name; // Points into text, NULL if the command is empty.
+	List(const char *) args; // Point into text.
+	unsigned nameHash;
+	int commandIndex; // -1 until the command runs for the first time.
+};
+
+// Splits up a command, e.g. "sound door.wav 0.5". The command doesn't have to be added yet.
+CompiledCommand CompileCommand(const char *command);
+
+// Frees all memory held by the command and nullifies it.
+void UnloadCompiledCommand(CompiledCommand *command);
+
+// Runs the command. Returns false and logs a warning if the command doesn't exist or its arguments are wrong.
+bool ExecuteCompiledCommand(CompiledCommand *command);
+
+// Not available in shipping builds.
 void ShowConsoleGui(void);
 
 void ResetConsole(void);
 
+//
+// Job system
+//
+
+// A group of jobs that can be waited on together.
+typedef struct JobGroup JobGroup;
+
+// Creates an empty job group.
+JobGroup *CreateJobGroup(void);
+
+// Waits for all jobs in the group to finish, and then destroys it.
+void DestroyJobGroup(JobGroup *group);
+
+// Runs function(userData) on one of the job threads at some point. If group isn't NULL, the job is added to it.
+// Jobs get their own temporary storage, which is reset after every job. On web builds the job runs right away on the calling thread.
+void RunJob(JobGroup *group, void (*function)(void *userData), void *userData);
+
+// Waits until all of the jobs in the group are finished. The calling thread helps out with the group's jobs while it waits.
+void WaitForJobGroup(JobGroup *group);
+
+// Splits [0, count) into batches of batchSize and calls function(begin, end, userData) on each batch, spread out over all job threads.
+// Returns once all of the batches are done. The batches of a ParallelFor must not depend on each other.
+void ParallelFor(int count, int batchSize, void (*function)(int begin, int end, void *userData), void *userData);
+
+// Returns the number of background job threads. This is 0 on web builds.
+int GetNumJobThreads(void);
+
+//
+// Profiler
+//
+
+// The profiler only exists in debug desktop builds. In release, web and shipping builds all of the macros compile to nothing.
+#if !defined(NDEBUG) && !defined(__EMSCRIPTEN__) && !defined(SHIPPING)
+#	define PROFILER_ENABLED
+#endif
+
+#ifdef PROFILER_ENABLED
+// Starts timing a scope. The name has to outlive the profiler, so it should be a string literal. MAIN THREAD ONLY.
+#	define PROFILE_BEGIN(name) BeginProfileScope(name)
+// Stops timing the innermost scope.
+#	define PROFILE_END() EndProfileScope()
+// Times the rest of the enclosing C++ block.
+#	define PROFILE_SCOPE(name) ProfileScope PASTE(profileScope, __LINE__)(name)
+// Marks the start and end of a frame. Called by the runtime, you don't need these.
+#	define PROFILE_FRAME_BEGIN() BeginProfileFrame()
+#	define PROFILE_FRAME_END() EndProfileFrame()
+#else
+#	define PROFILE_BEGIN(name) ((void)0)
+#	define PROFILE_END() ((void)0)
+#	define PROFILE_SCOPE(name) ((void)0)
+#	define PROFILE_FRAME_BEGIN() ((void)0)
+#	define PROFILE_FRAME_END() ((void)0)
+#endif
+
+#ifdef PROFILER_ENABLED
+void BeginProfileScope(const char *name);
+
+void EndProfileScope(void);
+
+void BeginProfileFrame(void);
+
+void EndProfileFrame(void);
+
+// Shows the frame time graph and the flame/tree view of a recorded frame.
+void ShowProfilerWindow(void);
+
+// Writes all recorded frames to a JSON file that can be opened in chrome://tracing or https://ui.perfetto.dev.
+bool ExportProfilerTrace(const char *path);
+#endif
+
 //
 // Runtime
 //
@@ -820,8 +1544,46 @@ void GameInit(void);
 // Deinitialize the game. This is used in runtime.cpp, but should actually be defined by the game. CALLED ON DESKTOP PLATFORMS ONLY.
 void GameDeinit(void);
 
+// Called right before every fixed update. This is where the game should remember the state it interpolates while rendering.
+// This is used in runtime.cpp, but should actually be defined by the game.
+void GameBeginUpdate(void);
+
+// Shipping builds (compiled with SHIPPING defined) leave out ImGui, the editor, the console window and all of the debug windows entirely.
+#ifndef SHIPPING
+#	define DEV_GUI_ENABLED
+#endif
+
+// Returns true if the game wants to show any ImGui windows this frame. It's asked after the updates and right before rendering.
+// This is used in runtime.cpp, but should actually be defined by the game.
+bool GameWantsDevGui(void);
+
+// Returns true if there's an ImGui frame running, so ImGui windows can be built. Nothing may call ImGui while this is false.
+bool IsDevGuiVisible(void);
+
+// Returns how far the current render is between the last two updates, from 0 (the previous update) to 1 (the last update).
+// Updates run at a fixed FPS, but we render as fast as the display wants, so things that move should be drawn
+// at Lerp(previous, current, GetRenderInterpolation()) to look smooth.
+float GetRenderInterpolation(void);
+
+// Returns the fraction of the screen resolution that the world should be rendered at. It goes down while frames take longer than the display
+// shows them (but at least FRAME_TIME), and slowly back up to 1 once there's time to spare again. It's always 1 while dynamic resolution is off, and during replays.
+float GetResolutionScale(void);
+
+// Turns dynamic resolution on or off, see GetResolutionScale. It's on by default.
+void SetDynamicResolution(bool enable);
+
+// Returns the average time between the last couple of frames in seconds, which is what GetResolutionScale goes by.
+double GetAverageFrameTime(void);
+
 #ifdef __cplusplus
 }
+#ifdef PROFILER_ENABLED
+struct ProfileScope
+{
+	ProfileScope(const char *name) { BeginProfileScope(name); }
+	~ProfileScope() { EndProfileScope(); }
+};
+#endif
 inline Vector2 operator +(Vector2 v) { return v; }
 inline Vector2 operator -(Vector2 v) { return { -v.x, -v.y }; }
 inline Vector2 operator +(Vector2 left, Vector2 right) { return { left.x + right.x, left.y + right.y }; }
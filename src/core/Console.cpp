@@ -1,67 +1,19 @@
 #include "../core.h"
-#include <vector>
-#include <string>
-#include <sstream>
-#include <algorithm>
-#include <map>
+#include <stdio.h>
+#include <string.h>
 
+// Commands are looked up by name in a small open addressing hash table, so running one never has to allocate.
+// Scripts go one step further and compile their commands once when they're loaded, see CompileCommand.
 
-static std::vector<std::string> SplitStringByCharacter(std::string string, char spacer)
-{
-    int i = 0;
-
-    std::vector<std::string> output;
-    std::stringstream ss;
-
-    while (i < string.size())
-    {
-        if (string[i] == spacer)
-            if (ss.str().length() > 0)
-            {
-                output.push_back(ss.str());
-                ss.str(std::string());
-            }
+#define MAX_COMMANDS 128
+#define COMMAND_TABLE_SIZE 256 // Must be a power of 2, and bigger than MAX_COMMANDS.
 
-
-        if (string[i] != spacer)
-        {
-            ss << string[i];
-        }
-        i++;
-
-        if ((i == string.size()) && (ss.str().length() > 0))
-        {
-            output.push_back(ss.str());
-            ss.str(std::string());
-        }
-    }
-
-    return output;
-}
-
-class Command
+struct Command
 {
-public:
-    Command(std::string pcmd, std::string pHelp, CommandHandler handle) : name(pcmd), help(pHelp), handler(handle) {}
-    Command()
-    {
-        handler = CommandHandler();
-    }
-
-    bool Invoke(List(const char*) args) { return handler(args); }
-
-    void SetHelp(std::string pHelp) { help = pHelp; }
-    const char* GetHelp() { return help.c_str(); }
-    std::string GetName() { return name; }
-
-private:
-
-    std::string name;
-    std::string help;
+    char name[32];
+    char help[256];
+    unsigned nameHash;
     CommandHandler handler;
-    // maybe implement later, for now useless
-    std::vector<std::string> _commandArgTypes; // %s %d %f etc
-
 };
 
 enum CmdState
@@ -73,117 +25,177 @@ enum CmdState
 };
 struct CmdResult
 {
-    std::shared_ptr<Command> cmd;
+    const Command *cmd;
     CmdState state;
 };
 
-class Console
-{
-public:
-
-    std::map<std::string, std::shared_ptr<Command>> _commandContainer = std::map<std::string, std::shared_ptr<Command>>();
+static Command commands[MAX_COMMANDS];
+static int numCommands;
+static int commandTable[COMMAND_TABLE_SIZE]; // Index + 1 into commands, 0 for empty slots.
 
-    Console()
+static int FindCommandIndex(const char *name, unsigned nameHash)
+{
+    for (unsigned i = 0; i < COMMAND_TABLE_SIZE; ++i)
     {
-        ClearLog();
+        int slot = commandTable[(nameHash + i) & (COMMAND_TABLE_SIZE - 1)];
+        if (slot == 0)
+            return -1;
 
-        AutoScroll = true;
-        ScrollToBottom = false;
+        const Command *command = &commands[slot - 1];
+        if (command->nameHash == nameHash and StringsEqual(command->name, name))
+            return slot - 1;
     }
+    return -1;
+}
 
-    ~Console()
+// Splits the text into words in place, and puts the words after the name into args. Returns the name.
+// Backticks in the arguments become spaces, so that arguments can contain spaces.
+static char *TokenizeCommand(char *text, List(const char *) *args)
+{
+    char *name = NULL;
+    for (char *c = text; *c;)
     {
-        ClearLog();
-    }
+        if (*c == ' ')
+        {
+            *c++ = 0;
+            continue;
+        }
 
+        char *word = c;
+        while (*c and *c != ' ')
+        {
+            if (*c == '`')
+                *c = ' ';
+            ++c;
+        }
+        if (*c)
+            *c++ = 0;
 
-    void AddCommand(const char* cmd, CommandHandler handle, const char* pHelp = "")
-    {
-        auto words = SplitStringByCharacter(std::string(cmd), ' ');
+        if (not name)
+            name = word;
+        else
+            ListAdd(args, (const char *)word);
+    }
+    return name;
+}
 
-        auto commandName = words[0];
-        words.erase(words.begin());
+static int CompareCommandNames(const void *left, const void *right)
+{
+    return strcmp(commands[*(const int *)left].name, commands[*(const int *)right].name);
+}
 
-        auto command = std::make_shared<Command>(commandName, std::string(pHelp), handle);
+class Console
+{
+public:
 
-        _commandContainer.insert(std::pair<std::string, std::shared_ptr<Command>>(commandName, command));
+    Console()
+    {
+        AutoScroll = true;
+        ScrollToBottom = false;
     }
 
-    CmdResult ExecuteCommand(const char* cmd)
+    void AddCommand(const char* cmd, CommandHandler handle, const char* pHelp = "")
     {
-        auto words = SplitStringByCharacter(std::string(cmd), ' ');
+        char name[sizeof commands[0].name];
+        int nameLength = 0;
+        while (cmd[nameLength] and cmd[nameLength] != ' ' and nameLength < (int)sizeof name - 1)
+        {
+            name[nameLength] = cmd[nameLength];
+            ++nameLength;
+        }
+        name[nameLength] = 0;
 
-        auto command = words[0];
-        words.erase(words.begin());
+        unsigned nameHash = HashString(name);
+        if (FindCommandIndex(name, nameHash) >= 0)
+        {
+            LogWarning("Command '%s' was already added.", name);
+            return;
+        }
+        ASSERT(numCommands < MAX_COMMANDS);
+
+        Command *command = &commands[numCommands];
+        CopyString(command->name, name, sizeof command->name);
+        CopyString(command->help, pHelp, sizeof command->help);
+        command->nameHash = nameHash;
+        command->handler = handle;
+
+        unsigned slot = nameHash & (COMMAND_TABLE_SIZE - 1);
+        while (commandTable[slot] != 0)
+            slot = (slot + 1) & (COMMAND_TABLE_SIZE - 1);
+        commandTable[slot] = ++numCommands;
+    }
 
+    CmdResult RunCommand(int commandIndex, const char *name, List(const char *) args)
+    {
         CmdResult result;
+        result.cmd = NULL;
 
-        if (command == "help")
+        if (StringsEqual(name, "help"))
         {
+            int sorted[MAX_COMMANDS];
+            for (int i = 0; i < numCommands; i++)
+                sorted[i] = i;
+            Sort(sorted, numCommands, sizeof sorted[0], CompareCommandNames);
+
             AddLog("All commands:");
-            for (auto &keyval : _commandContainer)
-                AddLog("  %s", keyval.second->GetHelp());
+            for (int i = 0; i < numCommands; i++)
+                AddLog("  %s", commands[sorted[i]].help);
 
             result.state = CmdState::COMMAND_HANDLED_DO_NOTHING;
             return result;
         }
 
-        if (_commandContainer.find(command) == _commandContainer.end())
+        if (commandIndex < 0)
         {
             result.state = CmdState::COMMAND_NOT_FOUND;
             return result;
         }
 
-        List(const char*) wordsList = NULL;
-        ListSetAllocator((void **)&wordsList, TempRealloc, TempFree);
-
-
-        for (int i = 0; i < words.size(); i++)
-        {          
-            std::replace(words[i].begin(), words[i].end(), '`', ' ');
+        result.cmd = &commands[commandIndex];
+        result.state = result.cmd->handler(args) ? CmdState::COMMAND_SUCCEEDED : CmdState::COMMAND_FOUND_BAD_ARGS;
+        return result;
+    }
 
-            ListAdd(&wordsList, words[i].c_str());
-        }
+    CmdResult ExecuteCommand(const char* cmd)
+    {
+        int mark = TempMark();
+        // Commands rarely have more than a handful of arguments, so they fit on the stack.
+        ListBuffer(const char *, argsBuffer, 16);
+        List(const char *) args = NULL;
+        ListSetBuffer(&args, argsBuffer);
+        char *text = (char *)TempCopy(cmd, StringLength(cmd) + 1);
+        char *name = TokenizeCommand(text, &args);
 
-        if (_commandContainer[command]->Invoke(wordsList))
-        {
-            result.state = CmdState::COMMAND_SUCCEEDED;
-            result.cmd = _commandContainer[command];
-        }
-        else
-        {
-            result.state = CmdState::COMMAND_FOUND_BAD_ARGS;
-            result.cmd = _commandContainer[command];
-        }
+        CmdResult result;
+        result.cmd = NULL;
+        result.state = CmdState::COMMAND_NOT_FOUND;
+        if (name)
+            result = RunCommand(FindCommandIndex(name, HashString(name)), name, args);
 
+        ListDestroy((void **)&args);
+        TempReset(mark);
         return result;
     }
 
     char                        InputBuf[256];
-    ImVector<char*>             Items;
     bool                        AutoScroll;
     bool                        ScrollToBottom;
     bool                        FocusOnLoad = true;
 
-    static char* Strdup(const char* s) { IM_ASSERT(s); size_t len = strlen(s) + 1; void* buf = malloc(len); IM_ASSERT(buf); return (char*)memcpy(buf, (const void*)s, len); }
-
+    // The console window just shows the log history, so what the console prints itself goes into the log too.
     void ClearLog()
     {
-        for (int i = 0; i < Items.Size; i++)
-            free(Items[i]);
-        Items.clear();
+        ClearLogHistory();
     }
 
     void AddLog(const char* fmt, ...) IM_FMTARGS(2)
     {
-        // FIXME-OPT
-        char buf[1024];
+        char buf[LOG_MESSAGE_SIZE];
         va_list args;
         va_start(args, fmt);
         vsnprintf(buf, IM_ARRAYSIZE(buf), fmt, args);
-        buf[IM_ARRAYSIZE(buf) - 1] = 0;
         va_end(args);
-        Items.push_back(Strdup(buf));
+        LogMessage(LOG_CATEGORY_CONSOLE, LOG_INFO, "%s", buf);
     }
 
     void ShowConsoleGui()
@@ -194,16 +206,21 @@ public:
 
         ImGui::PushStyleVar(ImGuiStyleVar_ItemSpacing, ImVec2(4, 1)); // Tighten spacing
 
-        for (int i = 0; i < Items.Size; i++)
+        for (int i = 0; i < GetNumLogEntries(); i++)
         {
-            const char* item = Items[i];
+            const LogEntry* item = GetLogEntry(i);
             ImVec4 color;
             bool has_color = false;
+            if (item->level >= LOG_ERROR)   { color = ImVec4(1.0f, 0.4f, 0.4f, 1.0f); has_color = true; }
+            if (item->level == LOG_WARNING) { color = ImVec4(1.0f, 0.8f, 0.4f, 1.0f); has_color = true; }
 
             if (has_color)
                 ImGui::PushStyleColor(ImGuiCol_Text, color);
 
-            ImGui::TextUnformatted(item);
+            if (item->count > 1)
+                ImGui::Text("%s (x%d)", item->text, item->count);
+            else
+                ImGui::TextUnformatted(item->text);
             if (has_color)
                 ImGui::PopStyleColor();
         }
@@ -272,7 +289,7 @@ public:
             break;
 
         case CmdState::COMMAND_FOUND_BAD_ARGS:
-            AddLog("Wrong arguments. Usage: %s.", cmd->GetHelp());
+            AddLog("Wrong arguments. Usage: %s.", cmd->help);
             break;
         
         case CmdState::COMMAND_HANDLED_DO_NOTHING:
@@ -342,10 +359,49 @@ extern "C" void ExecuteCommand(const char* command)
     g_console.ExecuteCommand(command);
 }
 
+extern "C" CompiledCommand CompileCommand(const char *command)
+{
+    CompiledCommand result = { 0 };
+    result.commandIndex = -1;
+    result.text = (char *)MemAlloc(StringLength(command) + 1);
+    CopyString(result.text, command, StringLength(command) + 1);
+    ListSetMinCapacity((void **)&result.args, 4); // Scripts compile lots of commands, most with just a few arguments.
+    result.name = TokenizeCommand(result.text, &result.args);
+    if (result.name)
+        result.nameHash = HashString(result.name);
+    return result;
+}
+
+extern "C" void UnloadCompiledCommand(CompiledCommand *command)
+{
+    MemFree(command->text);
+    ListDestroy((void **)&command->args);
+    ZeroBytes(command, sizeof command[0]);
+}
+
+extern "C" bool ExecuteCompiledCommand(CompiledCommand *command)
+{
+    if (not command->name)
+        return false;
+
+    // Scripts can be loaded before all of the commands are added, so we only look the command up once it runs.
+    if (command->commandIndex < 0)
+        command->commandIndex = FindCommandIndex(command->name, command->nameHash);
+
+    CmdResult result = g_console.RunCommand(command->commandIndex, command->name, command->args);
+    if (result.state == CmdState::COMMAND_NOT_FOUND)
+        LogWarning("Command '%s' not found.", command->name);
+    else if (result.state == CmdState::COMMAND_FOUND_BAD_ARGS)
+        LogWarning("Wrong arguments for command '%s'. Usage: %s.", command->name, result.cmd->help);
+    return result.state == CmdState::COMMAND_SUCCEEDED or result.state == CmdState::COMMAND_HANDLED_DO_NOTHING;
+}
+
+#ifdef DEV_GUI_ENABLED
 extern "C" void ShowConsoleGui()
 {
     g_console.ShowConsoleGui();
 }
+#endif
 
 extern "C" void ResetConsole()
 {
@@ -353,7 +409,7 @@ extern "C" void ResetConsole()
 }
 void AddConsoleLog(const char* log)
 {
-    g_console.AddLog(log);
+    g_console.AddLog("%s", log);
 }
 void ClearConsoleLog()
 {
@@ -1,8 +1,15 @@
 #include "../core.h"
 
-#include <unordered_map>
+#include <deque>
+#include <vector>
+#include <string>
+#include <algorithm>
 #include <stdio.h>
 
+#ifndef __EMSCRIPTEN__
+#include <mutex>
+#endif
+
 // We basically store all assets in a big table and reference count them.
 // Whenever you call AcquireXXX(path), we check if an asset with that path 
 // already exists in the table, and only load it if it's not already there.
@@ -11,6 +18,25 @@
 //
 // This allows us to have a powerful editor where you can change the sprites
 // and scripts of all objects without any performance loss / asset duplication.
+//
+// Textures, sprites and collision maps can also be streamed. In that case AcquireXXX
+// returns a placeholder right away, and the job threads read and decode the file.
+// The decoded images are then uploaded to the GPU on the main thread, a few per frame,
+// so that loading a big scene doesn't make us miss the frame time.
+// On the web we don't have threads, so the decoding also happens on the main thread,
+// but it still gets spread over multiple frames.
+//
+// Hot reloading only looks at the assets whose files the file watcher reported as changed.
+// If the watcher couldn't be started, we fall back to checking every asset every frame.
+//
+// Assets live in slots that are allocated in blocks which never move, so the pointers we hand out stay valid.
+// Every slot has a generation that goes up whenever an asset moves in or out of it (odd means there's an asset in it),
+// so checking that a pointer or handle still refers to a live asset is just a couple of integer compares.
+// Paths are only hashed when an asset is acquired, and looked up in an open addressed table.
+//
+// When the last reference to an asset is released, it isn't unloaded right away. It goes to the back of the released list instead,
+// and acquiring it again just takes it back out, so going back and forth between scenes doesn't load the same files over and over.
+// Released assets are only unloaded, starting at the front of the list, once they take up more than the cache budget.
 
 ENUM(AssetKind)
 {
@@ -23,11 +49,28 @@ ENUM(AssetKind)
 	ASSET_KIND_ENUM_COUNT,
 };
 
+// Refers to the asset in a slot, as long as that slot still has the same generation.
+STRUCT(AssetHandle)
+{
+	int slot;
+	unsigned generation;
+};
+
+STRUCT(StreamJob)
+{
+	AssetHandle asset; // Stops being valid if the asset is released before the job finished.
+	AssetKind kind;
+	char path[256];
+	List(Image) images; // Decoded on the streaming thread.
+	CollisionMap collisionMap; // Also built on the streaming thread.
+	Wave wave; // Sounds are decoded on the streaming thread, and only handed to the audio device on the main thread.
+};
+
 STRUCT(Asset)
 {
 	union
 	{
-		Image collisionMap;
+		CollisionMap collisionMap;
 		Texture texture;
 		Sprite sprite;
 		Script script;
@@ -38,13 +81,56 @@ STRUCT(Asset)
 	AssetKind kind;
 	char path[256];
 	long lastModTime;
+	StreamJob *job; // Not NULL while the asset is still streaming in, in which case it holds a placeholder.
+	unsigned char *fileData; // Music streams from the file data, so it has to stay around.
+	int fileDataSize;
+	AssetHandle handle;
+	unsigned pathHash;
+	int64_t cpuBytes; // How much memory the asset uses, only kept up to date while the asset is in the released list.
+	int64_t vramBytes;
+	int previousReleased; // Slots in the released list, -1 at the ends.
+	int nextReleased;
 };
 
-// Try to ignore this C++ bullshit :)
-struct Hash { unsigned operator()(const char *string) const { return HashString(string); } };
-struct Equal { bool operator()(const char *a, const char *b) const { return StringsEqual(a, b); } };
+#define ASSET_BLOCK_SIZE 256
+#define MAX_ASSET_BLOCKS 256
+
+static Asset *assetBlocks[MAX_ASSET_BLOCKS];
+static int numAssetSlots;
+static List(int) freeAssetSlots;
 
-static std::unordered_map<const char *, Asset *, Hash, Equal> table;
+// Maps path hashes to slots. Empty entries have slot -1. The capacity is a power of 2 and at most half full.
+STRUCT(AssetTableEntry)
+{
+	unsigned pathHash;
+	int slot;
+};
+static AssetTableEntry *table;
+static int tableCapacity;
+static int numAssets;
+
+// Least recently released first.
+static int firstReleased = -1;
+static int lastReleased = -1;
+static int64_t releasedCpuBytes;
+static int64_t releasedVramBytes;
+static int64_t cpuBudget = 64 << 20;
+static int64_t vramBudget = 128 << 20;
+
+static bool streamingEnabled;
+static Texture placeholderTexture;
+static SpriteFrame placeholderFrame;
+#ifdef __EMSCRIPTEN__
+static std::deque<StreamJob *> pendingJobs; // Waiting to be decoded.
+#endif
+static std::deque<StreamJob *> decodedJobs; // Waiting to be uploaded.
+static int numStreamingAssets;
+static unsigned assetGeneration;
+static unsigned collisionMapGeneration;
+static std::vector<std::string> dirtyAssetPaths; // Reported by the file watcher, but not reloaded yet.
+#ifndef __EMSCRIPTEN__
+static std::mutex streamMutex;
+#endif
 
 static long GetDirectoryModTime(const char *path)
 {
@@ -63,56 +149,496 @@ static long GetDirectoryModTime(const char *path)
 }
 static long GetFileOrDirectoryModTime(const char *path)
 {
+	if (not FileExists(path))
+		return 0; // It's in a resource pack, those never change.
 	if (IsPathFile(path))
 		return GetFileModTime(path);
 	else
 		return GetDirectoryModTime(path);
 }
+static Asset *GetAssetSlot(int slot)
+{
+	return &assetBlocks[slot / ASSET_BLOCK_SIZE][slot % ASSET_BLOCK_SIZE];
+}
+static bool IsAssetHandleValid(AssetHandle handle)
+{
+	return handle.slot >= 0 and handle.slot < numAssetSlots and GetAssetSlot(handle.slot)->handle.generation == handle.generation;
+}
+static Asset *FindAsset(const char *path, unsigned pathHash)
+{
+	if (tableCapacity == 0)
+		return NULL;
+
+	for (int i = (int)(pathHash & (unsigned)(tableCapacity - 1));; i = (i + 1) & (tableCapacity - 1))
+	{
+		AssetTableEntry *entry = &table[i];
+		if (entry->slot < 0)
+			return NULL;
+		if (entry->pathHash == pathHash)
+		{
+			Asset *asset = GetAssetSlot(entry->slot);
+			if (StringsEqual(asset->path, path))
+				return asset;
+		}
+	}
+}
+static void InsertIntoAssetTable(unsigned pathHash, int slot)
+{
+	for (int i = (int)(pathHash & (unsigned)(tableCapacity - 1));; i = (i + 1) & (tableCapacity - 1))
+	{
+		if (table[i].slot < 0)
+		{
+			table[i].pathHash = pathHash;
+			table[i].slot = slot;
+			return;
+		}
+	}
+}
+static void AddToAssetTable(Asset *asset)
+{
+	if (2 * (numAssets + 1) > tableCapacity)
+	{
+		AssetTableEntry *oldTable = table;
+		int oldCapacity = tableCapacity;
+		tableCapacity = tableCapacity ? 2 * tableCapacity : 256;
+		table = (AssetTableEntry *)MemAlloc(tableCapacity * (int)sizeof table[0]);
+		for (int i = 0; i < tableCapacity; ++i)
+			table[i].slot = -1;
+		for (int i = 0; i < oldCapacity; ++i)
+			if (oldTable[i].slot >= 0)
+				InsertIntoAssetTable(oldTable[i].pathHash, oldTable[i].slot);
+		MemFree(oldTable);
+	}
+
+	InsertIntoAssetTable(asset->pathHash, asset->handle.slot);
+	++numAssets;
+}
+static void RemoveFromAssetTable(Asset *asset)
+{
+	int i = (int)(asset->pathHash & (unsigned)(tableCapacity - 1));
+	while (table[i].slot != asset->handle.slot)
+		i = (i + 1) & (tableCapacity - 1);
+
+	// Linear probing without tombstones: move later entries of the same probe run back into the hole,
+	// unless their home position comes after the hole, in which case they can stay where they are.
+	for (int j = i;;)
+	{
+		table[i].slot = -1;
+		for (;;)
+		{
+			j = (j + 1) & (tableCapacity - 1);
+			if (table[j].slot < 0)
+			{
+				--numAssets;
+				return;
+			}
+			int home = (int)(table[j].pathHash & (unsigned)(tableCapacity - 1));
+			bool canStay = (i <= j) ? (i < home and home <= j) : (i < home or home <= j);
+			if (not canStay)
+				break;
+		}
+		table[i] = table[j];
+		i = j;
+	}
+}
+static Asset *AllocateAssetSlot(void)
+{
+	int slot;
+	if (ListCount(freeAssetSlots) > 0)
+		slot = ListPop(&freeAssetSlots);
+	else
+	{
+		if (numAssetSlots == ASSET_BLOCK_SIZE * MAX_ASSET_BLOCKS)
+			Crash("Too many assets, the limit is %d.", ASSET_BLOCK_SIZE * MAX_ASSET_BLOCKS);
+		slot = numAssetSlots++;
+		Asset **block = &assetBlocks[slot / ASSET_BLOCK_SIZE];
+		if (not *block)
+		{
+			*block = (Asset *)MemAlloc(ASSET_BLOCK_SIZE * (int)sizeof(Asset));
+			ZeroBytes(*block, ASSET_BLOCK_SIZE * (int)sizeof(Asset));
+		}
+		GetAssetSlot(slot)->handle.slot = slot;
+	}
+
+	Asset *asset = GetAssetSlot(slot);
+	++asset->handle.generation;
+	return asset;
+}
+static void FreeAssetSlot(Asset *asset)
+{
+	RemoveFromAssetTable(asset);
+	++asset->handle.generation;
+	asset->referenceCount = 0;
+	ListAdd(&freeAssetSlots, asset->handle.slot);
+}
+static void GetAssetBytes(const Asset *asset, int64_t *outCpuBytes, int64_t *outVramBytes)
+{
+	int64_t cpu = 0;
+	int64_t vram = 0;
+	switch (asset->kind)
+	{
+		case COLLISION_MAP: cpu = (int64_t)asset->collisionMap.wordsPerRow * asset->collisionMap.height * (int64_t)sizeof(uint32_t); break;
+		case TEXTURE:
+		{
+			Texture t = asset->texture;
+			vram = GetPixelDataSize(t.width, t.height, t.format);
+		} break;
+		case SPRITE:
+		{
+			// Frames only take up their part of the atlas page.
+			cpu = asset->sprite.numFrames * (int64_t)sizeof(SpriteFrame);
+			for (int i = 0; i < asset->sprite.numFrames; ++i)
+			{
+				SpriteFrame frame = asset->sprite.frames[i];
+				vram += GetPixelDataSize((int)frame.source.width, (int)frame.source.height, frame.texture.format);
+			}
+		} break;
+		case SCRIPT:
+		{
+			const Script *script = &asset->script;
+			cpu += script->numParagraphs * (int64_t)sizeof script->paragraphs[0];
+			cpu += script->numCodepoints * (int64_t)sizeof script->codepoints[0];
+			cpu += script->numExpressionChanges * (int64_t)sizeof script->expressionChanges[0];
+			cpu += script->stringPoolSize;
+			if (script->text)
+				cpu += StringLength(script->text) + 1;
+		} break;
+		case SOUND:
+		{
+			Sound sound = asset->sound;
+			cpu = (int64_t)sound.frameCount * sound.stream.channels * (sound.stream.sampleSize / 8);
+		} break;
+		case MUSIC: cpu = asset->fileDataSize; break;
+		default: break;
+	}
+	*outCpuBytes = cpu;
+	*outVramBytes = vram;
+}
+static void UnloadAsset(Asset *asset)
+{
+	// If it's still streaming, all we have is a placeholder. The job will see that the slot's generation changed and clean up after itself.
+	if (not asset->job) switch (asset->kind)
+	{
+		case COLLISION_MAP: UnloadCollisionMap(asset->collisionMap); break;
+		case TEXTURE:       UnloadTexture(asset->texture);    break;
+		case SPRITE:        UnloadSprite(asset->sprite);      break;
+		case SCRIPT:        UnloadScript(&asset->script);     break;
+		case SOUND:         UnloadSound(asset->sound);        break;
+		case MUSIC:         UnloadMusicStream(asset->music);  break;
+		default: break;
+	}
+	if (asset->fileData)
+		UnloadFileData(asset->fileData);
+
+	FreeAssetSlot(asset);
+}
+static void RemoveFromReleased(Asset *asset)
+{
+	if (asset->previousReleased >= 0)
+		GetAssetSlot(asset->previousReleased)->nextReleased = asset->nextReleased;
+	else
+		firstReleased = asset->nextReleased;
+	if (asset->nextReleased >= 0)
+		GetAssetSlot(asset->nextReleased)->previousReleased = asset->previousReleased;
+	else
+		lastReleased = asset->previousReleased;
+
+	releasedCpuBytes -= asset->cpuBytes;
+	releasedVramBytes -= asset->vramBytes;
+}
+static void EvictReleasedAssets(void)
+{
+	while (firstReleased >= 0 and (releasedCpuBytes > cpuBudget or releasedVramBytes > vramBudget))
+	{
+		Asset *asset = GetAssetSlot(firstReleased);
+		RemoveFromReleased(asset);
+		UnloadAsset(asset);
+	}
+}
+static void AddToReleased(Asset *asset)
+{
+	GetAssetBytes(asset, &asset->cpuBytes, &asset->vramBytes);
+	asset->previousReleased = lastReleased;
+	asset->nextReleased = -1;
+	if (lastReleased >= 0)
+		GetAssetSlot(lastReleased)->nextReleased = asset->handle.slot;
+	else
+		firstReleased = asset->handle.slot;
+	lastReleased = asset->handle.slot;
+
+	releasedCpuBytes += asset->cpuBytes;
+	releasedVramBytes += asset->vramBytes;
+	EvictReleasedAssets();
+}
 static bool AcquireAsset(const char *path, AssetKind kind, Asset **outResult)
 {
 	*outResult = NULL;
 	if (not path or not path[0])
 		return false;
 
-	auto iterator = table.find(path);
-	if (iterator != table.end())
+	unsigned pathHash = HashString(path);
+	Asset *found = FindAsset(path, pathHash);
+	if (found)
 	{
-		Asset *asset = iterator->second;
+		Asset *asset = found;
 		ASSERT(asset->kind == kind);
 
+		if (asset->referenceCount == 0)
+			RemoveFromReleased(asset); // Still loaded from before, so this is free.
+
 		++asset->referenceCount;
 		*outResult = asset;
 		return true;
 	}
 
-	if (not FileExists(path))
+	if (not ResourceExists(path))
 		return false;
 
-	Asset *asset = new Asset;
+	Asset *asset = AllocateAssetSlot();
 	asset->kind = kind;
 	asset->referenceCount = 1;
 	asset->lastModTime = GetFileOrDirectoryModTime(path);
+	asset->job = NULL;
+	asset->fileData = NULL;
+	asset->fileDataSize = 0;
 
 	ASSERT(StringLength(path) < sizeof asset->path - 1);
 	CopyString(asset->path, path, sizeof asset->path);
-
-	table.insert({ asset->path, asset });
+	asset->pathHash = pathHash;
+	AddToAssetTable(asset);
 
 	*outResult = asset;
 	return false;
 }
+// Textures with a baked compressed version get uploaded straight from the compressed blocks, without decoding the image.
+static Texture UploadTexture(Image image)
+{
+	Texture texture = UploadTextureImage(image);
+	SetTextureFilter(texture, TEXTURE_FILTER_BILINEAR);
+	SetTextureWrap(texture, TEXTURE_WRAP_CLAMP);
+	return texture;
+}
+static Texture LoadTextureAsset(const char *path)
+{
+	Image image = LoadTextureImage(path);
+	Texture texture = UploadTexture(image);
+	UnloadImage(image);
+	return texture;
+}
+static void DecodeStreamJob(StreamJob *job)
+{
+	switch (job->kind)
+	{
+		case COLLISION_MAP: job->collisionMap = LoadCollisionMap(job->path); break;
+		case TEXTURE: ListAdd(&job->images, LoadTextureImage(job->path)); break;
+		case SPRITE:  job->images = LoadSpriteImages(job->path);  break;
+		case SOUND:   job->wave = LoadWave(job->path); break;
+		default: ASSERT(false); break; // Only images and sounds are streamed.
+	}
+}
+static void FinishStreamJob(StreamJob *job)
+{
+	if (IsAssetHandleValid(job->asset))
+	{
+		Asset *asset = GetAssetSlot(job->asset.slot);
+		switch (job->kind)
+		{
+			case COLLISION_MAP:
+			{
+				// Collision maps never leave the CPU, so we just take over the mask.
+				asset->collisionMap = job->collisionMap;
+				asset->collisionMap.generation = ++collisionMapGeneration;
+				job->collisionMap = CollisionMap{ 0 };
+			} break;
+
+			case TEXTURE: asset->texture = UploadTexture(job->images[0]); break;
+
+			case SPRITE: asset->sprite = LoadSpriteFromImages(job->images, ListCount(job->images)); break;
+
+			case SOUND: asset->sound = LoadSoundFromWave(job->wave); break;
+			default: break;
+		}
+		asset->job = NULL;
+		++assetGeneration;
+	}
+
+	for (int i = 0; i < ListCount(job->images); ++i)
+		UnloadImage(job->images[i]);
+	ListDestroy((void **)&job->images);
+	UnloadCollisionMap(job->collisionMap);
+	UnloadWave(job->wave);
+	delete job;
+	--numStreamingAssets;
+}
+#ifndef __EMSCRIPTEN__
+static void DecodeStreamJobTask(void *userData)
+{
+	// The job threads never touch the asset, that belongs to the main thread.
+	StreamJob *job = (StreamJob *)userData;
+	DecodeStreamJob(job);
+
+	std::lock_guard<std::mutex> lock(streamMutex);
+	decodedJobs.push_back(job);
+}
+#endif
+static void StartStreaming(Asset *asset)
+{
+	if (not placeholderTexture.id)
+	{
+		Image blank = GenImageColor(1, 1, BLANK);
+		placeholderTexture = LoadTextureFromImage(blank);
+		UnloadImage(blank);
+		placeholderFrame.texture = placeholderTexture;
+		placeholderFrame.source = Rectangle{ 0, 0, 1, 1 };
+	}
+
+	// The placeholder has to behave like a real asset, because the game will start using it right away.
+	switch (asset->kind)
+	{
+		case COLLISION_MAP: asset->collisionMap = CollisionMap{ 0 }; break;
+		case TEXTURE:       asset->texture = placeholderTexture; break;
+		case SPRITE:
+		{
+			asset->sprite.numFrames = 1;
+			asset->sprite.frames = &placeholderFrame;
+		} break;
+		// An empty sound, the voices wait for the real one.
+		case SOUND:         asset->sound = Sound{ 0 }; break;
+		default: ASSERT(false); break;
+	}
+
+	StreamJob *job = new StreamJob{};
+	job->asset = asset->handle;
+	job->kind = asset->kind;
+	CopyString(job->path, asset->path, sizeof job->path);
+	asset->job = job;
+	++numStreamingAssets;
+
+	#ifdef __EMSCRIPTEN__
+	{
+		pendingJobs.push_back(job);
+	}
+	#else
+	{
+		RunJob(NULL, DecodeStreamJobTask, job);
+	}
+	#endif
+}
+// Returns false if the asset changed but couldn't be reloaded yet, so we should try again later.
+static bool TryHotReload(Asset *asset)
+{
+	if (asset->job)
+		return true; // Still streaming in, and what's streaming in is already the latest version.
+
+	if (not FileExists(asset->path))
+		return true;
+
+	long modTime = GetFileOrDirectoryModTime(asset->path);
+	if (modTime == asset->lastModTime)
+		return true;
+
+	if (asset->referenceCount == 0)
+	{
+		// Nobody is using it, so there's no point in reloading it now. It'll just be loaded again the next time it's acquired.
+		RemoveFromReleased(asset);
+		UnloadAsset(asset);
+		return true;
+	}
+
+	// Sometimes it takes while before the file being updated is completely written.
+	// Until it's completely written, the program that's changing the file holds a lock on the file, so we can't open it.
+	// If that happens, we just skip it for now, eventually it will release the lock and we will be able to open it.
+	List(FILE *) files = NULL;
+	ListSetAllocator((void **)&files, TempRealloc, TempFree);
+
+	if (not IsPathFile(asset->path))
+	{
+		FilePathList contents = LoadDirectoryFiles(asset->path);
+		for (unsigned i = 0; i < contents.count; ++i)
+			ListAdd(&files, fopen(contents.paths[i], "rb"));
+		UnloadDirectoryFiles(contents);
+	}
+	else ListAdd(&files, fopen(asset->path, "rb"));
+
+	bool allOpenSuccessfully = true;
+	for (int i = 0; i < ListCount(files); ++i)
+	{
+		if (not files[i])
+		{
+			allOpenSuccessfully = false;
+			break;
+		}
+	}
+
+	if (not allOpenSuccessfully)
+	{
+		for (int i = 0; i < ListCount(files); ++i)
+			if (files[i])
+				fclose(files[i]);
+		return false;
+	}
+
+	switch (asset->kind)
+	{
+		case COLLISION_MAP:
+		{
+			UnloadCollisionMap(asset->collisionMap);
+			asset->collisionMap = LoadCollisionMap(asset->path);
+			asset->collisionMap.generation = ++collisionMapGeneration;
+		} break;
+
+		case TEXTURE:
+		{
+			UnloadTexture(asset->texture);
+			asset->texture = LoadTextureAsset(asset->path);
+		} break;
+
+		case SPRITE:
+		{
+			UnloadSprite(asset->sprite);
+			asset->sprite = LoadSprite(asset->path);
+		} break;
+
+		case SCRIPT:
+		{
+			FontFace regular    = asset->script.font;
+			FontFace bold       = asset->script.boldFont;
+			FontFace italic     = asset->script.italicFont;
+			FontFace boldItalic = asset->script.boldItalicFont;
+			UnloadScript(&asset->script);
+			asset->script = LoadScript(asset->path, regular, bold, italic, boldItalic);
+		} break;
+
+		// Sounds could be playing right now, and music streams from its file data, so swapping them out isn't supported.
+		case SOUND:
+		case MUSIC:
+		{
+			LogWarning("'%s' changed, but sounds and music can't be hot reloaded. Restart the game to hear the new version.", asset->path);
+		} break;
+
+		case ASSET_KIND_ENUM_COUNT: ASSERT(false); break;
+	}
+
+	// Aparently if you don't keep a file handle open the whole time we sometimes fail to load.. I have no clue why.
+	for (int i = 0; i < ListCount(files); ++i)
+		fclose(files[i]);
+	asset->lastModTime = modTime;
+	++assetGeneration;
+	return true;
+}
 static bool IsAsset(Asset *asset)
 {
+	// The asset is the first thing in its slot, so whatever the game passes in has to point exactly at a slot with an odd generation.
 	return
 		asset and
-		asset->kind >= 0 and asset->kind < ASSET_KIND_ENUM_COUNT and
-		asset->referenceCount >= 0 and
-		table.find(asset->path) != table.end();
+		asset->handle.slot >= 0 and asset->handle.slot < numAssetSlots and
+		GetAssetSlot(asset->handle.slot) == asset and
+		(asset->handle.generation & 1);
 }
 
 extern "C"
 {
-	Image *AcquireCollisionMap(const char *path)
+	CollisionMap *AcquireCollisionMap(const char *path)
 	{
 		Asset *asset;
 		if (AcquireAsset(path, COLLISION_MAP, &asset))
@@ -120,8 +646,13 @@ extern "C"
 		if (not asset)
 			return NULL;
 
-		asset->collisionMap = LoadImage(path);
-		ImageFormat(&asset->collisionMap, PIXELFORMAT_UNCOMPRESSED_GRAYSCALE);
+		if (streamingEnabled)
+		{
+			StartStreaming(asset);
+			return &asset->collisionMap;
+		}
+
+		asset->collisionMap = LoadCollisionMap(path);
 		return &asset->collisionMap;
 	}
 
@@ -133,6 +664,12 @@ extern "C"
 		if (not asset)
 			return NULL;
 
+		if (streamingEnabled)
+		{
+			StartStreaming(asset);
+			return &asset->sprite;
+		}
+
 		asset->sprite = LoadSprite(path);
 		return &asset->sprite;
 	}
@@ -145,13 +682,17 @@ extern "C"
 		if (not asset)
 			return NULL;
 
-		asset->texture = LoadTexture(path);
-		SetTextureFilter(asset->texture, TEXTURE_FILTER_BILINEAR);
-		SetTextureWrap(asset->texture, TEXTURE_WRAP_CLAMP);
+		if (streamingEnabled)
+		{
+			StartStreaming(asset);
+			return &asset->texture;
+		}
+
+		asset->texture = LoadTextureAsset(path);
 		return &asset->texture;
 	}
 
-	Script *AcquireScript(const char *path, Font regular, Font bold, Font italic, Font boldItalic)
+	Script *AcquireScript(const char *path, FontFace regular, FontFace bold, FontFace italic, FontFace boldItalic)
 	{
 		Asset *asset;
 		if (AcquireAsset(path, SCRIPT, &asset))
@@ -163,7 +704,28 @@ extern "C"
 		return &asset->script;
 	}
 
-	Music *AcquireMusic(const char *path);
+	Music *AcquireMusic(const char *path)
+	{
+		Asset *asset;
+		if (AcquireAsset(path, MUSIC, &asset))
+			return &asset->music;
+		if (not asset)
+			return NULL;
+
+		// raylib reads music files straight from disk, which would skip the resource packs, so we give it the data ourselves.
+		// Music only decodes the bit that's about to play, so this is just the compressed file in memory.
+		unsigned size = 0;
+		asset->fileData = LoadFileData(path, &size);
+		asset->fileDataSize = (int)size;
+		asset->music = LoadMusicStreamFromMemory(GetFileExtension(path), asset->fileData, (int)size);
+		if (not asset->music.ctxData)
+		{
+			// Not worth caching, it would just fail the same way next time.
+			UnloadAsset(asset);
+			return NULL;
+		}
+		return &asset->music;
+	}
 
 	Sound *AcquireSound(const char *path)
 	{
@@ -173,10 +735,22 @@ extern "C"
 		if (not asset)
 			return NULL;
 
+		if (streamingEnabled)
+		{
+			StartStreaming(asset);
+			return &asset->sound;
+		}
+
 		asset->sound = LoadSound(path);
 		return &asset->sound;
 	}
 
+	bool IsAssetStreaming(const void *asset)
+	{
+		const Asset *a = (const Asset *)asset;
+		return a and a->job != NULL;
+	}
+
 	void ReleaseAsset(void *asset)
 	{
 		if (not asset)
@@ -192,16 +766,11 @@ extern "C"
 		if (a->referenceCount > 0)
 			return;
 
-		switch (a->kind)
-		{
-			case COLLISION_MAP: UnloadImage(a->collisionMap); break;
-			case TEXTURE:       UnloadTexture(a->texture);    break;
-			case SCRIPT:        UnloadScript(&a->script);     break;
-			case SOUND:         UnloadSound(a->sound);        break;
-		}
-
-		table.erase(a->path);
-		delete a;
+		// A placeholder isn't worth keeping around.
+		if (a->job)
+			UnloadAsset(a);
+		else
+			AddToReleased(a);
 	}
 
 	void *CloneAsset(void *asset)
@@ -209,10 +778,79 @@ extern "C"
 		Asset *a = (Asset *)asset;
 		if (not IsAsset(a))
 			return NULL;
+		if (a->referenceCount == 0)
+			RemoveFromReleased(a);
 		++a->referenceCount;
 		return a;
 	}
 
+	void SetAssetCacheBudget(int64_t cpuBytes, int64_t vramBytes)
+	{
+		cpuBudget = cpuBytes;
+		vramBudget = vramBytes;
+		EvictReleasedAssets();
+	}
+
+	#ifdef DEV_GUI_ENABLED
+	void ShowAssetWindow(void)
+	{
+		static const char *const kindNames[ASSET_KIND_ENUM_COUNT] = { "Collision maps", "Textures", "Sprites", "Scripts", "Music", "Sounds" };
+
+		int numUsed[ASSET_KIND_ENUM_COUNT] = { 0 };
+		int numReleased[ASSET_KIND_ENUM_COUNT] = { 0 };
+		int64_t cpuBytes[ASSET_KIND_ENUM_COUNT] = { 0 };
+		int64_t vramBytes[ASSET_KIND_ENUM_COUNT] = { 0 };
+		for (int i = 0; i < numAssetSlots; ++i)
+		{
+			Asset *asset = GetAssetSlot(i);
+			if (not IsAsset(asset) or asset->job)
+				continue;
+
+			int64_t cpu, vram;
+			GetAssetBytes(asset, &cpu, &vram);
+			cpuBytes[asset->kind] += cpu;
+			vramBytes[asset->kind] += vram;
+			if (asset->referenceCount > 0)
+				++numUsed[asset->kind];
+			else
+				++numReleased[asset->kind];
+		}
+
+		ImGui::Begin("Assets");
+		{
+			ImGui::Text("Released: %.1f / %.1f MB CPU, %.1f / %.1f MB VRAM", releasedCpuBytes / 1048576.0, cpuBudget / 1048576.0, releasedVramBytes / 1048576.0, vramBudget / 1048576.0);
+			if (ImGui::Button("Unload released"))
+			{
+				int64_t cpu = cpuBudget;
+				int64_t vram = vramBudget;
+				SetAssetCacheBudget(0, 0);
+				SetAssetCacheBudget(cpu, vram);
+			}
+
+			if (ImGui::BeginTable("Resident", 5, ImGuiTableFlags_Borders))
+			{
+				ImGui::TableSetupColumn("Kind");
+				ImGui::TableSetupColumn("Used");
+				ImGui::TableSetupColumn("Released");
+				ImGui::TableSetupColumn("CPU kB");
+				ImGui::TableSetupColumn("VRAM kB");
+				ImGui::TableHeadersRow();
+				for (int kind = 0; kind < ASSET_KIND_ENUM_COUNT; ++kind)
+				{
+					ImGui::TableNextRow();
+					ImGui::TableNextColumn(); ImGui::TextUnformatted(kindNames[kind]);
+					ImGui::TableNextColumn(); ImGui::Text("%d", numUsed[kind]);
+					ImGui::TableNextColumn(); ImGui::Text("%d", numReleased[kind]);
+					ImGui::TableNextColumn(); ImGui::Text("%lld", (long long)(cpuBytes[kind] / 1024));
+					ImGui::TableNextColumn(); ImGui::Text("%lld", (long long)(vramBytes[kind] / 1024));
+				}
+				ImGui::EndTable();
+			}
+		}
+		ImGui::End();
+	}
+	#endif
+
 	const char *GetAssetPath(const void *asset)
 	{
 		Asset *a = (Asset *)asset;
@@ -223,87 +861,113 @@ extern "C"
 
 	void UpdateAllChangedAssets(void)
 	{
-		for (auto &keyval : table)
+		#ifndef __EMSCRIPTEN__
 		{
-			Asset *asset = keyval.second;
-			if (asset->kind == SOUND or asset->kind == MUSIC)
-				continue; // We don't hot reload these.
-
-			if (not FileExists(asset->path))
-				continue;
-
-			long modTime = GetFileOrDirectoryModTime(asset->path);
-			if (modTime == asset->lastModTime)
-				continue;
-
-			// Sometimes it takes while before the file being updated is completely written.
-			// Until it's completely written, the program that's changing the file holds a lock on the file, so we can't open it.
-			// If that happens, we just skip it for now, eventually it will release the lock and we will be able to open it.
-			List(FILE *) files = NULL;
-			ListSetAllocator((void **)&files, TempRealloc, TempFree);
+			static bool isWatcherStarted;
+			static bool isWatching;
+			if (not isWatcherStarted)
+			{
+				isWatching = StartWatchingDirectory(".");
+				isWatcherStarted = true;
+			}
 
-			if (not IsPathFile(asset->path))
+			if (not isWatching)
 			{
-				FilePathList contents = LoadDirectoryFiles(asset->path);
-				for (unsigned i = 0; i < contents.count; ++i)
-					ListAdd(&files, fopen(contents.paths[i], "rb"));
-				UnloadDirectoryFiles(contents);
+				// No file watcher, so we have to check everything ourselves.
+				for (int i = 0; i < numAssetSlots; ++i)
+					if (IsAsset(GetAssetSlot(i)))
+						TryHotReload(GetAssetSlot(i));
+				return;
 			}
-			else ListAdd(&files, fopen(asset->path, "rb"));
 
-			bool allOpenSuccessfully = true;
-			for (int i = 0; i < ListCount(files); ++i)
+			// A changed file can be an asset by itself, or one of the frames inside of a sprite directory.
+			char changed[256];
+			while (PollChangedFile(changed, sizeof changed))
 			{
-				if (not files[i])
+				for (char *end = changed + StringLength(changed);;)
 				{
-					allOpenSuccessfully = false;
-					break;
+					*end = 0;
+					std::string path = changed;
+					if (std::find(dirtyAssetPaths.begin(), dirtyAssetPaths.end(), path) == dirtyAssetPaths.end())
+						dirtyAssetPaths.push_back(path);
+
+					while (end > changed and *end != '/')
+						--end;
+					if (end == changed)
+						break;
 				}
 			}
 
-			if (not allOpenSuccessfully)
+			// We look the assets up by path every time because they could have been released in the meantime.
+			for (size_t i = 0; i < dirtyAssetPaths.size();)
 			{
-				for (int i = 0; i < ListCount(files); ++i)
-					if (files[i])
-						fclose(files[i]);
-				continue;
+				const char *path = dirtyAssetPaths[i].c_str();
+				Asset *asset = FindAsset(path, HashString(path));
+				if (not asset or TryHotReload(asset))
+				{
+					dirtyAssetPaths[i] = dirtyAssetPaths.back();
+					dirtyAssetPaths.pop_back();
+				}
+				else ++i;
 			}
+		}
+		#endif
+	}
+
+	void SetAssetStreaming(bool enabled)
+	{
+		streamingEnabled = enabled;
+	}
 
-			switch (asset->kind)
+	void UpdateStreamingAssets(double timeBudget)
+	{
+		double start = GetTime();
+		while (numStreamingAssets > 0)
+		{
+			StreamJob *job = NULL;
+			#ifdef __EMSCRIPTEN__
 			{
-				case COLLISION_MAP:
+				if (not pendingJobs.empty())
 				{
-					UnloadImage(asset->collisionMap);
-					asset->collisionMap = LoadImage(asset->path);
-				} break;
-
-				case TEXTURE:
+					job = pendingJobs.front();
+					pendingJobs.pop_front();
+					DecodeStreamJob(job);
+				}
+			}
+			#else
+			{
+				std::lock_guard<std::mutex> lock(streamMutex);
+				if (not decodedJobs.empty())
 				{
-					UnloadTexture(asset->texture);
-					asset->texture = LoadTexture(asset->path);
-				} break;
+					job = decodedJobs.front();
+					decodedJobs.pop_front();
+				}
+			}
+			#endif
 
-				case SPRITE:
-				{
-					UnloadSprite(asset->sprite);
-					asset->sprite = LoadSprite(asset->path);
-				} break;
+			if (not job)
+				break; // Everything that was decoded so far is done, the rest is still being decoded.
 
-				case SCRIPT:
-				{
-					Font regular    = asset->script.font;
-					Font bold       = asset->script.boldFont;
-					Font italic     = asset->script.italicFont;
-					Font boldItalic = asset->script.boldItalicFont;
-					UnloadScript(&asset->script);
-					asset->script = LoadScript(asset->path, regular, bold, italic, boldItalic);
-				} break;
-			}
+			FinishStreamJob(job);
 
-			// Aparently if you don't keep a file handle open the whole time we sometimes fail to load.. I have no clue why.
-			for (int i = 0; i < ListCount(files); ++i)
-				fclose(files[i]);
-			asset->lastModTime = modTime;
+			// We always finish at least one job per frame, so we never get stuck even if a single upload takes longer than the budget.
+			if (GetTime() - start >= timeBudget)
+				break;
 		}
 	}
+
+	int GetNumStreamingAssets(void)
+	{
+		return numStreamingAssets;
+	}
+
+	unsigned GetAssetGeneration(void)
+	{
+		return assetGeneration;
+	}
+
+	unsigned GetCollisionMapGeneration(void)
+	{
+		return collisionMapGeneration;
+	}
 }
@@ -0,0 +1,173 @@
+#include "../core.h"
+
+#define STB_RECT_PACK_IMPLEMENTATION
+#define STBRP_STATIC
+#include "../lib/imgui/imstb_rectpack.h"
+
+// All sprite frames get packed into a couple of big atlas pages, so that drawing
+// a whole scene mostly keeps using the same texture and rlgl doesn't have to
+// flush its batch for every single object.
+//
+// The rect packer can't free individual rects, so a removed frame's space stays
+// taken until every frame in its page is removed, and then the whole page goes away.
+// That's mostly an issue while hot reloading, which isn't something we care about in the shipped game.
+
+// WebGL only guarantees tiny textures, but in practice everything supports 2048.
+#define ATLAS_PAGE_SIZE 2048
+
+// The edge pixels of every frame are repeated into this border, so that bilinear filtering
+// never samples a neighboring frame.
+#define ATLAS_PADDING 1
+
+STRUCT(AtlasPage)
+{
+	Texture texture;
+	int numFrames;
+	bool isDedicated; // The page only holds one image that was too big to share a page.
+	stbrp_context context;
+	stbrp_node nodes[ATLAS_PAGE_SIZE];
+};
+
+static List(AtlasPage *) pages;
+
+static AtlasPage *CreatePage(int width, int height)
+{
+	AtlasPage *page = MemAlloc(sizeof page[0]);
+	page->texture.id = rlLoadTexture(NULL, width, height, PIXELFORMAT_UNCOMPRESSED_R8G8B8A8, 1);
+	page->texture.width = width;
+	page->texture.height = height;
+	page->texture.mipmaps = 1;
+	page->texture.format = PIXELFORMAT_UNCOMPRESSED_R8G8B8A8;
+	SetTextureWrap(page->texture, TEXTURE_WRAP_CLAMP);
+	SetTextureFilter(page->texture, TEXTURE_FILTER_BILINEAR);
+	stbrp_init_target(&page->context, width, height, page->nodes, COUNTOF(page->nodes));
+	ListAdd(&pages, page);
+	return page;
+}
+
+static Image PadImage(Image image)
+{
+	Image copy = ImageCopy(image);
+	ImageFormat(&copy, PIXELFORMAT_UNCOMPRESSED_R8G8B8A8);
+
+	Image padded = { 0 };
+	padded.width = image.width + 2 * ATLAS_PADDING;
+	padded.height = image.height + 2 * ATLAS_PADDING;
+	padded.mipmaps = 1;
+	padded.format = PIXELFORMAT_UNCOMPRESSED_R8G8B8A8;
+	padded.data = MemAlloc(padded.width * padded.height * sizeof(Color));
+
+	const Color *from = copy.data;
+	Color *to = padded.data;
+	for (int y = 0; y < padded.height; ++y)
+	{
+		int fromY = ClampInt(y - ATLAS_PADDING, 0, image.height - 1);
+		for (int x = 0; x < padded.width; ++x)
+		{
+			int fromX = ClampInt(x - ATLAS_PADDING, 0, image.width - 1);
+			to[y * padded.width + x] = from[fromY * image.width + fromX];
+		}
+	}
+
+	UnloadImage(copy);
+	return padded;
+}
+
+// Compressed images can't be copied into an uncompressed page, so they are uploaded as they are into a page of their own.
+// The blocks past the edge of the image repeat the edge pixels, so they work as padding.
+static SpriteFrame AddCompressedImageToAtlas(Image image)
+{
+	SpriteFrame frame = { 0 };
+	Texture texture = UploadTextureImage(image);
+	if (not texture.id)
+		return frame;
+
+	AtlasPage *page = MemAlloc(sizeof page[0]);
+	page->texture = texture;
+	page->numFrames = 1;
+	page->isDedicated = true;
+	SetTextureWrap(page->texture, TEXTURE_WRAP_CLAMP);
+	SetTextureFilter(page->texture, TEXTURE_FILTER_BILINEAR);
+	ListAdd(&pages, page);
+
+	frame.texture = page->texture;
+	frame.source = (Rectangle){ 0, 0, (float)image.width, (float)image.height };
+	return frame;
+}
+
+SpriteFrame AddImageToAtlas(Image image)
+{
+	SpriteFrame frame = { 0 };
+	if (not image.data or image.width <= 0 or image.height <= 0)
+		return frame;
+
+	if (image.format >= PIXELFORMAT_COMPRESSED_DXT1_RGB)
+		return AddCompressedImageToAtlas(image);
+
+	Image padded = PadImage(image);
+	stbrp_rect rect = { 0 };
+	rect.w = padded.width;
+	rect.h = padded.height;
+
+	AtlasPage *page = NULL;
+	if (padded.width > ATLAS_PAGE_SIZE or padded.height > ATLAS_PAGE_SIZE)
+	{
+		page = CreatePage(padded.width, padded.height);
+		page->isDedicated = true;
+	}
+	else
+	{
+		for (int i = 0; i < ListCount(pages) and not page; ++i)
+			if (not pages[i]->isDedicated and stbrp_pack_rects(&pages[i]->context, &rect, 1))
+				page = pages[i];
+
+		if (not page)
+		{
+			page = CreatePage(ATLAS_PAGE_SIZE, ATLAS_PAGE_SIZE);
+			stbrp_pack_rects(&page->context, &rect, 1);
+			ASSERT(rect.was_packed);
+		}
+	}
+
+	Rectangle destination = { (float)rect.x, (float)rect.y, (float)padded.width, (float)padded.height };
+	UpdateTextureRec(page->texture, destination, padded.data);
+	UnloadImage(padded);
+	++page->numFrames;
+
+	frame.texture = page->texture;
+	frame.source.x = (float)(rect.x + ATLAS_PADDING);
+	frame.source.y = (float)(rect.y + ATLAS_PADDING);
+	frame.source.width = (float)image.width;
+	frame.source.height = (float)image.height;
+	return frame;
+}
+
+void RemoveFromAtlas(SpriteFrame frame)
+{
+	if (not frame.texture.id)
+		return;
+
+	for (int i = 0; i < ListCount(pages); ++i)
+	{
+		AtlasPage *page = pages[i];
+		if (page->texture.id != frame.texture.id)
+			continue;
+
+		ASSERT(page->numFrames > 0);
+		--page->numFrames;
+		if (page->numFrames <= 0)
+		{
+			UnloadTexture(page->texture);
+			MemFree(page);
+			ListSwapRemove(&pages, i);
+		}
+		return;
+	}
+
+	LogWarning("Tried to remove a sprite frame that isn't in any atlas page.");
+}
+
+int GetNumAtlasPages(void)
+{
+	return ListCount(pages);
+}
@@ -91,10 +91,46 @@ void WriteString(BinaryStream *stream, const char *s)
 
 void WriteBytes(BinaryStream *stream, const void *bytes, int numBytesToWrite)
 {
+	if (stream->hasFailed or numBytesToWrite < 0)
+	{
+		stream->hasFailed = true;
+		return;
+	}
+
 	int bytesRemaining = stream->size - stream->cursor;
 	if (bytesRemaining < numBytesToWrite)
-		return;
+	{
+		if (not stream->canGrow or numBytesToWrite > INT_MAX - stream->cursor)
+		{
+			stream->hasFailed = true;
+			return;
+		}
+
+		// Doubling keeps the number of reallocations down to a handful, even for big files.
+		int newSize = stream->size < INT_MAX / 2 ? 2 * stream->size : INT_MAX;
+		if (newSize < stream->cursor + numBytesToWrite)
+			newSize = stream->cursor + numBytesToWrite;
+		if (newSize < 256)
+			newSize = 256;
+		void *newBuffer = MemRealloc(stream->buffer, newSize);
+		if (not newBuffer)
+		{
+			stream->hasFailed = true;
+			return;
+		}
+		stream->buffer = newBuffer;
+		stream->size = newSize;
+	}
 
 	CopyBytes((char *)stream->buffer + stream->cursor, bytes, numBytesToWrite);
 	stream->cursor += numBytesToWrite;
 }
+
+void WritePadding(BinaryStream *stream, int alignment)
+{
+	static const char zeros[16];
+	ASSERT(alignment > 0 and alignment <= (int)sizeof zeros);
+	int remainder = stream->cursor % alignment;
+	if (remainder != 0)
+		WriteBytes(stream, zeros, alignment - remainder);
+}
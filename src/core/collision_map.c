@@ -0,0 +1,95 @@
+#include "../core.h"
+#include <stdlib.h>
+
+// Collision maps are stored as 1 bit per pixel, packed into 32-bit words row by row.
+// Each row starts on a new word, so a lookup is just an index and a shift.
+
+CollisionMap LoadCollisionMapFromImage(Image image)
+{
+	CollisionMap map = { 0 };
+	if (not image.data or image.width <= 0 or image.height <= 0)
+		return map;
+
+	Image gray = ImageCopy(image);
+	ImageFormat(&gray, PIXELFORMAT_UNCOMPRESSED_GRAYSCALE);
+
+	map.width = image.width;
+	map.height = image.height;
+	map.wordsPerRow = (map.width + 31) / 32;
+	map.bits = MemAlloc(map.wordsPerRow * map.height * sizeof map.bits[0]);
+
+	const unsigned char *pixels = gray.data;
+	for (int y = 0; y < map.height; ++y)
+	{
+		uint32_t *row = map.bits + y * map.wordsPerRow;
+		for (int x = 0; x < map.width; ++x)
+			row[x / 32] |= (uint32_t)(pixels[y * map.width + x] < 128) << (x % 32);
+	}
+
+	UnloadImage(gray);
+	return map;
+}
+
+CollisionMap LoadCollisionMap(const char *path)
+{
+	Image image = LoadImage(path);
+	CollisionMap map = LoadCollisionMapFromImage(image);
+	UnloadImage(image);
+	return map;
+}
+
+void UnloadCollisionMap(CollisionMap map)
+{
+	MemFree(map.bits);
+}
+
+bool IsCollisionMapPixelSolid(CollisionMap map, int x, int y)
+{
+	if ((unsigned)x >= (unsigned)map.width or (unsigned)y >= (unsigned)map.height)
+		return false;
+	return (map.bits[y * map.wordsPerRow + x / 32] >> (x % 32)) & 1;
+}
+
+bool CheckCollisionMapPoint(CollisionMap map, Vector2 point)
+{
+	return IsCollisionMapPixelSolid(map, (int)floorf(point.x), (int)floorf(point.y));
+}
+
+bool CheckCollisionMapSegment(CollisionMap map, Vector2 from, Vector2 to)
+{
+	// Walks through every pixel the segment touches, in order (Amanatides & Woo).
+	int x = (int)floorf(from.x);
+	int y = (int)floorf(from.y);
+	int endX = (int)floorf(to.x);
+	int endY = (int)floorf(to.y);
+
+	float dx = to.x - from.x;
+	float dy = to.y - from.y;
+	int stepX = dx > 0 ? +1 : -1;
+	int stepY = dy > 0 ? +1 : -1;
+
+	// How far along the segment (in [0, 1]) we have to go to cross one whole pixel, and to cross the next pixel edge.
+	float deltaX = dx != 0 ? fabsf(1 / dx) : FLT_MAX;
+	float deltaY = dy != 0 ? fabsf(1 / dy) : FLT_MAX;
+	float nextX = dx != 0 ? ((dx > 0 ? x + 1 - from.x : from.x - x) * deltaX) : FLT_MAX;
+	float nextY = dy != 0 ? ((dy > 0 ? y + 1 - from.y : from.y - y) * deltaY) : FLT_MAX;
+
+	int numSteps = abs(endX - x) + abs(endY - y);
+	for (int i = 0; i <= numSteps; ++i)
+	{
+		if (IsCollisionMapPixelSolid(map, x, y))
+			return true;
+
+		if (nextX < nextY)
+		{
+			nextX += deltaX;
+			x += stepX;
+		}
+		else
+		{
+			nextY += deltaY;
+			y += stepY;
+		}
+	}
+	return false;
+}
@@ -58,3 +58,65 @@ void DrawTextureCenteredScaled(Texture texture, Vector2 position, float scale, C
 	position.y -= 0.5f * texture.height;
 	DrawTextureEx(texture, position, 0, scale, tint);
 }
+
+void DrawSpriteFrameCentered(SpriteFrame frame, Vector2 position, Color tint)
+{
+	Rectangle destination = {
+		position.x - 0.5f * frame.source.width,
+		position.y - 0.5f * frame.source.height,
+		frame.source.width,
+		frame.source.height
+	};
+
+	Vector2 origin = { 0, 0 };
+	DrawTexturePro(frame.texture, frame.source, destination, origin, 0, tint);
+}
+
+void DrawSpriteFrameCenteredAndFlippedVertically(SpriteFrame frame, Vector2 position, Color tint)
+{
+	Rectangle source = frame.source;
+	source.width = -source.width;
+	Rectangle destination = {
+		position.x - 0.5f * frame.source.width,
+		position.y - 0.5f * frame.source.height,
+		frame.source.width,
+		frame.source.height
+	};
+
+	Vector2 origin = { 0, 0 };
+	DrawTexturePro(frame.texture, source, destination, origin, 0, tint);
+}
+
+// The render textures passed to BeginRenderTexture, innermost last. raylib itself only knows about the innermost one.
+static RenderTexture renderTextureStack[8];
+static int renderTextureDepth;
+
+void BeginRenderTexture(RenderTexture target)
+{
+	ASSERT(renderTextureDepth < COUNTOF(renderTextureStack));
+	renderTextureStack[renderTextureDepth++] = target;
+	BeginTextureMode(target);
+}
+
+void EndRenderTexture(void)
+{
+	ASSERT(renderTextureDepth > 0);
+	EndTextureMode();
+	// EndTextureMode always goes back to the screen, so the outer render texture has to be started again.
+	if (--renderTextureDepth > 0)
+		BeginTextureMode(renderTextureStack[renderTextureDepth - 1]);
+}
+
+int GetRenderTargetWidth(void)
+{
+	if (renderTextureDepth > 0)
+		return renderTextureStack[renderTextureDepth - 1].texture.width;
+	return GetScreenWidth();
+}
+
+int GetRenderTargetHeight(void)
+{
+	if (renderTextureDepth > 0)
+		return renderTextureStack[renderTextureDepth - 1].texture.height;
+	return GetScreenHeight();
+}
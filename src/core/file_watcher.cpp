@@ -0,0 +1,281 @@
+#include "../core.h"
+
+#include <deque>
+#include <string>
+
+#ifndef __EMSCRIPTEN__
+#include <thread>
+#include <mutex>
+#endif
+
+#if defined(__linux__)
+#include <sys/inotify.h>
+#include <dirent.h>
+#include <unistd.h>
+#include <unordered_map>
+#elif defined(_WIN32)
+#include <stdint.h>
+#elif !defined(__EMSCRIPTEN__)
+#include <unordered_map>
+#include <chrono>
+#endif
+
+// A background thread waits for the OS to tell us that files changed, and pushes
+// the paths of the changed files into a queue. The main thread then only has to look at
+// the files that actually changed, instead of checking every single asset every frame.
+//
+// Linux uses inotify, and Windows uses ReadDirectoryChangesW. Everywhere else (macOS)
+// we fall back to a thread that scans the whole directory a couple of times per second.
+// The web build doesn't watch anything - files can't change there anyway.
+
+#ifndef __EMSCRIPTEN__
+static std::mutex queueMutex;
+static std::deque<std::string> changedFiles;
+
+static void PushChangedFile(std::string path)
+{
+	ReplaceChar(&path[0], '\\', '/');
+	std::lock_guard<std::mutex> lock(queueMutex);
+	// Programs usually fire off a bunch of events for a single save, no need to queue all of them.
+	for (const std::string &changed : changedFiles)
+		if (changed == path)
+			return;
+	changedFiles.push_back(path);
+}
+#endif
+
+#if defined(__linux__)
+
+static int inotifyFd = -1;
+static std::unordered_map<int, std::string> watchedDirectories; // Watch descriptor -> directory prefix, e.g. "player_down/"
+
+static void WatchDirectoryRecursive(const char *path, const std::string &prefix)
+{
+	int wd = inotify_add_watch(inotifyFd, path, IN_CLOSE_WRITE | IN_MOVED_TO | IN_CREATE | IN_DELETE | IN_MOVED_FROM);
+	if (wd < 0)
+	{
+		LogWarning("Couldn't watch directory '%s' for changes.", path);
+		return;
+	}
+	watchedDirectories[wd] = prefix;
+
+	DIR *dir = opendir(path);
+	if (not dir)
+		return;
+	for (struct dirent *entry = readdir(dir); entry; entry = readdir(dir))
+	{
+		if (entry->d_name[0] == '.')
+			continue;
+		std::string subPath = std::string(path) + "/" + entry->d_name;
+		if (not IsPathFile(subPath.c_str()))
+			WatchDirectoryRecursive(subPath.c_str(), prefix + entry->d_name + "/");
+	}
+	closedir(dir);
+}
+
+static void WatcherThread(std::string root)
+{
+	alignas(struct inotify_event) char buffer[4096];
+	for (;;)
+	{
+		ssize_t length = read(inotifyFd, buffer, sizeof buffer);
+		if (length <= 0)
+			continue;
+
+		for (char *p = buffer; p < buffer + length; p += sizeof(struct inotify_event) + ((struct inotify_event *)p)->len)
+		{
+			struct inotify_event *event = (struct inotify_event *)p;
+			if (event->mask & IN_Q_OVERFLOW)
+			{
+				LogWarning("Too many file changes at once, some of them will be missed by hot reloading.");
+				continue;
+			}
+			if (not event->len)
+				continue;
+
+			std::string prefix;
+			{
+				// New directories get added to the map on this thread, but StartWatching fills it in on the main thread.
+				std::lock_guard<std::mutex> lock(queueMutex);
+				auto iterator = watchedDirectories.find(event->wd);
+				if (iterator == watchedDirectories.end())
+					continue;
+				prefix = iterator->second;
+			}
+
+			std::string path = prefix + event->name;
+			if ((event->mask & IN_ISDIR) and (event->mask & (IN_CREATE | IN_MOVED_TO)))
+			{
+				std::lock_guard<std::mutex> lock(queueMutex);
+				WatchDirectoryRecursive((root + "/" + path).c_str(), path + "/");
+			}
+			PushChangedFile(path);
+		}
+	}
+}
+
+static bool StartWatching(const char *path)
+{
+	inotifyFd = inotify_init();
+	if (inotifyFd < 0)
+		return false;
+
+	{
+		std::lock_guard<std::mutex> lock(queueMutex);
+		WatchDirectoryRecursive(path, "");
+	}
+	std::thread(WatcherThread, std::string(path)).detach();
+	return true;
+}
+
+#elif defined(_WIN32)
+
+// We don't want to include windows.h for just these.
+extern "C"
+{
+	__declspec(dllimport) void *__stdcall CreateFileA(const char *fileName, unsigned long access, unsigned long shareMode, void *security, unsigned long creationDisposition, unsigned long flags, void *templateFile);
+	__declspec(dllimport) int __stdcall ReadDirectoryChangesW(void *directory, void *buffer, unsigned long bufferLength, int watchSubtree, unsigned long filter, unsigned long *bytesReturned, void *overlapped, void *completionRoutine);
+	__declspec(dllimport) int __stdcall WideCharToMultiByte(unsigned codePage, unsigned long flags, const wchar_t *wideString, int wideLength, char *string, int length, const char *defaultChar, int *usedDefaultChar);
+}
+
+#define FILE_LIST_DIRECTORY 0x1
+#define FILE_SHARE_ALL 0x7 // FILE_SHARE_READ | FILE_SHARE_WRITE | FILE_SHARE_DELETE
+#define OPEN_EXISTING 3
+#define FILE_FLAG_BACKUP_SEMANTICS 0x02000000
+#define NOTIFY_FILTER 0x1B // FILE_NOTIFY_CHANGE_FILE_NAME | FILE_NOTIFY_CHANGE_DIR_NAME | FILE_NOTIFY_CHANGE_SIZE | FILE_NOTIFY_CHANGE_LAST_WRITE
+#define CP_UTF8 65001
+
+STRUCT(FileNotifyInformation)
+{
+	unsigned long nextEntryOffset;
+	unsigned long action;
+	unsigned long fileNameLength; // In bytes, not characters.
+	wchar_t fileName[1];
+};
+
+static void WatcherThread(void *directory)
+{
+	alignas(unsigned long) char buffer[16 * 1024];
+	for (;;)
+	{
+		unsigned long length = 0;
+		if (not ReadDirectoryChangesW(directory, buffer, sizeof buffer, true, NOTIFY_FILTER, &length, NULL, NULL))
+		{
+			LogError("Stopped watching for file changes, hot reloading won't work anymore.");
+			return;
+		}
+		if (length == 0)
+		{
+			LogWarning("Too many file changes at once, some of them will be missed by hot reloading.");
+			continue;
+		}
+
+		for (char *p = buffer;;)
+		{
+			FileNotifyInformation *info = (FileNotifyInformation *)p;
+			char path[512];
+			int pathLength = WideCharToMultiByte(CP_UTF8, 0, info->fileName, (int)(info->fileNameLength / sizeof(wchar_t)), path, sizeof path - 1, NULL, NULL);
+			if (pathLength > 0)
+				PushChangedFile(std::string(path, pathLength));
+
+			if (not info->nextEntryOffset)
+				break;
+			p += info->nextEntryOffset;
+		}
+	}
+}
+
+static bool StartWatching(const char *path)
+{
+	void *directory = CreateFileA(path, FILE_LIST_DIRECTORY, FILE_SHARE_ALL, NULL, OPEN_EXISTING, FILE_FLAG_BACKUP_SEMANTICS, NULL);
+	if (directory == (void *)(intptr_t)-1)
+		return false;
+
+	std::thread(WatcherThread, directory).detach();
+	return true;
+}
+
+#elif !defined(__EMSCRIPTEN__)
+
+#define POLL_INTERVAL_MS 500
+
+static void WatcherThread(std::string root)
+{
+	// Nothing here touches the main thread's data, so this is only ever a couple of stats per file, twice a second, off the main thread.
+	std::unordered_map<std::string, long> modTimes;
+	bool isFirstScan = true;
+	for (;;)
+	{
+		FilePathList files = LoadDirectoryFilesEx(root.c_str(), NULL, true);
+		for (unsigned i = 0; i < files.count; ++i)
+		{
+			long modTime = GetFileModTime(files.paths[i]);
+			std::string path = files.paths[i] + root.length() + 1; // Strip the "root/" prefix.
+			auto iterator = modTimes.find(path);
+			if (iterator == modTimes.end())
+			{
+				modTimes[path] = modTime;
+				if (not isFirstScan)
+					PushChangedFile(path);
+			}
+			else if (iterator->second != modTime)
+			{
+				iterator->second = modTime;
+				PushChangedFile(path);
+			}
+		}
+		UnloadDirectoryFiles(files);
+
+		isFirstScan = false;
+		std::this_thread::sleep_for(std::chrono::milliseconds(POLL_INTERVAL_MS));
+	}
+}
+
+static bool StartWatching(const char *path)
+{
+	std::thread(WatcherThread, std::string(path)).detach();
+	return true;
+}
+
+#endif
+
+extern "C"
+{
+	bool StartWatchingDirectory(const char *path)
+	{
+		#ifdef __EMSCRIPTEN__
+		{
+			UNUSED(path);
+			return false;
+		}
+		#else
+		{
+			if (not StartWatching(path))
+			{
+				LogWarning("Couldn't watch '%s' for changes.", path);
+				return false;
+			}
+			return true;
+		}
+		#endif
+	}
+
+	bool PollChangedFile(char *buffer, int bufferSize)
+	{
+		#ifdef __EMSCRIPTEN__
+		{
+			UNUSED(buffer); UNUSED(bufferSize);
+			return false;
+		}
+		#else
+		{
+			std::lock_guard<std::mutex> lock(queueMutex);
+			if (changedFiles.empty())
+				return false;
+			CopyString(buffer, changedFiles.front().c_str(), bufferSize);
+			changedFiles.pop_front();
+			return true;
+		}
+		#endif
+	}
+}
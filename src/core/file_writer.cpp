@@ -0,0 +1,165 @@
+#include "../core.h"
+
+#include <stdio.h>
+
+#ifndef __EMSCRIPTEN__
+#include <condition_variable>
+#include <mutex>
+#endif
+
+#ifdef _WIN32
+// windows.h clashes with raylib, so this is declared by hand. rename doesn't replace existing files on Windows.
+extern "C" __declspec(dllimport) int __stdcall MoveFileExA(const char *existingFileName, const char *newFileName, unsigned long flags);
+#define MOVEFILE_REPLACE_EXISTING 0x1
+#define MOVEFILE_WRITE_THROUGH    0x8
+#endif
+
+// Files are written on a job thread, so saving never waits on the disk. A path has at most two buffers: the one
+// that's being written right now, and the newest one waiting behind it. Saving the same path again while a buffer is
+// waiting just replaces that buffer, since only the newest version of the file matters.
+//
+// A file is first written next to its path and then renamed over it, so the file on disk is always either
+// the old version or the new one, never half of each - even if the game crashes in the middle of the write.
+//
+// There's only ever one job writing, so writes happen in the order they were started.
+
+#define MAX_WRITE_PATH 256
+
+STRUCT(FileWrite)
+{
+	char path[MAX_WRITE_PATH];
+	void *data; // Owned by the write, and freed once it's written.
+	int size;
+};
+
+static List(FileWrite) queuedWrites; // Oldest first.
+static bool isWriterRunning;
+#ifndef __EMSCRIPTEN__
+static std::mutex writeMutex;
+static std::condition_variable writerStopped;
+#endif
+
+static bool ReplaceFile(const char *from, const char *to)
+{
+	#ifdef _WIN32
+	{
+		return MoveFileExA(from, to, MOVEFILE_REPLACE_EXISTING | MOVEFILE_WRITE_THROUGH) != 0;
+	}
+	#else
+	{
+		return rename(from, to) == 0;
+	}
+	#endif
+}
+
+static bool WriteFileAtomically(const char *path, const void *data, int size)
+{
+	char tempPath[MAX_WRITE_PATH + 4];
+	FormatString(tempPath, sizeof tempPath, "%s.tmp", path);
+	FILE *file = fopen(tempPath, "wb");
+	if (not file)
+		return false;
+
+	bool success = fwrite(data, 1, (size_t)size, file) == (size_t)size;
+	success = fflush(file) == 0 and success;
+	success = fclose(file) == 0 and success;
+	success = success and ReplaceFile(tempPath, path);
+	if (not success)
+		remove(tempPath);
+	return success;
+}
+
+static void WriteQueuedFiles(void *userData)
+{
+	(void)userData;
+	for (;;)
+	{
+		FileWrite write;
+		{
+			#ifndef __EMSCRIPTEN__
+			std::lock_guard<std::mutex> lock(writeMutex);
+			#endif
+			if (ListCount(queuedWrites) == 0)
+			{
+				isWriterRunning = false;
+				#ifndef __EMSCRIPTEN__
+				writerStopped.notify_all();
+				#endif
+				return;
+			}
+			// There's only a couple of writes queued at a time, so moving them up is cheap.
+			write = queuedWrites[0];
+			int count = ListCount(queuedWrites);
+			for (int i = 0; i < count - 1; ++i)
+				queuedWrites[i] = queuedWrites[i + 1];
+			ListTruncate(queuedWrites, count - 1);
+		}
+
+		if (WriteFileAtomically(write.path, write.data, write.size))
+			LogInfo("Saved '%s'.", write.path);
+		else
+			LogError("Couldn't save '%s'.", write.path);
+		MemFree(write.data);
+	}
+}
+
+extern "C"
+{
+	void SaveFileDataInBackground(const char *path, void *data, int size)
+	{
+		ASSERT(StringLength(path) < MAX_WRITE_PATH);
+		bool startWriter = false;
+		{
+			#ifndef __EMSCRIPTEN__
+			std::lock_guard<std::mutex> lock(writeMutex);
+			#endif
+			bool isReplaced = false;
+			for (int i = 0; i < ListCount(queuedWrites) and not isReplaced; ++i)
+			{
+				FileWrite *queued = &queuedWrites[i];
+				if (StringsEqual(queued->path, path))
+				{
+					MemFree(queued->data);
+					queued->data = data;
+					queued->size = size;
+					isReplaced = true;
+				}
+			}
+			if (not isReplaced)
+			{
+				FileWrite *write = ListAllocateItem(&queuedWrites);
+				CopyString(write->path, path, sizeof write->path);
+				write->data = data;
+				write->size = size;
+			}
+
+			if (not isWriterRunning)
+			{
+				isWriterRunning = true;
+				startWriter = true;
+			}
+		}
+
+		// The job has to be started outside of the lock, since on the web it runs right away.
+		if (startWriter)
+			RunJob(NULL, WriteQueuedFiles, NULL);
+	}
+
+	bool IsSavingFiles(void)
+	{
+		#ifndef __EMSCRIPTEN__
+		std::lock_guard<std::mutex> lock(writeMutex);
+		#endif
+		return isWriterRunning;
+	}
+
+	void WaitForSavedFiles(void)
+	{
+		#ifndef __EMSCRIPTEN__
+		{
+			std::unique_lock<std::mutex> lock(writeMutex);
+			writerStopped.wait(lock, [] { return not isWriterRunning; });
+		}
+		#endif
+	}
+}
@@ -12,12 +12,23 @@ STRUCT(Entry)
 {
 	int state;
 	int frameNumber;
+	int serial; // Different for every push, so the snapshot knows which state it was taken for.
 };
 
 static Functions registry[100];
 static int cursor;
 static Entry stack[100];
 static Entry current;
+static int previousRenderDepth;
+static int nextSerial = 1;
+
+// What the previous game state rendered, for CallPreviousGameStateRenderFrozen. There's only one,
+// because only the game state right underneath the current one is ever on screen frozen.
+static RenderTexture snapshot;
+static int snapshotSerial; // Of the game state that the snapshot was taken for, 0 if there's no snapshot.
+static int snapshotCursor;
+static unsigned snapshotAssetGeneration; // Hot reloaded or streamed in assets change what the snapshot should look like.
+static bool isTakingSnapshot;
 
 void RegisterGameState(int state, void(*init)(void *parameter), void(*deinit)(void), void(*update)(void), void(*render)(void))
 {
@@ -34,7 +45,7 @@ void PushGameState(int state, void *parameter)
 	ASSERT(state >= 0 && state < COUNTOF(registry));
 
 	stack[cursor++] = current;
-	current = (Entry){ state };
+	current = (Entry){ state, 0, nextSerial++ };
 	if (registry[state].init)
 		registry[state].init(parameter);
 }
@@ -65,6 +76,7 @@ void SetCurrentGameState(int state, void *parameter)
 	if (registry[current.state].deinit)
 		registry[current.state].deinit();
 	current.state = state;
+	current.serial = nextSerial++;
 	if (registry[current.state].init)
 		registry[current.state].init(parameter);
 }
@@ -94,14 +106,78 @@ void CallPreviousGameStateRender(void)
 		--cursor;
 		Entry backup = current;
 		current = previous;
+		++previousRenderDepth;
 		{
 			registry[previous.state].render();
 		}
+		--previousRenderDepth;
 		current = backup;
 		++cursor;
 	}
 }
 
+void CallPreviousGameStateRenderFrozen(void)
+{
+	if (cursor == 0)
+		return;
+	if (isTakingSnapshot)
+	{
+		// Already drawing into the snapshot for a state further up, and it can't be drawn into itself.
+		CallPreviousGameStateRender();
+		return;
+	}
+
+	int width = GetScreenWidth();
+	int height = GetScreenHeight();
+	if (snapshot.texture.width != width or snapshot.texture.height != height)
+	{
+		if (snapshot.id)
+			UnloadRenderTexture(snapshot);
+		snapshot = LoadRenderTexture(width, height);
+		snapshotSerial = 0;
+	}
+
+	if (snapshotSerial != current.serial or snapshotCursor != cursor or snapshotAssetGeneration != GetAssetGeneration())
+	{
+		isTakingSnapshot = true;
+		BeginRenderTexture(snapshot);
+		{
+			ClearBackground(BLACK);
+			CallPreviousGameStateRender();
+		}
+		EndRenderTexture();
+		isTakingSnapshot = false;
+		snapshotSerial = current.serial;
+		snapshotCursor = cursor;
+		snapshotAssetGeneration = GetAssetGeneration();
+	}
+
+	// The snapshot is a copy of the screen, so its pixels are copied as they are. Blending would darken
+	// everything that was blended into it, because the alpha in there is the alpha of whatever was drawn last.
+	rlSetBlendFactors(1, 0, 0x8006); // GL_ONE, GL_ZERO, GL_FUNC_ADD
+	BeginBlendMode(BLEND_CUSTOM);
+	{
+		Rectangle source = { 0, 0, (float)width, -(float)height }; // Render textures are upside down.
+		DrawTextureRec(snapshot.texture, source, (Vector2){ 0, 0 }, WHITE);
+	}
+	EndBlendMode();
+}
+
+void InvalidateGameStateSnapshot(void)
+{
+	snapshotSerial = 0;
+}
+
+bool IsTakingGameStateSnapshot(void)
+{
+	return isTakingSnapshot;
+}
+
+bool IsRenderingPreviousGameState(void)
+{
+	return previousRenderDepth > 0;
+}
+
 int GetCurrentGameState(void)
 {
 	return current.state;
@@ -45,6 +45,24 @@ STRUCT(Mapping)
 
 static List(Mapping) mappings;
 
+// Recordings start with a header, followed by one record per update. A record is an int with 3 bits for every button
+// (down, pressed, released) and one bit for every axis that changed since the previous update, followed by the positions
+// of the axes that changed. Nothing changes in most updates, so most records are just the int.
+#define INPUT_RECORDING_MAGIC "INRC"
+#define INPUT_RECORDING_VERSION 1
+#define MAX_RECORDED_BUTTONS 8
+#define MAX_RECORDED_AXES 8
+#define AXIS_CHANGED_BIT(axis) (1u << (3 * MAX_RECORDED_BUTTONS + (axis)))
+
+static bool isRecording;
+static bool isReplaying;
+static BinaryStream recording;  // Grows while we're recording, and holds the whole file while we're replaying.
+static int numRecordedButtons;
+static int numRecordedAxes;
+static InputButton *recordedButtons[MAX_RECORDED_BUTTONS];
+static InputAxis *recordedAxes[MAX_RECORDED_AXES];
+static Vector2 previousAxisPositions[MAX_RECORDED_AXES];
+
 static void UpdateButtonFromButton(InputButton *button, bool isDown, bool wasPressed, bool wasReleased)
 {
 	button->isDown |= isDown;
@@ -179,9 +197,8 @@ void UpdateInputMappings(void)
 			case CONTROLLER_BUTTON_TO_BUTTON:
 			case CONTROLLER_AXIS_TO_BUTTON:
 			{
+				// Presses and releases stay latched until ClearInputPresses.
 				map.to.button->isDown = false;
-				map.to.button->wasPressed = false;
-				map.to.button->wasReleased = false;
 			} break;
 
 			case KEY_TO_AXIS:
@@ -255,3 +272,227 @@ void UpdateInputMappings(void)
 		}
 	}
 }
+
+void ClearInputPresses(void)
+{
+	int numMappings = ListCount(mappings);
+	for (int i = 0; i < numMappings; ++i)
+	{
+		Mapping map = mappings[i];
+		switch (map.kind)
+		{
+			case KEY_TO_BUTTON:
+			case MOUSE_BUTTON_TO_BUTTON:
+			case CONTROLLER_BUTTON_TO_BUTTON:
+			case CONTROLLER_AXIS_TO_BUTTON:
+			{
+				map.to.button->wasPressed = false;
+				map.to.button->wasReleased = false;
+			} break;
+
+			default: break;
+		}
+	}
+}
+
+// Many mappings can point to the same button or axis, but every button and axis only gets recorded once, in the order they're first mapped.
+static bool CollectRecordedInputs(void)
+{
+	numRecordedButtons = 0;
+	numRecordedAxes = 0;
+	for (int i = 0; i < ListCount(mappings); ++i)
+	{
+		Mapping map = mappings[i];
+		switch (map.kind)
+		{
+			case KEY_TO_BUTTON:
+			case MOUSE_BUTTON_TO_BUTTON:
+			case CONTROLLER_BUTTON_TO_BUTTON:
+			case CONTROLLER_AXIS_TO_BUTTON:
+			{
+				bool isNew = true;
+				for (int j = 0; j < numRecordedButtons and isNew; ++j)
+					isNew = recordedButtons[j] != map.to.button;
+				if (isNew and numRecordedButtons == MAX_RECORDED_BUTTONS)
+					return false;
+				if (isNew)
+					recordedButtons[numRecordedButtons++] = map.to.button;
+			} break;
+
+			case KEY_TO_AXIS:
+			case MOUSE_BUTTON_TO_AXIS:
+			case CONTROLLER_BUTTON_TO_AXIS:
+			case CONTROLLER_AXIS_TO_AXIS:
+			{
+				bool isNew = true;
+				for (int j = 0; j < numRecordedAxes and isNew; ++j)
+					isNew = recordedAxes[j] != map.to.axis;
+				if (isNew and numRecordedAxes == MAX_RECORDED_AXES)
+					return false;
+				if (isNew)
+					recordedAxes[numRecordedAxes++] = map.to.axis;
+			} break;
+		}
+	}
+	ZeroBytes(previousAxisPositions, sizeof previousAxisPositions);
+	return true;
+}
+
+void StartInputRecording(const char *startCommand)
+{
+	if (isReplaying)
+	{
+		LogWarning("Can't record input while a recording is being replayed.");
+		return;
+	}
+	if (not CollectRecordedInputs())
+	{
+		LogError("Can't record input because there are more than %d mapped buttons or %d mapped axes.", MAX_RECORDED_BUTTONS, MAX_RECORDED_AXES);
+		return;
+	}
+
+	MemFree(recording.buffer);
+	ZeroBytes(&recording, sizeof recording);
+	recording.canGrow = true;
+	WriteBytes(&recording, INPUT_RECORDING_MAGIC, 4);
+	WriteInt(&recording, INPUT_RECORDING_VERSION);
+	WriteInt(&recording, numRecordedButtons);
+	WriteInt(&recording, numRecordedAxes);
+	WriteString(&recording, startCommand ? startCommand : "");
+	isRecording = true;
+}
+
+bool StopInputRecording(const char *path)
+{
+	if (not isRecording)
+		return false;
+
+	isRecording = false;
+	bool success = SaveFileData(path, recording.buffer, (unsigned)recording.cursor);
+	if (success)
+		LogInfo("Saved input recording to '%s'.", path);
+	else
+		LogError("Couldn't save input recording to '%s'.", path);
+	MemFree(recording.buffer);
+	ZeroBytes(&recording, sizeof recording);
+	return success;
+}
+
+bool IsRecordingInput(void)
+{
+	return isRecording;
+}
+
+bool StartInputReplay(const char *path)
+{
+	if (isRecording)
+	{
+		LogWarning("Can't replay '%s' while input is being recorded.", path);
+		return false;
+	}
+
+	unsigned dataSize;
+	unsigned char *data = LoadFileData(path, &dataSize);
+	if (not data)
+	{
+		LogError("Couldn't replay input from '%s' because the file couldn't be loaded.", path);
+		return false;
+	}
+
+	BinaryStream stream = { 0 };
+	stream.buffer = data;
+	stream.size = (int)dataSize;
+	const void *magic = ReadBytes(&stream, 4);
+	int version = ReadInt(&stream);
+	int numButtons = ReadInt(&stream);
+	int numAxes = ReadInt(&stream);
+	const char *startCommand = ReadString(&stream);
+	if (not magic or not BytesEqual(magic, INPUT_RECORDING_MAGIC, 4) or version != INPUT_RECORDING_VERSION or not startCommand)
+	{
+		UnloadFileData(data);
+		LogError("Couldn't replay input from '%s' because it isn't an input recording.", path);
+		return false;
+	}
+	if (not CollectRecordedInputs() or numButtons != numRecordedButtons or numAxes != numRecordedAxes)
+	{
+		UnloadFileData(data);
+		LogError("Couldn't replay input from '%s' because it was recorded with different input mappings.", path);
+		return false;
+	}
+
+	MemFree(recording.buffer);
+	recording = stream;
+	isReplaying = true;
+	if (startCommand[0])
+		ExecuteCommand(startCommand);
+	return true;
+}
+
+bool IsReplayingInput(void)
+{
+	return isReplaying;
+}
+
+static void RecordInputs(void)
+{
+	unsigned bits = 0;
+	for (int i = 0; i < numRecordedButtons; ++i)
+	{
+		InputButton *button = recordedButtons[i];
+		bits |= (unsigned)button->isDown << (3 * i + 0);
+		bits |= (unsigned)button->wasPressed << (3 * i + 1);
+		bits |= (unsigned)button->wasReleased << (3 * i + 2);
+	}
+	for (int i = 0; i < numRecordedAxes; ++i)
+		if (not BytesEqual(&recordedAxes[i]->position, &previousAxisPositions[i], sizeof previousAxisPositions[i]))
+			bits |= AXIS_CHANGED_BIT(i);
+
+	WriteInt(&recording, (int)bits);
+	for (int i = 0; i < numRecordedAxes; ++i)
+	{
+		if (bits & AXIS_CHANGED_BIT(i))
+		{
+			Vector2 position = recordedAxes[i]->position;
+			WriteFloat(&recording, position.x);
+			WriteFloat(&recording, position.y);
+			previousAxisPositions[i] = position;
+		}
+	}
+}
+
+static void ReplayInputs(void)
+{
+	if (recording.cursor >= recording.size)
+	{
+		isReplaying = false;
+		UnloadFileData(recording.buffer);
+		ZeroBytes(&recording, sizeof recording);
+		return;
+	}
+
+	unsigned bits = (unsigned)ReadInt(&recording);
+	for (int i = 0; i < numRecordedButtons; ++i)
+	{
+		InputButton *button = recordedButtons[i];
+		button->isDown = (bits >> (3 * i + 0)) & 1;
+		button->wasPressed = (bits >> (3 * i + 1)) & 1;
+		button->wasReleased = (bits >> (3 * i + 2)) & 1;
+	}
+	for (int i = 0; i < numRecordedAxes; ++i)
+	{
+		if (bits & AXIS_CHANGED_BIT(i))
+		{
+			previousAxisPositions[i].x = ReadFloat(&recording);
+			previousAxisPositions[i].y = ReadFloat(&recording);
+		}
+		recordedAxes[i]->position = previousAxisPositions[i];
+	}
+}
+
+void UpdateInputRecording(void)
+{
+	if (isRecording)
+		RecordInputs();
+	else if (isReplaying)
+		ReplayInputs();
+}
@@ -0,0 +1,269 @@
+#include "../core.h"
+
+#ifndef __EMSCRIPTEN__
+#include <atomic>
+#include <condition_variable>
+#include <deque>
+#include <mutex>
+#include <thread>
+#endif
+
+// Every job thread has its own queue. Threads push and pop their own jobs at the back of their queue,
+// and when they run out of work they steal from the front of the other queues. Threads that aren't job
+// threads (like the main thread) just spread the jobs they add over all of the queues.
+//
+// Waiting for a group only ever helps out with jobs from that same group. Otherwise a quick ParallelFor
+// on the main thread could end up decoding a huge image for the asset streamer, and we'd drop a frame.
+
+#define MAX_JOB_THREADS 15
+
+STRUCT(Job)
+{
+	void (*function)(void *userData);
+	void *userData;
+	JobGroup *group;
+};
+
+#ifdef __EMSCRIPTEN__
+
+struct JobGroup
+{
+	int unused;
+};
+
+#else
+
+struct JobGroup
+{
+	std::atomic<int> numPending;
+};
+
+STRUCT(JobQueue)
+{
+	std::mutex mutex;
+	std::deque<Job> jobs;
+};
+
+static std::once_flag startFlag;
+static int numThreads;
+static JobQueue queues[MAX_JOB_THREADS];
+static std::atomic<int> numQueuedJobs;
+static std::atomic<unsigned> nextQueue;
+static std::mutex sleepMutex;
+static std::condition_variable wakeCondition;
+static THREAD_LOCAL int threadQueueIndex = -1; // Only job threads have a queue.
+
+static bool TryPopJob(JobQueue *queue, JobGroup *group, bool fromBack, Job *outJob)
+{
+	std::lock_guard<std::mutex> lock(queue->mutex);
+	if (queue->jobs.empty())
+		return false;
+
+	if (not group)
+	{
+		if (fromBack)
+		{
+			*outJob = queue->jobs.back();
+			queue->jobs.pop_back();
+		}
+		else
+		{
+			*outJob = queue->jobs.front();
+			queue->jobs.pop_front();
+		}
+		--numQueuedJobs;
+		return true;
+	}
+
+	for (auto it = queue->jobs.begin(); it != queue->jobs.end(); ++it)
+	{
+		if (it->group == group)
+		{
+			*outJob = *it;
+			queue->jobs.erase(it);
+			--numQueuedJobs;
+			return true;
+		}
+	}
+	return false;
+}
+
+// If group is NULL, any job will do.
+static bool TryRunOneJob(JobGroup *group)
+{
+	Job job;
+	bool found = false;
+	if (threadQueueIndex >= 0)
+		found = TryPopJob(&queues[threadQueueIndex], group, true, &job);
+
+	int first = threadQueueIndex >= 0 ? threadQueueIndex + 1 : 0;
+	for (int i = 0; i < numThreads and not found; ++i)
+	{
+		int index = (first + i) % numThreads;
+		if (index != threadQueueIndex)
+			found = TryPopJob(&queues[index], group, false, &job);
+	}
+
+	if (not found)
+		return false;
+
+	job.function(job.userData);
+	if (threadQueueIndex >= 0)
+		TempReset(0);
+	if (job.group)
+		--job.group->numPending;
+	return true;
+}
+
+static void JobThread(int index)
+{
+	threadQueueIndex = index;
+	for (;;)
+	{
+		if (TryRunOneJob(NULL))
+			continue;
+
+		std::unique_lock<std::mutex> lock(sleepMutex);
+		wakeCondition.wait(lock, []{ return numQueuedJobs > 0; });
+	}
+}
+
+static void StartJobThreads(void)
+{
+	int numCores = (int)std::thread::hardware_concurrency();
+	numThreads = ClampInt(numCores - 1, 1, MAX_JOB_THREADS);
+	for (int i = 0; i < numThreads; ++i)
+		std::thread(JobThread, i).detach();
+}
+
+#endif
+
+STRUCT(ParallelForBatch)
+{
+	void (*function)(int begin, int end, void *userData);
+	void *userData;
+	int begin;
+	int end;
+};
+
+static void RunParallelForBatch(void *userData)
+{
+	ParallelForBatch *batch = (ParallelForBatch *)userData;
+	batch->function(batch->begin, batch->end, batch->userData);
+}
+
+extern "C"
+{
+	JobGroup *CreateJobGroup(void)
+	{
+		JobGroup *group = new JobGroup;
+		#ifndef __EMSCRIPTEN__
+		group->numPending = 0;
+		#endif
+		return group;
+	}
+
+	void DestroyJobGroup(JobGroup *group)
+	{
+		if (not group)
+			return;
+
+		WaitForJobGroup(group);
+		delete group;
+	}
+
+	void RunJob(JobGroup *group, void (*function)(void *userData), void *userData)
+	{
+		#ifdef __EMSCRIPTEN__
+		{
+			UNUSED(group);
+			function(userData);
+		}
+		#else
+		{
+			std::call_once(startFlag, StartJobThreads);
+
+			Job job = { function, userData, group };
+			if (group)
+				++group->numPending;
+
+			int index = threadQueueIndex;
+			if (index < 0)
+				index = (int)(nextQueue++ % (unsigned)numThreads);
+			{
+				std::lock_guard<std::mutex> lock(queues[index].mutex);
+				queues[index].jobs.push_back(job);
+			}
+
+			// Incrementing under the sleep mutex makes sure a thread that's just about to go to sleep doesn't miss the job.
+			{
+				std::lock_guard<std::mutex> lock(sleepMutex);
+				++numQueuedJobs;
+			}
+			wakeCondition.notify_one();
+		}
+		#endif
+	}
+
+	void WaitForJobGroup(JobGroup *group)
+	{
+		#ifdef __EMSCRIPTEN__
+		{
+			UNUSED(group);
+		}
+		#else
+		{
+			while (group->numPending > 0)
+				if (not TryRunOneJob(group))
+					std::this_thread::yield(); // The last jobs of the group are running on other threads.
+		}
+		#endif
+	}
+
+	void ParallelFor(int count, int batchSize, void (*function)(int begin, int end, void *userData), void *userData)
+	{
+		if (count <= 0)
+			return;
+		if (batchSize < 1)
+			batchSize = 1;
+
+		int numBatches = (count + batchSize - 1) / batchSize;
+		if (numBatches == 1 or GetNumJobThreads() == 0)
+		{
+			function(0, count, userData);
+			return;
+		}
+
+		ParallelForBatch *batches = (ParallelForBatch *)TempAlloc(numBatches * sizeof batches[0]);
+		JobGroup *group = CreateJobGroup();
+		for (int i = 0; i < numBatches; ++i)
+		{
+			ParallelForBatch *batch = &batches[i];
+			batch->function = function;
+			batch->userData = userData;
+			batch->begin = i * batchSize;
+			batch->end = batch->begin + batchSize < count ? batch->begin + batchSize : count;
+
+			// The calling thread does the last batch itself instead of just waiting around.
+			if (i < numBatches - 1)
+				RunJob(group, RunParallelForBatch, batch);
+		}
+		RunParallelForBatch(&batches[numBatches - 1]);
+		DestroyJobGroup(group);
+		TempFree(batches);
+	}
+
+	int GetNumJobThreads(void)
+	{
+		#ifdef __EMSCRIPTEN__
+		{
+			return 0;
+		}
+		#else
+		{
+			std::call_once(startFlag, StartJobThreads);
+			return numThreads;
+		}
+		#endif
+	}
+}
@@ -11,10 +11,16 @@ static void FooFree(void *pointer)
 	free(pointer);
 }
 
+// How many items a list makes space for when it first grows, unless ListSetMinCapacity says otherwise.
+#define LIST_DEFAULT_MIN_CAPACITY 64
+
+// The count has to come last, the list macros find it right before the first item.
 STRUCT(Header)
 {
 	void *(*realloc)(void *block, int newSize);
 	void (*free)(void *block);
+	int minCapacity; // How many items the list makes space for when it first grows, 0 means LIST_DEFAULT_MIN_CAPACITY.
+	bool isInBuffer; // The list is still in the buffer from ListSetBuffer, which it doesn't own.
 	int capacity;
 	int count;
 };
@@ -32,10 +38,33 @@ void ListSetAllocator(List(void) *listPointer, void *(*realloc)(void *block, int
 		*listPointer = (Header *)realloc(NULL, sizeof(Header)) + 1;
 
 	Header *header = GetHeader(*listPointer);
+	ZeroBytes(header, sizeof header[0]);
 	header->realloc = realloc;
 	header->free = free;
-	header->capacity = 0;
-	header->count = 0;
+}
+
+void ListSetMinCapacity(List(void) *listPointer, int minCapacity)
+{
+	ASSERT(minCapacity > 0);
+
+	if (not *listPointer)
+		ListSetAllocator(listPointer, FooRealloc, FooFree);
+	GetHeader(*listPointer)->minCapacity = minCapacity;
+}
+
+void private_ListSetBuffer(List(void) *listPointer, void *buffer, int bufferSize, int sizeOfOneItem)
+{
+	ASSERT(not *listPointer); // You can only call ListSetBuffer on a completely empty (NULL) list!
+	ASSERT((uintptr_t)buffer % sizeof(void *) == 0);
+	ASSERT(sizeof(Header) <= LIST_HEADER_SIZE and bufferSize >= (int)sizeof(Header));
+
+	Header *header = buffer;
+	ZeroBytes(header, sizeof header[0]);
+	header->realloc = FooRealloc;
+	header->free = FooFree;
+	header->isInBuffer = true;
+	header->capacity = (bufferSize - (int)sizeof(Header)) / sizeOfOneItem;
+	*listPointer = header + 1;
 }
 
 int ListCount(const List(void) list)
@@ -54,29 +83,55 @@ void ListDestroy(List(void) *listPointer)
 		return;
 
 	Header *header = GetHeader(*listPointer);
-	if (header->free)
+	if (header->free and not header->isInBuffer)
 		header->free(header);
 	*listPointer = NULL;
 }
 
+void ListClear(List(void) list)
+{
+	if (list)
+		GetHeader(list)->count = 0;
+}
+
+void ListTruncate(List(void) list, int count)
+{
+	ASSERT(count >= 0 and count <= ListCount(list)); // Lists can only get shorter this way.
+	if (list)
+		GetHeader(list)->count = count;
+}
+
 void private_ListReserve(List(void) *listPointer, int neededCapacity, int sizeOfOneItem)
 {
 	int capacity = ListCapacity(*listPointer);
 	if (capacity >= neededCapacity)
 		return;
 
-	if (capacity < 64)
-		capacity = 64;
+	int minCapacity = *listPointer ? GetHeader(*listPointer)->minCapacity : 0;
+	if (minCapacity <= 0)
+		minCapacity = LIST_DEFAULT_MIN_CAPACITY;
+	if (capacity < minCapacity)
+		capacity = minCapacity;
 	while (capacity < neededCapacity)
 		capacity *= 2;
 
 	if (not *listPointer)
 	{
 		Header *header = FooRealloc(NULL, sizeof(Header) + capacity * sizeOfOneItem);
+		ZeroBytes(header, sizeof header[0]);
 		header->realloc = FooRealloc;
 		header->free = FooFree;
 		header->capacity = capacity;
-		header->count = 0;
+		*listPointer = header + 1;
+	}
+	else if (GetHeader(*listPointer)->isInBuffer)
+	{
+		// The buffer isn't ours to reallocate, so the list moves out of it.
+		Header *old = GetHeader(*listPointer);
+		Header *header = old->realloc(NULL, sizeof(Header) + capacity * sizeOfOneItem);
+		CopyBytes(header, old, sizeof(Header) + old->count * sizeOfOneItem);
+		header->isInBuffer = false;
+		header->capacity = capacity;
 		*listPointer = header + 1;
 	}
 	else
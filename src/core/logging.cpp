@@ -0,0 +1,362 @@
+#include "../core.h"
+#include <stdlib.h>
+#include <stdio.h>
+#include <atomic>
+
+#ifndef __EMSCRIPTEN__
+#include <thread>
+#endif
+
+// Logging a message just formats it into a slot of a lock-free ring, so any thread can log without waiting on stdout
+// (or on console.log on the web, which is a lot slower). Once per frame the main thread flushes the ring,
+// which moves the messages into the history that the console window shows, and prints them.
+//
+// The ring is a bounded queue where every slot has a sequence number: it's 2 * lap while the slot is free
+// for the writer of that lap, and 2 * lap + 1 once the message in it is ready to be read. That way all
+// slots start out free when they're zero initialized. If the ring is full the message is dropped,
+// except on the main thread, which can just flush the ring to make space.
+//
+// raylib's own messages are logged into the raylib category through a trace log callback, so they get filtered like everyone
+// else's. That means we can't print with TraceLog, so we print the same way raylib does ourselves.
+
+#define LOG_RING_SIZE 256 // Must be a power of 2.
+#define LOG_HISTORY_SIZE 1024
+
+// How many messages per second a category may print; the rest only go into the history.
+// Errors are never rate limited.
+#define LOG_RATE_LIMIT 30
+
+// How often we print the number of repeats of a message that keeps being logged.
+#define LOG_REPEAT_INTERVAL 1.0
+
+STRUCT(LogSlot)
+{
+	std::atomic<unsigned> sequence;
+	LogEntry entry;
+};
+
+static LogSlot ring[LOG_RING_SIZE];
+static std::atomic<uint64_t> writeIndex;
+static uint64_t readIndex;
+static std::atomic<int> numDroppedMessages;
+static std::atomic<int> categoryLevels[LOG_CATEGORY_ENUM_COUNT]; // Relative to LOG_INFO, so that zero initialized means LOG_INFO.
+
+static LogEntry history[LOG_HISTORY_SIZE];
+static int historyStart;
+static int numHistoryEntries;
+
+static int numPrintedRepeats; // Of the newest history entry.
+static double repeatsPrintTime;
+static double rateLimitStartTime;
+static int numPrintedInCategory[LOG_CATEGORY_ENUM_COUNT];
+static int numSuppressedInCategory[LOG_CATEGORY_ENUM_COUNT];
+
+static const char *const categoryNames[LOG_CATEGORY_ENUM_COUNT] =
+{
+	"general",
+	"assets",
+	"scripts",
+	"scenes",
+	"console",
+	"raylib",
+};
+
+#ifndef __EMSCRIPTEN__
+static std::thread::id mainThreadId = std::this_thread::get_id(); // Static initialization happens on the main thread.
+#endif
+
+static bool IsMainThread(void)
+{
+	#ifdef __EMSCRIPTEN__
+	{
+		return true;
+	}
+	#else
+	{
+		return std::this_thread::get_id() == mainThreadId;
+	}
+	#endif
+}
+
+static bool TryPushLogEntry(LogCategory category, int logLevel, FORMAT_STRING format, va_list args)
+{
+	uint64_t position = writeIndex.load(std::memory_order_relaxed);
+	for (;;)
+	{
+		LogSlot *slot = &ring[position % LOG_RING_SIZE];
+		unsigned freeSequence = (unsigned)(2 * (position / LOG_RING_SIZE));
+		unsigned sequence = slot->sequence.load(std::memory_order_acquire);
+		if (sequence == freeSequence)
+		{
+			if (writeIndex.compare_exchange_weak(position, position + 1, std::memory_order_relaxed))
+			{
+				LogEntry *entry = &slot->entry;
+				entry->time = GetTime();
+				entry->level = logLevel;
+				entry->category = category;
+				entry->count = 1;
+				vsnprintf(entry->text, sizeof entry->text, format, args);
+				slot->sequence.store(freeSequence + 1, std::memory_order_release);
+				return true;
+			}
+		}
+		else if ((int)(sequence - freeSequence) < 0)
+			return false; // The slot still holds a message from the previous lap, so the ring is full.
+		else
+			position = writeIndex.load(std::memory_order_relaxed); // Another thread took this slot.
+	}
+}
+
+static void LogInternal(LogCategory category, int logLevel, FORMAT_STRING format, va_list args)
+{
+	if (logLevel < GetLogCategoryLevel(category))
+		return;
+
+	va_list copy;
+	va_copy(copy, args);
+	bool success = TryPushLogEntry(category, logLevel, format, copy);
+	va_end(copy);
+	if (not success and IsMainThread())
+	{
+		FlushLog();
+		success = TryPushLogEntry(category, logLevel, format, args);
+	}
+	if (not success)
+		++numDroppedMessages;
+}
+
+static void PrintLogLineV(int logLevel, FORMAT_STRING format, va_list args)
+{
+	static const char *const prefixes[] = { "", "TRACE: ", "DEBUG: ", "INFO: ", "WARNING: ", "ERROR: ", "FATAL: " };
+	fputs(logLevel >= 0 and logLevel < (int)COUNTOF(prefixes) ? prefixes[logLevel] : "", stdout);
+	vprintf(format, args);
+	fputs("\n", stdout);
+}
+
+static void PrintLogLine(int logLevel, FORMAT_STRING format, ...)
+{
+	va_list args;
+	va_start(args, format);
+	PrintLogLineV(logLevel, format, args);
+	va_end(args);
+}
+
+static void LogRaylibMessage(int logLevel, const char *text, va_list args)
+{
+	if (logLevel == LOG_FATAL)
+	{
+		// raylib doesn't exit by itself when there's a callback.
+		if (IsMainThread())
+			FlushLog();
+		PrintLogLineV(logLevel, text, args);
+		exit(EXIT_FAILURE);
+	}
+	LogInternal(LOG_CATEGORY_RAYLIB, logLevel, text, args);
+}
+
+static void PrintLogEntry(const LogEntry *entry, int count)
+{
+	double t = entry->time;
+	int us = (int)(t * 1e6) % 1000;
+	int ms = (int)(t * 1e3) % 1000;
+	int sec = (int)(t) % 60;
+	int min = (int)(t / 60) % 60;
+	int hour = (int)(t / 3600);
+
+	char category[32] = "";
+	if (entry->category != LOG_CATEGORY_GENERAL)
+		snprintf(category, sizeof category, "[%s] ", categoryNames[entry->category]);
+	if (count > 1)
+		PrintLogLine(entry->level, "[%02d:%02d:%02d.%03d'%03d] %s%s (x%d)", hour, min, sec, ms, us, category, entry->text, count);
+	else
+		PrintLogLine(entry->level, "[%02d:%02d:%02d.%03d'%03d] %s%s", hour, min, sec, ms, us, category, entry->text);
+}
+
+static LogEntry *GetNewestLogEntry(void)
+{
+	if (numHistoryEntries == 0)
+		return NULL;
+	return &history[(historyStart + numHistoryEntries - 1) % LOG_HISTORY_SIZE];
+}
+
+static bool IsLogEntryPrinted(const LogEntry *entry)
+{
+	return entry->category != LOG_CATEGORY_CONSOLE;
+}
+
+// Messages that keep getting logged only print how many times they were repeated, and only every once in a while.
+static void PrintLogRepeats(bool force)
+{
+	LogEntry *newest = GetNewestLogEntry();
+	if (not newest or not IsLogEntryPrinted(newest) or newest->count <= numPrintedRepeats)
+		return;
+	if (not force and newest->time - repeatsPrintTime < LOG_REPEAT_INTERVAL)
+		return;
+
+	PrintLogEntry(newest, newest->count);
+	numPrintedRepeats = newest->count;
+	repeatsPrintTime = newest->time;
+}
+
+static void AddToLogHistory(const LogEntry *entry)
+{
+	LogEntry *newest = GetNewestLogEntry();
+	if (newest and newest->level == entry->level and newest->category == entry->category and StringsEqual(newest->text, entry->text))
+	{
+		++newest->count;
+		newest->time = entry->time;
+		return;
+	}
+
+	PrintLogRepeats(true);
+	if (numHistoryEntries == LOG_HISTORY_SIZE)
+	{
+		historyStart = (historyStart + 1) % LOG_HISTORY_SIZE;
+		--numHistoryEntries;
+	}
+	newest = &history[(historyStart + numHistoryEntries) % LOG_HISTORY_SIZE];
+	++numHistoryEntries;
+	CopyBytes(newest, entry, sizeof newest[0]);
+	numPrintedRepeats = 1;
+	repeatsPrintTime = entry->time;
+
+	if (not IsLogEntryPrinted(entry))
+		return;
+	if (entry->level < LOG_ERROR and numPrintedInCategory[entry->category] >= LOG_RATE_LIMIT)
+	{
+		++numSuppressedInCategory[entry->category];
+		return;
+	}
+	++numPrintedInCategory[entry->category];
+	PrintLogEntry(entry, 1);
+}
+
+extern "C"
+{
+	void LogMessage(LogCategory category, int logLevel, FORMAT_STRING message, ...)
+	{
+		va_list args;
+		va_start(args, message);
+		LogInternal(category, logLevel, message, args);
+		va_end(args);
+	}
+
+	void LogInfo(FORMAT_STRING message, ...)
+	{
+		va_list args;
+		va_start(args, message);
+		LogInternal(LOG_CATEGORY_GENERAL, LOG_INFO, message, args);
+		va_end(args);
+	}
+
+	void LogWarning(FORMAT_STRING message, ...)
+	{
+		va_list args;
+		va_start(args, message);
+		LogInternal(LOG_CATEGORY_GENERAL, LOG_WARNING, message, args);
+		va_end(args);
+	}
+
+	void LogError(FORMAT_STRING message, ...)
+	{
+		va_list args;
+		va_start(args, message);
+		LogInternal(LOG_CATEGORY_GENERAL, LOG_ERROR, message, args);
+		va_end(args);
+	}
+
+	void Crash(FORMAT_STRING message, ...)
+	{
+		__debugbreak(); // Drop into debugger if possible, so we can see what happened from the call stack.
+
+		// Whatever was logged right before the crash is probably what we want to know about, so that goes out first.
+		if (IsMainThread())
+			FlushLog();
+
+		char buffer[LOG_MESSAGE_SIZE];
+		va_list args;
+		va_start(args, message);
+		vsnprintf(buffer, sizeof buffer, message, args);
+		va_end(args);
+		PrintLogLine(LOG_FATAL, "%s", buffer);
+		exit(EXIT_FAILURE);
+	}
+
+	void CaptureRaylibLog(void)
+	{
+		SetTraceLogCallback(LogRaylibMessage);
+		SetTraceLogLevel(LOG_ALL);
+	}
+
+	void SetLogCategoryLevel(LogCategory category, int logLevel)
+	{
+		if (category >= 0 and category < LOG_CATEGORY_ENUM_COUNT)
+			categoryLevels[category].store(logLevel - LOG_INFO, std::memory_order_relaxed);
+	}
+
+	int GetLogCategoryLevel(LogCategory category)
+	{
+		if (category < 0 or category >= LOG_CATEGORY_ENUM_COUNT)
+			return LOG_INFO;
+		return categoryLevels[category].load(std::memory_order_relaxed) + LOG_INFO;
+	}
+
+	const char *GetLogCategoryName(LogCategory category)
+	{
+		if (category < 0 or category >= LOG_CATEGORY_ENUM_COUNT)
+			return "";
+		return categoryNames[category];
+	}
+
+	void FlushLog(void)
+	{
+		double now = GetTime();
+		if (now - rateLimitStartTime >= 1)
+		{
+			for (int i = 0; i < LOG_CATEGORY_ENUM_COUNT; ++i)
+			{
+				if (numSuppressedInCategory[i] > 0)
+					PrintLogLine(LOG_WARNING, "Suppressed %d %s messages in the last second.", numSuppressedInCategory[i], categoryNames[i]);
+				numPrintedInCategory[i] = 0;
+				numSuppressedInCategory[i] = 0;
+			}
+			rateLimitStartTime = now;
+		}
+
+		for (;;)
+		{
+			LogSlot *slot = &ring[readIndex % LOG_RING_SIZE];
+			unsigned ready = (unsigned)(2 * (readIndex / LOG_RING_SIZE) + 1);
+			if (slot->sequence.load(std::memory_order_acquire) != ready)
+				break;
+
+			AddToLogHistory(&slot->entry);
+			slot->sequence.store(ready + 1, std::memory_order_release);
+			++readIndex;
+		}
+		PrintLogRepeats(false);
+
+		int numDropped = numDroppedMessages.exchange(0);
+		if (numDropped > 0)
+			PrintLogLine(LOG_WARNING, "Dropped %d log messages because the log ring was full.", numDropped);
+	}
+
+	int GetNumLogEntries(void)
+	{
+		return numHistoryEntries;
+	}
+
+	const LogEntry *GetLogEntry(int index)
+	{
+		if (index < 0 or index >= numHistoryEntries)
+			return NULL;
+		return &history[(historyStart + index) % LOG_HISTORY_SIZE];
+	}
+
+	void ClearLogHistory(void)
+	{
+		historyStart = 0;
+		numHistoryEntries = 0;
+		numPrintedRepeats = 0;
+	}
+}
@@ -2,6 +2,17 @@
 #include <string.h>
 #include <stdlib.h>
 
+#if defined(__SSE2__) || defined(_M_X64) || defined(_M_AMD64)
+#include <emmintrin.h>
+#define USE_SSE2
+#elif defined(__ARM_NEON)
+#include <arm_neon.h>
+#define USE_NEON
+#elif defined(__wasm_simd128__)
+#include <wasm_simd128.h>
+#define USE_WASM_SIMD
+#endif
+
 void ZeroBytes(void *bytes, int count)
 {
 	SetBytes(bytes, 0, count);
@@ -19,7 +30,36 @@ void SetInts(int *ints, int value, int count)
 {
 	ASSERT(ints or count <= 0);
 
-	for (int i = 0; i < count; ++i)
+	int i = 0;
+	#if defined(USE_SSE2)
+	{
+		__m128i v = _mm_set1_epi32(value);
+		for (; i + 8 <= count; i += 8)
+		{
+			_mm_storeu_si128((__m128i *)&ints[i], v);
+			_mm_storeu_si128((__m128i *)&ints[i + 4], v);
+		}
+	}
+	#elif defined(USE_NEON)
+	{
+		int32x4_t v = vdupq_n_s32(value);
+		for (; i + 8 <= count; i += 8)
+		{
+			vst1q_s32(&ints[i], v);
+			vst1q_s32(&ints[i + 4], v);
+		}
+	}
+	#elif defined(USE_WASM_SIMD)
+	{
+		v128_t v = wasm_i32x4_splat(value);
+		for (; i + 8 <= count; i += 8)
+		{
+			wasm_v128_store(&ints[i], v);
+			wasm_v128_store(&ints[i + 4], v);
+		}
+	}
+	#endif
+	for (; i < count; ++i)
 		ints[i] = value;
 }
 
@@ -27,8 +67,57 @@ void SetFloats(float *floats, float value, int count)
 {
 	ASSERT(floats or count <= 0);
 
-	for (int i = 0; i < count; ++i)
-		floats[i] = value;
+	// Setting floats is just setting their bits.
+	int bits;
+	CopyBytes(&bits, &value, sizeof bits);
+	SetInts((int *)floats, bits, count);
+}
+
+int FindInt(const int *ints, int value, int count)
+{
+	ASSERT(ints or count <= 0);
+
+	int i = 0;
+	#if defined(USE_SSE2)
+	{
+		__m128i v = _mm_set1_epi32(value);
+		for (; i + 8 <= count; i += 8)
+		{
+			__m128i a = _mm_cmpeq_epi32(_mm_loadu_si128((const __m128i *)&ints[i]), v);
+			__m128i b = _mm_cmpeq_epi32(_mm_loadu_si128((const __m128i *)&ints[i + 4]), v);
+			if (_mm_movemask_epi8(_mm_or_si128(a, b)))
+				break;
+		}
+	}
+	#elif defined(USE_NEON)
+	{
+		int32x4_t v = vdupq_n_s32(value);
+		for (; i + 8 <= count; i += 8)
+		{
+			uint32x4_t a = vceqq_s32(vld1q_s32(&ints[i]), v);
+			uint32x4_t b = vceqq_s32(vld1q_s32(&ints[i + 4]), v);
+			uint32x4_t any = vorrq_u32(a, b);
+			if (vgetq_lane_u64(vreinterpretq_u64_u32(any), 0) | vgetq_lane_u64(vreinterpretq_u64_u32(any), 1))
+				break;
+		}
+	}
+	#elif defined(USE_WASM_SIMD)
+	{
+		v128_t v = wasm_i32x4_splat(value);
+		for (; i + 8 <= count; i += 8)
+		{
+			v128_t a = wasm_i32x4_eq(wasm_v128_load(&ints[i]), v);
+			v128_t b = wasm_i32x4_eq(wasm_v128_load(&ints[i + 4]), v);
+			if (wasm_v128_any_true(wasm_v128_or(a, b)))
+				break;
+		}
+	}
+	#endif
+	// Either the block we stopped at has the value, or we're at the tail that didn't fill a whole block.
+	for (; i < count; ++i)
+		if (ints[i] == value)
+			return i;
+	return -1;
 }
 
 void CopyBytes(void *to, const void *from, int numBytes)
@@ -70,3 +159,83 @@ void Sort(void *items, int numItems, int sizeofOneItem, int(*compare)(const void
 
 	qsort(items, (size_t)numItems, (size_t)sizeofOneItem, compare);
 }
+
+// Maps the bits of a float to an unsigned int that sorts in the same order as the float.
+static uint32_t GetSortableFloatBits(float f)
+{
+	uint32_t bits;
+	CopyBytes(&bits, &f, sizeof bits);
+	if (bits & 0x80000000u)
+		return ~bits; // Negative floats sort backwards.
+	else
+		return bits | 0x80000000u;
+}
+
+void RadixSortByFloatKeys(float *keys, int *values, int count)
+{
+	ASSERT((keys and values) or count <= 0);
+
+	if (count <= 1)
+		return;
+
+	// An 8 bit digit at a time, least significant digit first. Every pass is a stable counting sort
+	// from source to destination, and a pass is skipped when all keys have the same digit, which is common for the upper bits.
+	int mark = TempMark();
+	uint32_t *sourceKeys = TempAlloc(count * (int)sizeof sourceKeys[0]);
+	uint32_t *destKeys = TempAlloc(count * (int)sizeof destKeys[0]);
+	int *sourceValues = values;
+	int *destValues = TempAlloc(count * (int)sizeof destValues[0]);
+
+	int counts[4][256];
+	ZeroBytes(counts, sizeof counts);
+	for (int i = 0; i < count; ++i)
+	{
+		uint32_t bits = GetSortableFloatBits(keys[i]);
+		sourceKeys[i] = bits;
+		++counts[0][bits & 0xFF];
+		++counts[1][(bits >> 8) & 0xFF];
+		++counts[2][(bits >> 16) & 0xFF];
+		++counts[3][bits >> 24];
+	}
+
+	for (int pass = 0; pass < 4; ++pass)
+	{
+		int shift = 8 * pass;
+		int *digitCounts = counts[pass];
+		if (digitCounts[(sourceKeys[0] >> shift) & 0xFF] == count)
+			continue;
+
+		int offset = 0;
+		for (int digit = 0; digit < 256; ++digit)
+		{
+			int digitCount = digitCounts[digit];
+			digitCounts[digit] = offset;
+			offset += digitCount;
+		}
+		for (int i = 0; i < count; ++i)
+		{
+			int j = digitCounts[(sourceKeys[i] >> shift) & 0xFF]++;
+			destKeys[j] = sourceKeys[i];
+			destValues[j] = sourceValues[i];
+		}
+
+		uint32_t *tempKeys = sourceKeys;
+		sourceKeys = destKeys;
+		destKeys = tempKeys;
+		int *tempValues = sourceValues;
+		sourceValues = destValues;
+		destValues = tempValues;
+	}
+
+	// The sortable bits map back to the exact same floats.
+	for (int i = 0; i < count; ++i)
+	{
+		uint32_t bits = sourceKeys[i];
+		bits = (bits & 0x80000000u) ? bits & 0x7FFFFFFFu : ~bits;
+		CopyBytes(&keys[i], &bits, sizeof bits);
+	}
+	if (sourceValues != values)
+		CopyBytes(values, sourceValues, count * (int)sizeof values[0]);
+
+	TempReset(mark);
+}
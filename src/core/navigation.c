@@ -0,0 +1,422 @@
+#include "../core.h"
+#include <stdlib.h>
+
+// Paths are found with A* over the 8 neighbors of every cell. Diagonal steps can't cut corners,
+// so a path never squeezes between two blocked cells that only touch at a corner.
+// A path that starts inside of blocked cells (e.g. a character inside of its own collision map)
+// can walk through blocked cells until it gets out, but never back into them.
+//
+// Only one request is searched at a time. Its search state covers the bounds of the grid plus
+// the start and goal, with some margin, since everything outside of the bounds is walkable anyway.
+// The state sticks around between calls to UpdateNavPaths, so a search can be spread over many frames.
+
+#define NAV_SEARCH_MARGIN 16
+#define NAV_MAX_SEARCH_CELLS (1 << 20)
+#define DIAGONAL_COST 1.41421356f
+
+ENUM(NavCellState)
+{
+	NAV_CELL_UNSEEN,
+	NAV_CELL_OPEN,
+	NAV_CELL_CLOSED,
+};
+
+STRUCT(NavOpenCell)
+{
+	int index;
+	float priority;
+};
+
+struct NavSearch
+{
+	int requestId;
+	int x0, y0;
+	int width, height;
+	int start, goal; // Indices into the search state.
+	float *costs; // Cost of the cheapest known way from the start to every cell.
+	int *cameFrom;
+	uint8_t *states;
+	List(NavOpenCell) open; // Binary min-heap on the priority.
+	int closest; // Where a partial path ends if the goal can't be reached.
+	float closestHeuristic;
+};
+
+static float GetHeuristic(int dx, int dy)
+{
+	dx = abs(dx);
+	dy = abs(dy);
+	int diagonal = dx < dy ? dx : dy;
+	int straight = (dx > dy ? dx : dy) - diagonal;
+	return (float)straight + DIAGONAL_COST * (float)diagonal;
+}
+
+static void PushOpenCell(NavSearch *search, int index, float priority)
+{
+	NavOpenCell cell = { index, priority };
+	ListAdd(&search->open, cell);
+
+	int i = ListCount(search->open) - 1;
+	while (i > 0)
+	{
+		int parent = (i - 1) / 2;
+		if (search->open[parent].priority <= search->open[i].priority)
+			break;
+		NavOpenCell temp = search->open[parent];
+		search->open[parent] = search->open[i];
+		search->open[i] = temp;
+		i = parent;
+	}
+}
+
+static int PopOpenCell(NavSearch *search)
+{
+	List(NavOpenCell) open = search->open;
+	int result = open[0].index;
+	int count = ListCount(open) - 1;
+	open[0] = open[count];
+	ListTruncate(search->open, count);
+
+	int i = 0;
+	for (;;)
+	{
+		int left = 2 * i + 1;
+		int right = left + 1;
+		int smallest = i;
+		if (left < count and open[left].priority < open[smallest].priority)
+			smallest = left;
+		if (right < count and open[right].priority < open[smallest].priority)
+			smallest = right;
+		if (smallest == i)
+			break;
+		NavOpenCell temp = open[smallest];
+		open[smallest] = open[i];
+		open[i] = temp;
+		i = smallest;
+	}
+	return result;
+}
+
+static void DestroySearch(NavGrid *grid)
+{
+	NavSearch *search = grid->search;
+	if (not search)
+		return;
+
+	MemFree(search->costs);
+	MemFree(search->cameFrom);
+	MemFree(search->states);
+	ListDestroy((List(void) *)&search->open);
+	MemFree(search);
+	grid->search = NULL;
+}
+
+static NavPathRequest *FindRequest(NavGrid *grid, int id)
+{
+	for (int i = 0; i < ListCount(grid->requests); ++i)
+		if (grid->requests[i].id == id)
+			return &grid->requests[i];
+	return NULL;
+}
+
+static NavPathRequest *FindFirstPendingRequest(NavGrid *grid)
+{
+	for (int i = 0; i < ListCount(grid->requests); ++i)
+		if (grid->requests[i].status == NAV_PATH_PENDING)
+			return &grid->requests[i];
+	return NULL;
+}
+
+// Returns false if the search would need too much memory.
+static bool StartSearch(NavGrid *grid, const NavPathRequest *request)
+{
+	int x0 = request->start.x < request->goal.x ? request->start.x : request->goal.x;
+	int y0 = request->start.y < request->goal.y ? request->start.y : request->goal.y;
+	int x1 = request->start.x > request->goal.x ? request->start.x : request->goal.x;
+	int y1 = request->start.y > request->goal.y ? request->start.y : request->goal.y;
+	if (grid->width > 0 and grid->height > 0)
+	{
+		x0 = x0 < grid->x0 ? x0 : grid->x0;
+		y0 = y0 < grid->y0 ? y0 : grid->y0;
+		x1 = x1 > grid->x0 + grid->width - 1 ? x1 : grid->x0 + grid->width - 1;
+		y1 = y1 > grid->y0 + grid->height - 1 ? y1 : grid->y0 + grid->height - 1;
+	}
+	x0 -= NAV_SEARCH_MARGIN;
+	y0 -= NAV_SEARCH_MARGIN;
+	x1 += NAV_SEARCH_MARGIN;
+	y1 += NAV_SEARCH_MARGIN;
+
+	int64_t numCells = (int64_t)(x1 - x0 + 1) * (int64_t)(y1 - y0 + 1);
+	if (numCells > NAV_MAX_SEARCH_CELLS)
+		return false;
+
+	NavSearch *search = MemAlloc(sizeof search[0]);
+	search->requestId = request->id;
+	search->x0 = x0;
+	search->y0 = y0;
+	search->width = x1 - x0 + 1;
+	search->height = y1 - y0 + 1;
+	search->costs = MemAlloc((int)numCells * sizeof search->costs[0]);
+	search->cameFrom = MemAlloc((int)numCells * sizeof search->cameFrom[0]);
+	search->states = MemAlloc((int)numCells * sizeof search->states[0]);
+	search->start = (request->start.y - y0) * search->width + (request->start.x - x0);
+	search->goal = (request->goal.y - y0) * search->width + (request->goal.x - x0);
+	search->closest = search->start;
+	search->closestHeuristic = GetHeuristic(request->goal.x - request->start.x, request->goal.y - request->start.y);
+
+	search->costs[search->start] = 0;
+	search->cameFrom[search->start] = -1;
+	search->states[search->start] = NAV_CELL_OPEN;
+	PushOpenCell(search, search->start, search->closestHeuristic);
+	grid->search = search;
+	return true;
+}
+
+static bool IsBlocked(const NavGrid *grid, const NavSearch *search, int index)
+{
+	int x = search->x0 + index % search->width;
+	int y = search->y0 + index / search->width;
+	return IsNavCellBlocked(grid, x, y);
+}
+
+static void FinishSearch(NavGrid *grid, NavPathRequest *request, bool foundGoal)
+{
+	NavSearch *search = grid->search;
+	int end = foundGoal ? search->goal : search->closest;
+
+	// Walk back from the end, so the path comes out reversed.
+	int numCells = 0;
+	for (int index = end; index != search->start; index = search->cameFrom[index])
+		++numCells;
+
+	ListClear(request->path);
+	request->status = foundGoal ? NAV_PATH_FOUND : NAV_PATH_PARTIAL;
+	if (numCells == 0)
+	{
+		DestroySearch(grid);
+		return; // Already there, or can't get any closer.
+	}
+
+	NavCell *cells = ListAllocate(&request->path, numCells);
+	int i = numCells;
+	for (int index = end; index != search->start; index = search->cameFrom[index])
+	{
+		NavCell cell = { search->x0 + index % search->width, search->y0 + index / search->width };
+		cells[--i] = cell;
+	}
+
+	// Only keep the cells where the path changes direction.
+	int numKept = 0;
+	NavCell previous = request->start;
+	for (i = 0; i < numCells; ++i)
+	{
+		bool isLast = i == numCells - 1;
+		if (not isLast)
+		{
+			NavCell next = cells[i + 1];
+			bool isStraight =
+				cells[i].x - previous.x == next.x - cells[i].x and
+				cells[i].y - previous.y == next.y - cells[i].y;
+			previous = cells[i];
+			if (isStraight)
+				continue;
+		}
+		cells[numKept++] = cells[i];
+	}
+	ListTruncate(request->path, numKept);
+	DestroySearch(grid);
+}
+
+// Returns the number of steps taken.
+static int StepSearch(NavGrid *grid, NavPathRequest *request, int maxSteps)
+{
+	static const int dx[8] = { +1, -1, 0, 0, +1, +1, -1, -1 };
+	static const int dy[8] = { 0, 0, +1, -1, +1, -1, +1, -1 };
+
+	NavSearch *search = grid->search;
+	int goalX = search->goal % search->width;
+	int goalY = search->goal / search->width;
+
+	int steps = 0;
+	while (steps < maxSteps)
+	{
+		if (ListCount(search->open) == 0)
+		{
+			FinishSearch(grid, request, false);
+			return steps;
+		}
+
+		int index = PopOpenCell(search);
+		if (search->states[index] == NAV_CELL_CLOSED)
+			continue; // Was pushed again with a lower cost after this entry.
+		search->states[index] = NAV_CELL_CLOSED;
+		++steps;
+
+		if (index == search->goal)
+		{
+			FinishSearch(grid, request, true);
+			return steps;
+		}
+
+		int x = index % search->width;
+		int y = index / search->width;
+		bool isEscaping = IsBlocked(grid, search, index); // Only possible if we started inside of blocked cells.
+		float heuristic = GetHeuristic(goalX - x, goalY - y);
+		if (search->closestHeuristic > heuristic)
+		{
+			search->closestHeuristic = heuristic;
+			search->closest = index;
+		}
+
+		for (int i = 0; i < 8; ++i)
+		{
+			int nx = x + dx[i];
+			int ny = y + dy[i];
+			if ((unsigned)nx >= (unsigned)search->width or (unsigned)ny >= (unsigned)search->height)
+				continue;
+
+			int neighbor = ny * search->width + nx;
+			if (search->states[neighbor] == NAV_CELL_CLOSED)
+				continue;
+			if (not isEscaping and IsBlocked(grid, search, neighbor))
+				continue;
+
+			bool isDiagonal = i >= 4;
+			if (isDiagonal and not isEscaping)
+			{
+				if (IsBlocked(grid, search, y * search->width + nx) or IsBlocked(grid, search, ny * search->width + x))
+					continue;
+			}
+
+			float cost = search->costs[index] + (isDiagonal ? DIAGONAL_COST : 1);
+			if (search->states[neighbor] == NAV_CELL_OPEN and search->costs[neighbor] <= cost)
+				continue;
+
+			search->states[neighbor] = NAV_CELL_OPEN;
+			search->costs[neighbor] = cost;
+			search->cameFrom[neighbor] = index;
+			PushOpenCell(search, neighbor, cost + GetHeuristic(goalX - nx, goalY - ny));
+		}
+	}
+	return steps;
+}
+
+NavGrid CreateNavGrid(void)
+{
+	NavGrid grid = { 0 };
+	grid.nextRequestId = 1;
+	return grid;
+}
+
+void DestroyNavGrid(NavGrid *grid)
+{
+	DestroySearch(grid);
+	for (int i = 0; i < ListCount(grid->requests); ++i)
+		ListDestroy((List(void) *)&grid->requests[i].path);
+	ListDestroy((List(void) *)&grid->requests);
+	MemFree(grid->blocked);
+	ZeroBytes(grid, sizeof grid[0]);
+}
+
+void ResizeNavGrid(NavGrid *grid, int x0, int y0, int width, int height)
+{
+	ASSERT(width >= 0 and height >= 0);
+	DestroySearch(grid);
+	MemFree(grid->blocked);
+	grid->x0 = x0;
+	grid->y0 = y0;
+	grid->width = width;
+	grid->height = height;
+	grid->blocked = width > 0 and height > 0 ? MemAlloc(width * height * sizeof grid->blocked[0]) : NULL;
+}
+
+void SetNavCellBlocked(NavGrid *grid, int x, int y, bool isBlocked)
+{
+	x -= grid->x0;
+	y -= grid->y0;
+	if ((unsigned)x < (unsigned)grid->width and (unsigned)y < (unsigned)grid->height)
+		grid->blocked[y * grid->width + x] = isBlocked;
+}
+
+bool IsNavCellBlocked(const NavGrid *grid, int x, int y)
+{
+	x -= grid->x0;
+	y -= grid->y0;
+	if ((unsigned)x >= (unsigned)grid->width or (unsigned)y >= (unsigned)grid->height)
+		return false;
+	return grid->blocked[y * grid->width + x];
+}
+
+int RequestNavPath(NavGrid *grid, NavCell start, NavCell goal)
+{
+	if (grid->nextRequestId <= 0)
+		grid->nextRequestId = 1; // Wrapped around, or the grid is zero initialized.
+
+	NavPathRequest *request = ListAllocateItem(&grid->requests);
+	ZeroBytes(request, sizeof request[0]);
+	request->id = grid->nextRequestId++;
+	request->start = start;
+	request->goal = goal;
+	request->status = NAV_PATH_PENDING;
+	return request->id;
+}
+
+void CancelNavPath(NavGrid *grid, int id)
+{
+	for (int i = 0; i < ListCount(grid->requests); ++i)
+	{
+		if (grid->requests[i].id == id)
+		{
+			if (grid->search and grid->search->requestId == id)
+				DestroySearch(grid);
+			ListDestroy((List(void) *)&grid->requests[i].path);
+
+			// Requests are searched in order, so we can't just swap remove.
+			int count = ListCount(grid->requests);
+			for (int j = i; j < count - 1; ++j)
+				grid->requests[j] = grid->requests[j + 1];
+			ListTruncate(grid->requests, count - 1);
+			return;
+		}
+	}
+}
+
+NavPathStatus GetNavPath(NavGrid *grid, int id, List(NavCell) *outPath)
+{
+	NavPathRequest *request = FindRequest(grid, id);
+	if (not request)
+		return NAV_PATH_INVALID;
+
+	NavPathStatus status = request->status;
+	if (status == NAV_PATH_PENDING)
+		return status;
+
+	*outPath = request->path;
+	request->path = NULL;
+	CancelNavPath(grid, id);
+	return status;
+}
+
+void UpdateNavPaths(NavGrid *grid, int maxSteps)
+{
+	while (maxSteps > 0)
+	{
+		NavPathRequest *request = FindFirstPendingRequest(grid);
+		if (not request)
+			return;
+
+		if (grid->search and grid->search->requestId != request->id)
+			DestroySearch(grid); // Can't really happen, but better safe than sorry.
+
+		if (not grid->search and not StartSearch(grid, request))
+		{
+			LogWarning("Path from cell (%d, %d) to (%d, %d) is too long to search for.", request->start.x, request->start.y, request->goal.x, request->goal.y);
+			ListClear(request->path);
+			request->status = NAV_PATH_PARTIAL;
+			continue;
+		}
+
+		// Even a search that finishes right away counts as a step, so we can't get stuck here.
+		int steps = StepSearch(grid, request, maxSteps);
+		maxSteps -= steps > 0 ? steps : 1;
+	}
+}
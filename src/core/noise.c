@@ -1,5 +1,58 @@
 #include "../core.h"
 
+// The batched noise functions return the exact same bits as the scalar ones, which only works if the compiler does
+// the exact same float operations in both, without fusing multiplies and adds into FMAs in one of them.
+// The builds pass -ffp-contract=off (clang and emcc) and /fp:precise (MSVC) for that. GCC ignores this pragma, so it needs the flag too.
+#ifdef __clang__
+#pragma STDC FP_CONTRACT OFF
+#endif
+
+// Just enough 4-wide SIMD to interpolate 4 noise samples at once. Only plain adds, subtracts and multiplies,
+// which give the same results as scalar floats on every platform.
+#if defined(__SSE2__) || defined(_M_X64) || defined(_M_AMD64)
+#include <emmintrin.h>
+typedef __m128 Float4;
+#define Float4Load(p)       _mm_loadu_ps(p)
+#define Float4Store(p, v)   _mm_storeu_ps(p, v)
+#define Float4Splat(f)      _mm_set1_ps(f)
+#define Float4Add(a, b)     _mm_add_ps(a, b)
+#define Float4Subtract(a, b) _mm_sub_ps(a, b)
+#define Float4Multiply(a, b) _mm_mul_ps(a, b)
+#elif defined(__ARM_NEON)
+#include <arm_neon.h>
+typedef float32x4_t Float4;
+#define Float4Load(p)       vld1q_f32(p)
+#define Float4Store(p, v)   vst1q_f32(p, v)
+#define Float4Splat(f)      vdupq_n_f32(f)
+#define Float4Add(a, b)     vaddq_f32(a, b)
+#define Float4Subtract(a, b) vsubq_f32(a, b)
+#define Float4Multiply(a, b) vmulq_f32(a, b)
+#elif defined(__wasm_simd128__)
+#include <wasm_simd128.h>
+typedef v128_t Float4;
+#define Float4Load(p)       wasm_v128_load(p)
+#define Float4Store(p, v)   wasm_v128_store(p, v)
+#define Float4Splat(f)      wasm_f32x4_splat(f)
+#define Float4Add(a, b)     wasm_f32x4_add(a, b)
+#define Float4Subtract(a, b) wasm_f32x4_sub(a, b)
+#define Float4Multiply(a, b) wasm_f32x4_mul(a, b)
+#else
+STRUCT(Float4)
+{
+	float f[4];
+};
+static Float4 Float4Load(const float *p) { Float4 r; for (int i = 0; i < 4; ++i) r.f[i] = p[i]; return r; }
+static void Float4Store(float *p, Float4 v) { for (int i = 0; i < 4; ++i) p[i] = v.f[i]; }
+static Float4 Float4Splat(float f) { Float4 r; for (int i = 0; i < 4; ++i) r.f[i] = f; return r; }
+static Float4 Float4Add(Float4 a, Float4 b) { for (int i = 0; i < 4; ++i) a.f[i] += b.f[i]; return a; }
+static Float4 Float4Subtract(Float4 a, Float4 b) { for (int i = 0; i < 4; ++i) a.f[i] -= b.f[i]; return a; }
+static Float4 Float4Multiply(Float4 a, Float4 b) { for (int i = 0; i < 4; ++i) a.f[i] *= b.f[i]; return a; }
+#endif
+
+// Points that are close together mostly share their lattice cells, so the batch functions remember the last couple of
+// lattice gradients instead of hashing and taking sines and cosines for every corner of every point again.
+#define GRADIENT_CACHE_SIZE 256 // Must be a power of 2.
+
 static unsigned RandomBitsToRange(unsigned rand1, unsigned rand2, unsigned range)
 {
 	// https://github.com/apple/swift/pull/39143
@@ -167,6 +220,15 @@ float ValueNoise3V(unsigned seed, Vector3 position)
 	return ValueNoise3(seed, position.x, position.y, position.z);
 }
 
+static Vector2 PerlinGradient2(unsigned seed, int x, int y)
+{
+	return UnitVector2WithAngle(2 * PI * FloatNoise2(seed, x, y));
+}
+static Vector3 PerlinGradient3(unsigned seed, int x, int y, int z)
+{
+	return UnitVector3FromSphericalCoordinates(2 * PI * FloatNoise3(seed, x, y, z), 2 * PI * FloatNoise3(seed + 1, x, y, z));
+}
+
 float PerlinNoise1(unsigned seed, float x)
 {
 	int x0 = (int)floorf(x);
@@ -196,10 +258,10 @@ float PerlinNoise2(unsigned seed, float x, float y)
 	float dy0 = y - (float)y0;
 	float dy1 = y - (float)y1;
 
-	Vector2 v00 = UnitVector2WithAngle(2 * PI * FloatNoise2(seed, x0, y0));
-	Vector2 v01 = UnitVector2WithAngle(2 * PI * FloatNoise2(seed, x0, y1));
-	Vector2 v10 = UnitVector2WithAngle(2 * PI * FloatNoise2(seed, x1, y0));
-	Vector2 v11 = UnitVector2WithAngle(2 * PI * FloatNoise2(seed, x1, y1));
+	Vector2 v00 = PerlinGradient2(seed, x0, y0);
+	Vector2 v01 = PerlinGradient2(seed, x0, y1);
+	Vector2 v10 = PerlinGradient2(seed, x1, y0);
+	Vector2 v11 = PerlinGradient2(seed, x1, y1);
 	
 	float d00 = (dx0 * v00.x) + (dy0 * v00.y);
 	float d01 = (dx0 * v01.x) + (dy1 * v01.y);
@@ -229,14 +291,14 @@ float PerlinNoise3(unsigned seed, float x, float y, float z)
 	float dz0 = z - (float)z0;
 	float dz1 = z - (float)z1;
 
-	Vector3 v000 = UnitVector3FromSphericalCoordinates(2 * PI * FloatNoise3(seed, x0, y0, z0), 2 * PI * FloatNoise3(seed + 1, x0, y0, z0));
-	Vector3 v001 = UnitVector3FromSphericalCoordinates(2 * PI * FloatNoise3(seed, x0, y0, z1), 2 * PI * FloatNoise3(seed + 1, x0, y0, z1));
-	Vector3 v010 = UnitVector3FromSphericalCoordinates(2 * PI * FloatNoise3(seed, x0, y1, z0), 2 * PI * FloatNoise3(seed + 1, x0, y1, z0));
-	Vector3 v011 = UnitVector3FromSphericalCoordinates(2 * PI * FloatNoise3(seed, x0, y1, z1), 2 * PI * FloatNoise3(seed + 1, x0, y1, z1));
-	Vector3 v100 = UnitVector3FromSphericalCoordinates(2 * PI * FloatNoise3(seed, x1, y0, z0), 2 * PI * FloatNoise3(seed + 1, x1, y0, z0));
-	Vector3 v101 = UnitVector3FromSphericalCoordinates(2 * PI * FloatNoise3(seed, x1, y0, z1), 2 * PI * FloatNoise3(seed + 1, x1, y0, z1));
-	Vector3 v110 = UnitVector3FromSphericalCoordinates(2 * PI * FloatNoise3(seed, x1, y1, z0), 2 * PI * FloatNoise3(seed + 1, x1, y1, z0));
-	Vector3 v111 = UnitVector3FromSphericalCoordinates(2 * PI * FloatNoise3(seed, x1, y1, z1), 2 * PI * FloatNoise3(seed + 1, x1, y1, z1));
+	Vector3 v000 = PerlinGradient3(seed, x0, y0, z0);
+	Vector3 v001 = PerlinGradient3(seed, x0, y0, z1);
+	Vector3 v010 = PerlinGradient3(seed, x0, y1, z0);
+	Vector3 v011 = PerlinGradient3(seed, x0, y1, z1);
+	Vector3 v100 = PerlinGradient3(seed, x1, y0, z0);
+	Vector3 v101 = PerlinGradient3(seed, x1, y0, z1);
+	Vector3 v110 = PerlinGradient3(seed, x1, y1, z0);
+	Vector3 v111 = PerlinGradient3(seed, x1, y1, z1);
 
 	float d000 = (dx0 * v000.x) + (dy0 * v000.y) + (dz0 * v000.z);
 	float d001 = (dx0 * v001.x) + (dy0 * v001.y) + (dz1 * v001.z);
@@ -266,4 +328,298 @@ float PerlinNoise2V(unsigned seed, Vector2 position)
 float PerlinNoise3V(unsigned seed, Vector3 position)
 {
 	return PerlinNoise3(seed, position.x, position.y, position.z);
-}
\ No newline at end of file
+}
+STRUCT(GradientCache2)
+{
+	bool isValid[GRADIENT_CACHE_SIZE];
+	int x[GRADIENT_CACHE_SIZE];
+	int y[GRADIENT_CACHE_SIZE];
+	Vector2 gradients[GRADIENT_CACHE_SIZE];
+};
+
+STRUCT(GradientCache3)
+{
+	bool isValid[GRADIENT_CACHE_SIZE];
+	int x[GRADIENT_CACHE_SIZE];
+	int y[GRADIENT_CACHE_SIZE];
+	int z[GRADIENT_CACHE_SIZE];
+	Vector3 gradients[GRADIENT_CACHE_SIZE];
+};
+
+static Vector2 GetCachedPerlinGradient2(GradientCache2 *cache, unsigned seed, int x, int y)
+{
+	unsigned slot = ((unsigned)x * 0x8DA6B343u ^ (unsigned)y * 0xD8163841u) & (GRADIENT_CACHE_SIZE - 1);
+	if (not cache->isValid[slot] or cache->x[slot] != x or cache->y[slot] != y)
+	{
+		cache->isValid[slot] = true;
+		cache->x[slot] = x;
+		cache->y[slot] = y;
+		cache->gradients[slot] = PerlinGradient2(seed, x, y);
+	}
+	return cache->gradients[slot];
+}
+
+static Vector3 GetCachedPerlinGradient3(GradientCache3 *cache, unsigned seed, int x, int y, int z)
+{
+	unsigned slot = ((unsigned)x * 0x8DA6B343u ^ (unsigned)y * 0xD8163841u ^ (unsigned)z * 0xCB1AB31Fu) & (GRADIENT_CACHE_SIZE - 1);
+	if (not cache->isValid[slot] or cache->x[slot] != x or cache->y[slot] != y or cache->z[slot] != z)
+	{
+		cache->isValid[slot] = true;
+		cache->x[slot] = x;
+		cache->y[slot] = y;
+		cache->z[slot] = z;
+		cache->gradients[slot] = PerlinGradient3(seed, x, y, z);
+	}
+	return cache->gradients[slot];
+}
+
+// Everything that 4 samples of 2D Perlin noise need after the lattice lookups, one lane per sample.
+// Corners are indexed like v00, v01, v10, v11 in PerlinNoise2.
+STRUCT(PerlinLanes2)
+{
+	float dx0[4], dx1[4];
+	float dy0[4], dy1[4];
+	float weightX[4], weightY[4];
+	float gradientX[4][4]; // [corner][lane]
+	float gradientY[4][4];
+};
+
+// Same as PerlinLanes2, corners are indexed like v000 ... v111 in PerlinNoise3.
+STRUCT(PerlinLanes3)
+{
+	float dx0[4], dx1[4];
+	float dy0[4], dy1[4];
+	float dz0[4], dz1[4];
+	float weightX[4], weightY[4], weightZ[4];
+	float gradientX[8][4]; // [corner][lane]
+	float gradientY[8][4];
+	float gradientZ[8][4];
+};
+
+// Does the exact same operations as PerlinNoise2, in the same order, so the results are the same too.
+static void InterpolatePerlinLanes2(const PerlinLanes2 *lanes, float out[4])
+{
+	Float4 dx0 = Float4Load(lanes->dx0);
+	Float4 dx1 = Float4Load(lanes->dx1);
+	Float4 dy0 = Float4Load(lanes->dy0);
+	Float4 dy1 = Float4Load(lanes->dy1);
+
+	Float4 d00 = Float4Add(Float4Multiply(dx0, Float4Load(lanes->gradientX[0])), Float4Multiply(dy0, Float4Load(lanes->gradientY[0])));
+	Float4 d01 = Float4Add(Float4Multiply(dx0, Float4Load(lanes->gradientX[1])), Float4Multiply(dy1, Float4Load(lanes->gradientY[1])));
+	Float4 d10 = Float4Add(Float4Multiply(dx1, Float4Load(lanes->gradientX[2])), Float4Multiply(dy0, Float4Load(lanes->gradientY[2])));
+	Float4 d11 = Float4Add(Float4Multiply(dx1, Float4Load(lanes->gradientX[3])), Float4Multiply(dy1, Float4Load(lanes->gradientY[3])));
+
+	Float4 weightY = Float4Load(lanes->weightY);
+	Float4 weightX = Float4Load(lanes->weightX);
+
+	Float4 d0 = Float4Add(d00, Float4Multiply(Float4Subtract(d01, d00), weightY));
+	Float4 d1 = Float4Add(d10, Float4Multiply(Float4Subtract(d11, d10), weightY));
+	Float4Store(out, Float4Add(d0, Float4Multiply(Float4Subtract(d1, d0), weightX)));
+}
+
+// Does the exact same operations as PerlinNoise3, in the same order, so the results are the same too.
+static void InterpolatePerlinLanes3(const PerlinLanes3 *lanes, float out[4])
+{
+	Float4 dx[2] = { Float4Load(lanes->dx0), Float4Load(lanes->dx1) };
+	Float4 dy[2] = { Float4Load(lanes->dy0), Float4Load(lanes->dy1) };
+	Float4 dz[2] = { Float4Load(lanes->dz0), Float4Load(lanes->dz1) };
+
+	Float4 d[8];
+	for (int corner = 0; corner < 8; ++corner)
+	{
+		Float4 x = Float4Multiply(dx[(corner >> 2) & 1], Float4Load(lanes->gradientX[corner]));
+		Float4 y = Float4Multiply(dy[(corner >> 1) & 1], Float4Load(lanes->gradientY[corner]));
+		Float4 z = Float4Multiply(dz[corner & 1], Float4Load(lanes->gradientZ[corner]));
+		d[corner] = Float4Add(Float4Add(x, y), z);
+	}
+
+	Float4 weightZ = Float4Load(lanes->weightZ);
+	Float4 weightY = Float4Load(lanes->weightY);
+	Float4 weightX = Float4Load(lanes->weightX);
+
+	Float4 d00 = Float4Add(d[0], Float4Multiply(Float4Subtract(d[1], d[0]), weightZ));
+	Float4 d01 = Float4Add(d[2], Float4Multiply(Float4Subtract(d[3], d[2]), weightZ));
+	Float4 d10 = Float4Add(d[4], Float4Multiply(Float4Subtract(d[5], d[4]), weightZ));
+	Float4 d11 = Float4Add(d[6], Float4Multiply(Float4Subtract(d[7], d[6]), weightZ));
+	Float4 d0 = Float4Add(d00, Float4Multiply(Float4Subtract(d01, d00), weightY));
+	Float4 d1 = Float4Add(d10, Float4Multiply(Float4Subtract(d11, d10), weightY));
+	Float4Store(out, Float4Add(d0, Float4Multiply(Float4Subtract(d1, d0), weightX)));
+}
+
+static void SetPerlinLaneGradients2(PerlinLanes2 *lanes, int lane, GradientCache2 *cache, unsigned seed, int x0, int y0)
+{
+	for (int corner = 0; corner < 4; ++corner)
+	{
+		Vector2 gradient = GetCachedPerlinGradient2(cache, seed, x0 + (corner >> 1), y0 + (corner & 1));
+		lanes->gradientX[corner][lane] = gradient.x;
+		lanes->gradientY[corner][lane] = gradient.y;
+	}
+}
+
+static void SetPerlinLaneGradients3(PerlinLanes3 *lanes, int lane, GradientCache3 *cache, unsigned seed, int x0, int y0, int z0)
+{
+	for (int corner = 0; corner < 8; ++corner)
+	{
+		Vector3 gradient = GetCachedPerlinGradient3(cache, seed, x0 + ((corner >> 2) & 1), y0 + ((corner >> 1) & 1), z0 + (corner & 1));
+		lanes->gradientX[corner][lane] = gradient.x;
+		lanes->gradientY[corner][lane] = gradient.y;
+		lanes->gradientZ[corner][lane] = gradient.z;
+	}
+}
+
+// The lattice cell and the offsets into it along one axis, same as in PerlinNoise2 and PerlinNoise3.
+STRUCT(PerlinAxis)
+{
+	int cell;
+	float d0;
+	float d1;
+	float weight;
+};
+
+static PerlinAxis GetPerlinAxis(float x)
+{
+	PerlinAxis axis;
+	axis.cell = (int)floorf(x);
+	axis.d0 = x - (float)axis.cell;
+	axis.d1 = x - (float)(axis.cell + 1);
+	axis.weight = Smootherstep01(axis.d0);
+	return axis;
+}
+
+static void SetPerlinLaneAxes2(PerlinLanes2 *lanes, int lane, PerlinAxis x, PerlinAxis y)
+{
+	lanes->dx0[lane] = x.d0;
+	lanes->dx1[lane] = x.d1;
+	lanes->dy0[lane] = y.d0;
+	lanes->dy1[lane] = y.d1;
+	lanes->weightX[lane] = x.weight;
+	lanes->weightY[lane] = y.weight;
+}
+
+static void SetPerlinLaneAxes3(PerlinLanes3 *lanes, int lane, PerlinAxis x, PerlinAxis y, PerlinAxis z)
+{
+	lanes->dx0[lane] = x.d0;
+	lanes->dx1[lane] = x.d1;
+	lanes->dy0[lane] = y.d0;
+	lanes->dy1[lane] = y.d1;
+	lanes->dz0[lane] = z.d0;
+	lanes->dz1[lane] = z.d1;
+	lanes->weightX[lane] = x.weight;
+	lanes->weightY[lane] = y.weight;
+	lanes->weightZ[lane] = z.weight;
+}
+
+void PerlinNoise2Batch(unsigned seed, const float xs[], const float ys[], float out[], int count)
+{
+	GradientCache2 *cache = TempAlloc(sizeof cache[0]);
+	ZeroBytes(cache->isValid, sizeof cache->isValid);
+	for (int i = 0; i < count; i += 4)
+	{
+		int numLanes = count - i < 4 ? count - i : 4;
+		PerlinLanes2 lanes;
+		ZeroBytes(&lanes, sizeof lanes);
+		for (int lane = 0; lane < numLanes; ++lane)
+		{
+			PerlinAxis x = GetPerlinAxis(xs[i + lane]);
+			PerlinAxis y = GetPerlinAxis(ys[i + lane]);
+			SetPerlinLaneAxes2(&lanes, lane, x, y);
+			SetPerlinLaneGradients2(&lanes, lane, cache, seed, x.cell, y.cell);
+		}
+		float results[4];
+		InterpolatePerlinLanes2(&lanes, results);
+		CopyBytes(out + i, results, numLanes * sizeof results[0]);
+	}
+	TempFree(cache);
+}
+
+void PerlinNoise3Batch(unsigned seed, const float xs[], const float ys[], const float zs[], float out[], int count)
+{
+	GradientCache3 *cache = TempAlloc(sizeof cache[0]);
+	ZeroBytes(cache->isValid, sizeof cache->isValid);
+	for (int i = 0; i < count; i += 4)
+	{
+		int numLanes = count - i < 4 ? count - i : 4;
+		PerlinLanes3 lanes;
+		ZeroBytes(&lanes, sizeof lanes);
+		for (int lane = 0; lane < numLanes; ++lane)
+		{
+			PerlinAxis x = GetPerlinAxis(xs[i + lane]);
+			PerlinAxis y = GetPerlinAxis(ys[i + lane]);
+			PerlinAxis z = GetPerlinAxis(zs[i + lane]);
+			SetPerlinLaneAxes3(&lanes, lane, x, y, z);
+			SetPerlinLaneGradients3(&lanes, lane, cache, seed, x.cell, y.cell, z.cell);
+		}
+		float results[4];
+		InterpolatePerlinLanes3(&lanes, results);
+		CopyBytes(out + i, results, numLanes * sizeof results[0]);
+	}
+	TempFree(cache);
+}
+
+// Every sample in a column has the same x, so the columns are only worked out once.
+static PerlinAxis *GetPerlinGridColumns(float x, float step, int width)
+{
+	PerlinAxis *columns = TempAlloc(width * (int)sizeof columns[0]);
+	for (int i = 0; i < width; ++i)
+		columns[i] = GetPerlinAxis(x + (float)i * step);
+	return columns;
+}
+
+void PerlinNoise2Grid(unsigned seed, float x, float y, float step, int width, int height, float out[])
+{
+	int mark = TempMark();
+	GradientCache2 *cache = TempAlloc(sizeof cache[0]);
+	ZeroBytes(cache->isValid, sizeof cache->isValid);
+	PerlinAxis *columns = GetPerlinGridColumns(x, step, width);
+	for (int j = 0; j < height; ++j)
+	{
+		PerlinAxis row = GetPerlinAxis(y + (float)j * step);
+		float *rowOut = out + j * width;
+		for (int i = 0; i < width; i += 4)
+		{
+			int numLanes = width - i < 4 ? width - i : 4;
+			PerlinLanes2 lanes;
+			ZeroBytes(&lanes, sizeof lanes);
+			for (int lane = 0; lane < numLanes; ++lane)
+			{
+				PerlinAxis column = columns[i + lane];
+				SetPerlinLaneAxes2(&lanes, lane, column, row);
+				SetPerlinLaneGradients2(&lanes, lane, cache, seed, column.cell, row.cell);
+			}
+			float results[4];
+			InterpolatePerlinLanes2(&lanes, results);
+			CopyBytes(rowOut + i, results, numLanes * sizeof results[0]);
+		}
+	}
+	TempReset(mark);
+}
+
+void PerlinNoise3Grid(unsigned seed, float x, float y, float z, float step, int width, int height, float out[])
+{
+	int mark = TempMark();
+	GradientCache3 *cache = TempAlloc(sizeof cache[0]);
+	ZeroBytes(cache->isValid, sizeof cache->isValid);
+	PerlinAxis *columns = GetPerlinGridColumns(x, step, width);
+	PerlinAxis slice = GetPerlinAxis(z);
+	for (int j = 0; j < height; ++j)
+	{
+		PerlinAxis row = GetPerlinAxis(y + (float)j * step);
+		float *rowOut = out + j * width;
+		for (int i = 0; i < width; i += 4)
+		{
+			int numLanes = width - i < 4 ? width - i : 4;
+			PerlinLanes3 lanes;
+			ZeroBytes(&lanes, sizeof lanes);
+			for (int lane = 0; lane < numLanes; ++lane)
+			{
+				PerlinAxis column = columns[i + lane];
+				SetPerlinLaneAxes3(&lanes, lane, column, row, slice);
+				SetPerlinLaneGradients3(&lanes, lane, cache, seed, column.cell, row.cell, slice.cell);
+			}
+			float results[4];
+			InterpolatePerlinLanes3(&lanes, results);
+			CopyBytes(rowOut + i, results, numLanes * sizeof results[0]);
+		}
+	}
+	TempReset(mark);
+}
@@ -0,0 +1,315 @@
+#include "../core.h"
+
+// Every particle is one slot in each of the arrays, and particles that die are swapped with the last one, so the
+// living particles are always the first numParticles slots. The update is then just a couple of loops that each
+// do one simple thing to every slot, which is what compilers are best at turning into SIMD code.
+
+enum { NUM_PARTICLE_ARRAYS = 9 };
+
+// Points all of the arrays into the block, which has to fit capacity particles.
+static void SetParticleArrays(ParticleEmitter *emitter, void *block, int capacity)
+{
+	float *floats = (float *)block;
+	emitter->x = floats + 0 * capacity;
+	emitter->y = floats + 1 * capacity;
+	emitter->previousX = floats + 2 * capacity;
+	emitter->previousY = floats + 3 * capacity;
+	emitter->velocityX = floats + 4 * capacity;
+	emitter->velocityY = floats + 5 * capacity;
+	emitter->age = floats + 6 * capacity;
+	emitter->lifetime = floats + 7 * capacity;
+	emitter->frame = (int *)(floats + 8 * capacity);
+	emitter->capacity = capacity;
+}
+
+static int GetParticleCapacity(ParticleEmitterSettings settings)
+{
+	return ClampInt(settings.budget, 0, MAX_PARTICLES_PER_EMITTER);
+}
+
+ParticleEmitter *CreateParticleEmitter(ParticleEmitterSettings settings, unsigned seed)
+{
+	ParticleEmitter *emitter = MemAlloc(sizeof emitter[0]);
+	ZeroBytes(emitter, sizeof emitter[0]);
+	emitter->settings = settings;
+	emitter->random = (Random) { seed };
+	emitter->noiseSeed = BitNoise1(seed, -1);
+
+	int capacity = GetParticleCapacity(settings);
+	if (capacity > 0)
+		SetParticleArrays(emitter, MemAlloc(capacity * NUM_PARTICLE_ARRAYS * (int)sizeof(float)), capacity);
+	return emitter;
+}
+
+void SetParticleEmitterSettings(ParticleEmitter *emitter, ParticleEmitterSettings settings)
+{
+	emitter->settings = settings;
+	int capacity = GetParticleCapacity(settings);
+	if (capacity == emitter->capacity)
+		return;
+
+	ParticleEmitter old = *emitter;
+	int numKept = emitter->numParticles < capacity ? emitter->numParticles : capacity;
+	if (capacity > 0)
+	{
+		SetParticleArrays(emitter, MemAlloc(capacity * NUM_PARTICLE_ARRAYS * (int)sizeof(float)), capacity);
+		CopyBytes(emitter->x, old.x, numKept * sizeof(float));
+		CopyBytes(emitter->y, old.y, numKept * sizeof(float));
+		CopyBytes(emitter->previousX, old.previousX, numKept * sizeof(float));
+		CopyBytes(emitter->previousY, old.previousY, numKept * sizeof(float));
+		CopyBytes(emitter->velocityX, old.velocityX, numKept * sizeof(float));
+		CopyBytes(emitter->velocityY, old.velocityY, numKept * sizeof(float));
+		CopyBytes(emitter->age, old.age, numKept * sizeof(float));
+		CopyBytes(emitter->lifetime, old.lifetime, numKept * sizeof(float));
+		CopyBytes(emitter->frame, old.frame, numKept * sizeof(int));
+	}
+	else
+		SetParticleArrays(emitter, NULL, 0);
+	emitter->numParticles = numKept;
+	MemFree(old.x);
+}
+
+void DestroyParticleEmitter(ParticleEmitter *emitter)
+{
+	if (not emitter)
+		return;
+	MemFree(emitter->x);
+	MemFree(emitter);
+}
+
+static void KillParticle(ParticleEmitter *emitter, int i)
+{
+	int last = --emitter->numParticles;
+	emitter->x[i] = emitter->x[last];
+	emitter->y[i] = emitter->y[last];
+	emitter->previousX[i] = emitter->previousX[last];
+	emitter->previousY[i] = emitter->previousY[last];
+	emitter->velocityX[i] = emitter->velocityX[last];
+	emitter->velocityY[i] = emitter->velocityY[last];
+	emitter->age[i] = emitter->age[last];
+	emitter->lifetime[i] = emitter->lifetime[last];
+	emitter->frame[i] = emitter->frame[last];
+}
+
+static void SpawnParticles(ParticleEmitter *emitter, Vector2 position, int count)
+{
+	ParticleEmitterSettings *settings = &emitter->settings;
+	Random *random = &emitter->random;
+	int numFrames = settings->sprite ? settings->sprite->numFrames : 0;
+	for (int n = 0; n < count; ++n)
+	{
+		int i = emitter->numParticles++;
+
+		// sqrt makes the particles spread out evenly over the circle, instead of bunching up in the middle.
+		float angle = RandomFloat(random, 0, 2 * PI);
+		float radius = settings->spawnRadius * sqrtf(RandomFloat01(random));
+		emitter->x[i] = position.x + radius * cosf(angle);
+		emitter->y[i] = position.y + radius * sinf(angle);
+		emitter->previousX[i] = emitter->x[i];
+		emitter->previousY[i] = emitter->y[i];
+
+		float spreadAngle = RandomFloat(random, 0, 2 * PI);
+		float spread = settings->velocitySpread * RandomFloat01(random);
+		emitter->velocityX[i] = settings->velocity.x + spread * cosf(spreadAngle);
+		emitter->velocityY[i] = settings->velocity.y + spread * sinf(spreadAngle);
+
+		float lifetime = settings->lifetime + RandomFloat(random, -settings->lifetimeVariance, +settings->lifetimeVariance);
+		emitter->age[i] = 0;
+		emitter->lifetime[i] = lifetime > 0.01f ? lifetime : 0.01f;
+		emitter->frame[i] = numFrames > 1 ? RandomInt(random, 0, numFrames - 1) : 0;
+	}
+}
+
+// The particles are drawn somewhere between their previous and current position, so the bounds cover both.
+static void UpdateParticleBounds(ParticleEmitter *emitter)
+{
+	const ParticleEmitterSettings *settings = &emitter->settings;
+	int count = emitter->numParticles;
+	if (count == 0)
+	{
+		emitter->bounds = (Rectangle) { 0 };
+		return;
+	}
+
+	float minX = emitter->x[0], minY = emitter->y[0];
+	float maxX = emitter->x[0], maxY = emitter->y[0];
+	for (int i = 0; i < count; ++i)
+	{
+		minX = fminf(minX, fminf(emitter->x[i], emitter->previousX[i]));
+		minY = fminf(minY, fminf(emitter->y[i], emitter->previousY[i]));
+		maxX = fmaxf(maxX, fmaxf(emitter->x[i], emitter->previousX[i]));
+		maxY = fmaxf(maxY, fmaxf(emitter->y[i], emitter->previousY[i]));
+	}
+
+	// Just assume every particle is as big as the biggest one can get, instead of keeping track of the size of each.
+	float halfWidth = 0.5f, halfHeight = 0.5f;
+	if (settings->sprite)
+	{
+		halfWidth = halfHeight = 0;
+		for (int i = 0; i < settings->sprite->numFrames; ++i)
+		{
+			halfWidth = fmaxf(halfWidth, 0.5f * settings->sprite->frames[i].source.width);
+			halfHeight = fmaxf(halfHeight, 0.5f * settings->sprite->frames[i].source.height);
+		}
+	}
+	float size = fmaxf(fabsf(settings->startSize), fabsf(settings->endSize));
+	emitter->bounds = (Rectangle) {
+		minX - size * halfWidth,
+		minY - size * halfHeight,
+		maxX - minX + 2 * size * halfWidth,
+		maxY - minY + 2 * size * halfHeight,
+	};
+}
+
+void UpdateParticleEmitter(ParticleEmitter *emitter, Vector2 position, float deltaTime)
+{
+	ParticleEmitterSettings *settings = &emitter->settings;
+	emitter->time += deltaTime;
+
+	int count = emitter->numParticles;
+	for (int i = 0; i < count; ++i)
+		emitter->age[i] += deltaTime;
+
+	for (int i = 0; i < emitter->numParticles;)
+	{
+		if (emitter->age[i] >= emitter->lifetime[i])
+			KillParticle(emitter, i);
+		else
+			++i;
+	}
+
+	count = emitter->numParticles;
+	CopyBytes(emitter->previousX, emitter->x, count * sizeof(float));
+	CopyBytes(emitter->previousY, emitter->y, count * sizeof(float));
+
+	if (settings->turbulence != 0 and count > 0)
+	{
+		// The noise slowly changes over time, so the swirls don't stay in one place.
+		int mark = TempMark();
+		float *noiseX = TempAlloc(count * (int)sizeof(float));
+		float *noiseY = TempAlloc(count * (int)sizeof(float));
+		float *noiseZ = TempAlloc(count * (int)sizeof(float));
+		float *forceX = TempAlloc(count * (int)sizeof(float));
+		float *forceY = TempAlloc(count * (int)sizeof(float));
+		float frequency = 1 / (settings->turbulenceScale > 1 ? settings->turbulenceScale : 1);
+		float z = 0.5f * emitter->time;
+		for (int i = 0; i < count; ++i)
+		{
+			noiseX[i] = frequency * emitter->x[i];
+			noiseY[i] = frequency * emitter->y[i];
+			noiseZ[i] = z;
+		}
+		PerlinNoise3Batch(emitter->noiseSeed + 0, noiseX, noiseY, noiseZ, forceX, count);
+		PerlinNoise3Batch(emitter->noiseSeed + 1, noiseX, noiseY, noiseZ, forceY, count);
+
+		float strength = settings->turbulence * deltaTime;
+		for (int i = 0; i < count; ++i)
+		{
+			emitter->velocityX[i] += strength * forceX[i];
+			emitter->velocityY[i] += strength * forceY[i];
+		}
+		TempReset(mark);
+	}
+
+	float accelerationX = settings->acceleration.x * deltaTime;
+	float accelerationY = settings->acceleration.y * deltaTime;
+	for (int i = 0; i < count; ++i)
+	{
+		emitter->velocityX[i] += accelerationX;
+		emitter->velocityY[i] += accelerationY;
+	}
+	for (int i = 0; i < count; ++i)
+	{
+		emitter->x[i] += emitter->velocityX[i] * deltaTime;
+		emitter->y[i] += emitter->velocityY[i] * deltaTime;
+	}
+
+	// Particles that don't fit into the budget are never spawned, and not just put off until there's space,
+	// otherwise a full emitter would spit out a big burst as soon as its particles start dying.
+	emitter->spawnAccumulator += settings->rate * deltaTime;
+	int numToSpawn = (int)emitter->spawnAccumulator;
+	emitter->spawnAccumulator -= (float)numToSpawn;
+	numToSpawn = ClampInt(numToSpawn, 0, emitter->capacity - emitter->numParticles);
+	SpawnParticles(emitter, position, numToSpawn);
+	UpdateParticleBounds(emitter);
+}
+
+static void EmitParticleQuads(const ParticleEmitter *emitter, float interpolation, unsigned textureId)
+{
+	const ParticleEmitterSettings *settings = &emitter->settings;
+	const Sprite *sprite = settings->sprite;
+	if (sprite and sprite->numFrames == 0)
+		return; // E.g. the sprite failed to load, then there's no frame to pick.
+	rlSetTexture(textureId);
+
+	// The batch can only hold so many vertices, so we make sure there's enough space every couple of particles.
+	enum { PARTICLES_PER_CHUNK = 256 };
+	for (int chunk = 0; chunk < emitter->numParticles; chunk += PARTICLES_PER_CHUNK)
+	{
+		int chunkEnd = chunk + PARTICLES_PER_CHUNK < emitter->numParticles ? chunk + PARTICLES_PER_CHUNK : emitter->numParticles;
+		rlCheckRenderBatchLimit(4 * (chunkEnd - chunk));
+		rlBegin(RL_QUADS);
+		rlNormal3f(0, 0, 1);
+		for (int i = chunk; i < chunkEnd; ++i)
+		{
+			float u0 = 0, v0 = 0, u1 = 1, v1 = 1;
+			float halfWidth = 0.5f, halfHeight = 0.5f;
+			if (sprite)
+			{
+				// The sprite could have been hot reloaded with fewer frames since the particle spawned.
+				SpriteFrame frame = sprite->frames[emitter->frame[i] % sprite->numFrames];
+				if (frame.texture.id != textureId)
+					continue;
+				u0 = frame.source.x / frame.texture.width;
+				v0 = frame.source.y / frame.texture.height;
+				u1 = (frame.source.x + frame.source.width) / frame.texture.width;
+				v1 = (frame.source.y + frame.source.height) / frame.texture.height;
+				halfWidth = 0.5f * frame.source.width;
+				halfHeight = 0.5f * frame.source.height;
+			}
+
+			float t = emitter->age[i] / emitter->lifetime[i];
+			float size = Lerp(settings->startSize, settings->endSize, t);
+			float x = Lerp(emitter->previousX[i], emitter->x[i], interpolation);
+			float y = Lerp(emitter->previousY[i], emitter->y[i], interpolation);
+			float x0 = x - size * halfWidth;
+			float y0 = y - size * halfHeight;
+			float x1 = x + size * halfWidth;
+			float y1 = y + size * halfHeight;
+
+			rlColor(BlendColors(settings->startColor, settings->endColor, t));
+			rlTexCoord2f(u0, v0); rlVertex2f(x0, y0);
+			rlTexCoord2f(u0, v1); rlVertex2f(x0, y1);
+			rlTexCoord2f(u1, v1); rlVertex2f(x1, y1);
+			rlTexCoord2f(u1, v0); rlVertex2f(x1, y0);
+		}
+		rlEnd();
+	}
+}
+
+void DrawParticles(const ParticleEmitter *emitter, float interpolation)
+{
+	if (emitter->numParticles == 0)
+		return;
+
+	const Sprite *sprite = emitter->settings.sprite;
+	if (not sprite)
+	{
+		EmitParticleQuads(emitter, interpolation, rlGetTextureIdDefault());
+		rlSetTexture(0);
+		return;
+	}
+
+	// Frames can be spread over a couple of atlas pages, and every page is its own texture, so the particles are drawn
+	// page by page. A sprite's frames usually all fit in one page though, so this is usually still a single draw call.
+	for (int i = 0; i < sprite->numFrames; ++i)
+	{
+		unsigned textureId = sprite->frames[i].texture.id;
+		bool isNewPage = true;
+		for (int j = 0; j < i and isNewPage; ++j)
+			isNewPage = sprite->frames[j].texture.id != textureId;
+		if (isNewPage)
+			EmitParticleQuads(emitter, interpolation, textureId);
+	}
+	rlSetTexture(0);
+}
@@ -0,0 +1,275 @@
+#include "../core.h"
+
+#ifdef PROFILER_ENABLED
+
+#include <stdio.h>
+
+// Every PROFILE_BEGIN/PROFILE_END pair records one event into a big ring buffer.
+// Frames just remember which range of the ring buffer belongs to them, so recording
+// is only a couple of stores, and old frames get overwritten once the ring buffer wraps around.
+
+#define PROFILER_MAX_EVENTS 65536 // Must be a power of 2.
+#define PROFILER_MAX_FRAMES 256
+#define PROFILER_MAX_DEPTH 64
+
+STRUCT(ProfileEvent)
+{
+	const char *name;
+	double start;
+	double end;
+	int depth;
+};
+
+STRUCT(ProfileFrame)
+{
+	double start;
+	double end;
+	unsigned firstEvent;
+	unsigned numEvents;
+};
+
+static ProfileEvent events[PROFILER_MAX_EVENTS];
+static unsigned eventHead; // Total number of events ever recorded, wraps around.
+static ProfileFrame frames[PROFILER_MAX_FRAMES];
+static unsigned frameHead; // Total number of frames ever recorded.
+static unsigned stack[PROFILER_MAX_DEPTH];
+static int stackDepth;
+static bool isPaused;
+static bool isRecording;
+static int selectedFrameAge; // 0 is the last finished frame, 1 is the one before that...
+
+static ProfileEvent *GetEvent(unsigned index)
+{
+	return &events[index & (PROFILER_MAX_EVENTS - 1)];
+}
+
+static int GetNumRecordedFrames(void)
+{
+	// The newest frame is still being recorded, so we don't count it.
+	unsigned finished = frameHead > 0 ? frameHead - 1 : 0;
+	return finished < PROFILER_MAX_FRAMES ? (int)finished : PROFILER_MAX_FRAMES - 1;
+}
+
+static ProfileFrame *GetFinishedFrame(int age)
+{
+	unsigned index = frameHead - 2 - (unsigned)age;
+	return &frames[index % PROFILER_MAX_FRAMES];
+}
+
+static bool AreFrameEventsValid(const ProfileFrame *frame)
+{
+	// The events of really old frames (or really busy ones) might have been overwritten already.
+	return eventHead - frame->firstEvent <= PROFILER_MAX_EVENTS;
+}
+
+static Color GetScopeColor(const char *name)
+{
+	float hue = (float)(HashString(name) % 360);
+	return ColorFromHSV(hue, 0.5f, 0.8f);
+}
+
+static void ShowFlameGraph(const ProfileFrame *frame)
+{
+	const float rowHeight = ImGui::GetTextLineHeightWithSpacing();
+	int maxDepth = 0;
+	for (unsigned i = 0; i < frame->numEvents; ++i)
+		if (maxDepth < GetEvent(frame->firstEvent + i)->depth)
+			maxDepth = GetEvent(frame->firstEvent + i)->depth;
+
+	ImVec2 origin = ImGui::GetCursorScreenPos();
+	float width = ImGui::GetContentRegionAvail().x;
+	float height = (maxDepth + 1) * rowHeight;
+	ImGui::InvisibleButton("flame", ImVec2(width, height));
+
+	// We always show at least a whole frame time, so that short frames look short.
+	double duration = frame->end - frame->start;
+	if (duration < FRAME_TIME)
+		duration = FRAME_TIME;
+
+	ImDrawList *drawList = ImGui::GetWindowDrawList();
+	ImVec2 mouse = ImGui::GetMousePos();
+	for (unsigned i = 0; i < frame->numEvents; ++i)
+	{
+		const ProfileEvent *event = GetEvent(frame->firstEvent + i);
+		float x0 = origin.x + (float)((event->start - frame->start) / duration) * width;
+		float x1 = origin.x + (float)((event->end - frame->start) / duration) * width;
+		float y0 = origin.y + event->depth * rowHeight;
+		float y1 = y0 + rowHeight - 1;
+		if (x1 - x0 < 1)
+			x1 = x0 + 1;
+
+		Color color = GetScopeColor(event->name);
+		drawList->AddRectFilled(ImVec2(x0, y0), ImVec2(x1, y1), IM_COL32(color.r, color.g, color.b, 255));
+		ImVec4 clip(x0, y0, x1, y1);
+		drawList->AddText(NULL, 0, ImVec2(x0 + 2, y0), IM_COL32_BLACK, event->name, NULL, 0, &clip);
+
+		if (ImGui::IsItemHovered() and mouse.x >= x0 and mouse.x < x1 and mouse.y >= y0 and mouse.y < y1)
+			ImGui::SetTooltip("%s: %.3f ms", event->name, 1000 * (event->end - event->start));
+	}
+}
+
+static void ShowTreeView(const ProfileFrame *frame)
+{
+	// Events are stored in the order they started, with their depth, so this is a pre-order walk of the tree.
+	int openDepth = 0;
+	for (unsigned i = 0; i < frame->numEvents; ++i)
+	{
+		const ProfileEvent *event = GetEvent(frame->firstEvent + i);
+		if (event->depth > openDepth)
+			continue; // Parent is collapsed.
+		while (openDepth > event->depth)
+		{
+			ImGui::TreePop();
+			--openDepth;
+		}
+
+		bool hasChildren = i + 1 < frame->numEvents and GetEvent(frame->firstEvent + i + 1)->depth > event->depth;
+		ImGuiTreeNodeFlags flags = hasChildren ? 0 : ImGuiTreeNodeFlags_Leaf;
+		bool isOpen = ImGui::TreeNodeEx((void *)(uintptr_t)i, flags, "%s  %.3f ms", event->name, 1000 * (event->end - event->start));
+		if (isOpen)
+			++openDepth;
+	}
+	while (openDepth > 0)
+	{
+		ImGui::TreePop();
+		--openDepth;
+	}
+}
+
+extern "C"
+{
+	void BeginProfileScope(const char *name)
+	{
+		if (not isRecording)
+			return;
+
+		ASSERT(stackDepth < PROFILER_MAX_DEPTH);
+		unsigned index = eventHead++;
+		ProfileEvent *event = GetEvent(index);
+		event->name = name;
+		event->start = GetTime();
+		event->end = event->start;
+		event->depth = stackDepth;
+		stack[stackDepth++] = index;
+	}
+
+	void EndProfileScope(void)
+	{
+		if (not isRecording)
+			return;
+
+		ASSERT(stackDepth > 0); // More PROFILE_ENDs than PROFILE_BEGINs.
+		unsigned index = stack[--stackDepth];
+		GetEvent(index)->end = GetTime();
+	}
+
+	void BeginProfileFrame(void)
+	{
+		isRecording = not isPaused;
+		if (not isRecording)
+			return;
+
+		ProfileFrame *frame = &frames[frameHead++ % PROFILER_MAX_FRAMES];
+		frame->start = GetTime();
+		frame->end = frame->start;
+		frame->firstEvent = eventHead;
+		frame->numEvents = 0;
+	}
+
+	void EndProfileFrame(void)
+	{
+		if (not isRecording)
+			return;
+
+		ASSERT(stackDepth == 0); // A scope was left open at the end of the frame.
+		stackDepth = 0;
+		ProfileFrame *frame = &frames[(frameHead - 1) % PROFILER_MAX_FRAMES];
+		frame->end = GetTime();
+		frame->numEvents = eventHead - frame->firstEvent;
+	}
+
+	void ShowProfilerWindow(void)
+	{
+		ImGui::Begin("Profiler");
+		{
+			int numFrames = GetNumRecordedFrames();
+
+			float frameTimes[PROFILER_MAX_FRAMES];
+			float maxFrameTime = 1000 * FRAME_TIME;
+			for (int i = 0; i < numFrames; ++i)
+			{
+				// Oldest frame first, so the graph scrolls to the left.
+				ProfileFrame *frame = GetFinishedFrame(numFrames - 1 - i);
+				frameTimes[i] = 1000 * (float)(frame->end - frame->start);
+				if (maxFrameTime < frameTimes[i])
+					maxFrameTime = frameTimes[i];
+			}
+
+			ImGui::Checkbox("Paused", &isPaused);
+			ImGui::SameLine();
+			if (ImGui::Button("Export trace"))
+				ExportProfilerTrace("trace.json");
+
+			TempStorageStats tempStats = GetTempStorageStats();
+			ImGui::Text("Temp storage: %d kB peak, %d slabs, %d overflows", tempStats.peakBytes / 1024, tempStats.numSlabs, tempStats.numOverflows);
+
+			char overlay[64];
+			FormatString(overlay, sizeof overlay, "%.2f ms (budget %.2f ms)", numFrames > 0 ? frameTimes[numFrames - 1] : 0.0f, 1000 * FRAME_TIME);
+			ImGui::PlotHistogram("##frames", frameTimes, numFrames, 0, overlay, 0, maxFrameTime, ImVec2(ImGui::GetContentRegionAvail().x, 80));
+
+			if (numFrames > 0)
+			{
+				selectedFrameAge = ClampInt(selectedFrameAge, 0, numFrames - 1);
+				ImGui::SliderInt("Frames ago", &selectedFrameAge, 0, numFrames - 1);
+
+				ProfileFrame *frame = GetFinishedFrame(selectedFrameAge);
+				if (AreFrameEventsValid(frame))
+				{
+					ShowFlameGraph(frame);
+					ShowTreeView(frame);
+				}
+				else ImGui::TextUnformatted("The events of this frame were already overwritten.");
+			}
+		}
+		ImGui::End();
+	}
+
+	bool ExportProfilerTrace(const char *path)
+	{
+		FILE *file = fopen(path, "wb");
+		if (not file)
+		{
+			LogError("Couldn't export profiler trace to '%s'.", path);
+			return false;
+		}
+
+		// See: https://docs.google.com/document/d/1CvAClvFfyA5R-PhYUmn5OOQtYMH4h6I0nSsKchNAySU
+		fprintf(file, "{\"traceEvents\":[\n");
+		bool isFirst = true;
+		int numFrames = GetNumRecordedFrames();
+		for (int age = numFrames - 1; age >= 0; --age)
+		{
+			ProfileFrame *frame = GetFinishedFrame(age);
+			if (not AreFrameEventsValid(frame))
+				continue;
+
+			fprintf(file, "%s{\"name\":\"Frame\",\"ph\":\"X\",\"pid\":0,\"tid\":0,\"ts\":%.3f,\"dur\":%.3f}",
+				isFirst ? "" : ",\n", 1e6 * frame->start, 1e6 * (frame->end - frame->start));
+			isFirst = false;
+
+			for (unsigned i = 0; i < frame->numEvents; ++i)
+			{
+				const ProfileEvent *event = GetEvent(frame->firstEvent + i);
+				fprintf(file, ",\n{\"name\":\"%s\",\"ph\":\"X\",\"pid\":0,\"tid\":0,\"ts\":%.3f,\"dur\":%.3f}",
+					event->name, 1e6 * event->start, 1e6 * (event->end - event->start));
+			}
+		}
+		fprintf(file, "\n]}\n");
+		fclose(file);
+
+		LogInfo("Exported %d frames of profiler trace to '%s'.", numFrames, path);
+		return true;
+	}
+}
+
+#endif
@@ -0,0 +1,740 @@
+#include "../core.h"
+
+#include <mutex>
+#include <stdio.h>
+#include <string.h>
+
+#ifdef __EMSCRIPTEN__
+#include <emscripten/emscripten.h>
+#endif
+
+// A pack is one file that holds a bunch of resource files:
+//
+//   PackHeader
+//   PackEntry[numEntries]  sorted by path hash (and then by path), so lookups are a binary search
+//   paths                  0 terminated, relative to the resource directory, always with '/'
+//   file data              every file starts on a PACK_ALIGNMENT boundary
+//
+// Mounted packs are kept in memory as a whole, so reading an uncompressed file is just a copy.
+// We hook raylib's LoadFileData and LoadFileText, so everything that loads files through raylib
+// (LoadImage, LoadFontEx, LoadSound...) finds packed files without knowing anything about packs.
+// Files that aren't in any pack are read from disk just like raylib would.
+//
+// Paths are matched ignoring case, because that's how the desktop file systems we make the game on work,
+// and the assets don't always get the case right (e.g. "roboto.ttf" is really "Roboto.ttf").
+
+#define PACK_MAGIC "WSTP"
+#define PACK_VERSION 1
+#define PACK_ALIGNMENT 16
+#define PACK_MIN_COMPRESSION_GAIN 0.9f // Files are only stored compressed if that makes them at least 10% smaller.
+
+STRUCT(PackHeader)
+{
+	char magic[4];
+	int version;
+	int numEntries;
+	int pathsOffset;
+	int pathsSize;
+};
+
+STRUCT(PackEntry)
+{
+	unsigned pathHash;
+	int pathOffset; // From the start of the paths.
+	int offset;     // From the start of the pack.
+	int size;       // Size of the file when it's not compressed.
+	int packedSize; // Size of the file data in the pack.
+	int isCompressed;
+};
+
+#define MAX_PACK_PATH 256
+
+// Every directory that has files in the pack, so checking whether a path is a packed directory is a binary search too.
+STRUCT(PackDirectory)
+{
+	unsigned pathHash;
+	int pathOffset; // Of one of the files inside of the directory, which starts with the directory's path.
+	int pathLength;
+};
+
+STRUCT(Pack)
+{
+	char path[MAX_PACK_PATH];
+	unsigned char *data;
+	int size;
+	const PackEntry *entries;
+	int numEntries;
+	const char *paths;
+	List(PackDirectory) directories; // Sorted by path hash.
+	int numReaders; // Files that are being read out of the pack right now, which keep it alive after it's unmounted.
+	bool isMounted;
+};
+
+static std::mutex packsMutex; // Protects the packs list and the numReaders and isMounted of every pack.
+static bool areCallbacksInstalled;
+static List(Pack *) packs; // The pack that was mounted last is searched first.
+
+// Paths inside of packs are relative and always use '/', so "./alex\\neutral.png" has to become "alex/neutral.png".
+// Returns false if the path is too long to be in a pack.
+static bool NormalizePath(const char *path, char result[MAX_PACK_PATH])
+{
+	while (path[0] == '.' and (path[1] == '/' or path[1] == '\\'))
+		path += 2;
+	int length = StringLength(path);
+	if (length >= MAX_PACK_PATH)
+		return false;
+	for (int i = 0; i < length; ++i)
+		result[i] = path[i] == '\\' ? '/' : path[i];
+	while (length > 0 and result[length - 1] == '/')
+		--length;
+	result[length] = 0;
+	return true;
+}
+
+// HashString of the first length chars of the lowercase path.
+static unsigned HashPathPrefix(const char *path, int length)
+{
+	unsigned hash = 2166136261u;
+	for (int i = 0; i < length; ++i)
+		hash = (hash ^ CharToLowercase(path[i])) * 16777619;
+	return hash;
+}
+
+static unsigned HashPath(const char *path)
+{
+	return HashPathPrefix(path, StringLength(path));
+}
+
+static bool PrefixEqualNocase(const char *a, const char *b, int length)
+{
+	for (int i = 0; i < length; ++i)
+		if (CharToLowercase(a[i]) != CharToLowercase(b[i]) or not a[i])
+			return false;
+	return true;
+}
+
+static const char *GetEntryPath(const Pack *pack, const PackEntry *entry)
+{
+	return pack->paths + entry->pathOffset;
+}
+
+// Entries with the same hash are sorted by path. The paths are written in sorted order, so that's the same as sorting by offset.
+static int CompareEntries(const void *left, const void *right)
+{
+	const PackEntry *a = (const PackEntry *)left;
+	const PackEntry *b = (const PackEntry *)right;
+	if (a->pathHash != b->pathHash)
+		return a->pathHash < b->pathHash ? -1 : 1;
+	return a->pathOffset - b->pathOffset;
+}
+
+static int CompareDirectories(const void *left, const void *right)
+{
+	const PackDirectory *a = (const PackDirectory *)left;
+	const PackDirectory *b = (const PackDirectory *)right;
+	if (a->pathHash != b->pathHash)
+		return a->pathHash < b->pathHash ? -1 : 1;
+	return 0;
+}
+
+static int ComparePaths(const void *left, const void *right)
+{
+	return strcmp(*(const char *const *)left, *(const char *const *)right);
+}
+
+static const PackEntry *FindEntry(const Pack *pack, const char *path)
+{
+	unsigned hash = HashPath(path);
+	int low = 0, high = pack->numEntries;
+	while (low < high)
+	{
+		int middle = (low + high) / 2;
+		if (pack->entries[middle].pathHash < hash)
+			low = middle + 1;
+		else
+			high = middle;
+	}
+	for (const PackEntry *entry = pack->entries + low; entry < pack->entries + pack->numEntries and entry->pathHash == hash; ++entry)
+		if (StringsEqualNocase(path, GetEntryPath(pack, entry)))
+			return entry;
+	return NULL;
+}
+
+static bool HasDirectory(const Pack *pack, const char *path)
+{
+	int length = StringLength(path);
+	unsigned hash = HashPathPrefix(path, length);
+	int count = ListCount(pack->directories);
+	int low = 0, high = count;
+	while (low < high)
+	{
+		int middle = (low + high) / 2;
+		if (pack->directories[middle].pathHash < hash)
+			low = middle + 1;
+		else
+			high = middle;
+	}
+	for (int i = low; i < count and pack->directories[i].pathHash == hash; ++i)
+		if (pack->directories[i].pathLength == length and PrefixEqualNocase(pack->paths + pack->directories[i].pathOffset, path, length))
+			return true;
+	return false;
+}
+
+static void DestroyPack(Pack *pack)
+{
+	ListDestroy((void **)&pack->directories);
+	MemFree(pack->data);
+	MemFree(pack);
+}
+
+// Returns NULL if none of the mounted packs have the file. Call ReleasePack once you're done reading the file,
+// the pack stays alive until then, even if someone unmounts it in the meantime.
+static const PackEntry *FindPackedFile(const char *path, Pack **outPack)
+{
+	char normalized[MAX_PACK_PATH];
+	if (not NormalizePath(path, normalized))
+		return NULL;
+
+	std::lock_guard<std::mutex> lock(packsMutex);
+	for (int i = ListCount(packs) - 1; i >= 0; --i)
+	{
+		const PackEntry *entry = FindEntry(packs[i], normalized);
+		if (entry)
+		{
+			++packs[i]->numReaders;
+			*outPack = packs[i];
+			return entry;
+		}
+	}
+	return NULL;
+}
+
+static void ReleasePack(Pack *pack)
+{
+	bool isDead;
+	{
+		std::lock_guard<std::mutex> lock(packsMutex);
+		isDead = --pack->numReaders == 0 and not pack->isMounted;
+	}
+	if (isDead)
+		DestroyPack(pack);
+}
+
+static bool IsPackedDirectory(const char *path)
+{
+	char normalized[MAX_PACK_PATH];
+	if (not NormalizePath(path, normalized))
+		return false;
+
+	std::lock_guard<std::mutex> lock(packsMutex);
+	for (int i = 0; i < ListCount(packs); ++i)
+		if (HasDirectory(packs[i], normalized))
+			return true;
+	return false;
+}
+
+// The returned memory is allocated like raylib's LoadFileData, so it can be freed with UnloadFileData or UnloadFileText.
+static unsigned char *ReadPackedFile(const Pack *pack, const PackEntry *entry, unsigned *outSize, bool addTerminator)
+{
+	const unsigned char *packed = pack->data + entry->offset;
+	unsigned char *data = NULL;
+	int size = 0;
+	if (entry->isCompressed)
+	{
+		data = DecompressData(packed, entry->packedSize, &size);
+		if (not data or size != entry->size)
+		{
+			LogError("Couldn't decompress '%s' from pack '%s'.", GetEntryPath(pack, entry), pack->path);
+			MemFree(data);
+			*outSize = 0;
+			return NULL;
+		}
+		if (addTerminator)
+			data = (unsigned char *)MemRealloc(data, size + 1);
+	}
+	else
+	{
+		size = entry->size;
+		data = (unsigned char *)MemAlloc(size + (addTerminator ? 1 : 0));
+		CopyBytes(data, packed, size);
+	}
+
+	if (addTerminator)
+		data[size] = 0;
+	*outSize = (unsigned)size;
+	return data;
+}
+
+static unsigned char *LoadLooseFileData(const char *path, unsigned *outSize, bool isText)
+{
+	*outSize = 0;
+	FILE *file = fopen(path, isText ? "rt" : "rb");
+	if (not file)
+	{
+		LogWarning("Couldn't open file '%s'.", path);
+		return NULL;
+	}
+
+	fseek(file, 0, SEEK_END);
+	long size = ftell(file);
+	fseek(file, 0, SEEK_SET);
+	unsigned char *data = NULL;
+	if (size >= 0)
+	{
+		data = (unsigned char *)MemAlloc((int)size + 1);
+		// In text mode Windows turns "\r\n" into "\n", so we can end up reading less than the size of the file.
+		size_t numRead = fread(data, 1, (size_t)size, file);
+		data[numRead] = 0;
+		*outSize = (unsigned)numRead;
+	}
+	fclose(file);
+	return data;
+}
+
+static unsigned char *LoadResourceFileData(const char *path, unsigned *outSize)
+{
+	Pack *pack;
+	const PackEntry *entry = FindPackedFile(path, &pack);
+	if (not entry)
+		return LoadLooseFileData(path, outSize, false);
+
+	unsigned char *data = ReadPackedFile(pack, entry, outSize, false);
+	ReleasePack(pack);
+	return data;
+}
+
+static char *LoadResourceFileText(const char *path)
+{
+	unsigned size;
+	Pack *pack;
+	const PackEntry *entry = FindPackedFile(path, &pack);
+	if (not entry)
+		return (char *)LoadLooseFileData(path, &size, true);
+
+	char *text = (char *)ReadPackedFile(pack, entry, &size, true);
+	ReleasePack(pack);
+	return text;
+}
+
+static bool ValidatePack(Pack *pack)
+{
+	BinaryStream stream = { 0 };
+	stream.buffer = pack->data;
+	stream.size = pack->size;
+
+	PackHeader header;
+	ReadBytesInto(&stream, &header, sizeof header);
+	if (not BytesEqual(header.magic, PACK_MAGIC, 4) or header.version != PACK_VERSION)
+		return false;
+	if (header.numEntries < 0 or header.numEntries > (pack->size - stream.cursor) / (int)sizeof(PackEntry))
+		return false;
+	if (header.pathsOffset < 0 or header.pathsSize < 0 or header.pathsOffset > pack->size - header.pathsSize)
+		return false;
+	if (header.pathsSize > 0 and pack->data[header.pathsOffset + header.pathsSize - 1] != 0)
+		return false;
+
+	pack->entries = (const PackEntry *)ReadBytes(&stream, header.numEntries * (int)sizeof(PackEntry));
+	pack->numEntries = header.numEntries;
+	pack->paths = (const char *)pack->data + header.pathsOffset;
+	for (int i = 0; i < pack->numEntries; ++i)
+	{
+		const PackEntry *entry = &pack->entries[i];
+		if (entry->pathOffset < 0 or entry->pathOffset >= header.pathsSize)
+			return false;
+		if (entry->offset < 0 or entry->packedSize < 0 or entry->size < 0 or entry->offset > pack->size - entry->packedSize)
+			return false;
+		if (not entry->isCompressed and entry->packedSize != entry->size)
+			return false;
+	}
+
+	// Every slash in a path ends one of the directories that the file is in.
+	for (int i = 0; i < pack->numEntries; ++i)
+	{
+		const char *path = GetEntryPath(pack, &pack->entries[i]);
+		for (int length = 0; path[length]; ++length)
+		{
+			if (path[length] != '/')
+				continue;
+			PackDirectory directory = { HashPathPrefix(path, length), pack->entries[i].pathOffset, length };
+			ListAdd(&pack->directories, directory);
+		}
+	}
+	Sort(pack->directories, ListCount(pack->directories), sizeof pack->directories[0], CompareDirectories);
+
+	// A directory shows up once for every file in it, but we only need it once.
+	int numKept = 0;
+	for (int i = 0; i < ListCount(pack->directories); ++i)
+	{
+		PackDirectory directory = pack->directories[i];
+		bool isDuplicate = false;
+		for (int j = numKept - 1; j >= 0 and pack->directories[j].pathHash == directory.pathHash and not isDuplicate; --j)
+			isDuplicate = pack->directories[j].pathLength == directory.pathLength and
+				PrefixEqualNocase(pack->paths + pack->directories[j].pathOffset, pack->paths + directory.pathOffset, directory.pathLength);
+		if (not isDuplicate)
+			pack->directories[numKept++] = directory;
+	}
+	ListTruncate(pack->directories, numKept);
+	return true;
+}
+
+// Adds a normalized copy of the path to the list, in temporary storage.
+static bool AddPackFile(const char *path, List(char *) *files)
+{
+	char normalized[MAX_PACK_PATH];
+	if (not NormalizePath(path, normalized))
+	{
+		LogError("Can't put '%s' into a pack, because its path is longer than %d characters.", path, MAX_PACK_PATH - 1);
+		return false;
+	}
+	ListAdd(files, TempFormat("%s", normalized));
+	return true;
+}
+
+// Adds the file, or all files inside of the directory, to the list.
+static bool CollectPackFiles(const char *path, List(char *) *files)
+{
+	if (IsPathFile(path))
+		return AddPackFile(path, files);
+
+	bool success = true;
+	FilePathList contents = LoadDirectoryFilesEx(path, NULL, true);
+	for (unsigned i = 0; i < contents.count; ++i)
+		success = AddPackFile(contents.paths[i], files) and success;
+	UnloadDirectoryFiles(contents);
+	return success;
+}
+
+#ifdef __EMSCRIPTEN__
+STRUCT(PackFetch)
+{
+	char path[256];
+	void (*onFinished)(const char *packPath, bool success, void *userData);
+	void *userData;
+};
+
+static void OnPackDownloaded(unsigned handle, void *arg, void *data, unsigned size)
+{
+	UNUSED(handle);
+	PackFetch *fetch = (PackFetch *)arg;
+	// The downloaded buffer is freed after this returns, and the mounted pack has to own its memory.
+	void *copy = MemAlloc((int)size);
+	CopyBytes(copy, data, (int)size);
+	bool success = MountPackFromMemory(fetch->path, copy, (int)size);
+	if (fetch->onFinished)
+		fetch->onFinished(fetch->path, success, fetch->userData);
+	MemFree(fetch);
+}
+
+static void OnPackDownloadFailed(unsigned handle, void *arg, int httpStatus, const char *description)
+{
+	UNUSED(handle);
+	PackFetch *fetch = (PackFetch *)arg;
+	LogError("Couldn't download pack '%s' (HTTP %d: %s).", fetch->path, httpStatus, description ? description : "");
+	if (fetch->onFinished)
+		fetch->onFinished(fetch->path, false, fetch->userData);
+	MemFree(fetch);
+}
+#endif
+
+// Takes the pack with the path out of the mounted packs. Returns it if nobody is reading from it anymore, so it can be destroyed
+// outside of the lock, otherwise the last reader destroys it. Call this with packsMutex locked.
+static Pack *RemoveMountedPack(const char *path)
+{
+	for (int i = 0; i < ListCount(packs); ++i)
+	{
+		Pack *pack = packs[i];
+		if (not StringsEqual(pack->path, path))
+			continue;
+
+		for (int j = i; j < ListCount(packs) - 1; ++j)
+			packs[j] = packs[j + 1];
+		ListTruncate(packs, ListCount(packs) - 1);
+		pack->isMounted = false;
+		return pack->numReaders == 0 ? pack : NULL;
+	}
+	return NULL;
+}
+
+extern "C"
+{
+	bool BuildPack(const char *packPath, const char *const paths[], int numPaths)
+	{
+		int mark = TempMark();
+		List(char *) files = NULL;
+		ListSetAllocator((void **)&files, TempRealloc, TempFree);
+		for (int i = 0; i < numPaths; ++i)
+		{
+			if (not FileExists(paths[i]))
+			{
+				LogError("Couldn't build pack '%s' because '%s' doesn't exist.", packPath, paths[i]);
+				TempReset(mark);
+				return false;
+			}
+			if (not CollectPackFiles(paths[i], &files))
+			{
+				TempReset(mark);
+				return false;
+			}
+		}
+
+		// The same file could have been added through two different paths, e.g. a sprite directory and one of its frames.
+		Sort(files, ListCount(files), sizeof files[0], ComparePaths);
+		int numEntries = 0;
+		for (int i = 0; i < ListCount(files); ++i)
+			if (numEntries == 0 or not StringsEqual(files[numEntries - 1], files[i]))
+				files[numEntries++] = files[i];
+		ListTruncate(files, numEntries);
+
+		PackEntry *entries = (PackEntry *)TempAlloc(numEntries * (int)sizeof entries[0]);
+		ZeroBytes(entries, numEntries * (int)sizeof entries[0]);
+		BinaryStream pathsData = { 0 };
+		pathsData.canGrow = true;
+		for (int i = 0; i < numEntries; ++i)
+		{
+			entries[i].pathHash = HashPath(files[i]);
+			entries[i].pathOffset = pathsData.cursor;
+			WriteBytes(&pathsData, files[i], StringLength(files[i]) + 1);
+		}
+
+		PackHeader header;
+		ZeroBytes(&header, sizeof header);
+		CopyBytes(header.magic, PACK_MAGIC, 4);
+		header.version = PACK_VERSION;
+		header.numEntries = numEntries;
+		header.pathsOffset = (int)(sizeof header + numEntries * sizeof(PackEntry));
+		header.pathsSize = pathsData.cursor;
+
+		// The header and the entries are filled in at the end once we know where all of the files went.
+		BinaryStream stream = { 0 };
+		stream.canGrow = true;
+		WriteBytes(&stream, &header, sizeof header);
+		if (numEntries > 0)
+			WriteBytes(&stream, entries, numEntries * (int)sizeof(PackEntry));
+		WriteBytes(&stream, pathsData.buffer, header.pathsSize);
+
+		int totalSize = 0;
+		for (int i = 0; i < numEntries; ++i)
+		{
+			PackEntry *entry = &entries[i];
+			unsigned size = 0;
+			unsigned char *data = LoadFileData(files[i], &size);
+			if (not data)
+				LogWarning("Pack '%s' has '%s' as an empty file, because it couldn't be read.", packPath, files[i]);
+
+			int compressedSize = 0;
+			unsigned char *compressed = size > 0 ? CompressData(data, (int)size, &compressedSize) : NULL;
+			WritePadding(&stream, PACK_ALIGNMENT);
+			entry->offset = stream.cursor;
+			entry->size = (int)size;
+			if (compressed and compressedSize < PACK_MIN_COMPRESSION_GAIN * size)
+			{
+				entry->isCompressed = true;
+				entry->packedSize = compressedSize;
+				WriteBytes(&stream, compressed, compressedSize);
+			}
+			else
+			{
+				entry->packedSize = (int)size;
+				WriteBytes(&stream, data, (int)size);
+			}
+			totalSize += (int)size;
+			MemFree(compressed);
+			UnloadFileData(data);
+		}
+
+		// Sorting by hash only now is fine, because the entries don't point at each other.
+		Sort(entries, numEntries, sizeof entries[0], CompareEntries);
+		if (numEntries > 0)
+			CopyBytes((char *)stream.buffer + sizeof header, entries, numEntries * (int)sizeof(PackEntry));
+
+		bool success = SaveFileData(packPath, stream.buffer, (unsigned)stream.cursor);
+		if (success)
+			LogMessage(LOG_CATEGORY_ASSETS, LOG_INFO, "Built pack '%s' (%d files, %d kB packed, %d kB unpacked).", packPath, numEntries, stream.cursor / 1024, totalSize / 1024);
+		else
+			LogError("Couldn't save pack '%s'.", packPath);
+		MemFree(stream.buffer);
+		MemFree(pathsData.buffer);
+		TempReset(mark);
+		return success;
+	}
+
+	bool MountPack(const char *packPath)
+	{
+		unsigned size = 0;
+		unsigned char *data = LoadFileData(packPath, &size);
+		if (not data)
+		{
+			LogError("Couldn't mount pack '%s' because it couldn't be read.", packPath);
+			return false;
+		}
+
+		// LoadFileData memory and MemAlloc memory are one and the same in raylib, so the pack can just take it over.
+		return MountPackFromMemory(packPath, data, (int)size);
+	}
+
+	bool MountPackFromMemory(const char *packPath, void *data, int size)
+	{
+		Pack *pack = (Pack *)MemAlloc(sizeof pack[0]);
+		ZeroBytes(pack, sizeof pack[0]);
+		pack->data = (unsigned char *)data;
+		pack->size = size;
+		if (not NormalizePath(packPath, pack->path) or not ValidatePack(pack))
+		{
+			LogError("Couldn't mount pack '%s' because it's corrupted, or not a pack.", packPath);
+			DestroyPack(pack);
+			return false;
+		}
+
+		Pack *replaced = NULL;
+		{
+			std::lock_guard<std::mutex> lock(packsMutex);
+			if (not areCallbacksInstalled)
+			{
+				SetLoadFileDataCallback(LoadResourceFileData);
+				SetLoadFileTextCallback(LoadResourceFileText);
+				areCallbacksInstalled = true;
+			}
+			replaced = RemoveMountedPack(pack->path);
+			pack->isMounted = true;
+			ListAdd(&packs, pack);
+		}
+		if (replaced)
+			DestroyPack(replaced);
+		LogMessage(LOG_CATEGORY_ASSETS, LOG_INFO, "Mounted pack '%s' (%d files).", packPath, pack->numEntries);
+		return true;
+	}
+
+	void UnmountPack(const char *packPath)
+	{
+		char path[MAX_PACK_PATH];
+		if (not NormalizePath(packPath, path))
+			return;
+
+		Pack *removed;
+		{
+			std::lock_guard<std::mutex> lock(packsMutex);
+			removed = RemoveMountedPack(path);
+		}
+		if (removed)
+			DestroyPack(removed);
+	}
+
+	bool IsPackMounted(const char *packPath)
+	{
+		char path[MAX_PACK_PATH];
+		if (not NormalizePath(packPath, path))
+			return false;
+
+		std::lock_guard<std::mutex> lock(packsMutex);
+		for (int i = 0; i < ListCount(packs); ++i)
+			if (StringsEqual(packs[i]->path, path))
+				return true;
+		return false;
+	}
+
+	void FetchPack(const char *packPath, void (*onFinished)(const char *packPath, bool success, void *userData), void *userData)
+	{
+		if (IsPackMounted(packPath))
+		{
+			if (onFinished)
+				onFinished(packPath, true, userData);
+			return;
+		}
+
+		#ifdef __EMSCRIPTEN__
+		{
+			PackFetch *fetch = (PackFetch *)MemAlloc(sizeof fetch[0]);
+			CopyString(fetch->path, packPath, sizeof fetch->path);
+			fetch->onFinished = onFinished;
+			fetch->userData = userData;
+			// The URL is relative to the page, so the packs have to be uploaded next to index.html.
+			emscripten_async_wget2_data(packPath, "GET", "", fetch, 1, OnPackDownloaded, OnPackDownloadFailed, NULL);
+		}
+		#else
+		{
+			bool success = MountPack(packPath);
+			if (onFinished)
+				onFinished(packPath, success, userData);
+		}
+		#endif
+	}
+
+	bool ResourceExists(const char *path)
+	{
+		if (FileExists(path))
+			return true;
+		return IsResourceFile(path) or IsPackedDirectory(path);
+	}
+
+	bool IsResourceFile(const char *path)
+	{
+		Pack *pack;
+		if (FindPackedFile(path, &pack))
+		{
+			ReleasePack(pack);
+			return true;
+		}
+		if (IsPackedDirectory(path))
+			return false;
+		return IsPathFile(path);
+	}
+
+	FilePathList LoadResourceDirectoryFiles(const char *path)
+	{
+		char prefix[MAX_PACK_PATH];
+		if (not NormalizePath(path, prefix) or StringLength(prefix) + 1 >= MAX_PACK_PATH)
+			return LoadDirectoryFiles(path);
+		int prefixLength = StringLength(prefix);
+		prefix[prefixLength++] = '/';
+		prefix[prefixLength] = 0;
+
+		int mark = TempMark();
+		List(char *) children = NULL;
+		ListSetAllocator((void **)&children, TempRealloc, TempFree);
+		{
+			std::lock_guard<std::mutex> lock(packsMutex);
+			for (int i = 0; i < ListCount(packs); ++i)
+			{
+				const Pack *pack = packs[i];
+				for (int j = 0; j < pack->numEntries; ++j)
+				{
+					const char *entryPath = GetEntryPath(pack, &pack->entries[j]);
+					if (not PrefixEqualNocase(entryPath, prefix, prefixLength))
+						continue;
+
+					// Files in subdirectories only show up as the subdirectory, just like with LoadDirectoryFiles.
+					const char *name = entryPath + prefixLength;
+					const char *slash = strchr(name, '/');
+					int nameLength = slash ? (int)(slash - name) : StringLength(name);
+					ListAdd(&children, TempFormat("%s%.*s", prefix, nameLength, name));
+				}
+			}
+		}
+		if (ListCount(children) == 0)
+		{
+			TempReset(mark);
+			return LoadDirectoryFiles(path);
+		}
+
+		// Sprite frames are played back in this order.
+		Sort(children, ListCount(children), sizeof children[0], ComparePaths);
+		int numChildren = 0;
+		for (int i = 0; i < ListCount(children); ++i)
+			if (numChildren == 0 or not StringsEqual(children[numChildren - 1], children[i]))
+				children[numChildren++] = children[i];
+
+		// Allocated the same way raylib does it, so that UnloadDirectoryFiles works on it.
+		FilePathList result = { 0 };
+		result.count = (unsigned)numChildren;
+		result.capacity = result.count;
+		result.paths = (char **)MemAlloc(result.count * sizeof result.paths[0]);
+		for (unsigned i = 0; i < result.count; ++i)
+		{
+			int length = StringLength(children[i]);
+			result.paths[i] = (char *)MemAlloc(length + 1);
+			CopyBytes(result.paths[i], children[i], length + 1);
+		}
+		TempReset(mark);
+		return result;
+	}
+}
@@ -1,5 +1,9 @@
 #include "../core.h"
+#ifdef DEV_GUI_ENABLED
 #include "../lib/imgui/imgui_impl_raylib.h"
+#endif
+#include <algorithm>
+#include <stdlib.h>
 
 #ifdef __EMSCRIPTEN__
 #include <emscripten/emscripten.h>
@@ -12,28 +16,340 @@ extern "C" __declspec(dllexport) unsigned long NvOptimusEnablement = 1;
 extern "C" __declspec(dllexport) int AmdPowerXpressRequestHighPerformance = 1;
 #endif
 
+// How much of each frame we're willing to spend on finishing up streamed assets.
+#define STREAMING_TIME_BUDGET (0.25 * FRAME_TIME)
+
+// If a frame takes so long that we would need more updates than this to catch up, we just drop the rest of the time.
+// Otherwise updates that take longer than FRAME_TIME would make us fall further and further behind (the "spiral of death").
+#define MAX_UPDATES_PER_FRAME 4
+
+// The world is rendered at a lower resolution while frames take too long, in steps of this much, see UpdateResolutionScale.
+#define MIN_RESOLUTION_SCALE 0.5f
+#define RESOLUTION_SCALE_STEP 0.125f
+
+// Frames that take this much longer than the display (or the browser) shows them on average are too slow.
+// There's some slack, because frame times jitter even with vsync.
+#define SLOW_FRAME_FACTOR 1.15
+
+// How many seconds it takes to notice that the display shows frames less often than it used to, see UpdateResolutionScale.
+#define PRESENT_INTERVAL_ADAPTATION_TIME 5.0
+
+// We only go back up a step after this many quick frames in a row. It doubles every time going up made us too slow again.
+#define MIN_QUICK_FRAMES_BEFORE_SCALING_UP 120
+#define MAX_QUICK_FRAMES_BEFORE_SCALING_UP 3840
+
+// A new scale takes a couple of frames to show up in the frame times, so we wait at least this long before changing it again.
+#define MIN_FRAMES_BETWEEN_SCALE_CHANGES 20
+
+static double previousFrameTime = -1;
+static double updateTimeAccumulator;
+static float renderInterpolation = 1;
+
+// Replays run exactly one update per frame, without waiting for vsync or the frame rate limit, so that every
+// run of the same recording does the same work as fast as it can. See StartInputReplay.
+static bool isReplay;
+static const char *replayPath;
+static const char *replayResultsPath;
+static List(double) replayFrameTimes;
+static double replayFrameStartTime = -1;
+
+static bool isDevGuiVisible;
+
+static bool isResolutionDynamic = true;
+static float resolutionScale = 1;
+static double frameStartTime = -1;
+static double frameWorkTime; // Everything before waiting for vsync.
+static double averageFrameTime = FRAME_TIME;
+static double presentInterval = FRAME_TIME; // How often the display shows frames, as far as we can tell. Never less than FRAME_TIME.
+static int numFramesSinceScaleChange;
+static int numQuickFrames;
+static int numQuickFramesBeforeScalingUp = MIN_QUICK_FRAMES_BEFORE_SCALING_UP;
+static bool wasLastScaleChangeUp;
+
+extern "C" float GetRenderInterpolation(void)
+{
+	return renderInterpolation;
+}
+
+extern "C" bool IsDevGuiVisible(void)
+{
+	return isDevGuiVisible;
+}
+
+extern "C" float GetResolutionScale(void)
+{
+	return resolutionScale;
+}
+
+extern "C" void SetDynamicResolution(bool enable)
+{
+	isResolutionDynamic = enable;
+	if (not enable)
+		resolutionScale = 1;
+}
+
+extern "C" double GetAverageFrameTime(void)
+{
+	return averageFrameTime;
+}
+
+#ifdef DEV_GUI_ENABLED
+// ImGui is only started the first time the game wants to show a window, so players never pay for the font atlas.
+static bool isDevGuiInitialized;
+
+static void InitDevGui()
+{
+	ImGui::CreateContext();
+	ImGui::StyleColorsDark();
+	ImGui_ImplRaylib_Init();
+	auto &io = ImGui::GetIO();
+	{
+		// ImGui opens files itself, so it wouldn't find the font inside of a pack. The data has to stay around while the atlas is alive.
+		unsigned fontSize = 0;
+		unsigned char *fontData = LoadFileData("roboto.ttf", &fontSize);
+		ImFontConfig fontConfig;
+		fontConfig.FontDataOwnedByAtlas = false;
+		if (fontData)
+			io.Fonts->AddFontFromMemoryTTF(fontData, (int)fontSize, 18, &fontConfig);
+	}
+	ImGui_ImplRaylib_LoadDefaultFontAtlas();
+	isDevGuiInitialized = true;
+}
+#endif
+
+// Updates run at a fixed rate, and we render however often the display wants to.
+// See: https://gafferongames.com/post/fix_your_timestep/
+static void UpdateFixedTimestep()
+{
+	if (isReplay)
+	{
+		UpdateInputRecording();
+		GameBeginUpdate();
+		UpdateCurrentGameState();
+		ClearInputPresses();
+		renderInterpolation = 1;
+		return;
+	}
+
+	double now = GetTime();
+	if (previousFrameTime < 0)
+		previousFrameTime = now - FRAME_TIME;
+	updateTimeAccumulator += now - previousFrameTime;
+	previousFrameTime = now;
+	if (updateTimeAccumulator > MAX_UPDATES_PER_FRAME * FRAME_TIME)
+		updateTimeAccumulator = MAX_UPDATES_PER_FRAME * FRAME_TIME;
+
+	while (updateTimeAccumulator >= FRAME_TIME)
+	{
+		UpdateInputRecording();
+		GameBeginUpdate();
+		UpdateCurrentGameState();
+		ClearInputPresses();
+		updateTimeAccumulator -= FRAME_TIME;
+	}
+
+	renderInterpolation = (float)(updateTimeAccumulator / FRAME_TIME);
+}
+
+// With vsync, frames are either on time or a whole refresh late, so the frame times only tell us when we're too slow, and not how
+// much time there is to spare. The time we spend before waiting for vsync tells us some of that, but not how long the GPU takes,
+// since it works while we wait. So we go down a step as soon as the average frame is too slow, but only go back up after being
+// quick for a long time, and wait twice as long the next time if going up made us too slow again. Otherwise a GPU that's right
+// on the edge would make the scale flip back and forth every couple of frames.
+//
+// Frames are only too slow compared to how often the display shows them, which isn't always 60 times a second: 50Hz displays
+// exist, and browsers throttle to 30 frames per second in low power mode. So we keep the shortest average frame time we've seen,
+// and once the scale is as low as it goes and frames are still slow, we slowly let it creep up to the average we're getting now.
+// A display that shows fewer frames than we'd like is then learned within a couple of seconds and stops counting as slow, and the
+// scale goes back up. Frames that are slow because there's too much to render don't get learned, unless even the lowest scale
+// can't make them quick, since going down a step fixes them first.
+static void UpdateResolutionScale(double frameTime, double workTime)
+{
+	// Really long frames are hitches, like loading a scene, which rendering at a lower resolution wouldn't fix.
+	if (frameTime > MAX_UPDATES_PER_FRAME * FRAME_TIME)
+		return;
+	averageFrameTime += 0.1 * (frameTime - averageFrameTime);
+	bool canScaleGoDown = isResolutionDynamic and not isReplay and resolutionScale > MIN_RESOLUTION_SCALE;
+	if (averageFrameTime < presentInterval)
+		presentInterval = std::max(averageFrameTime, (double)FRAME_TIME);
+	else if (not canScaleGoDown)
+		presentInterval += std::min(frameTime / PRESENT_INTERVAL_ADAPTATION_TIME, 1.0) * (averageFrameTime - presentInterval);
+	double slowFrameTime = SLOW_FRAME_FACTOR * presentInterval;
+
+	// Replays measure how long frames take, so they have to do the same work every time.
+	if (not isResolutionDynamic or isReplay)
+	{
+		resolutionScale = 1;
+		return;
+	}
+
+	++numFramesSinceScaleChange;
+	if (numFramesSinceScaleChange < MIN_FRAMES_BETWEEN_SCALE_CHANGES)
+		return;
+
+	if (averageFrameTime > slowFrameTime)
+	{
+		numQuickFrames = 0;
+		if (resolutionScale > MIN_RESOLUTION_SCALE)
+		{
+			if (wasLastScaleChangeUp and numFramesSinceScaleChange < MIN_QUICK_FRAMES_BEFORE_SCALING_UP)
+				numQuickFramesBeforeScalingUp = std::min(2 * numQuickFramesBeforeScalingUp, MAX_QUICK_FRAMES_BEFORE_SCALING_UP);
+			resolutionScale = std::max(resolutionScale - RESOLUTION_SCALE_STEP, MIN_RESOLUTION_SCALE);
+			numFramesSinceScaleChange = 0;
+			wasLastScaleChangeUp = false;
+			averageFrameTime = presentInterval; // The frames so far were rendered at the old scale.
+		}
+	}
+	else if (frameTime < slowFrameTime and workTime < 0.5 * presentInterval)
+	{
+		++numQuickFrames;
+		if (numQuickFrames >= numQuickFramesBeforeScalingUp and resolutionScale < 1)
+		{
+			resolutionScale = std::min(resolutionScale + RESOLUTION_SCALE_STEP, 1.0f);
+			numQuickFrames = 0;
+			numFramesSinceScaleChange = 0;
+			wasLastScaleChangeUp = true;
+		}
+	}
+	else numQuickFrames = 0;
+}
+
 static void DoOneFrame()
 {
-	UpdateAllChangedAssets();
+	if (isReplay)
+	{
+		double now = GetTime();
+		if (replayFrameStartTime >= 0)
+			ListAdd(&replayFrameTimes, now - replayFrameStartTime);
+		replayFrameStartTime = now;
+	}
+
+	double now = GetTime();
+	if (frameStartTime >= 0)
+		UpdateResolutionScale(now - frameStartTime, frameWorkTime);
+	frameStartTime = now;
+
+	PROFILE_FRAME_BEGIN();
+	PROFILE_BEGIN("Update assets");
+	{
+		UpdateAllChangedAssets();
+		UpdateStreamingAssets(STREAMING_TIME_BUDGET);
+	}
+	PROFILE_END();
 	TempReset(0);
 	BeginDrawing();
 	UpdateInputMappings();
-	ImGui_ImplRaylib_NewFrame();
-	ImGui::NewFrame();
 	rlDisableBackfaceCulling();
 	{
-		UpdateCurrentGameState();
+		PROFILE_BEGIN("Update");
+		UpdateFixedTimestep();
+		PROFILE_END();
+
+		// Updates never build ImGui windows, so we can wait until they're done to see if the game state that renders wants any.
+		#ifdef DEV_GUI_ENABLED
+		{
+			isDevGuiVisible = GameWantsDevGui();
+			if (isDevGuiVisible)
+			{
+				if (not isDevGuiInitialized)
+					InitDevGui();
+				ImGui_ImplRaylib_NewFrame();
+				ImGui::NewFrame();
+			}
+		}
+		#endif
+
+		PROFILE_BEGIN("Render");
 		RenderCurrentGameState();
+		rlDrawRenderBatchActive();
+		PROFILE_END();
+	}
+	#ifdef DEV_GUI_ENABLED
+	if (isDevGuiVisible)
+	{
+		PROFILE_BEGIN("ImGui");
+		ImGui::Render();
+		ImGui_ImplRaylib_Render(ImGui::GetDrawData());
+		PROFILE_END();
 	}
-	rlDrawRenderBatchActive();
-	ImGui::Render();
-	ImGui_ImplRaylib_Render(ImGui::GetDrawData());
+	#endif
+	// This is where we wait for vsync, so it's usually most of the frame.
+	frameWorkTime = GetTime() - frameStartTime;
+	PROFILE_BEGIN("Present");
 	EndDrawing();
+	PROFILE_END();
 	UpdateTemporarySounds();
+	FlushLog();
+	PROFILE_FRAME_END();
+}
+
+static double GetReplayFrameTimePercentile(int percentile)
+{
+	int numFrames = ListCount(replayFrameTimes);
+	return 1000 * replayFrameTimes[(numFrames - 1) * percentile / 100];
+}
+
+static void ReportReplayFrameTimes(void)
+{
+	int numFrames = ListCount(replayFrameTimes);
+	if (numFrames == 0)
+	{
+		LogWarning("Replay of '%s' didn't run any frames.", replayPath);
+		return;
+	}
+
+	std::sort(replayFrameTimes, replayFrameTimes + numFrames);
+	double total = 0;
+	for (int i = 0; i < numFrames; ++i)
+		total += replayFrameTimes[i];
+	double mean = 1000 * total / numFrames;
+
+	LogInfo("Replayed %d frames of '%s'. Frame times: mean %.3fms, p50 %.3fms, p90 %.3fms, p99 %.3fms, max %.3fms.",
+		numFrames, replayPath, mean, GetReplayFrameTimePercentile(50), GetReplayFrameTimePercentile(90),
+		GetReplayFrameTimePercentile(99), GetReplayFrameTimePercentile(100));
+
+	if (replayResultsPath)
+	{
+		char *results = TempFormat(
+			"{\n"
+			"\t\"replay\": \"%s\",\n"
+			"\t\"frames\": %d,\n"
+			"\t\"mean_ms\": %.3f,\n"
+			"\t\"p50_ms\": %.3f,\n"
+			"\t\"p90_ms\": %.3f,\n"
+			"\t\"p99_ms\": %.3f,\n"
+			"\t\"max_ms\": %.3f\n"
+			"}\n",
+			replayPath, numFrames, mean, GetReplayFrameTimePercentile(50), GetReplayFrameTimePercentile(90),
+			GetReplayFrameTimePercentile(99), GetReplayFrameTimePercentile(100));
+		if (not SaveFileText(replayResultsPath, results))
+			LogError("Couldn't save replay results to '%s'.", replayResultsPath);
+		TempFree(results);
+	}
 }
 
-int main()
+// Usage: WhoStoleTheSun [--replay recording] [--replay-results file.json]
+// Recordings are made with the "record" console command. Paths are relative to 'res'.
+static void ParseCommandLine(int argc, char **argv)
 {
+	for (int i = 1; i < argc; ++i)
+	{
+		if (StringsEqual(argv[i], "--replay") and i + 1 < argc)
+			replayPath = argv[++i];
+		else if (StringsEqual(argv[i], "--replay-results") and i + 1 < argc)
+			replayResultsPath = argv[++i];
+		else
+			LogWarning("Ignoring unknown command line argument '%s'.", argv[i]);
+	}
+	isReplay = replayPath != NULL;
+}
+
+int main(int argc, char **argv)
+{
+	// The log categories do all of the filtering (see SetLogCategoryLevel), including raylib's messages.
+	CaptureRaylibLog();
+	ParseCommandLine(argc, argv);
+
 	// We need the 'res' folder to be accessible from the working directory before we do anything. 
 	// But, on desktop we have no clue where the working directory or the app will be when we run. 
 	// I mean, we do actually know, but it's different on mac/windows/linux, and I don't want to
@@ -53,16 +369,22 @@ int main()
 	#endif
 	ChangeDirectory("res");
 
+	// The web build only preloads the base pack, the packs of the scenes are downloaded when they're loaded.
+	#ifdef __EMSCRIPTEN__
+	{
+		if (FileExists("base.pack"))
+			MountPack("base.pack");
+	}
+	#endif
+
+	// Replays still have to render to measure anything, but nobody is watching, so the window stays hidden.
+	if (isReplay)
+		SetConfigFlags(FLAG_WINDOW_HIDDEN);
+
 	GameInit();
 	rlDisableBackfaceCulling(); // It's a 2D game we don't need this..
 	rlDisableDepthTest();
 	SetExitKey(0);
-	ImGui::CreateContext();
-	ImGui::StyleColorsDark();
-	ImGui_ImplRaylib_Init();
-	auto &io = ImGui::GetIO();
-	io.Fonts->AddFontFromFileTTF("roboto.ttf", 18);
-	ImGui_ImplRaylib_LoadDefaultFontAtlas();
 
 	// On the web, the browser wants to drive the main loop. On other platforms, we drive it.
 	// See: https://emscripten.org/docs/porting/emscripten-runtime-environment.html#browser-main-loop
@@ -72,9 +394,26 @@ int main()
 	}
 	#else
 	{
+		if (isReplay)
+		{
+			SetTargetFPS(0);
+			// Streamed assets show up whenever they're done, which would make every run a little different.
+			SetAssetStreaming(false);
+			if (not StartInputReplay(replayPath))
+				isReplay = false;
+		}
+
 		while (not WindowShouldClose())
+		{
 			DoOneFrame();
+			if (isReplay and not IsReplayingInput())
+			{
+				ReportReplayFrameTimes();
+				break;
+			}
+		}
 		GameDeinit();
+		FlushLog();
 	}
 	#endif
 }
@@ -85,6 +424,6 @@ int main()
 int __stdcall WinMain(void *instance, void *prevInstance, char *cmdLine, int showCmd)
 {
 	UNUSED(instance); UNUSED(prevInstance); UNUSED(cmdLine); UNUSED(showCmd);
-	return main();
+	return main(__argc, __argv);
 }
 #endif
\ No newline at end of file
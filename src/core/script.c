@@ -24,18 +24,21 @@ STRUCT(Word)
 	float width;
 };
 
-static float GetAdvance(Font font, float fontSize, int glyphIndex)
+// Everything is collected into growable lists while parsing, and then copied into the script's arena in one go.
+STRUCT(ScriptBuilder)
 {
-	float scaleFactor = fontSize / font.baseSize;
-	if (font.glyphs[glyphIndex].advanceX == 0)
-		return scaleFactor * font.recs[glyphIndex].width;
-	else
-		return scaleFactor * font.glyphs[glyphIndex].advanceX;
-}
+	List(Paragraph) paragraphs;
+	List(int) codepoints;
+	List(ExpressionChange) expressionChanges;
+	List(char) stringPool;
+	List(int) speakers; // String pool indices of the speaker names we've seen so far.
+};
 
-static List(int) ConvertToCodepoints(const char *text, int length, List(char) *stringPool)
+// Appends the codepoints of the paragraph text to the list.
+static void ConvertToCodepoints(const char *text, int length, List(int) *codepointList, List(char) *stringPool)
 {
-	List(int) codepoints = NULL;
+	List(int) codepoints = *codepointList;
+	int first = ListCount(codepoints);
 
 	int lastNonPauseCodepoint = 0;
 	for (int i = 0; i < length;)
@@ -47,7 +50,7 @@ static List(int) ConvertToCodepoints(const char *text, int length, List(char) *s
 		i += advance;
 
 		int lastIndex = ListCount(codepoints) - 1;
-		bool isEscaped = lastIndex > 0 and codepoints[lastIndex] == CONTROL('\\');
+		bool isEscaped = lastIndex > first and codepoints[lastIndex] == CONTROL('\\');
 
 		if ((codepoint == '[' or codepoint == '{') and not isEscaped)
 		{
@@ -129,15 +132,14 @@ static List(int) ConvertToCodepoints(const char *text, int length, List(char) *s
 	}
 
 	// Remove pauses at the end.
-	while (ListCount(codepoints) > 0 and codepoints[ListCount(codepoints) - 1] == CONTROL('`'))
+	while (ListCount(codepoints) > first and codepoints[ListCount(codepoints) - 1] == CONTROL('`'))
 		ListPop(&codepoints);
 
-	return codepoints;
+	*codepointList = codepoints;
 }
 
-static float MeasureDuration(List(int) codepoints)
+static float MeasureDuration(const int *codepoints, int numCodepoints)
 {
-	int numCodepoints = ListCount(codepoints);
 	int duration = 0;
 	for (int i = 0; i < numCodepoints; ++i)
 	{
@@ -152,35 +154,324 @@ static float MeasureDuration(List(int) codepoints)
 	return (float)duration;
 }
 
+// Works out which expression each paragraph starts with, and when the expression changes within the paragraph.
+// The expression carries over between paragraphs, unless the speaker changes.
+static void BuildExpressionTimeline(ScriptBuilder *builder)
+{
+	int prevSpeaker = -2; // Not any speaker, not even the default one.
+	int expression = -1;
+	for (int i = 0; i < ListCount(builder->paragraphs); ++i)
+	{
+		Paragraph *paragraph = &builder->paragraphs[i];
+		if (paragraph->speakerIndex != prevSpeaker)
+		{
+			prevSpeaker = paragraph->speakerIndex;
+			expression = -1;
+		}
+		paragraph->startExpression = expression;
+		paragraph->firstExpressionChange = ListCount(builder->expressionChanges);
+		paragraph->numExpressionChanges = 0;
+
+		const int *codepoints = builder->codepoints + paragraph->firstCodepoint;
+		int numCodepoints = paragraph->numCodepoints;
+		float t = 0;
+		for (int j = 0; j < numCodepoints; ++j)
+		{
+			int codepoint = codepoints[j];
+			if (codepoint == CONTROL('['))
+			{
+				expression = codepoints[++j];
+				ExpressionChange change = { t, expression };
+				ListAdd(&builder->expressionChanges, change);
+				++paragraph->numExpressionChanges;
+			}
+			else if (codepoint == CONTROL('{'))
+			{
+				++j; // Skip the string index.
+			}
+			else if (not IS_CONTROL(codepoint) or codepoint == CONTROL('`'))
+			{
+				t += 1;
+			}
+		}
+	}
+}
+
+// Commands are compiled once up front, so that running them in the middle of a dialogue doesn't have to parse anything.
+// Afterwards, the codepoint after a CONTROL('{') is an index into script->commands instead of the string pool.
+static void CompileParagraphCommands(Script *script, Paragraph *paragraph)
+{
+	int *codepoints = script->codepoints + paragraph->firstCodepoint;
+	for (int i = 0; i < paragraph->numCodepoints; ++i)
+	{
+		if (codepoints[i] == CONTROL('['))
+			++i; // Skip the string index.
+		else if (codepoints[i] == CONTROL('{'))
+		{
+			int stringIndex = codepoints[++i];
+			if (stringIndex < 0)
+				continue; // Empty {}.
+
+			codepoints[i] = ListCount(script->commands);
+			ListAdd(&script->commands, CompileCommand(&script->stringPool[stringIndex]));
+		}
+	}
+}
+
 static bool IsWhitespace(int codepoint)
 {
 	return codepoint < 128 && CharIsWhitespace((char)codepoint);
 }
 
-Script LoadScript(const char *path, Font regular, Font bold, Font italic, Font boldItalic)
+// The cache is just the parsed script laid out flat, so loading it is one read.
+// Bump SCRIPT_CACHE_VERSION whenever the parser changes what it produces, so that old caches get rebuilt.
+#define SCRIPT_CACHE_MAGIC "SCRC"
+#define SCRIPT_CACHE_VERSION 2
+
+STRUCT(ScriptCacheHeader)
 {
-	Script script = { 
-		.text = LoadFileText(path), 
-		.font = regular,
-		.boldFont = bold,
-		.italicFont = italic,
-		.boldItalicFont = boldItalic
-	};
+	char magic[4];
+	int version;
+	unsigned textHash; // HashString of the script text the cache was made from.
+	int textLength;
+	int numParagraphs;
+	int numCodepoints;
+	int numExpressionChanges;
+	int stringPoolSize;
+};
 
-	if (not script.text)
+STRUCT(ScriptCacheParagraph)
+{
+	int speakerIndex;
+	int textOffset;
+	int textLength;
+	float duration;
+	int firstCodepoint;
+	int numCodepoints;
+	int startExpression;
+	int firstExpressionChange;
+	int numExpressionChanges;
+};
+
+// Paragraphs, codepoints, expression changes and the string pool all go into one allocation, in that order.
+// Everything in there is at least 4 byte aligned, so the parts can just go one after the other.
+static void AllocateScriptArena(Script *script, int numParagraphs, int numCodepoints, int numExpressionChanges, int stringPoolSize)
+{
+	int paragraphsSize = numParagraphs * (int)sizeof script->paragraphs[0];
+	int codepointsSize = numCodepoints * (int)sizeof script->codepoints[0];
+	int expressionChangesSize = numExpressionChanges * (int)sizeof script->expressionChanges[0];
+	char *arena = MemAlloc(paragraphsSize + codepointsSize + expressionChangesSize + stringPoolSize + 1);
+	ZeroBytes(arena, paragraphsSize);
+	script->arena = arena;
+	script->paragraphs = (Paragraph *)arena;
+	script->codepoints = (int *)(arena + paragraphsSize);
+	script->expressionChanges = (ExpressionChange *)(arena + paragraphsSize + codepointsSize);
+	script->stringPool = arena + paragraphsSize + codepointsSize + expressionChangesSize;
+	script->numParagraphs = numParagraphs;
+	script->numCodepoints = numCodepoints;
+	script->numExpressionChanges = numExpressionChanges;
+	script->stringPoolSize = stringPoolSize;
+}
+
+static const char *GetScriptCachePath(const char *path)
+{
+	return TempFormat("%s.compiled", path);
+}
+
+static bool IsStringPoolIndexValid(const ScriptCacheHeader *header, int stringIndex)
+{
+	return stringIndex >= -1 and stringIndex < header->stringPoolSize;
+}
+
+static bool IsScriptCacheParagraphValid(const ScriptCacheHeader *header, const ScriptCacheParagraph *record)
+{
+	return IsStringPoolIndexValid(header, record->speakerIndex)
+		and record->textOffset >= 0 and record->textLength >= 0 and record->textOffset + record->textLength <= header->textLength
+		and record->firstCodepoint >= 0 and record->numCodepoints >= 0 and record->firstCodepoint + record->numCodepoints <= header->numCodepoints
+		and IsStringPoolIndexValid(header, record->startExpression)
+		and record->firstExpressionChange >= 0 and record->numExpressionChanges >= 0
+		and record->firstExpressionChange + record->numExpressionChanges <= header->numExpressionChanges;
+}
+
+// The codepoints after every CONTROL('[') and CONTROL('{') are string pool indices, and have to be in the same paragraph.
+static bool AreScriptCacheCodepointsValid(const ScriptCacheHeader *header, const ScriptCacheParagraph *record, const int *codepoints)
+{
+	const int *paragraphCodepoints = codepoints + record->firstCodepoint;
+	for (int i = 0; i < record->numCodepoints; ++i)
 	{
-		LogError("Failed to load script file '%s'.", path);
-		return script;
+		if (paragraphCodepoints[i] == CONTROL('[') or paragraphCodepoints[i] == CONTROL('{'))
+		{
+			++i;
+			if (i >= record->numCodepoints or not IsStringPoolIndexValid(header, paragraphCodepoints[i]))
+				return false;
+		}
 	}
+	return true;
+}
 
+// Returns false if there's no cache, or if it's out of date, in which case the script is left alone.
+static bool LoadScriptCache(Script *script, const char *path, unsigned textHash, int textLength)
+{
+	const char *cachePath = GetScriptCachePath(path);
+	if (not ResourceExists(cachePath))
+		return false;
+
+	unsigned dataSize;
+	unsigned char *data = LoadFileData(cachePath, &dataSize);
+	if (not data)
+		return false;
+
+	BinaryStream stream = { 0 };
+	stream.buffer = data;
+	stream.size = (int)dataSize;
+
+	ScriptCacheHeader header;
+	ReadBytesInto(&stream, &header, sizeof header);
+	bool isValid = stream.cursor == sizeof header
+		and BytesEqual(header.magic, SCRIPT_CACHE_MAGIC, 4)
+		and header.version == SCRIPT_CACHE_VERSION
+		and header.textHash == textHash
+		and header.textLength == textLength
+		and header.numParagraphs >= 0 and header.numCodepoints >= 0
+		and header.numExpressionChanges >= 0 and header.stringPoolSize >= 0;
+
+	const ScriptCacheParagraph *records = NULL;
+	const int *codepoints = NULL;
+	const ExpressionChange *expressionChanges = NULL;
+	const char *stringPool = NULL;
+	if (isValid)
+	{
+		int64_t expectedSize = (int64_t)sizeof header
+			+ (int64_t)header.numParagraphs * sizeof records[0]
+			+ (int64_t)header.numCodepoints * sizeof codepoints[0]
+			+ (int64_t)header.numExpressionChanges * sizeof expressionChanges[0]
+			+ header.stringPoolSize;
+		isValid = expectedSize == (int64_t)dataSize;
+	}
+	if (isValid)
+	{
+		records = ReadBytes(&stream, header.numParagraphs * (int)sizeof records[0]);
+		codepoints = ReadBytes(&stream, header.numCodepoints * (int)sizeof codepoints[0]);
+		expressionChanges = ReadBytes(&stream, header.numExpressionChanges * (int)sizeof expressionChanges[0]);
+		stringPool = ReadBytes(&stream, header.stringPoolSize);
+		isValid = header.stringPoolSize == 0 or stringPool[header.stringPoolSize - 1] == 0;
+		// A corrupt cache could otherwise make us read outside the string pool much later, when the text is drawn.
+		for (int i = 0; i < header.numParagraphs and isValid; ++i)
+			isValid = IsScriptCacheParagraphValid(&header, &records[i]) and AreScriptCacheCodepointsValid(&header, &records[i], codepoints);
+		for (int i = 0; i < header.numExpressionChanges and isValid; ++i)
+			isValid = IsStringPoolIndexValid(&header, expressionChanges[i].stringIndex);
+	}
+	if (not isValid)
+	{
+		UnloadFileData(data);
+		return false;
+	}
+
+	AllocateScriptArena(script, header.numParagraphs, header.numCodepoints, header.numExpressionChanges, header.stringPoolSize);
+	CopyBytes(script->codepoints, codepoints, header.numCodepoints * sizeof codepoints[0]);
+	CopyBytes(script->expressionChanges, expressionChanges, header.numExpressionChanges * sizeof expressionChanges[0]);
+	CopyBytes(script->stringPool, stringPool, header.stringPoolSize);
+	for (int i = 0; i < header.numParagraphs; ++i)
+	{
+		const ScriptCacheParagraph *record = &records[i];
+		Paragraph *paragraph = &script->paragraphs[i];
+		paragraph->speakerIndex = record->speakerIndex;
+		paragraph->text = script->text + record->textOffset;
+		paragraph->textLength = record->textLength;
+		paragraph->duration = record->duration;
+		paragraph->firstCodepoint = record->firstCodepoint;
+		paragraph->numCodepoints = record->numCodepoints;
+		paragraph->startExpression = record->startExpression;
+		paragraph->firstExpressionChange = record->firstExpressionChange;
+		paragraph->numExpressionChanges = record->numExpressionChanges;
+	}
+
+	UnloadFileData(data);
+	return true;
+}
+
+static void SaveScriptCache(const Script *script, const char *path, unsigned textHash, int textLength)
+{
+	#ifdef __EMSCRIPTEN__
+	{
+		// The web build can't write next to the preloaded files, the caches have to be made by a desktop build beforehand.
+		UNUSED(script);
+		UNUSED(path);
+		UNUSED(textHash);
+		UNUSED(textLength);
+	}
+	#else
+	{
+		ScriptCacheHeader header;
+		ZeroBytes(&header, sizeof header);
+		CopyBytes(header.magic, SCRIPT_CACHE_MAGIC, 4);
+		header.version = SCRIPT_CACHE_VERSION;
+		header.textHash = textHash;
+		header.textLength = textLength;
+		header.numParagraphs = script->numParagraphs;
+		header.numCodepoints = script->numCodepoints;
+		header.numExpressionChanges = script->numExpressionChanges;
+		header.stringPoolSize = script->stringPoolSize;
+
+		BinaryStream stream = { 0 };
+		stream.canGrow = true;
+		WriteBytes(&stream, &header, sizeof header);
+		for (int i = 0; i < header.numParagraphs; ++i)
+		{
+			const Paragraph *paragraph = &script->paragraphs[i];
+			ScriptCacheParagraph record;
+			ZeroBytes(&record, sizeof record);
+			record.speakerIndex = paragraph->speakerIndex;
+			record.textOffset = (int)(paragraph->text - script->text);
+			record.textLength = paragraph->textLength;
+			record.duration = paragraph->duration;
+			record.firstCodepoint = paragraph->firstCodepoint;
+			record.numCodepoints = paragraph->numCodepoints;
+			record.startExpression = paragraph->startExpression;
+			record.firstExpressionChange = paragraph->firstExpressionChange;
+			record.numExpressionChanges = paragraph->numExpressionChanges;
+			WriteBytes(&stream, &record, sizeof record);
+		}
+		WriteBytes(&stream, script->codepoints, header.numCodepoints * (int)sizeof script->codepoints[0]);
+		WriteBytes(&stream, script->expressionChanges, header.numExpressionChanges * (int)sizeof script->expressionChanges[0]);
+		WriteBytes(&stream, script->stringPool, header.stringPoolSize);
+
+		const char *cachePath = GetScriptCachePath(path);
+		if (not SaveFileData(cachePath, stream.buffer, (unsigned)stream.cursor))
+			LogWarning("Couldn't save script cache to '%s'.", cachePath);
+		MemFree(stream.buffer);
+	}
+	#endif
+}
+
+// Speakers are only stored once, so paragraphs with the same speaker also have the same speaker index.
+static int InternSpeaker(ScriptBuilder *builder, const char *name, int nameLength)
+{
+	for (int i = 0; i < ListCount(builder->speakers); ++i)
+	{
+		const char *speaker = &builder->stringPool[builder->speakers[i]];
+		if (StringLength(speaker) == nameLength and BytesEqual(speaker, name, nameLength))
+			return builder->speakers[i];
+	}
+
+	int index = ListCount(builder->stringPool);
+	char *speaker = ListAllocate(&builder->stringPool, nameLength + 1);
+	CopyBytes(speaker, name, nameLength);
+	speaker[nameLength] = 0;
+	ListAdd(&builder->speakers, index);
+	return index;
+}
+
+static void ParseScript(ScriptBuilder *builder, char *scriptText)
+{
 	int fileCursor = 0;
 	for (;;)
 	{
 		Paragraph paragraph = { 0 };
 		
-		while (CharIsWhitespace(script.text[fileCursor]))
+		while (CharIsWhitespace(scriptText[fileCursor]))
 			++fileCursor;
-		char *text = script.text + fileCursor;
+		char *text = scriptText + fileCursor;
 		if (!text[0])
 			break;
 
@@ -211,8 +502,9 @@ Script LoadScript(const char *path, Font regular, Font bold, Font italic, Font b
 					}
 					++cursor;
 				}
-				if (consecutiveNewline)
+				if (consecutiveNewline or !text[cursor])
 					break;
+				--cursor; // The outer loop has to look at the first character of the next line too.
 			}
 		}
 		int textLength = lastNonWhitespace + 1;
@@ -261,13 +553,8 @@ Script LoadScript(const char *path, Font regular, Font bold, Font italic, Font b
 				foundSpeaker = true;
 				int nameLength = speakerEnd - speakerStart;
 				if (nameLength > 0)
-				{
-					//paragraph.speaker = ListAllocate(&script.stringPool, nameLength + 1);
-					paragraph.speaker = MemAlloc(nameLength + 1);
-					CopyBytes(paragraph.speaker, text + speakerStart, nameLength);
-					paragraph.speaker[nameLength] = 0;
-				}
-				else paragraph.speaker = NULL; // Use the default name.
+					paragraph.speakerIndex = InternSpeaker(builder, text + speakerStart, nameLength);
+				else paragraph.speakerIndex = -1; // Use the default name.
 
 				int skip = (int)(nextLine - text);
 				text = nextLine;
@@ -277,30 +564,75 @@ Script LoadScript(const char *path, Font regular, Font bold, Font italic, Font b
 		if (not foundSpeaker)
 		{
 			// If we didn't find a name, the character stays the same between paragraphs.
-			const char *previousName = NULL;
-			if (script.paragraphs)
-				previousName = script.paragraphs[ListCount(script.paragraphs) - 1].speaker;
-
-			if (previousName)
-			{
-				int nameLength = StringLength(previousName);
-				//paragraph.speaker = ListAllocate(&script.stringPool, nameLength + 1);
-				paragraph.speaker = MemAlloc(nameLength + 1);
-				CopyBytes(paragraph.speaker, previousName, nameLength);
-				paragraph.speaker[nameLength] = 0;
-			}
-			else paragraph.speaker = NULL;
+			if (ListCount(builder->paragraphs) > 0)
+				paragraph.speakerIndex = builder->paragraphs[ListCount(builder->paragraphs) - 1].speakerIndex;
+			else
+				paragraph.speakerIndex = -1;
 		}
 
 		fileCursor += cursor;
 		paragraph.text = text;
 		paragraph.textLength = textLength;
-		paragraph.codepoints = ConvertToCodepoints(text, textLength, &script.stringPool);
-		paragraph.duration = MeasureDuration(paragraph.codepoints);
-		ListAdd(&script.paragraphs, paragraph);
+		paragraph.firstCodepoint = ListCount(builder->codepoints);
+		ConvertToCodepoints(text, textLength, &builder->codepoints, &builder->stringPool);
+		paragraph.numCodepoints = ListCount(builder->codepoints) - paragraph.firstCodepoint;
+		paragraph.duration = MeasureDuration(builder->codepoints + paragraph.firstCodepoint, paragraph.numCodepoints);
+		ListAdd(&builder->paragraphs, paragraph);
 	}
 
-	LogInfo("Script '%s' loaded successfully (%d paragraphs).", path, ListCount(script.paragraphs));
+	BuildExpressionTimeline(builder);
+}
+
+Script LoadScript(const char *path, FontFace regular, FontFace bold, FontFace italic, FontFace boldItalic)
+{
+	Script script = { 
+		.text = LoadFileText(path), 
+		.font = regular,
+		.boldFont = bold,
+		.italicFont = italic,
+		.boldItalicFont = boldItalic
+	};
+
+	if (not script.text)
+	{
+		LogError("Failed to load script file '%s'.", path);
+		return script;
+	}
+
+	// We still need the text to check whether the cache is up to date, but hashing it is a lot cheaper than parsing it.
+	unsigned textHash = HashString(script.text);
+	int textLength = StringLength(script.text);
+	bool isCached = LoadScriptCache(&script, path, textHash, textLength);
+	if (not isCached)
+	{
+		int mark = TempMark();
+		ScriptBuilder builder = { 0 };
+		ListSetAllocator((void **)&builder.paragraphs, TempRealloc, TempFree);
+		ListSetAllocator((void **)&builder.codepoints, TempRealloc, TempFree);
+		ListSetAllocator((void **)&builder.expressionChanges, TempRealloc, TempFree);
+		ListSetAllocator((void **)&builder.stringPool, TempRealloc, TempFree);
+		ListSetAllocator((void **)&builder.speakers, TempRealloc, TempFree);
+		ParseScript(&builder, script.text);
+
+		AllocateScriptArena(&script, ListCount(builder.paragraphs), ListCount(builder.codepoints), ListCount(builder.expressionChanges), ListCount(builder.stringPool));
+		CopyBytes(script.paragraphs, builder.paragraphs, script.numParagraphs * sizeof script.paragraphs[0]);
+		CopyBytes(script.codepoints, builder.codepoints, script.numCodepoints * sizeof script.codepoints[0]);
+		CopyBytes(script.expressionChanges, builder.expressionChanges, script.numExpressionChanges * sizeof script.expressionChanges[0]);
+		CopyBytes(script.stringPool, builder.stringPool, script.stringPoolSize);
+		TempReset(mark);
+
+		SaveScriptCache(&script, path, textHash, textLength);
+	}
+
+	// The arena doesn't move, so now we can point into the string pool.
+	for (int i = 0; i < script.numParagraphs; ++i)
+	{
+		Paragraph *paragraph = &script.paragraphs[i];
+		paragraph->speaker = paragraph->speakerIndex >= 0 ? &script.stringPool[paragraph->speakerIndex] : NULL;
+		CompileParagraphCommands(&script, paragraph);
+	}
+
+	LogMessage(LOG_CATEGORY_SCRIPTS, LOG_INFO, "Script '%s' loaded successfully (%d paragraphs%s).", path, script.numParagraphs, isCached ? ", cached" : "");
 	return script;
 }
 
@@ -309,59 +641,62 @@ void UnloadScript(Script *script)
 	if (not script or not script->text)
 		return;
 
-	for (int i = 0; i < ListCount(script->paragraphs); ++i)
-	{
-		Paragraph *paragraph = &script->paragraphs[i];
-		ListDestroy(&paragraph->codepoints);
-		MemFree(paragraph->speaker);
-	}
-	ListDestroy(&script->paragraphs);
-	ListDestroy(&script->stringPool);
+	for (int i = 0; i < script->numParagraphs; ++i)
+		ListDestroy(&script->paragraphs[i].layout);
+	for (int i = 0; i < ListCount(script->commands); ++i)
+		UnloadCompiledCommand(&script->commands[i]);
+	ListDestroy(&script->commands);
+	MemFree(script->arena);
 	UnloadFileText(script->text);
-	script->text = NULL;
-	script->commandIndex = 0;
-	LogInfo("Script unloaded.");
+	ZeroBytes(script, sizeof script[0]);
+	LogMessage(LOG_CATEGORY_SCRIPTS, LOG_DEBUG, "Script unloaded.");
 }
 
-void DrawScriptParagraph(Script *script, int paragraphIndex, Rectangle textBox, float fontSize, Color color, Color shadowColor, float time)
+// Works out where every glyph goes and when it shows up, so that drawing is just a walk through the items.
+// This only runs again if the text box width or font size changes, or when the script gets reloaded.
+static void LayoutParagraph(const Script *script, Paragraph *paragraph, float width, float fontSize)
 {
-	paragraphIndex = ClampInt(paragraphIndex, 0, ListCount(script->paragraphs) - 1);
-	Paragraph paragraph = script->paragraphs[paragraphIndex];
-	List(int) codepoints = paragraph.codepoints;
-	int numCodepoints = ListCount(codepoints);
+	const int *codepoints = script->codepoints + paragraph->firstCodepoint;
+	int numCodepoints = paragraph->numCodepoints;
 
-	Font fonts[STYLE_ENUM_COUNT] = {
+	FontFace fonts[STYLE_ENUM_COUNT] = {
 		[REGULAR    ] = script->font,
 		[BOLD       ] = script->boldFont,
 		[ITALIC     ] = script->italicFont,
 		[BOLD_ITALIC] = script->boldItalicFont
 	};
 
-	float x = textBox.x;
-	float y = textBox.y;
+	ListDestroy((void **)&paragraph->layout);
+	paragraph->layoutWidth = width;
+	paragraph->layoutFontSize = fontSize;
+
+	float x = 0;
+	float y = 0;
 	float t = 0;
+	float revealTime = 0;
 	Style style = REGULAR;
 	bool group = false;
-	float maxX = textBox.x + textBox.width;
-	int commandIndex = 0;
+	float remainingWordWidth = -1; // Negative when we're not inside of a word.
 
-	for (int i = 0; i < numCodepoints and (group or t < time); ++i)
+	for (int i = 0; i < numCodepoints; ++i)
 	{
+		// Everything inside of a |group| shows up at the same time as the start of the group.
+		if (not group)
+			revealTime = t;
+
 		int codepoint = codepoints[i];
 		if (codepoint == CONTROL('['))
 		{
 			++i; // Skip the string index.
+			remainingWordWidth = -1;
 		}
 		else if (codepoint == CONTROL('{'))
 		{
-			int stringIndex = codepoints[++i];
-			char *command = &script->stringPool[stringIndex];
-			if (++commandIndex > script->commandIndex)
-			{
-				script->commandIndex++;
-				LogInfo("Script executing command %d: '%s'.", script->commandIndex, command);
-				ExecuteCommand(command);
-			}
+			ParagraphItem *item = ListAllocateItem(&paragraph->layout);
+			item->revealTime = revealTime;
+			item->position = (Vector2) { x, y };
+			item->codepoint = 0;
+			item->data = codepoints[++i];
 		}
 		else if (codepoint == CONTROL('*'))
 		{
@@ -380,110 +715,152 @@ void DrawScriptParagraph(Script *script, int paragraphIndex, Rectangle textBox,
 			t += 1;
 			if (codepoint == '\n')
 			{
-				x = textBox.x;
+				x = 0;
 				y += GetLineHeight(fonts[style], fontSize);
+				remainingWordWidth = -1;
 			}
 			else if (codepoint != CONTROL('`'))
 			{
-				Font font = fonts[style];
-				int index = GetGlyphIndex(font, codepoint);
-				x += GetAdvance(font, fontSize, index);
-				if (x > maxX)
+				x += GetGlyphAdvance(fonts[style], fontSize, codepoint);
+				if (x > width)
 				{
-					x = textBox.x;
+					x = 0;
 					y += GetLineHeight(fonts[style], fontSize);
 				}
+				remainingWordWidth = -1;
 			}
 		}
 		else
 		{
-			//@TODO @SPEED This is EXTREMELY inneficient
-			// We draw every word character by character, but we scan through it to see if it will fit on the line every single time
-			// so it's O(n^2) performance when it could easily be O(1). Could be fixed, but it would require basically copy pasting the
-			// above control code checks into the loop of the word drawing itself, and I don't wanna do that right now soo...
-
-			// Check if the word will fit on the line, and if it doesn't, break the line before drawing the word.
-			float width = 0;
-			Style backupStyle = style;
-			for (int j = i; j < numCodepoints and not IsWhitespace(codepoints[j]) and codepoints[j] != CONTROL('['); ++j)
+			// Measure the whole word once when we get to it, so we can break the line before it if it doesn't fit.
+			if (remainingWordWidth < 0)
 			{
-				codepoint = codepoints[j];
-				if (codepoint == CONTROL('*'))
-					style ^= BOLD;
-				else if (codepoint == CONTROL('_'))
-					style ^= ITALIC;
-				else if (not IS_CONTROL(codepoint))
+				remainingWordWidth = 0;
+				Style wordStyle = style;
+				for (int j = i; j < numCodepoints and not IsWhitespace(codepoints[j]) and codepoints[j] != CONTROL('['); ++j)
 				{
-					Font font = fonts[style];
-					int index = GetGlyphIndex(font, codepoint);
-					width += GetAdvance(font, fontSize, index);
+					int c = codepoints[j];
+					if (c == CONTROL('*'))
+						wordStyle ^= BOLD;
+					else if (c == CONTROL('_'))
+						wordStyle ^= ITALIC;
+					else if (c == CONTROL('{'))
+						++j; // Skip the string index.
+					else if (not IS_CONTROL(c))
+					{
+						remainingWordWidth += GetGlyphAdvance(fonts[wordStyle], fontSize, c);
+					}
 				}
 			}
 
 			// Word is too long to fit onto current line. Break the line.
-			if (x + width > maxX)
+			if (x + remainingWordWidth > width)
 			{
-				x = textBox.x;
+				x = 0;
 				y += GetLineHeight(fonts[style], fontSize);
 			}
 
-			style = backupStyle;
-			codepoint = codepoints[i];
-
-			// @SPEED Here we could draw the entire word instead of just the one character.
-			{
-				Font font = fonts[style];
-				int index = GetGlyphIndex(font, codepoint);
-				DrawTextCodepoint(font, codepoint, (Vector2) { x + 2, y + 2 }, fontSize, shadowColor);
-				DrawTextCodepoint(font, codepoint, (Vector2) { x, y }, fontSize, color);
-				x += GetAdvance(font, fontSize, index);
-				t += 1;
-			}
+			float advance = GetGlyphAdvance(fonts[style], fontSize, codepoint);
+			ParagraphItem *item = ListAllocateItem(&paragraph->layout);
+			item->revealTime = revealTime;
+			item->position = (Vector2) { x, y };
+			item->codepoint = codepoint;
+			item->data = style;
+			x += advance;
+			remainingWordWidth -= advance;
+			t += 1;
 		}
 	}
 }
 
-const char *GetScriptExpression(Script script, int paragraphIndex, float time)
+void DrawScriptParagraph(Script *script, int paragraphIndex, Rectangle textBox, float fontSize, Color color, Color shadowColor, float time)
 {
-	// @SPEED The very existance of this call is inneficient.
-	// It basically has to crawl through the entire script to find the expression.
-	const char *prevSpeaker = "";
-	const char *expression = "default";
-	paragraphIndex = ClampInt(paragraphIndex, 0, ListCount(script.paragraphs) - 1); 
+	paragraphIndex = ClampInt(paragraphIndex, 0, script->numParagraphs - 1);
+	Paragraph *paragraph = &script->paragraphs[paragraphIndex];
+	if (paragraph->layoutWidth != textBox.width or paragraph->layoutFontSize != fontSize)
+		LayoutParagraph(script, paragraph, textBox.width, fontSize);
 
-	for (int i = 0; i <= paragraphIndex; ++i)
+	FontFace fonts[STYLE_ENUM_COUNT] = {
+		[REGULAR    ] = script->font,
+		[BOLD       ] = script->boldFont,
+		[ITALIC     ] = script->italicFont,
+		[BOLD_ITALIC] = script->boldItalicFont
+	};
+
+	// Glyphs with the same style get drawn together as one run.
+	int mark = TempMark();
+	List(int) runCodepoints = NULL;
+	List(Vector2) runOffsets = NULL;
+	ListSetAllocator((void **)&runCodepoints, TempRealloc, TempFree);
+	ListSetAllocator((void **)&runOffsets, TempRealloc, TempFree);
+	Style runStyle = REGULAR;
+	Vector2 origin = { textBox.x, textBox.y };
+	Vector2 shadowOffset = { 2, 2 };
+
+	int commandIndex = 0;
+	List(ParagraphItem) layout = paragraph->layout;
+	for (int i = 0; i <= ListCount(layout); ++i)
 	{
-		Paragraph paragraph = script.paragraphs[i];
-		if (not StringsEqual(paragraph.speaker, prevSpeaker))
+		bool isVisible = i < ListCount(layout) and layout[i].revealTime < time;
+		bool isGlyph = isVisible and layout[i].codepoint != 0;
+		if (ListCount(runCodepoints) > 0 and (not isVisible or (isGlyph and (Style)layout[i].data != runStyle)))
 		{
-			prevSpeaker = paragraph.speaker;
-			expression = "default";
+			TextStyle textStyle = { fonts[runStyle], fontSize, color, shadowColor, shadowOffset };
+			DrawGlyphRun(textStyle, runCodepoints, runOffsets, ListCount(runCodepoints), origin);
+			ListClear(runCodepoints);
+			ListClear(runOffsets);
 		}
+		if (not isVisible)
+			break;
 
-		List(int) codepoints = paragraph.codepoints;
-		int numCodepoints = ListCount(codepoints);
-		float t = 0;
-		for (int j = 0; j < numCodepoints and (t < time or i != paragraphIndex); ++j)
+		ParagraphItem item = layout[i];
+		if (isGlyph)
 		{
-			int codepoint = codepoints[j];
-			if (codepoint == CONTROL('['))
-			{
-				int stringIndex = codepoints[++j];
-				if (stringIndex == -1)
-					expression = "default";
-				else
-					expression = &script.stringPool[stringIndex];
-			}
-			else if (codepoint == CONTROL('{'))
-			{
-				++j; // Skip the string index.
-			}
-			else if (not IS_CONTROL(codepoint) or codepoint == CONTROL('`'))
+			runStyle = (Style)item.data;
+			ListAdd(&runCodepoints, item.codepoint);
+			ListAdd(&runOffsets, item.position);
+		}
+		else
+		{
+			if (++commandIndex > script->commandIndex)
 			{
-				t += 1;
+				script->commandIndex++;
+				if (item.data >= 0)
+				{
+					CompiledCommand *command = &script->commands[item.data];
+					LogMessage(LOG_CATEGORY_SCRIPTS, LOG_DEBUG, "Script executing command %d: '%s'.", script->commandIndex, command->name ? command->name : "");
+					ExecuteCompiledCommand(command);
+					// Commands can change anything in the world, which is probably being drawn frozen underneath the dialog.
+					InvalidateGameStateSnapshot();
+				}
 			}
 		}
 	}
+	TempReset(mark);
+}
+
+const char *GetScriptExpression(Script script, int paragraphIndex, float time)
+{
+	paragraphIndex = ClampInt(paragraphIndex, 0, script.numParagraphs - 1);
+	Paragraph paragraph = script.paragraphs[paragraphIndex];
+
+	// Find the last change that happened before the given time.
+	const ExpressionChange *changes = script.expressionChanges + paragraph.firstExpressionChange;
+	int stringIndex = paragraph.startExpression;
+	int low = 0;
+	int high = paragraph.numExpressionChanges;
+	while (low < high)
+	{
+		int middle = (low + high) / 2;
+		if (changes[middle].time < time)
+			low = middle + 1;
+		else
+			high = middle;
+	}
+	if (low > 0)
+		stringIndex = changes[low - 1].stringIndex;
 
-	return expression;
+	if (stringIndex == -1)
+		return "default";
+	return &script.stringPool[stringIndex];
 }
@@ -4,6 +4,8 @@
 #define MASK ((uintptr_t)(ALIGNMENT - 1))
 #define SLAB_SIZE_GRANULARITY KILOBYTES(64)
 
+#ifdef SLAB_ALLOCATOR_CHECKS
+
 STRUCT(Header)
 {
 	int size;
@@ -25,6 +27,34 @@ static bool IsCorrupted(SlabAllocator *allocator, void *block)
 		not BytesEqual(footer->magic, allocator->magic, sizeof footer->magic);
 }
 
+static void WriteGuards(SlabAllocator *allocator, Header *header)
+{
+	Footer *footer = (Footer *)((char *)(header + 1) + header->size);
+	CopyBytes(header->magic, allocator->magic, sizeof header->magic);
+	CopyBytes(footer->magic, allocator->magic, sizeof footer->magic);
+}
+
+#define FOOTER_SIZE sizeof(Footer)
+
+// Freed memory is zeroed right away, so that new allocations are always zeroed, and so that use-after-free bugs are obvious.
+#define ZERO_FREED_BYTES(bytes, count) ZeroBytes(bytes, count)
+
+#else
+
+// Without the checks the header only remembers the size for ReallocateFromSlabAllocator. It's still 16 bytes to keep the alignment.
+STRUCT(Header)
+{
+	int size;
+	char pad[12];
+};
+
+#define FOOTER_SIZE 0
+#define IsCorrupted(allocator, block) false
+#define WriteGuards(allocator, header) ((void)0)
+#define ZERO_FREED_BYTES(bytes, count) ((void)0)
+
+#endif
+
 void *AllocateFromSlabAllocator(SlabAllocator *allocator, int numBytes)
 {
 	if (numBytes < 0)
@@ -34,7 +64,7 @@ void *AllocateFromSlabAllocator(SlabAllocator *allocator, int numBytes)
 	{
 		uintptr_t unaligned = (uintptr_t)allocator->slab->memory + allocator->slab->cursor;
 		uintptr_t aligned = (unaligned + MASK) & (~MASK);
-		int needed = (int)((aligned - unaligned) + sizeof(Header) + numBytes + sizeof(Footer));
+		int needed = (int)((aligned - unaligned) + sizeof(Header) + numBytes + FOOTER_SIZE);
 		int remaining = allocator->slab->capacity - allocator->slab->cursor;
 		if (needed <= remaining)
 		{
@@ -42,14 +72,16 @@ void *AllocateFromSlabAllocator(SlabAllocator *allocator, int numBytes)
 			// We should be here 99% of the time.
 			allocator->cursor += needed;
 			allocator->slab->cursor += needed;
+			if (allocator->peakCursor < allocator->cursor)
+				allocator->peakCursor = allocator->cursor;
+			if (allocator->slab->prev)
+				++allocator->numOverflows;
 
 			Header *header = (Header *)aligned;
 			void *block = header + 1;
-			Footer *footer = (Footer *)((char *)block + numBytes);
 
 			header->size = numBytes;
-			CopyBytes(header->magic, allocator->magic, sizeof header->magic);
-			CopyBytes(footer->magic, allocator->magic, sizeof footer->magic);
+			WriteGuards(allocator, header);
 			return block;
 		}
 
@@ -58,7 +90,7 @@ void *AllocateFromSlabAllocator(SlabAllocator *allocator, int numBytes)
 		if (not next)
 		{
 			// Slowest path: None of the slabs have enough space so we need to allocate new ones.
-			int worstCase = ALIGNMENT - 1 + sizeof(Header) + numBytes + sizeof(Footer);
+			int worstCase = ALIGNMENT - 1 + sizeof(Header) + numBytes + FOOTER_SIZE;
 			int consecutiveSlabs = (worstCase + SLAB_SIZE_GRANULARITY - 1) / SLAB_SIZE_GRANULARITY;
 
 			next = MemAlloc(sizeof next[0] + consecutiveSlabs * SLAB_SIZE_GRANULARITY);
@@ -68,6 +100,7 @@ void *AllocateFromSlabAllocator(SlabAllocator *allocator, int numBytes)
 			next->prev = allocator->slab;
 			next->next = NULL;
 			allocator->slab->next = next;
+			++allocator->numNewSlabs;
 		}
 
 		allocator->cursor += remaining;
@@ -89,7 +122,7 @@ void *ReallocateFromSlabAllocator(SlabAllocator *allocator, void *block, int num
 	int newSize = numBytes;
 	int oldSize = header->size;
 	int delta = newSize - oldSize;
-	char *end = (char *)block + oldSize + sizeof(Footer);
+	char *end = (char *)block + oldSize + FOOTER_SIZE;
 	char *top = (char *)allocator->slab->memory + allocator->slab->cursor;
 
 	// If this was the last allocated block, we can reuse it, as long as the new block fits in the current slab.
@@ -97,10 +130,11 @@ void *ReallocateFromSlabAllocator(SlabAllocator *allocator, void *block, int num
 	{
 		allocator->slab->cursor += delta;
 		allocator->cursor += delta;
+		if (allocator->peakCursor < allocator->cursor)
+			allocator->peakCursor = allocator->cursor;
 		header->size += delta;
-		Footer *footer = (Footer *)((char *)block + newSize);
-		CopyBytes(footer->magic, allocator->magic, sizeof footer->magic);
-		ZeroBytes(footer + 1, -delta);
+		WriteGuards(allocator, header);
+		ZERO_FREED_BYTES((char *)block + newSize + FOOTER_SIZE, -delta);
 		return block;
 	}
 
@@ -108,9 +142,8 @@ void *ReallocateFromSlabAllocator(SlabAllocator *allocator, void *block, int num
 	if (newSize <= oldSize)
 	{
 		header->size += delta;
-		Footer *footer = (Footer *)((char *)block + newSize);
-		CopyBytes(footer->magic, allocator->magic, sizeof footer->magic);
-		ZeroBytes(footer + 1, -delta);
+		WriteGuards(allocator, header);
+		ZERO_FREED_BYTES((char *)block + newSize + FOOTER_SIZE, -delta);
 		return block;
 	}
 
@@ -129,9 +162,9 @@ void FreeFromSlabAllocator(SlabAllocator *allocator, void *block)
 
 	ASSERT(not IsCorrupted(allocator, block));
 	Header *header = (Header *)block - 1;
-	int size = sizeof(Header) + header->size + sizeof(Footer);
+	int size = sizeof(Header) + header->size + FOOTER_SIZE;
 
-	char *end = (char *)block + header->size + sizeof(Footer);
+	char *end = (char *)block + header->size + FOOTER_SIZE;
 	char *top = (char *)allocator->slab->memory + allocator->slab->cursor;
 	if (end == top)
 	{
@@ -139,7 +172,7 @@ void FreeFromSlabAllocator(SlabAllocator *allocator, void *block)
 		allocator->cursor -= size;
 	}
 
-	ZeroBytes(header, size);
+	ZERO_FREED_BYTES(header, size);
 }
 
 void ResetSlabAllocator(SlabAllocator *allocator, int cursor)
@@ -153,13 +186,13 @@ void ResetSlabAllocator(SlabAllocator *allocator, int cursor)
 		if (remaining <= allocator->slab->cursor)
 		{
 			char *start = (char *)allocator->slab->memory + allocator->slab->cursor - remaining;
-			ZeroBytes(start, remaining);
+			ZERO_FREED_BYTES(start, remaining);
 			allocator->slab->cursor -= remaining;
 			allocator->cursor = cursor;
 			return;
 		}
 
-		ZeroBytes(allocator->slab->memory, allocator->slab->cursor);
+		ZERO_FREED_BYTES(allocator->slab->memory, allocator->slab->cursor);
 		allocator->cursor -= allocator->slab->cursor;
 		allocator->slab->cursor = 0;
 		if (allocator->slab->prev)
@@ -1,6 +1,121 @@
 #include "../core.h"
 
-static List(Sound *) temporarySounds;
+// Temporary sounds play on a fixed pool of voices. The sounds themselves come from the asset manager, so they stream in
+// on the job threads and stay cached after they're released. Every voice keeps its sound acquired for a while after it finishes,
+// so playing the same sound again (footsteps, UI clicks..) doesn't load or allocate anything.
+// Voices with the same sound share it, so the same sound can't play on two voices at once: playing it again restarts it.
+// When all voices are busy, the new sound takes over the voice with the lowest priority, or isn't played if all of them are more important.
+//
+// Music is streamed from the (still compressed) file data instead, so long tracks don't have to be decoded into memory.
+
+#define NUM_VOICES 16
+
+// How long an idle voice holds on to its sound, in case it gets played again.
+#define VOICE_KEEP_TIME 10.0
+
+// A sound that's still streaming in when it's played starts once it's there, unless that would be more than this many seconds late.
+#define VOICE_MAX_DELAY 0.25
+
+STRUCT(Voice)
+{
+	Sound *sound; // NULL if the voice hasn't acquired anything yet.
+	char path[256];
+	int priority;
+	float volume;
+	float pitch;
+	bool isWaiting; // Played while the sound was still streaming in, so it starts in UpdateTemporarySounds.
+	double startTime;
+	double endTime; // When the sound is done playing, assuming the pitch didn't change.
+};
+
+static Voice voices[NUM_VOICES];
+static Music *music;
+
+// False while the sound is still streaming in, or if it failed to load.
+static bool IsVoiceLoaded(const Voice *voice)
+{
+	return voice->sound and voice->sound->frameCount != 0;
+}
+
+static bool IsVoicePlaying(const Voice *voice)
+{
+	if (voice->isWaiting)
+		return true;
+	if (not IsVoiceLoaded(voice))
+		return false;
+	// Most of the time we know from the clock that the sound is done, and don't have to ask the audio thread.
+	if (GetTime() > voice->endTime)
+		return false;
+	return IsSoundPlaying(*voice->sound);
+}
+
+static void UnloadVoice(Voice *voice)
+{
+	if (IsVoiceLoaded(voice))
+		StopSound(*voice->sound);
+	ReleaseAsset(voice->sound);
+	ZeroBytes(voice, sizeof voice[0]);
+}
+
+static void StartVoice(Voice *voice)
+{
+	double duration = (double)voice->sound->frameCount / voice->sound->stream.sampleRate;
+	voice->isWaiting = false;
+	voice->endTime = GetTime() + duration / (voice->pitch > 0.01f ? voice->pitch : 0.01f);
+	SetSoundVolume(*voice->sound, voice->volume);
+	SetSoundPitch(*voice->sound, voice->pitch);
+	PlaySound(*voice->sound);
+}
+
+// Picks the voice that plays the next sound, or returns NULL if the sound isn't important enough to interrupt any of them.
+static Voice *FindVoice(const char *path, int priority)
+{
+	// Best case, a voice already has the sound. Since they share it, this is also the only voice that can play it.
+	for (int i = 0; i < NUM_VOICES; ++i)
+	{
+		Voice *voice = &voices[i];
+		if (not StringsEqual(voice->path, path))
+			continue;
+		if (IsVoicePlaying(voice))
+		{
+			if (voice->priority > priority)
+				return NULL;
+			if (IsVoiceLoaded(voice))
+				StopSound(*voice->sound);
+		}
+		return voice;
+	}
+
+	// Otherwise an empty voice, or the one that's been sitting around the longest.
+	Voice *idle = NULL;
+	for (int i = 0; i < NUM_VOICES; ++i)
+	{
+		Voice *voice = &voices[i];
+		if (IsVoicePlaying(voice))
+			continue;
+		if (not voice->sound)
+			return voice;
+		if (not idle or voice->endTime < idle->endTime)
+			idle = voice;
+	}
+	if (idle)
+		return idle;
+
+	// All busy, so steal the least important voice, and of those the one that's been playing the longest.
+	Voice *victim = &voices[0];
+	for (int i = 1; i < NUM_VOICES; ++i)
+	{
+		Voice *voice = &voices[i];
+		if (voice->priority < victim->priority or (voice->priority == victim->priority and voice->startTime < victim->startTime))
+			victim = voice;
+	}
+	if (victim->priority > priority)
+		return NULL;
+
+	if (IsVoiceLoaded(victim))
+		StopSound(*victim->sound);
+	return victim;
+}
 
 void PlayTemporarySound(const char *path)
 {
@@ -9,32 +124,126 @@ void PlayTemporarySound(const char *path)
 
 void PlayTemporarySoundEx(const char *path, float volume, float pitch)
 {
-	Sound *sound = AcquireSound(path);
-	if (not sound)
+	PlayTemporarySoundWithPriority(path, volume, pitch, 0);
+}
+
+void PlayTemporarySoundWithPriority(const char *path, float volume, float pitch, int priority)
+{
+	if (not path or not path[0])
+		return;
+	if (StringLength(path) >= (int)sizeof voices[0].path)
 	{
-		if (not FileExists(path))
-			LogError("Couldn't play temporary sound '%s' because the file doesn't exist.", path);
-		else
-			LogError("Couldn't play temporary sound '%s'.", path);
+		LogError("Couldn't play temporary sound '%s' because the path is too long.", path);
 		return;
 	}
 
-	SetSoundVolume(*sound, volume);
-	SetSoundPitch(*sound, pitch);
-	PlaySound(*sound);
-	ListAdd(&temporarySounds, sound);
+	Voice *voice = FindVoice(path, priority);
+	if (not voice)
+		return;
+
+	if (not StringsEqual(voice->path, path))
+	{
+		UnloadVoice(voice);
+		voice->sound = AcquireSound(path);
+		if (not voice->sound)
+		{
+			LogError("Couldn't play temporary sound '%s' because the file doesn't exist.", path);
+			return;
+		}
+		CopyString(voice->path, path, sizeof voice->path);
+	}
+
+	voice->priority = priority;
+	voice->volume = volume;
+	voice->pitch = pitch;
+	voice->startTime = GetTime();
+	if (IsAssetStreaming(voice->sound))
+	{
+		voice->isWaiting = true;
+		return;
+	}
+	if (voice->sound->frameCount == 0)
+	{
+		LogError("Couldn't play temporary sound '%s'.", path);
+		UnloadVoice(voice);
+		return;
+	}
+	StartVoice(voice);
 }
 
 void UpdateTemporarySounds(void)
 {
-	for (int i = 0; i < ListCount(temporarySounds); ++i)
+	double now = GetTime();
+	for (int i = 0; i < NUM_VOICES; ++i)
 	{
-		Sound *sound = temporarySounds[i];
-		if (not IsSoundPlaying(*sound))
+		Voice *voice = &voices[i];
+		if (voice->isWaiting)
 		{
-			ReleaseAsset(sound);
-			ListSwapRemove(&temporarySounds, i);
-			--i;
+			if (IsAssetStreaming(voice->sound))
+			{
+				if (now - voice->startTime > VOICE_MAX_DELAY)
+				{
+					// Too late to still make sense, but the sound keeps streaming in for next time.
+					voice->isWaiting = false;
+					voice->endTime = now;
+				}
+			}
+			else if (voice->sound->frameCount == 0)
+			{
+				LogError("Couldn't play temporary sound '%s'.", voice->path);
+				UnloadVoice(voice);
+			}
+			else StartVoice(voice);
 		}
+		else if (voice->sound and now - voice->endTime > VOICE_KEEP_TIME and not (IsVoiceLoaded(voice) and IsSoundPlaying(*voice->sound)))
+			UnloadVoice(voice);
+	}
+
+	if (music)
+		UpdateMusicStream(*music);
+}
+
+void UnloadTemporarySounds(void)
+{
+	for (int i = 0; i < NUM_VOICES; ++i)
+		UnloadVoice(&voices[i]);
+	StopMusic();
+}
+
+void PlayMusic(const char *path, float volume)
+{
+	if (music and StringsEqual(GetAssetPath(music), path))
+	{
+		SetMusicVolume(*music, volume);
+		return;
+	}
+
+	StopMusic();
+	music = AcquireMusic(path);
+	if (not music)
+	{
+		if (not ResourceExists(path))
+			LogError("Couldn't play music '%s' because the file doesn't exist.", path);
+		else
+			LogError("Couldn't play music '%s'.", path);
+		return;
 	}
+
+	SetMusicVolume(*music, volume);
+	PlayMusicStream(*music);
+}
+
+void StopMusic(void)
+{
+	if (not music)
+		return;
+
+	StopMusicStream(*music);
+	ReleaseAsset(music);
+	music = NULL;
+}
+
+bool IsMusicPlaying(void)
+{
+	return music != NULL;
 }
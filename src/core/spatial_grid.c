@@ -0,0 +1,140 @@
+#include "../core.h"
+
+// The world is split into square cells, and every item is added to each cell its bounds touch.
+// The cells are hashed into a fixed number of buckets, so the world doesn't need to have a fixed size.
+// Far away cells can end up in the same bucket, which is fine because we always check the exact bounds anyway.
+
+static int GetBucket(int x, int y)
+{
+	unsigned hash = ((unsigned)x * 73856093u) ^ ((unsigned)y * 19349663u);
+	return (int)(hash & (SPATIAL_GRID_NUM_BUCKETS - 1));
+}
+
+static void GetCellRange(const SpatialGrid *grid, Rectangle bounds, int *x0, int *y0, int *x1, int *y1)
+{
+	*x0 = (int)floorf(bounds.x / grid->cellSize);
+	*y0 = (int)floorf(bounds.y / grid->cellSize);
+	*x1 = (int)floorf((bounds.x + bounds.width) / grid->cellSize);
+	*y1 = (int)floorf((bounds.y + bounds.height) / grid->cellSize);
+}
+
+static void RemoveFromBucket(List(int) *bucket, int id)
+{
+	for (int i = 0; i < ListCount(*bucket); ++i)
+	{
+		if ((*bucket)[i] == id)
+		{
+			ListSwapRemove(bucket, i);
+			return;
+		}
+	}
+}
+
+static void RemoveFromCells(SpatialGrid *grid, int id)
+{
+	SpatialGridItem *item = &grid->items[id];
+	for (int y = item->y0; y <= item->y1; ++y)
+		for (int x = item->x0; x <= item->x1; ++x)
+			RemoveFromBucket(&grid->buckets[GetBucket(x, y)], id);
+}
+
+static bool Overlaps(Rectangle a, Rectangle b)
+{
+	return
+		a.x <= b.x + b.width and b.x <= a.x + a.width and
+		a.y <= b.y + b.height and b.y <= a.y + a.height;
+}
+
+SpatialGrid CreateSpatialGrid(float cellSize)
+{
+	ASSERT(cellSize > 0);
+	SpatialGrid grid = { 0 };
+	grid.cellSize = cellSize;
+	grid.buckets = MemAlloc(SPATIAL_GRID_NUM_BUCKETS * sizeof grid.buckets[0]);
+	return grid;
+}
+
+void DestroySpatialGrid(SpatialGrid *grid)
+{
+	if (grid->buckets)
+		for (int i = 0; i < SPATIAL_GRID_NUM_BUCKETS; ++i)
+			ListDestroy((void **)&grid->buckets[i]);
+	MemFree(grid->buckets);
+	ListDestroy((void **)&grid->items);
+	ZeroBytes(grid, sizeof grid[0]);
+}
+
+void UpdateSpatialGridItem(SpatialGrid *grid, int id, Rectangle bounds)
+{
+	ASSERT(id >= 0);
+	while (ListCount(grid->items) <= id)
+	{
+		SpatialGridItem empty = { 0 };
+		ListAdd(&grid->items, empty);
+	}
+
+	SpatialGridItem *item = &grid->items[id];
+	int x0, y0, x1, y1;
+	GetCellRange(grid, bounds, &x0, &y0, &x1, &y1);
+	item->bounds = bounds;
+
+	// Most of the time things only move a tiny bit, so they stay in the same cells and we're done.
+	if (item->isInGrid and x0 == item->x0 and y0 == item->y0 and x1 == item->x1 and y1 == item->y1)
+		return;
+
+	if (item->isInGrid)
+		RemoveFromCells(grid, id);
+
+	item->isInGrid = true;
+	item->x0 = x0;
+	item->y0 = y0;
+	item->x1 = x1;
+	item->y1 = y1;
+	for (int y = y0; y <= y1; ++y)
+		for (int x = x0; x <= x1; ++x)
+			ListAdd(&grid->buckets[GetBucket(x, y)], id);
+}
+
+void RemoveSpatialGridItem(SpatialGrid *grid, int id)
+{
+	if (id < 0 or id >= ListCount(grid->items) or not grid->items[id].isInGrid)
+		return;
+
+	RemoveFromCells(grid, id);
+	grid->items[id].isInGrid = false;
+}
+
+List(int) QuerySpatialGrid(SpatialGrid *grid, Rectangle area)
+{
+	List(int) result = NULL;
+	ListSetAllocator((void **)&result, TempRealloc, TempFree);
+
+	// Items that span multiple cells would show up multiple times, so we stamp every item we've already seen.
+	++grid->queryStamp;
+
+	int x0, y0, x1, y1;
+	GetCellRange(grid, area, &x0, &y0, &x1, &y1);
+	for (int y = y0; y <= y1; ++y)
+	{
+		for (int x = x0; x <= x1; ++x)
+		{
+			List(int) bucket = grid->buckets[GetBucket(x, y)];
+			for (int i = 0; i < ListCount(bucket); ++i)
+			{
+				SpatialGridItem *item = &grid->items[bucket[i]];
+				if (item->queryStamp == grid->queryStamp)
+					continue;
+				item->queryStamp = grid->queryStamp;
+				if (Overlaps(item->bounds, area))
+					ListAdd(&result, bucket[i]);
+			}
+		}
+	}
+	return result;
+}
+
+List(int) QuerySpatialGridPoint(SpatialGrid *grid, Vector2 point)
+{
+	Rectangle area = { point.x, point.y, 0, 0 };
+	return QuerySpatialGrid(grid, area);
+}
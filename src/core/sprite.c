@@ -1,52 +1,60 @@
 #include "../core.h"
 
-Sprite LoadSprite(const char *path)
+List(Image) LoadSpriteImages(const char *path)
 {
-	Sprite s = { 0 };
-	if (not FileExists(path))
+	List(Image) images = NULL;
+	if (not ResourceExists(path))
 	{
 		LogError("Couldn't load sprite from '%s' because that path doesn't exist.", path);
-		return s;
+		return images;
 	}
 
-	if (IsPathFile(path))
+	if (IsResourceFile(path))
 	{
-		s.numFrames = 1;
-		s.frames = MemAlloc(sizeof s.frames[0]);
-		s.frames[0] = LoadTexture(path);
+		ListAdd(&images, LoadTextureImage(path));
 	}
 	else
 	{
-		FilePathList contents = LoadDirectoryFiles(path);
+		FilePathList contents = LoadResourceDirectoryFiles(path);
 		{
 			if (not contents.count)
-			{
 				LogError("Couldn't load sprite from '%s' because the directory is empty.", path);
-				return s;
-			}
-			else
-			{
-				s.numFrames = (int)contents.count;
-				s.frames = MemAlloc(s.numFrames * sizeof s.frames[0]);
-				for (int i = 0; i < s.numFrames; ++i)
-					s.frames[i] = LoadTexture(contents.paths[i]);
-			}
+			for (unsigned i = 0; i < contents.count; ++i)
+				ListAdd(&images, LoadTextureImage(contents.paths[i]));
 		}
 		UnloadDirectoryFiles(contents);
 	}
 
+	return images;
+}
+
+Sprite LoadSpriteFromImages(const Image images[], int numImages)
+{
+	Sprite s = { 0 };
+	if (numImages <= 0)
+		return s;
+
+	s.numFrames = numImages;
+	s.frames = MemAlloc(s.numFrames * sizeof s.frames[0]);
 	for (int i = 0; i < s.numFrames; ++i)
-	{
-		SetTextureWrap(s.frames[i], TEXTURE_WRAP_CLAMP);
-		SetTextureFilter(s.frames[i], TEXTURE_FILTER_BILINEAR);
-	}
+		s.frames[i] = AddImageToAtlas(images[i]);
+
+	return s;
+}
 
+Sprite LoadSprite(const char *path)
+{
+	List(Image) images = LoadSpriteImages(path);
+	Sprite s = LoadSpriteFromImages(images, ListCount(images));
+	for (int i = 0; i < ListCount(images); ++i)
+		UnloadImage(images[i]);
+	ListDestroy((void **)&images);
 	return s;
 }
 
 void UnloadSprite(Sprite sprite)
 {
 	for (int i = 0; i < sprite.numFrames; ++i)
-		UnloadTexture(sprite.frames[i]);
+		RemoveFromAtlas(sprite.frames[i]);
 	MemFree(sprite.frames);
 }
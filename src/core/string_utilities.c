@@ -113,6 +113,7 @@ List(char *) SplitByWhitespace(const char *string)
 
 	List(char *) results = NULL;
 	ListSetAllocator((void **)&results, TempRealloc, TempFree);
+	ListSetMinCapacity((void **)&results, 8);
 
 	for (;;)
 	{
@@ -140,6 +141,7 @@ List(char*) SplitByChar(const char* string, const char* spacer)
 
 	List(char*) results = NULL;
 	ListSetAllocator((void**)&results, TempRealloc, TempFree);
+	ListSetMinCapacity((void**)&results, 8);
 
 	for (;;)
 	{
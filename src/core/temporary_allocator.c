@@ -1,31 +1,38 @@
 #include "../core.h"
 #include <stdio.h>
 
-static char firstSlabMemory[MEGABYTES(1)];
+// Every thread gets its own slab allocator, which lazily allocates its first slab the first time the thread needs temporary memory.
+// If GetTempStorageStats says the first slab overflows all the time, this is what you want to increase.
+#define FIRST_SLAB_SIZE MEGABYTES(1)
 
-static Slab firstSlab = {
-	.memory = firstSlabMemory,
-	.capacity = sizeof firstSlabMemory,
-};
+static THREAD_LOCAL SlabAllocator allocator;
 
-static SlabAllocator allocator = {
-	.magic = { 'T', 'E', 'M', 'P' },
-	.slab = &firstSlab
-};
+static SlabAllocator *GetAllocator(void)
+{
+	if (not allocator.slab)
+	{
+		Slab *slab = MemAlloc(sizeof slab[0] + FIRST_SLAB_SIZE);
+		slab->memory = slab + 1;
+		slab->capacity = FIRST_SLAB_SIZE;
+		CopyBytes(allocator.magic, "TEMP", sizeof allocator.magic);
+		allocator.slab = slab;
+	}
+	return &allocator;
+}
 
 void *TempAlloc(int numBytes)
 {
-	return AllocateFromSlabAllocator(&allocator, numBytes);
+	return AllocateFromSlabAllocator(GetAllocator(), numBytes);
 }
 
 void *TempRealloc(void *block, int numBytes)
 {
-	return ReallocateFromSlabAllocator(&allocator, block, numBytes);
+	return ReallocateFromSlabAllocator(GetAllocator(), block, numBytes);
 }
 
 void TempFree(void *block)
 {
-	FreeFromSlabAllocator(&allocator, block);
+	FreeFromSlabAllocator(GetAllocator(), block);
 }
 
 int TempMark(void)
@@ -35,7 +42,33 @@ int TempMark(void)
 
 void TempReset(int mark)
 {
-	ResetSlabAllocator(&allocator, mark);
+	ResetSlabAllocator(GetAllocator(), mark);
+}
+
+void DestroyTempStorage(void)
+{
+	if (not allocator.slab)
+		return;
+
+	Slab *slab = allocator.slab;
+	while (slab->prev)
+		slab = slab->prev;
+	while (slab)
+	{
+		Slab *next = slab->next;
+		MemFree(slab);
+		slab = next;
+	}
+	ZeroBytes(&allocator, sizeof allocator);
+}
+
+TempStorageStats GetTempStorageStats(void)
+{
+	TempStorageStats stats = { 0 };
+	stats.peakBytes = allocator.peakCursor;
+	stats.numSlabs = allocator.slab ? 1 + allocator.numNewSlabs : 0;
+	stats.numOverflows = allocator.numOverflows;
+	return stats;
 }
 
 void *TempCopy(const void *bytes, int numBytes)
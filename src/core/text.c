@@ -1,19 +1,567 @@
 #include "../core.h"
 
-Font LoadFontAscii(const char *path, int fontSize)
+#define STB_TRUETYPE_IMPLEMENTATION
+#define STBTT_STATIC
+#define STBTT_malloc(size, userData) ((void)(userData), MemAlloc((int)(size)))
+#define STBTT_free(pointer, userData) ((void)(userData), MemFree(pointer))
+#include "../lib/imgui/imstb_truetype.h"
+
+// Glyphs are rasterized the first time they're drawn, into a couple of glyph pages that all fonts share.
+// That way localized text can use any codepoint the font has, and we only pay for the glyphs we actually draw.
+//
+// SDF fonts store every glyph once as a signed distance field, and the same glyph is drawn sharp at any font size.
+// Bitmap fonts store a separate copy of every glyph for every font size, but small text looks a bit crisper.
+//
+// The pages are shelf packed. When all of them are full, the page that was used the longest ago is thrown out
+// whole, and its glyphs get rasterized again the next time they're drawn.
+
+#define MAX_FONT_FACES 16
+
+#define GLYPH_PAGE_SIZE 1024
+#define MAX_GLYPH_PAGES 4
+
+#define MAX_CACHED_GLYPHS 4096
+#define GLYPH_TABLE_SIZE (2 * MAX_CACHED_GLYPHS) // Has to be a power of 2.
+
+// The font size that SDF glyphs are rasterized at, and how far the distance field reaches past the outline, in pixels.
+#define SDF_GLYPH_SIZE 48
+#define SDF_PADDING 6
+
+// Bitmap glyphs bigger than this get scaled up from this size, so that a single glyph can't take up a whole page.
+#define MAX_BITMAP_GLYPH_SIZE 256
+
+STRUCT(FontFaceData)
+{
+	stbtt_fontinfo info;
+	unsigned char *fileData; // NULL if nothing is loaded into this face.
+	bool isSdf;
+	int ascent; // In font units.
+	int fallbackGlyph; // Drawn for codepoints the font doesn't have.
+	float pixelsPerUnit; // For a font size of 1.
+	float asciiAdvances[128]; // In font units, so that measuring ASCII text doesn't have to look through the font.
+};
+
+STRUCT(CachedGlyph)
+{
+	uint64_t key; // Font face, raster size and codepoint.
+	int page; // -1 for glyphs that don't draw anything, like spaces.
+	Rectangle source; // In pixels, inside of the page.
+	float offsetX; // From the pen position to the left of the source, in pixels at the raster size.
+	float offsetY; // From the top of the line to the top of the source, in pixels at the raster size.
+	float rasterSize; // The font size the glyph was rasterized at.
+};
+
+STRUCT(GlyphPage)
+{
+	Texture texture; // Zero until the page is needed for the first time.
+	int shelfX;
+	int shelfY;
+	int shelfHeight;
+	unsigned lastUsedRun;
+};
+
+// Where one glyph of a run goes, already resolved so that drawing it twice (shadow and text) doesn't look anything up.
+STRUCT(PlacedGlyph)
+{
+	int page;
+	Rectangle source;
+	Rectangle quad;
+};
+
+static FontFaceData faces[MAX_FONT_FACES]; // Face 0 is never used, so that a zeroed FontFace means no font.
+static GlyphPage pages[MAX_GLYPH_PAGES];
+static CachedGlyph glyphs[MAX_CACHED_GLYPHS];
+static int numGlyphs;
+static int glyphTable[GLYPH_TABLE_SIZE]; // Index into glyphs + 1, so 0 means the entry is empty.
+static unsigned runCounter; // Goes up with every glyph run, so we know which pages are used by the run we're drawing.
+static Shader sdfShader;
+
+// The distance field is 0.5 right on the outline. The edge is smoothed over about a pixel on screen, whatever the font size.
+static const char *sdfFragmentShader = GLSL_FRAGMENT_HEADER
+	"IN vec2 fragTexCoord;\n"
+	"IN vec4 fragColor;\n"
+	"uniform sampler2D texture0;\n"
+	"uniform vec4 colDiffuse;\n"
+	"void main()\n"
+	"{\n"
+	"	float distance = TEXTURE(texture0, fragTexCoord).a;\n"
+	"	float smoothing = 0.7 * fwidth(distance);\n"
+	"	float alpha = smoothstep(0.5 - smoothing, 0.5 + smoothing, distance);\n"
+	"	OUT_COLOR = vec4(fragColor.rgb, fragColor.a * alpha) * colDiffuse;\n"
+	"}\n";
+
+static FontFaceData *GetFace(FontFace font)
+{
+	if (font.id <= 0 or font.id >= MAX_FONT_FACES or not faces[font.id].fileData)
+		return NULL;
+	return &faces[font.id];
+}
+
+static int FindGlyph(const FontFaceData *face, int codepoint)
+{
+	int glyph = stbtt_FindGlyphIndex(&face->info, codepoint);
+	return glyph ? glyph : face->fallbackGlyph;
+}
+
+static float GetGlyphAdvanceUnits(const FontFaceData *face, int glyph)
+{
+	int advance, leftSideBearing;
+	stbtt_GetGlyphHMetrics(&face->info, glyph, &advance, &leftSideBearing);
+	return (float)advance;
+}
+
+static unsigned HashGlyphKey(uint64_t key)
+{
+	key ^= key >> 33;
+	key *= 0xff51afd7ed558ccdull;
+	key ^= key >> 33;
+	return (unsigned)key;
+}
+
+static CachedGlyph *FindCachedGlyph(uint64_t key)
+{
+	for (unsigned i = HashGlyphKey(key) & (GLYPH_TABLE_SIZE - 1);; i = (i + 1) & (GLYPH_TABLE_SIZE - 1))
+	{
+		int index = glyphTable[i];
+		if (index == 0)
+			return NULL;
+		if (glyphs[index - 1].key == key)
+			return &glyphs[index - 1];
+	}
+}
+
+static void AddToGlyphTable(int glyphIndex)
+{
+	// The table is twice as big as the number of glyphs, so there's always an empty entry.
+	unsigned i = HashGlyphKey(glyphs[glyphIndex].key) & (GLYPH_TABLE_SIZE - 1);
+	while (glyphTable[i] != 0)
+		i = (i + 1) & (GLYPH_TABLE_SIZE - 1);
+	glyphTable[i] = glyphIndex + 1;
+}
+
+// Throws out all glyphs in the page (if page >= 0) and all glyphs of the font face (if faceId > 0).
+// This moves the remaining glyphs around, so the table is rebuilt from scratch. Evicting is rare enough that that's fine.
+static void RemoveCachedGlyphs(int page, int faceId)
+{
+	int numKept = 0;
+	for (int i = 0; i < numGlyphs; ++i)
+	{
+		bool isRemoved = (page >= 0 and glyphs[i].page == page) or (faceId > 0 and (int)(glyphs[i].key >> 56) == faceId);
+		if (not isRemoved)
+			glyphs[numKept++] = glyphs[i];
+	}
+	numGlyphs = numKept;
+
+	ZeroBytes(glyphTable, sizeof glyphTable);
+	for (int i = 0; i < numGlyphs; ++i)
+		AddToGlyphTable(i);
+}
+
+static void EvictGlyphPage(int page)
+{
+	// Glyphs from this page could still be waiting in the batch, and they have to be drawn before we draw over them.
+	rlDrawRenderBatchActive();
+	RemoveCachedGlyphs(page, 0);
+	pages[page].shelfX = 0;
+	pages[page].shelfY = 0;
+	pages[page].shelfHeight = 0;
+}
+
+// Returns the page that was used the longest ago, but never one the current run already uses, or -1 if there isn't one.
+static int FindEvictablePage(void)
+{
+	int result = -1;
+	for (int i = 0; i < MAX_GLYPH_PAGES; ++i)
+	{
+		if (pages[i].lastUsedRun == runCounter)
+			continue;
+		if (result < 0 or pages[i].lastUsedRun < pages[result].lastUsedRun)
+			result = i;
+	}
+	return result;
+}
+
+static bool PackIntoPage(GlyphPage *page, int width, int height, Rectangle *outRect)
+{
+	if (page->shelfX + width > GLYPH_PAGE_SIZE)
+	{
+		page->shelfX = 0;
+		page->shelfY += page->shelfHeight;
+		page->shelfHeight = 0;
+	}
+	if (page->shelfY + height > GLYPH_PAGE_SIZE)
+		return false;
+
+	*outRect = (Rectangle) { (float)page->shelfX, (float)page->shelfY, (float)width, (float)height };
+	page->shelfX += width;
+	if (page->shelfHeight < height)
+		page->shelfHeight = height;
+	return true;
+}
+
+// Finds room for a rectangle in one of the pages, and evicts a page if they're all full. Returns the page, or -1 if there's no room.
+static int AllocateGlyphRect(int width, int height, Rectangle *outRect)
+{
+	if (width > GLYPH_PAGE_SIZE or height > GLYPH_PAGE_SIZE)
+		return -1;
+
+	for (int i = 0; i < MAX_GLYPH_PAGES; ++i)
+	{
+		GlyphPage *page = &pages[i];
+		if (not page->texture.id)
+		{
+			page->texture.id = rlLoadTexture(NULL, GLYPH_PAGE_SIZE, GLYPH_PAGE_SIZE, PIXELFORMAT_UNCOMPRESSED_GRAY_ALPHA, 1);
+			page->texture.width = GLYPH_PAGE_SIZE;
+			page->texture.height = GLYPH_PAGE_SIZE;
+			page->texture.mipmaps = 1;
+			page->texture.format = PIXELFORMAT_UNCOMPRESSED_GRAY_ALPHA;
+			SetTextureWrap(page->texture, TEXTURE_WRAP_CLAMP);
+			SetTextureFilter(page->texture, TEXTURE_FILTER_BILINEAR);
+		}
+		if (PackIntoPage(page, width, height, outRect))
+			return i;
+	}
+
+	int evicted = FindEvictablePage();
+	if (evicted < 0)
+		return -1;
+	EvictGlyphPage(evicted);
+	PackIntoPage(&pages[evicted], width, height, outRect);
+	return evicted;
+}
+
+// Returns the glyph from the cache, rasterizing it first if it isn't there. Returns NULL if there's no room for it.
+// The pointer is only good until the next call, since rasterizing can evict glyphs and move the rest around.
+static CachedGlyph *GetCachedGlyph(FontFace font, int codepoint, float fontSize)
+{
+	FontFaceData *face = &faces[font.id];
+	int sizeKey = face->isSdf ? 0 : ClampInt((int)(fontSize + 0.5f), 1, MAX_BITMAP_GLYPH_SIZE);
+	uint64_t key = ((uint64_t)font.id << 56) | ((uint64_t)sizeKey << 32) | (uint32_t)codepoint;
+
+	CachedGlyph *cached = FindCachedGlyph(key);
+	if (cached)
+	{
+		if (cached->page >= 0)
+			pages[cached->page].lastUsedRun = runCounter;
+		return cached;
+	}
+
+	if (numGlyphs == MAX_CACHED_GLYPHS)
+	{
+		int evicted = FindEvictablePage();
+		if (evicted < 0)
+			return NULL;
+		EvictGlyphPage(evicted);
+		if (numGlyphs == MAX_CACHED_GLYPHS)
+			return NULL;
+	}
+
+	float rasterSize = face->isSdf ? SDF_GLYPH_SIZE : (float)sizeKey;
+	float scale = face->pixelsPerUnit * rasterSize;
+	int glyph = FindGlyph(face, codepoint);
+	int width = 0;
+	int height = 0;
+	int offsetX = 0;
+	int offsetY = 0;
+	unsigned char *pixels;
+	if (face->isSdf)
+		pixels = stbtt_GetGlyphSDF(&face->info, scale, glyph, SDF_PADDING, 128, 128.0f / SDF_PADDING, &width, &height, &offsetX, &offsetY);
+	else
+		pixels = stbtt_GetGlyphBitmap(&face->info, 0, scale, glyph, &width, &height, &offsetX, &offsetY);
+
+	CachedGlyph result = { 0 };
+	result.key = key;
+	result.page = -1;
+	result.offsetX = (float)offsetX;
+	result.offsetY = (float)offsetY + face->ascent * scale;
+	result.rasterSize = rasterSize;
+	if (pixels and width > 0 and height > 0)
+	{
+		// Every glyph gets a transparent border, so that bilinear filtering doesn't pick up the glyph that was there before.
+		Rectangle rect;
+		int page = AllocateGlyphRect(width + 2, height + 2, &rect);
+		if (page < 0)
+		{
+			if (face->isSdf)
+				stbtt_FreeSDF(pixels, NULL);
+			else
+				stbtt_FreeBitmap(pixels, NULL);
+			return NULL;
+		}
+
+		int mark = TempMark();
+		{
+			int paddedWidth = width + 2;
+			unsigned char *padded = TempAlloc(2 * paddedWidth * (height + 2));
+			ZeroBytes(padded, 2 * paddedWidth * (height + 2));
+			for (int y = 0; y < height; ++y)
+			{
+				unsigned char *row = padded + 2 * ((y + 1) * paddedWidth + 1);
+				for (int x = 0; x < width; ++x)
+				{
+					row[2 * x + 0] = 255;
+					row[2 * x + 1] = pixels[y * width + x];
+				}
+			}
+			UpdateTextureRec(pages[page].texture, rect, padded);
+		}
+		TempReset(mark);
+
+		result.page = page;
+		result.source = (Rectangle) { rect.x + 1, rect.y + 1, (float)width, (float)height };
+		pages[page].lastUsedRun = runCounter;
+	}
+	if (face->isSdf)
+		stbtt_FreeSDF(pixels, NULL);
+	else
+		stbtt_FreeBitmap(pixels, NULL);
+
+	glyphs[numGlyphs] = result;
+	AddToGlyphTable(numGlyphs);
+	return &glyphs[numGlyphs++];
+}
+
+FontFace LoadFontFace(const char *path, bool isSdf)
+{
+	FontFace result = { 0 };
+
+	int id = 1;
+	while (id < MAX_FONT_FACES and faces[id].fileData)
+		++id;
+	if (id == MAX_FONT_FACES)
+	{
+		LogError("Couldn't load font '%s' because there are already %d fonts loaded.", path, MAX_FONT_FACES - 1);
+		return result;
+	}
+
+	unsigned fileSize = 0;
+	unsigned char *fileData = LoadFileData(path, &fileSize);
+	if (not fileData)
+	{
+		LogError("Couldn't load font '%s'.", path);
+		return result;
+	}
+
+	FontFaceData *face = &faces[id];
+	if (not stbtt_InitFont(&face->info, fileData, stbtt_GetFontOffsetForIndex(fileData, 0)))
+	{
+		LogError("Couldn't load font '%s' because it isn't a valid font file.", path);
+		UnloadFileData(fileData);
+		ZeroBytes(face, sizeof face[0]);
+		return result;
+	}
+
+	int descent, lineGap;
+	stbtt_GetFontVMetrics(&face->info, &face->ascent, &descent, &lineGap);
+	face->fileData = fileData;
+	face->isSdf = isSdf;
+	face->pixelsPerUnit = stbtt_ScaleForPixelHeight(&face->info, 1);
+	face->fallbackGlyph = stbtt_FindGlyphIndex(&face->info, '?');
+	for (int c = 0; c < COUNTOF(face->asciiAdvances); ++c)
+		face->asciiAdvances[c] = GetGlyphAdvanceUnits(face, FindGlyph(face, c));
+
+	result.id = id;
+	return result;
+}
+
+void UnloadFontFace(FontFace *font)
+{
+	FontFaceData *face = GetFace(*font);
+	if (face)
+	{
+		// The glyphs could still be waiting in the batch, and the file data has to outlive them.
+		rlDrawRenderBatchActive();
+		RemoveCachedGlyphs(-1, font->id);
+		UnloadFileData(face->fileData);
+		ZeroBytes(face, sizeof face[0]);
+	}
+	font->id = 0;
+}
+
+int GetNumGlyphPages(void)
+{
+	int result = 0;
+	for (int i = 0; i < MAX_GLYPH_PAGES; ++i)
+		result += pages[i].texture.id != 0;
+	return result;
+}
+
+float GetLineHeight(FontFace font, float fontSize)
 {
-	int ascii[128];
-	for (int i = 0; i < COUNTOF(ascii); ++i)
-		ascii[i] = i;
-	return LoadFontEx(path, fontSize, ascii, COUNTOF(ascii));
+	(void)font;
+	return fontSize;
 }
 
-float GetLineHeight(Font font, float fontSize)
+// Same line spacing that raylib uses for DrawText.
+static float GetNewlineAdvance(float fontSize)
 {
-	return font.baseSize * (fontSize / font.baseSize);
+	return 1.5f * fontSize;
+}
+
+float GetGlyphAdvance(FontFace font, float fontSize, int codepoint)
+{
+	FontFaceData *face = GetFace(font);
+	if (not face)
+		return 0;
+
+	float advance;
+	if (codepoint >= 0 and codepoint < COUNTOF(face->asciiAdvances))
+		advance = face->asciiAdvances[codepoint];
+	else
+		advance = GetGlyphAdvanceUnits(face, FindGlyph(face, codepoint));
+	return advance * face->pixelsPerUnit * fontSize;
+}
+
+static void EmitGlyphQuads(const PlacedGlyph placed[], int numPlaced, unsigned usedPages, Vector2 offset, Color color)
+{
+	// Every page is its own texture, so the glyphs are drawn page by page. Usually that's still just one draw call.
+	for (int page = 0; page < MAX_GLYPH_PAGES; ++page)
+	{
+		if (not (usedPages & (1u << page)))
+			continue;
+
+		rlSetTexture(pages[page].texture.id);
+
+		// The batch can only hold so many vertices, so we make sure there's enough space every couple of glyphs.
+		enum { GLYPHS_PER_CHUNK = 256 };
+		for (int chunk = 0; chunk < numPlaced; chunk += GLYPHS_PER_CHUNK)
+		{
+			int chunkEnd = chunk + GLYPHS_PER_CHUNK < numPlaced ? chunk + GLYPHS_PER_CHUNK : numPlaced;
+			rlCheckRenderBatchLimit(4 * (chunkEnd - chunk));
+			rlBegin(RL_QUADS);
+			rlColor4ub(color.r, color.g, color.b, color.a);
+			rlNormal3f(0, 0, 1);
+			for (int i = chunk; i < chunkEnd; ++i)
+			{
+				if (placed[i].page != page)
+					continue;
+
+				Rectangle source = placed[i].source;
+				Rectangle quad = placed[i].quad;
+				float x0 = quad.x + offset.x;
+				float y0 = quad.y + offset.y;
+				float x1 = x0 + quad.width;
+				float y1 = y0 + quad.height;
+				float u0 = source.x / GLYPH_PAGE_SIZE;
+				float v0 = source.y / GLYPH_PAGE_SIZE;
+				float u1 = (source.x + source.width) / GLYPH_PAGE_SIZE;
+				float v1 = (source.y + source.height) / GLYPH_PAGE_SIZE;
+
+				rlTexCoord2f(u0, v0); rlVertex2f(x0, y0);
+				rlTexCoord2f(u0, v1); rlVertex2f(x0, y1);
+				rlTexCoord2f(u1, v1); rlVertex2f(x1, y1);
+				rlTexCoord2f(u1, v0); rlVertex2f(x1, y0);
+			}
+			rlEnd();
+		}
+	}
+	rlSetTexture(0);
+}
+
+void DrawGlyphRun(TextStyle style, const int codepoints[], const Vector2 offsets[], int numGlyphs, Vector2 position)
+{
+	FontFaceData *face = GetFace(style.font);
+	if (numGlyphs <= 0 or not face)
+		return;
+
+	++runCounter;
+	int mark = TempMark();
+	{
+		// All of the glyphs are looked up before any of them are drawn, since rasterizing a glyph can flush the batch.
+		PlacedGlyph *placed = TempAlloc(numGlyphs * (int)sizeof placed[0]);
+		int numPlaced = 0;
+		unsigned usedPages = 0;
+		float x = 0;
+		float y = 0;
+		for (int i = 0; i < numGlyphs; ++i)
+		{
+			int codepoint = codepoints[i];
+			if (offsets)
+			{
+				x = offsets[i].x;
+				y = offsets[i].y;
+			}
+			else if (codepoint == '\n')
+			{
+				x = 0;
+				y += GetNewlineAdvance(style.fontSize);
+				continue;
+			}
+
+			if (codepoint != ' ' and codepoint != '\t' and codepoint != '\n')
+			{
+				CachedGlyph *glyph = GetCachedGlyph(style.font, codepoint, style.fontSize);
+				if (glyph and glyph->page >= 0)
+				{
+					float scale = style.fontSize / glyph->rasterSize;
+					PlacedGlyph *p = &placed[numPlaced++];
+					p->page = glyph->page;
+					p->source = glyph->source;
+					p->quad.x = position.x + x + glyph->offsetX * scale;
+					p->quad.y = position.y + y + glyph->offsetY * scale;
+					p->quad.width = glyph->source.width * scale;
+					p->quad.height = glyph->source.height * scale;
+					usedPages |= 1u << glyph->page;
+				}
+			}
+
+			if (not offsets)
+				x += GetGlyphAdvance(style.font, style.fontSize, codepoint);
+		}
+
+		// Everything goes into the same batch with the same texture, so this usually ends up being a single draw call.
+		if (face->isSdf)
+		{
+			if (not sdfShader.id)
+				sdfShader = LoadShaderFromMemory(NULL, sdfFragmentShader);
+			BeginShaderMode(sdfShader);
+		}
+		{
+			if (style.shadowColor.a > 0)
+				EmitGlyphQuads(placed, numPlaced, usedPages, style.shadowOffset, style.shadowColor);
+			EmitGlyphQuads(placed, numPlaced, usedPages, (Vector2) { 0, 0 }, style.color);
+		}
+		if (face->isSdf)
+			EndShaderMode();
+	}
+	TempReset(mark);
+}
+
+static List(int) TempDecodeCodepoints(const char *string)
+{
+	List(int) codepoints = NULL;
+	ListSetAllocator((void **)&codepoints, TempRealloc, TempFree);
+	for (int i = 0; string[i];)
+	{
+		int advance;
+		int codepoint = GetCodepoint(string + i, &advance);
+		ListAdd(&codepoints, codepoint);
+		i += advance;
+	}
+	return codepoints;
+}
+
+// Same as raylib's MeasureTextEx, but with our font metrics.
+static Vector2 MeasureCodepoints(FontFace font, float fontSize, const int codepoints[], int numCodepoints)
+{
+	Vector2 size = { 0, fontSize };
+	float lineWidth = 0;
+	for (int i = 0; i < numCodepoints; ++i)
+	{
+		if (codepoints[i] == '\n')
+		{
+			lineWidth = 0;
+			size.y += GetNewlineAdvance(fontSize);
+			continue;
+		}
+		lineWidth += GetGlyphAdvance(font, fontSize, codepoints[i]);
+		if (size.x < lineWidth)
+			size.x = lineWidth;
+	}
+	return size;
 }
 
-void DrawFormat(Font font, float x, float y, float fontSize, Color color, FORMAT_STRING format, ...)
+void DrawFormat(FontFace font, float x, float y, float fontSize, Color color, FORMAT_STRING format, ...)
 {
 	va_list args;
 	va_start(args, format);
@@ -21,19 +569,20 @@ void DrawFormat(Font font, float x, float y, float fontSize, Color color, FORMAT
 	va_end(args);
 }
 
-void DrawFormatVa(Font font, float x, float y, float fontSize, Color color, FORMAT_STRING format, va_list args)
+void DrawFormatVa(FontFace font, float x, float y, float fontSize, Color color, FORMAT_STRING format, va_list args)
 {
 	int mark = TempMark();
 	{
 		char *string = TempFormatVa(format, args);
+		List(int) codepoints = TempDecodeCodepoints(string);
+		TextStyle style = { font, fontSize, color };
 		Vector2 pos = { x, y };
-		Vector2 origin = { 0 };
-		DrawTextPro(font, string, pos, origin, 0, fontSize, 0, color);
+		DrawGlyphRun(style, codepoints, NULL, ListCount(codepoints), pos);
 	}
 	TempReset(mark);
 }
 
-void DrawFormatCentered(Font font, float x, float y, float fontSize, Color color, FORMAT_STRING format, ...)
+void DrawFormatCentered(FontFace font, float x, float y, float fontSize, Color color, FORMAT_STRING format, ...)
 {
 	va_list args;
 	va_start(args, format);
@@ -41,15 +590,16 @@ void DrawFormatCentered(Font font, float x, float y, float fontSize, Color color
 	va_end(args);
 }
 
-void DrawFormatCenteredVa(Font font, float x, float y, float fontSize, Color color, FORMAT_STRING format, va_list args)
+void DrawFormatCenteredVa(FontFace font, float x, float y, float fontSize, Color color, FORMAT_STRING format, va_list args)
 {
 	int mark = TempMark();
 	{
 		char *string = TempFormatVa(format, args);
-		Vector2 size = MeasureTextEx(font, string, fontSize, 0);
+		List(int) codepoints = TempDecodeCodepoints(string);
+		Vector2 size = MeasureCodepoints(font, fontSize, codepoints, ListCount(codepoints));
 		Vector2 pos = { x - size.x / 2, y - size.y / 2 };
-		Vector2 origin = { 0 };
-		DrawTextPro(font, string, pos, origin, 0, fontSize, 0, color);
+		TextStyle style = { font, fontSize, color };
+		DrawGlyphRun(style, codepoints, NULL, ListCount(codepoints), pos);
 	}
 	TempReset(mark);
 }
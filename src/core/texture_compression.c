@@ -0,0 +1,514 @@
+#include "../core.h"
+#include <stdlib.h>
+#include <string.h>
+
+// Big images like the room backgrounds take up a lot of VRAM as plain RGBA, and decoding their PNGs is most of
+// the time it takes to load a scene. So when baking the resource packs we also compress them into BC1 (opaque)
+// or BC3 (with alpha) blocks, which the GPU can sample directly. Those get saved in a DDS file next to the image,
+// and loading just reads the blocks and hands them to the GPU without decoding anything.
+//
+// BC1 is an eighth and BC3 a quarter of the size of RGBA. Every desktop GPU and desktop browser supports them.
+// If the GPU doesn't, or the DDS file is older than the image because someone edited it, we load the image like before.
+
+// Smaller images go into the shared atlas pages, where compressing them wouldn't buy us much.
+#define COMPRESSED_TEXTURE_MIN_PIXELS (1024 * 1024)
+
+// The largest texture size we ever expect, just so a broken file can't make us allocate something crazy.
+#define COMPRESSED_TEXTURE_MAX_SIZE 16384
+
+#define DDS_MAGIC "DDS "
+#define DDSD_CAPS        0x1
+#define DDSD_HEIGHT      0x2
+#define DDSD_WIDTH       0x4
+#define DDSD_PIXELFORMAT 0x1000
+#define DDSD_LINEARSIZE  0x80000
+#define DDPF_FOURCC      0x4
+#define DDSCAPS_TEXTURE  0x1000
+
+STRUCT(DdsPixelFormat)
+{
+	uint32_t size;
+	uint32_t flags;
+	char fourCC[4];
+	uint32_t rgbBitCount;
+	uint32_t rBitMask;
+	uint32_t gBitMask;
+	uint32_t bBitMask;
+	uint32_t aBitMask;
+};
+
+STRUCT(DdsHeader)
+{
+	char magic[4];
+	uint32_t size;
+	uint32_t flags;
+	uint32_t height;
+	uint32_t width;
+	uint32_t pitchOrLinearSize;
+	uint32_t depth;
+	uint32_t mipMapCount;
+	uint32_t reserved1[11];
+	DdsPixelFormat pixelFormat;
+	uint32_t caps;
+	uint32_t caps2;
+	uint32_t caps3;
+	uint32_t caps4;
+	uint32_t reserved2;
+};
+
+STRUCT(BlockRows)
+{
+	const Color *pixels;
+	int width;
+	int height;
+	bool hasAlpha;
+	unsigned char *blocks;
+};
+
+static const char *GetCompressedTexturePath(const char *path)
+{
+	return TempFormat("%s.dds", path);
+}
+
+static bool IsFormatCompressed(int format)
+{
+	return format >= PIXELFORMAT_COMPRESSED_DXT1_RGB;
+}
+
+static int GetBlockSize(int format)
+{
+	return format == PIXELFORMAT_COMPRESSED_DXT1_RGB ? 8 : 16;
+}
+
+static int GetCompressedDataSize(int width, int height, int format)
+{
+	return ((width + 3) / 4) * ((height + 3) / 4) * GetBlockSize(format);
+}
+
+// Reading the supported formats only touches flags that rlgl set up when the window opened, so any thread can ask.
+static bool IsCompressedFormatSupported(int format)
+{
+	unsigned glInternalFormat, glFormat, glType;
+	rlGetGlTextureFormats(format, &glInternalFormat, &glFormat, &glType);
+	return glInternalFormat != 0;
+}
+
+// Loose files can be edited, so a compressed texture that's older than its image is out of date. Packed ones never change.
+static bool IsCompressedTextureUpToDate(const char *path, const char *compressedPath)
+{
+	if (not ResourceExists(compressedPath))
+		return false;
+	if (FileExists(path) and FileExists(compressedPath))
+		return GetFileModTime(compressedPath) >= GetFileModTime(path);
+	return true;
+}
+
+static uint16_t PackColor565(Vector3 color)
+{
+	int r = ClampInt((int)(color.x * 31 / 255 + 0.5f), 0, 31);
+	int g = ClampInt((int)(color.y * 63 / 255 + 0.5f), 0, 63);
+	int b = ClampInt((int)(color.z * 31 / 255 + 0.5f), 0, 31);
+	return (uint16_t)((r << 11) | (g << 5) | b);
+}
+
+static Vector3 UnpackColor565(uint16_t color)
+{
+	int r = (color >> 11) & 31;
+	int g = (color >> 5) & 63;
+	int b = color & 31;
+	return (Vector3){ (float)((r << 3) | (r >> 2)), (float)((g << 2) | (g >> 4)), (float)((b << 3) | (b >> 2)) };
+}
+
+static float ColorDistanceSquared(Vector3 a, Vector3 b)
+{
+	Vector3 d = Vector3Subtract(a, b);
+	return Vector3DotProduct(d, d);
+}
+
+// Picks the closest of the 4 palette colors for each pixel, and returns the total squared error.
+static float FindColorIndices(const Vector3 pixels[16], uint16_t color0, uint16_t color1, uint32_t *outIndices)
+{
+	Vector3 palette[4];
+	palette[0] = UnpackColor565(color0);
+	palette[1] = UnpackColor565(color1);
+	palette[2] = Vector3Lerp(palette[0], palette[1], 1.0f / 3);
+	palette[3] = Vector3Lerp(palette[0], palette[1], 2.0f / 3);
+
+	float error = 0;
+	uint32_t indices = 0;
+	for (int i = 0; i < 16; ++i)
+	{
+		int best = 0;
+		float bestDistance = FLT_MAX;
+		for (int j = 0; j < 4; ++j)
+		{
+			float distance = ColorDistanceSquared(pixels[i], palette[j]);
+			if (distance < bestDistance)
+			{
+				best = j;
+				bestDistance = distance;
+			}
+		}
+		error += bestDistance;
+		indices |= (uint32_t)best << (2 * i);
+	}
+	*outIndices = indices;
+	return error;
+}
+
+// Solves for the endpoints that best fit the pixels with the indices they were given (least squares).
+// Returns false if the indices don't have enough spread to solve for two endpoints.
+static bool RefineColorEndpoints(const Vector3 pixels[16], uint32_t indices, Vector3 *outColor0, Vector3 *outColor1)
+{
+	static const float weights[4] = { 1, 0, 2.0f / 3, 1.0f / 3 };
+	float aa = 0, ab = 0, bb = 0;
+	Vector3 ax = { 0 }, bx = { 0 };
+	for (int i = 0; i < 16; ++i)
+	{
+		float a = weights[(indices >> (2 * i)) & 3];
+		float b = 1 - a;
+		aa += a * a;
+		ab += a * b;
+		bb += b * b;
+		ax = Vector3Add(ax, Vector3Scale(pixels[i], a));
+		bx = Vector3Add(bx, Vector3Scale(pixels[i], b));
+	}
+
+	float determinant = aa * bb - ab * ab;
+	if (fabsf(determinant) < 1e-6f)
+		return false;
+
+	float inverse = 1 / determinant;
+	*outColor0 = Vector3Scale(Vector3Subtract(Vector3Scale(ax, bb), Vector3Scale(bx, ab)), inverse);
+	*outColor1 = Vector3Scale(Vector3Subtract(Vector3Scale(bx, aa), Vector3Scale(ax, ab)), inverse);
+	return true;
+}
+
+// The 4-color mode needs color0 > color1, otherwise the GPU decodes the block as 3 colors + transparent black.
+static void WriteColorBlock(uint16_t color0, uint16_t color1, uint32_t indices, unsigned char *out)
+{
+	if (color0 < color1)
+	{
+		uint16_t swap = color0;
+		color0 = color1;
+		color1 = swap;
+		indices ^= 0x55555555; // Swaps 0 <-> 1 and 2 <-> 3.
+	}
+	else if (color0 == color1)
+		indices = 0;
+
+	out[0] = (unsigned char)color0;
+	out[1] = (unsigned char)(color0 >> 8);
+	out[2] = (unsigned char)color1;
+	out[3] = (unsigned char)(color1 >> 8);
+	for (int i = 0; i < 4; ++i)
+		out[4 + i] = (unsigned char)(indices >> (8 * i));
+}
+
+// The endpoints start at the extremes of the pixels along their principal axis, and then get refined once.
+static void CompressColorBlock(const Color block[16], unsigned char *out)
+{
+	Vector3 pixels[16];
+	Vector3 mean = { 0 };
+	for (int i = 0; i < 16; ++i)
+	{
+		pixels[i] = (Vector3){ block[i].r, block[i].g, block[i].b };
+		mean = Vector3Add(mean, pixels[i]);
+	}
+	mean = Vector3Scale(mean, 1.0f / 16);
+
+	float covariance[6] = { 0 };
+	for (int i = 0; i < 16; ++i)
+	{
+		Vector3 d = Vector3Subtract(pixels[i], mean);
+		covariance[0] += d.x * d.x;
+		covariance[1] += d.x * d.y;
+		covariance[2] += d.x * d.z;
+		covariance[3] += d.y * d.y;
+		covariance[4] += d.y * d.z;
+		covariance[5] += d.z * d.z;
+	}
+
+	Vector3 axis = { 1, 1, 1 };
+	for (int iteration = 0; iteration < 8; ++iteration)
+	{
+		Vector3 next;
+		next.x = covariance[0] * axis.x + covariance[1] * axis.y + covariance[2] * axis.z;
+		next.y = covariance[1] * axis.x + covariance[3] * axis.y + covariance[4] * axis.z;
+		next.z = covariance[2] * axis.x + covariance[4] * axis.y + covariance[5] * axis.z;
+		float length = Vector3Length(next);
+		if (length < 1e-6f)
+			break; // All pixels are (almost) the same color.
+		axis = Vector3Scale(next, 1 / length);
+	}
+
+	float minProjection = FLT_MAX, maxProjection = -FLT_MAX;
+	Vector3 minColor = mean, maxColor = mean;
+	for (int i = 0; i < 16; ++i)
+	{
+		float projection = Vector3DotProduct(pixels[i], axis);
+		if (projection < minProjection)
+		{
+			minProjection = projection;
+			minColor = pixels[i];
+		}
+		if (projection > maxProjection)
+		{
+			maxProjection = projection;
+			maxColor = pixels[i];
+		}
+	}
+
+	uint16_t color0 = PackColor565(maxColor);
+	uint16_t color1 = PackColor565(minColor);
+	uint32_t indices;
+	float error = FindColorIndices(pixels, color0, color1, &indices);
+
+	Vector3 refined0, refined1;
+	if (error > 0 and RefineColorEndpoints(pixels, indices, &refined0, &refined1))
+	{
+		uint16_t refinedColor0 = PackColor565(refined0);
+		uint16_t refinedColor1 = PackColor565(refined1);
+		uint32_t refinedIndices;
+		float refinedError = FindColorIndices(pixels, refinedColor0, refinedColor1, &refinedIndices);
+		if (refinedError < error)
+		{
+			color0 = refinedColor0;
+			color1 = refinedColor1;
+			indices = refinedIndices;
+		}
+	}
+
+	WriteColorBlock(color0, color1, indices, out);
+}
+
+// Uses the 8 value mode, with the alpha range stretched between the smallest and largest alpha in the block.
+static void CompressAlphaBlock(const Color block[16], unsigned char *out)
+{
+	int alpha0 = 0, alpha1 = 255;
+	for (int i = 0; i < 16; ++i)
+	{
+		if (alpha0 < block[i].a)
+			alpha0 = block[i].a;
+		if (alpha1 > block[i].a)
+			alpha1 = block[i].a;
+	}
+
+	int palette[8];
+	palette[0] = alpha0;
+	palette[1] = alpha1;
+	for (int i = 1; i < 7; ++i)
+		palette[i + 1] = ((7 - i) * alpha0 + i * alpha1 + 3) / 7;
+
+	uint64_t indices = 0;
+	if (alpha0 != alpha1)
+	{
+		for (int i = 0; i < 16; ++i)
+		{
+			int best = 0;
+			for (int j = 1; j < 8; ++j)
+				if (abs(palette[j] - block[i].a) < abs(palette[best] - block[i].a))
+					best = j;
+			indices |= (uint64_t)best << (3 * i);
+		}
+	}
+
+	out[0] = (unsigned char)alpha0;
+	out[1] = (unsigned char)alpha1;
+	for (int i = 0; i < 6; ++i)
+		out[2 + i] = (unsigned char)(indices >> (8 * i));
+}
+
+// Blocks that stick out past the edge of the image repeat the edge pixels, so filtering near the edge looks the same as clamping.
+static void CompressBlockRows(int begin, int end, void *userData)
+{
+	BlockRows *rows = userData;
+	int numBlocksX = (rows->width + 3) / 4;
+	int blockSize = rows->hasAlpha ? 16 : 8;
+	for (int blockY = begin; blockY < end; ++blockY)
+	{
+		for (int blockX = 0; blockX < numBlocksX; ++blockX)
+		{
+			Color block[16];
+			for (int i = 0; i < 16; ++i)
+			{
+				int x = ClampInt(4 * blockX + i % 4, 0, rows->width - 1);
+				int y = ClampInt(4 * blockY + i / 4, 0, rows->height - 1);
+				block[i] = rows->pixels[y * rows->width + x];
+			}
+
+			unsigned char *out = rows->blocks + (blockY * numBlocksX + blockX) * blockSize;
+			if (rows->hasAlpha)
+			{
+				CompressAlphaBlock(block, out);
+				out += 8;
+			}
+			CompressColorBlock(block, out);
+		}
+	}
+}
+
+Image CompressImage(Image image)
+{
+	Image result = { 0 };
+	if (not image.data or image.width <= 0 or image.height <= 0 or IsFormatCompressed(image.format))
+		return result;
+
+	Image copy = ImageCopy(image);
+	ImageFormat(&copy, PIXELFORMAT_UNCOMPRESSED_R8G8B8A8);
+
+	BlockRows rows = { 0 };
+	rows.pixels = copy.data;
+	rows.width = copy.width;
+	rows.height = copy.height;
+	for (int i = 0; i < copy.width * copy.height and not rows.hasAlpha; ++i)
+		rows.hasAlpha = rows.pixels[i].a != 255;
+
+	result.width = image.width;
+	result.height = image.height;
+	result.mipmaps = 1;
+	result.format = rows.hasAlpha ? PIXELFORMAT_COMPRESSED_DXT5_RGBA : PIXELFORMAT_COMPRESSED_DXT1_RGB;
+	result.data = MemAlloc(GetCompressedDataSize(result.width, result.height, result.format));
+	rows.blocks = result.data;
+	ParallelFor((copy.height + 3) / 4, 16, CompressBlockRows, &rows);
+
+	UnloadImage(copy);
+	return result;
+}
+
+static Image LoadCompressedImage(const char *path)
+{
+	Image image = { 0 };
+	unsigned dataSize;
+	unsigned char *data = LoadFileData(path, &dataSize);
+	if (not data)
+		return image;
+
+	DdsHeader header;
+	bool isValid = dataSize >= sizeof header;
+	if (isValid)
+	{
+		CopyBytes(&header, data, sizeof header);
+		isValid = BytesEqual(header.magic, DDS_MAGIC, 4)
+			and header.size == sizeof header - sizeof header.magic
+			and (header.pixelFormat.flags & DDPF_FOURCC)
+			and (BytesEqual(header.pixelFormat.fourCC, "DXT1", 4) or BytesEqual(header.pixelFormat.fourCC, "DXT5", 4))
+			and header.width > 0 and header.width <= COMPRESSED_TEXTURE_MAX_SIZE
+			and header.height > 0 and header.height <= COMPRESSED_TEXTURE_MAX_SIZE;
+	}
+
+	int format = 0;
+	int size = 0;
+	if (isValid)
+	{
+		format = BytesEqual(header.pixelFormat.fourCC, "DXT1", 4) ? PIXELFORMAT_COMPRESSED_DXT1_RGB : PIXELFORMAT_COMPRESSED_DXT5_RGBA;
+		size = GetCompressedDataSize((int)header.width, (int)header.height, format);
+		isValid = dataSize >= sizeof header + size;
+	}
+	if (not isValid)
+	{
+		LogWarning("Couldn't load compressed texture '%s' because it's not a DDS file we wrote.", path);
+		UnloadFileData(data);
+		return image;
+	}
+
+	// The blocks just get moved to the front, so the image can keep using the file's memory.
+	memmove(data, data + sizeof header, (size_t)size);
+	image.data = data;
+	image.width = (int)header.width;
+	image.height = (int)header.height;
+	image.mipmaps = 1;
+	image.format = format;
+	return image;
+}
+
+Image LoadTextureImage(const char *path)
+{
+	const char *compressedPath = GetCompressedTexturePath(path);
+	if (IsCompressedTextureUpToDate(path, compressedPath))
+	{
+		Image image = LoadCompressedImage(compressedPath);
+		if (image.data and IsCompressedFormatSupported(image.format))
+			return image;
+		UnloadImage(image);
+	}
+	return LoadImage(path);
+}
+
+Texture UploadTextureImage(Image image)
+{
+	if (not IsFormatCompressed(image.format))
+		return LoadTextureFromImage(image);
+
+	// rlgl works out the data size from the texture size, so that has to cover the whole blocks.
+	Texture texture = { 0 };
+	texture.width = (image.width + 3) / 4 * 4;
+	texture.height = (image.height + 3) / 4 * 4;
+	texture.mipmaps = 1;
+	texture.format = image.format;
+	texture.id = rlLoadTexture(image.data, texture.width, texture.height, texture.format, 1);
+	if (not texture.id)
+	{
+		LogError("Couldn't upload a %dx%d compressed texture.", image.width, image.height);
+		texture = (Texture){ 0 };
+	}
+	return texture;
+}
+
+bool BakeCompressedTexture(const char *path)
+{
+	#ifdef __EMSCRIPTEN__
+	{
+		// The web build can't write next to the preloaded files, these have to be baked by a desktop build beforehand.
+		UNUSED(path);
+		return false;
+	}
+	#else
+	{
+		const char *compressedPath = GetCompressedTexturePath(path);
+		if (IsCompressedTextureUpToDate(path, compressedPath))
+			return true;
+		if (not IsPathFile(path) or not IsFileExtension(path, ".png"))
+			return false;
+
+		Image image = LoadImage(path);
+		if (image.width * image.height < COMPRESSED_TEXTURE_MIN_PIXELS)
+		{
+			UnloadImage(image);
+			return false;
+		}
+
+		Image compressed = CompressImage(image);
+		int size = GetCompressedDataSize(compressed.width, compressed.height, compressed.format);
+
+		DdsHeader header;
+		ZeroBytes(&header, sizeof header);
+		CopyBytes(header.magic, DDS_MAGIC, 4);
+		header.size = sizeof header - sizeof header.magic;
+		header.flags = DDSD_CAPS | DDSD_HEIGHT | DDSD_WIDTH | DDSD_PIXELFORMAT | DDSD_LINEARSIZE;
+		header.width = (uint32_t)compressed.width;
+		header.height = (uint32_t)compressed.height;
+		header.pitchOrLinearSize = (uint32_t)size;
+		header.mipMapCount = 1;
+		header.pixelFormat.size = sizeof header.pixelFormat;
+		header.pixelFormat.flags = DDPF_FOURCC;
+		CopyBytes(header.pixelFormat.fourCC, compressed.format == PIXELFORMAT_COMPRESSED_DXT1_RGB ? "DXT1" : "DXT5", 4);
+		header.caps = DDSCAPS_TEXTURE;
+
+		BinaryStream stream = { 0 };
+		stream.canGrow = true;
+		WriteBytes(&stream, &header, sizeof header);
+		WriteBytes(&stream, compressed.data, size);
+		bool success = SaveFileData(compressedPath, stream.buffer, stream.cursor);
+		if (success)
+			LogMessage(LOG_CATEGORY_ASSETS, LOG_INFO, "Compressed '%s' from %d KB to %d KB.", path, image.width * image.height * 4 / 1024, size / 1024);
+		else
+			LogError("Couldn't save compressed texture '%s'.", compressedPath);
+
+		MemFree(stream.buffer);
+		UnloadImage(compressed);
+		UnloadImage(image);
+		return success;
+	}
+	#endif
+}
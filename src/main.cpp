@@ -9,11 +9,38 @@
 #define DEFAULT_CAMERA_SHAKE_TRAUMA 0.5f
 #define DEFAULT_CAMERA_SHAKE_FALLOFF (0.7f * FRAME_TIME)
 #define SCENE_MAGIC "KEKW"
-#define SCENE_VERSION 5 // You need to increase this every time the scene binary format changes!
+#define SCENE_VERSION 6 // You need to increase this every time the scene binary format changes!
+#define SCENE_PACK_EXTENSION ".pack" // The web build downloads "intro.scene.pack" when "intro.scene" is loaded.
+#define BASE_PACK_PATH "base.pack" // Everything that isn't only used by one scene, the web build preloads this.
 #define Y_SQUISH 0.5773502691896258f // 1 / (2 * cos(30 degrees)) = 1 / sqrt(3)
 #define GRID_RESOLUTION_X 50.0f
 #define GRID_RESOLUTION_Y (GRID_RESOLUTION_X * Y_SQUISH)
 #define ELEVATION_TO_Y_OFFSET (-GRID_RESOLUTION_Y / 2)
+#define SPATIAL_GRID_CELL_SIZE 256.0f
+#define NAV_CELLS_PER_TILE 4 // Navigation cells are a subdivision of the isometric grid.
+#define NAV_GRID_MARGIN 8 // Number of walkable cells around the collision maps that are still stored in the navigation grid.
+#define NAV_STEPS_PER_UPDATE 2000 // How many navigation cells all path searches together get to look at every update.
+#define DEFAULT_MOTION_SPEED 10.0f
+#define CULLING_MARGIN 128.0f // Objects are drawn a bit away from their outline when they're on stairs or interpolated, so culling leaves some room.
+#define STATIC_TILE_SIZE 512 // In world units, which are also pixels while the camera isn't zoomed.
+// Every tile is a 512x512 render texture, so 1 MB of VRAM. The web build gets by with enough tiles for a couple of layers.
+#ifndef MAX_STATIC_TILES
+#	ifdef __EMSCRIPTEN__
+#		define MAX_STATIC_TILES 16
+#	else
+#		define MAX_STATIC_TILES 64
+#	endif
+#endif
+#define PARTICLE_EMITTER_SIZE 32.0f // Outline of objects that only emit particles and don't have a sprite, so they can still be picked.
+
+// The light buffer is a fraction of the screen resolution, and lower quality also takes fewer steps to find shadows.
+ENUM(LightingQuality)
+{
+	LIGHTING_OFF,
+	LIGHTING_QUARTER_RESOLUTION,
+	LIGHTING_HALF_RESOLUTION,
+	LIGHTING_QUALITY_ENUM_COUNT
+};
 
 ENUM(GameState)
 {
@@ -26,7 +53,7 @@ ENUM(GameState)
 STRUCT(Expression)
 {
 	char name[32];
-	Texture *portrait;
+	Sprite *portrait;
 };
 
 STRUCT(Input)
@@ -36,6 +63,8 @@ STRUCT(Input)
 	InputButton sprint;
 	InputButton pause;
 	InputButton console;
+	InputButton previousParagraph; // Only in dev mode, to skip around in dialogues.
+	InputButton nextParagraph;
 };
 
 STRUCT(MotionMaster)
@@ -45,6 +74,10 @@ STRUCT(MotionMaster)
 		if (start == end)
 			return;
 
+		// Objects are zero initialized, which doesn't run the default initializer.
+		if (speed <= 0)
+			speed = DEFAULT_MOTION_SPEED;
+
 		startPoint = start;
 		endPoint = end;
 		
@@ -69,9 +102,22 @@ STRUCT(MotionMaster)
 			currentPoint = endPoint;
 			
 			Reset();
+			if (nextWaypoint < ListCount(waypoints))
+				MoveToPoint(currentPoint, waypoints[nextWaypoint++]);
 		}	
 	}
 
+	// Moves through all of the points in the path, one after the other. Takes over the path, which is freed by the object's Destroy.
+	void MoveAlongPath(Vector2 start, List(Vector2) path)
+	{
+		ListDestroy((void **)&waypoints);
+		waypoints = path;
+		nextWaypoint = 0;
+		Reset();
+		if (ListCount(waypoints) > 0)
+			MoveToPoint(start, waypoints[nextWaypoint++]);
+	}
+
 	Vector2 GetDirection()
 	{
 		auto subtract = Vector2Subtract(endPoint, startPoint);
@@ -97,13 +143,29 @@ STRUCT(MotionMaster)
 
 	float motionTime = 0;
 	float arrivalTime = 0;
-	float speed = 10;
+	float speed = DEFAULT_MOTION_SPEED;
+
+	List(Vector2) waypoints = NULL; // Still to come after endPoint, see MoveAlongPath.
+	int nextWaypoint = 0;
+	int pathRequest = 0; // Navigation path we're waiting for, see MoveToPoint(Object *, Vector2).
+	Vector2 pathTarget = {};
 };
 
-STRUCT(Object)
+// The parts of an object that only get looked at once in a while (talking, the editor, saving..).
+// These are kept out of Object so that the per-frame loops over all objects stay cache friendly.
+STRUCT(ObjectDetails)
 {
 	char name[50];
+	Script *script;
+	Expression expressions[10]; // We might want more, but this should generally be a very small number.
+};
+
+// The parts of an object that are needed every frame for updating, collision and drawing.
+STRUCT(Object)
+{
+	ObjectDetails *details; // Every object owns its details, see CreateObjectDetails.
 	Vector2 position;
+	Vector2 previousPosition; // Position before the last update, so that rendering can interpolate between the two.
 	float zOffset;
 	Direction direction;
 	Sprite *sprites[DIRECTION_ENUM_COUNT];
@@ -112,10 +174,15 @@ STRUCT(Object)
 	float talkRange;
 	bool autoTalkInRange;
 	int animationFrame;
-	Image *collisionMap;
-	Script *script;
-	Expression expressions[10]; // We might want more, but this should generally be a very small number.
+	CollisionMap *collisionMap;
 	MotionMaster motionMaster;
+	float sortingZ; // Cached by UpdateObjectBounds, so that sorting doesn't have to look at sprites.
+	bool hasStaleBounds; // Set by Update, which runs on the job threads and can't touch the spatial grids.
+	float elevationOffset; // How far up the stairs under the feet move the sprite. Cached by UpdateObjectBounds.
+	bool isStatic; // Never moves or animates, so it's drawn as part of the cached static layers.
+	ParticleEmitter *particles; // NULL unless the object emits particles. Every object owns its emitter, and the emitter's sprite.
+	float lightRadius; // 0 if the object doesn't give off light.
+	Color lightColor; // The alpha is the brightness.
 };
 
 STRUCT(Stair)
@@ -136,86 +203,243 @@ STRUCT(Options)
 	char scene[256] = "test.scene";
 	bool showGrid = true;
 	Color gridColor = ColorAlpha(GRAY, 0.2f);
+	#ifdef __EMSCRIPTEN__
+	LightingQuality lightingQuality = LIGHTING_QUARTER_RESOLUTION;
+	#else
+	LightingQuality lightingQuality = LIGHTING_HALF_RESOLUTION;
+	#endif
+	bool isResolutionDynamic = true;
 };
 
 Options options;
 Input input;
-Font roboto;
-Font robotoBold;
-Font robotoItalic;
-Font robotoBoldItalic;
-Object objects[100];
-Object *player = &objects[0]; // The player is ALWAYS the first object.
+FontFace roboto;
+FontFace robotoBold;
+FontFace robotoItalic;
+FontFace robotoBoldItalic;
+Object *player; // The player is ALWAYS the first object, see EnsurePlayer.
 int numObjects;
 Camera2D camera;
+Vector2 previousCameraTarget; // Camera target before the last update, so that rendering can interpolate between the two.
 float cameraTrauma; // Amount of camera shake. Will slowly decrease over time.
 float cameraTraumaFalloff; // How quickly the camera shake stops.
 Vector2 cameraOffset1;
 Vector2 cameraOffset2;
-int numStairs;
-Stair stairs[100];
+List(Stair) stairs;
+
+// Object bounds are kept in spatial grids (indexed by object index), so that collisions,
+// picking and talking only ever have to look at the objects that are nearby.
+SpatialGrid collisionGrid; // Collision map rectangles.
+SpatialGrid outlineGrid;   // Sprite outlines, plus wherever the object's particles are. See GetCullingRectangle.
+SpatialGrid talkGrid;      // Talk range around the feet.
+
+// Object indices sorted by descending z. This is kept around between frames, because it barely ever changes.
+List(int) drawOrder;
+int numObjectsDrawn; // In the last rendered frame, see CountDrawnObjects.
+int numObjectsCulled;
+
+// Set this when objects change in a way that UpdateObjectBounds doesn't know about, e.g. when loading a scene.
+bool areObjectBoundsDirty = true;
+unsigned objectBoundsAssetGeneration;
+
+// Collision maps rasterized into navigation cells, so that moving objects can find their way around them.
+// When collision maps move, only the cells around them get rasterized again, see UpdateNavGridIfDirty.
+NavGrid navGrid;
+bool isNavGridDirty = true; // Set this to rebuild the whole navigation grid.
+unsigned navGridCollisionMapGeneration;
+List(Rectangle) dirtyNavAreas; // World space areas whose navigation cells need to be rasterized again.
+
+// Lights multiply the frame, so white ambient light leaves the scene as it is, and lights only show up in scenes that are darker than that.
+Color ambientLight = WHITE;
+bool areOccludersDirty = true; // Set this to build the occluder textures of all collision maps again, see UpdateOccluders.
+
+// Objects live in slots that are allocated in blocks, and never move once they're allocated. So a scene can hold as many objects
+// as it wants, and pointers to objects (like the player) stay valid for as long as the object exists. An object's index is its
+// position in the scene, which is kept separately in sceneSlots: removing an object moves the indices of all of the ones after
+// it down by one, but the objects themselves stay where they are. The slots of removed objects are reused for new ones,
+// so anything that holds on to an object while objects could be removed should hold an ObjectHandle instead.
+#define OBJECT_BLOCK_SIZE 256
+List(Object *) objectBlocks;
+List(int) sceneSlots;           // The slot of every object in the scene, by index.
+List(int) slotIndices;          // The index of the object in every slot, or -1 if the slot is free.
+List(unsigned) slotGenerations; // Goes up every time a slot's object is removed, so that the handles to it stop working.
+List(int) freeSlots;            // Lowest slot last, so that the order of the objects in memory follows the scene when it's loaded.
+
+// Refers to an object, and stops referring to anything (instead of to whatever object gets its slot next) once it's removed.
+STRUCT(ObjectHandle)
+{
+	int slot; // -1 for the handle to no object.
+	unsigned generation;
+};
 
-bool CheckCollisionMap(Image map, Vector2 position)
+Object *GetObject(int index)
+{
+	ASSERT(index >= 0 and index < numObjects);
+	int slot = sceneSlots[index];
+	return &objectBlocks[slot / OBJECT_BLOCK_SIZE][slot % OBJECT_BLOCK_SIZE];
+}
+static int GetObjectSlot(const Object *object)
+{
+	for (int i = 0; i < ListCount(objectBlocks); ++i)
+	{
+		const Object *first = objectBlocks[i];
+		if (object >= first and object < first + OBJECT_BLOCK_SIZE)
+			return i * OBJECT_BLOCK_SIZE + (int)(object - first);
+	}
+	ASSERT(false); // Not one of our objects.
+	return -1;
+}
+int GetObjectIndex(const Object *object)
+{
+	int index = slotIndices[GetObjectSlot(object)];
+	ASSERT(index >= 0); // The object was removed.
+	return index;
+}
+ObjectHandle GetObjectHandle(const Object *object)
+{
+	if (not object)
+		return ObjectHandle{ -1, 0 };
+	int slot = GetObjectSlot(object);
+	return ObjectHandle{ slot, slotGenerations[slot] };
+}
+// Returns NULL if the object was removed since the handle was made.
+Object *GetObjectFromHandle(ObjectHandle handle)
+{
+	if (handle.slot < 0 or handle.slot >= ListCount(slotIndices))
+		return NULL;
+	if (slotIndices[handle.slot] < 0 or slotGenerations[handle.slot] != handle.generation)
+		return NULL;
+	return GetObject(slotIndices[handle.slot]);
+}
+ObjectDetails *CreateObjectDetails(void)
 {
-	int xi = (int)floorf(position.x);
-	int yi = (int)floorf(position.y);
+	return (ObjectDetails *)MemAlloc(sizeof(ObjectDetails));
+}
+// Inserts a zeroed object without any details at the given index, moving the indices of all of the objects after it up by one.
+static Object *InsertObjectSlot(int index)
+{
+	ASSERT(index >= 0 and index <= numObjects);
+	if (ListCount(freeSlots) == 0)
+	{
+		Object *block = (Object *)MemAlloc(OBJECT_BLOCK_SIZE * sizeof block[0]);
+		ZeroBytes(block, OBJECT_BLOCK_SIZE * sizeof block[0]);
+		int firstSlot = ListCount(objectBlocks) * OBJECT_BLOCK_SIZE;
+		ListAdd(&objectBlocks, block);
+		SetInts(ListAllocate(&slotIndices, OBJECT_BLOCK_SIZE), -1, OBJECT_BLOCK_SIZE);
+		ZeroBytes(ListAllocate(&slotGenerations, OBJECT_BLOCK_SIZE), OBJECT_BLOCK_SIZE * sizeof slotGenerations[0]);
+		for (int i = OBJECT_BLOCK_SIZE - 1; i >= 0; --i)
+			ListAdd(&freeSlots, firstSlot + i);
+	}
+	int slot = ListPop(&freeSlots);
 
-	if (xi < 0)
-		return false;
-	if (xi >= map.width)
-		return false;
-	if (yi < 0)
-		return false;
-	if (yi >= map.height)
-		return false;
+	ListAdd(&sceneSlots, slot);
+	++numObjects;
+	for (int i = numObjects - 1; i > index; --i)
+	{
+		sceneSlots[i] = sceneSlots[i - 1];
+		slotIndices[sceneSlots[i]] = i;
+	}
+	sceneSlots[index] = slot;
+	slotIndices[slot] = index;
+	player = GetObject(0);
 
-	Color color = GetImageColor(map, xi, yi);
-	return color.r < 128;
+	Object *object = GetObject(index);
+	ZeroBytes(object, sizeof object[0]);
+	return object;
+}
+// Inserts a zeroed object at the given index, moving the indices of all of the objects after it up by one.
+Object *InsertObject(int index)
+{
+	Object *object = InsertObjectSlot(index);
+	object->details = CreateObjectDetails();
+	return object;
+}
+// Appends a zeroed object to the end of the scene.
+Object *AddObject(void)
+{
+	return InsertObject(numObjects);
+}
+void Destroy(Object *object);
+// Destroys the object at the given index, and moves the indices of all of the objects after it down by one.
+void RemoveObject(int index)
+{
+	ASSERT(index >= 0 and index < numObjects);
+	int slot = sceneSlots[index];
+	Destroy(GetObject(index));
+	slotIndices[slot] = -1;
+	++slotGenerations[slot];
+	ListAdd(&freeSlots, slot);
+
+	for (int i = index; i < numObjects - 1; ++i)
+	{
+		sceneSlots[i] = sceneSlots[i + 1];
+		slotIndices[sceneSlots[i]] = i;
+	}
+	ListPop(&sceneSlots);
+	--numObjects;
+	player = numObjects > 0 ? GetObject(0) : NULL;
+}
+// Removes everything, including the player. Add a new player right away, see EnsurePlayer.
+void RemoveAllObjects(void)
+{
+	while (numObjects > 0)
+		RemoveObject(numObjects - 1);
+}
+// The player is ALWAYS the first object, so there has to be one even when there's no scene, or the scene has no objects.
+void EnsurePlayer(void)
+{
+	if (numObjects > 0)
+		return;
+	Object *object = AddObject();
+	CopyString(object->details->name, "Player", sizeof object->details->name);
 }
+
 Vector2 MovePointWithCollisions(Vector2 position, Vector2 velocity)
 {
 	Vector2 p0 = position;
 	Vector2 p1 = position + velocity;
-	
-	Vector2 newPosition = position + velocity;
-	for (int i = 0; i < numObjects; ++i)
+
+	// We test the whole segment from p0 to p1, otherwise moving fast enough would let us skip right over thin walls.
+	Rectangle bounds = { fminf(p0.x, p1.x), fminf(p0.y, p1.y), fabsf(velocity.x), fabsf(velocity.y) };
+	List(int) nearby = QuerySpatialGrid(&collisionGrid, bounds);
+	for (int i = 0; i < ListCount(nearby); ++i)
 	{
-		Object *object = &objects[i];
+		Object *object = GetObject(nearby[i]);
 		if (object->collisionMap)
 		{
-			Rectangle rectangle = {
-				object->position.x - 0.5f * object->collisionMap->width,
-				object->position.y - 0.5f * object->collisionMap->height,
-				(float)object->collisionMap->width,
-				(float)object->collisionMap->height,
+			CollisionMap *map = object->collisionMap;
+			Vector2 topLeft = {
+				object->position.x - 0.5f * map->width,
+				object->position.y - 0.5f * map->height,
 			};
-			Vector2 topLeft = { rectangle.x, rectangle.y };
-			Vector2 localPosition = newPosition - topLeft;
+			Vector2 from = p0 - topLeft;
+			Vector2 to = p1 - topLeft;
 
-			// The CheckCollisionMap call might become more expensive in the future, so we first check
-			// the rectangle to make sure a collision can happen at all, and only then do we actually check the collision map.
-			if (CheckCollisionPointRec(newPosition, rectangle) and CheckCollisionMap(*object->collisionMap, localPosition))
+			// If we're already stuck inside of a wall, we still want to be able to walk out of it.
+			bool isStuck = CheckCollisionMapPoint(*map, from);
+			if (isStuck ? CheckCollisionMapPoint(*map, to) : CheckCollisionMapSegment(*map, from, to))
 				return position;
 		}
 	}
 
-	return newPosition;
+	return p1;
 }
 
 Object *FindObjectByName(const char *name)
 {
 	for (int i = 0; i < numObjects; ++i)
-		if (StringsEqualNocase(objects[i].name, name))
-			return &objects[i];
+		if (StringsEqualNocase(GetObject(i)->details->name, name))
+			return GetObject(i);
 
 	return NULL;
 }
-Texture *GetCharacterPortrait(const Object *object, const char *name)
+Sprite *GetCharacterPortrait(const Object *object, const char *name)
 {
-	for (int i = 0; i < COUNTOF(object->expressions); ++i)
-		if (StringsEqualNocase(object->expressions[i].name, name))
-			return object->expressions[i].portrait;
-	return object->expressions[0].portrait;
+	const ObjectDetails *details = object->details;
+	for (int i = 0; i < COUNTOF(details->expressions); ++i)
+		if (StringsEqualNocase(details->expressions[i].name, name))
+			return details->expressions[i].portrait;
+	return details->expressions[0].portrait;
 }
 Sprite *GetCurrentSprite(const Object *object)
 {
@@ -224,7 +448,7 @@ Sprite *GetCurrentSprite(const Object *object)
 		sprite = object->sprites[MirrorDirectionVertically(object->direction)];
 	return sprite;
 }
-Texture *GetCurrentTexture(const Object *object)
+SpriteFrame *GetCurrentFrame(const Object *object)
 {
 	Sprite *sprite = GetCurrentSprite(object);
 	if (not sprite)
@@ -236,9 +460,9 @@ Vector2 GetFootPositionInScreenSpace(const Object *object)
 {
 	Vector2 position = object->position;
 
-	Texture *objectTexture = GetCurrentTexture(object);
-	if (objectTexture)
-		position.y += objectTexture->height * 0.5f;
+	SpriteFrame *frame = GetCurrentFrame(object);
+	if (frame)
+		position.y += frame->source.height * 0.5f;
 
 	return position;
 }
@@ -256,55 +480,251 @@ float DistanceBetween(const Object *a, const Object *b)
 }
 Rectangle GetOutline(const Object *object)
 {
-	Texture *texture = GetCurrentTexture(object);
-	if (not texture)
+	SpriteFrame *frame = GetCurrentFrame(object);
+	if (not frame and object->particles)
+	{
+		Rectangle outline = {
+			object->position.x - 0.5f * PARTICLE_EMITTER_SIZE,
+			object->position.y - 0.5f * PARTICLE_EMITTER_SIZE,
+			PARTICLE_EMITTER_SIZE,
+			PARTICLE_EMITTER_SIZE,
+		};
+		return outline;
+	}
+	if (not frame)
 	{
 		Rectangle empty = { 0 };
 		return empty;
 	}
 
 	Rectangle outline = {
-		object->position.x - 0.5f * texture->width,
-		object->position.y - 0.5f * texture->height,
-		(float)texture->width,
-		(float)texture->height,
+		object->position.x - 0.5f * frame->source.width,
+		object->position.y - 0.5f * frame->source.height,
+		frame->source.width,
+		frame->source.height,
 	};
 	return outline;
 }
-List(Object *) GetZSortedObjects(void)
+Rectangle GetCollisionRectangle(const Object *object)
+{
+	if (not object->collisionMap)
+	{
+		Rectangle empty = { 0 };
+		return empty;
+	}
+
+	Rectangle rectangle = {
+		object->position.x - 0.5f * object->collisionMap->width,
+		object->position.y - 0.5f * object->collisionMap->height,
+		(float)object->collisionMap->width,
+		(float)object->collisionMap->height,
+	};
+	return rectangle;
+}
+Rectangle GetTalkRectangle(const Object *object)
+{
+	// Talk range is measured in world space, where the y axis is squished.
+	Vector2 feet = GetFootPositionInScreenSpace(object);
+	Rectangle rectangle = {
+		feet.x - object->talkRange,
+		feet.y - object->talkRange / Y_SQUISH,
+		2 * object->talkRange,
+		2 * object->talkRange / Y_SQUISH,
+	};
+	return rectangle;
+}
+float GetSortingZ(const Object *object)
+{
+	return GetFootPositionInScreenSpace(object).y + object->zOffset;
+}
+// Particles fly off on their own, so the outline alone would cull them as soon as the sprite leaves the view.
+Rectangle GetCullingRectangle(const Object *object)
+{
+	Rectangle outline = GetOutline(object);
+	if (not object->particles or object->particles->numParticles == 0)
+		return outline;
+
+	Rectangle particles = object->particles->bounds;
+	float x0 = fminf(outline.x, particles.x);
+	float y0 = fminf(outline.y, particles.y);
+	float x1 = fmaxf(outline.x + outline.width, particles.x + particles.width);
+	float y1 = fmaxf(outline.y + outline.height, particles.y + particles.height);
+	Rectangle rectangle = { x0, y0, x1 - x0, y1 - y0 };
+	return rectangle;
+}
+int GetElevationAt(Vector2 gridPoint);
+Vector2 WorldToGrid(Vector2 worldPoint);
+// Call this whenever an object moves or changes, so that the spatial grids and the draw order stay up to date.
+void UpdateObjectBounds(Object *object)
+{
+	int id = GetObjectIndex(object);
+
+	object->sortingZ = GetSortingZ(object);
+	object->elevationOffset = ELEVATION_TO_Y_OFFSET * GetElevationAt(WorldToGrid(GetFootPositionInScreenSpace(object)));
+
+	// Navigation cells only have to be rasterized again where the collision map was and now is.
+	bool wasColliding = id < ListCount(collisionGrid.items) and collisionGrid.items[id].isInGrid;
+	Rectangle oldCollision = wasColliding ? collisionGrid.items[id].bounds : Rectangle{ 0 };
+	Rectangle newCollision = GetCollisionRectangle(object);
+	if (wasColliding != (object->collisionMap != NULL) or not BytesEqual(&oldCollision, &newCollision, sizeof oldCollision))
+	{
+		if (wasColliding)
+			ListAdd(&dirtyNavAreas, oldCollision);
+		if (object->collisionMap)
+			ListAdd(&dirtyNavAreas, newCollision);
+	}
+
+	if (object->collisionMap)
+		UpdateSpatialGridItem(&collisionGrid, id, newCollision);
+	else
+		RemoveSpatialGridItem(&collisionGrid, id);
+
+	UpdateSpatialGridItem(&outlineGrid, id, GetCullingRectangle(object));
+
+	if (object->details->script)
+		UpdateSpatialGridItem(&talkGrid, id, GetTalkRectangle(object));
+	else
+		RemoveSpatialGridItem(&talkGrid, id);
+}
+// Brings all spatial grids and the draw order up to date. Objects get added, removed, reordered and edited
+// in a lot of places (mostly the editor), and this catches all of them.
+void UpdateAllObjectBounds(void)
+{
+	for (int i = 0; i < numObjects; ++i)
+		UpdateObjectBounds(GetObject(i));
+	// Every object is always in the outline grid, so that one knows about every index that was ever used.
+	for (int i = numObjects; i < ListCount(outlineGrid.items); ++i)
+	{
+		if (i < ListCount(collisionGrid.items) and collisionGrid.items[i].isInGrid)
+			ListAdd(&dirtyNavAreas, collisionGrid.items[i].bounds);
+		RemoveSpatialGridItem(&collisionGrid, i);
+		RemoveSpatialGridItem(&outlineGrid, i);
+		RemoveSpatialGridItem(&talkGrid, i);
+	}
+	areObjectBoundsDirty = false;
+	objectBoundsAssetGeneration = GetAssetGeneration();
+}
+// Only brings the object bounds up to date if something happened that could have changed them behind our back.
+// While just playing, static objects then don't cost anything.
+void UpdateAllObjectBoundsIfDirty(void)
+{
+	if (areObjectBoundsDirty or objectBoundsAssetGeneration != GetAssetGeneration())
+		UpdateAllObjectBounds();
+}
+void UpdateDrawOrder(void)
+{
+	int numDrawOrder = ListCount(drawOrder);
+	if (numDrawOrder != numObjects)
+	{
+		ListClear(drawOrder);
+		numDrawOrder = numObjects;
+		int *indices = ListAllocate(&drawOrder, numDrawOrder);
+		for (int i = 0; i < numDrawOrder; ++i)
+			indices[i] = i;
+
+		// Starting from scratch, so radix sort everything. Ascending order of -z is the descending order of z,
+		// and because it's stable, this is the same order that the insertion sort would have come up with.
+		float *keys = (float *)TempAlloc(numDrawOrder * (int)sizeof keys[0]);
+		for (int i = 0; i < numDrawOrder; ++i)
+			keys[i] = 0.0f - GetObject(i)->sortingZ; // 0 - z so that z = 0 and z = -0 get the same key.
+		RadixSortByFloatKeys(keys, indices, numDrawOrder);
+		TempFree(keys);
+		return;
+	}
+
+	// Only a couple of objects move in any given frame, so the order from last frame is almost sorted already.
+	// Insertion sort is basically O(n) in that case, and it doesn't touch static objects at all.
+	for (int i = 1; i < numDrawOrder; ++i)
+	{
+		int index = drawOrder[i];
+		float z = GetObject(index)->sortingZ;
+		int j = i;
+		for (; j > 0 and GetObject(drawOrder[j - 1])->sortingZ < z; --j)
+			drawOrder[j] = drawOrder[j - 1];
+		drawOrder[j] = index;
+	}
+}
+// Returns the area of the world that the camera sees.
+Rectangle GetCameraView(Camera2D view)
+{
+	// The camera might be rotated, so we need all 4 corners of the screen.
+	Vector2 corners[] = {
+		GetScreenToWorld2D(Vector2{ 0, 0 }, view),
+		GetScreenToWorld2D(Vector2{ WINDOW_WIDTH, 0 }, view),
+		GetScreenToWorld2D(Vector2{ 0, WINDOW_HEIGHT }, view),
+		GetScreenToWorld2D(Vector2{ WINDOW_WIDTH, WINDOW_HEIGHT }, view),
+	};
+	Vector2 min = corners[0];
+	Vector2 max = corners[0];
+	for (int i = 1; i < COUNTOF(corners); ++i)
+	{
+		min.x = fminf(min.x, corners[i].x);
+		min.y = fminf(min.y, corners[i].y);
+		max.x = fmaxf(max.x, corners[i].x);
+		max.y = fmaxf(max.y, corners[i].y);
+	}
+	Rectangle rectangle = { min.x, min.y, max.x - min.x, max.y - min.y };
+	return rectangle;
+}
+// Returns the objects whose culling rectangle is in the area, sorted by descending z.
+List(Object *) GetZSortedObjectsInArea(Rectangle area)
 {
+	UpdateAllObjectBoundsIfDirty(); // The outline grid has to be up to date.
+	UpdateDrawOrder();
+
+	List(int) visible = QuerySpatialGrid(&outlineGrid, area);
+	bool *isVisible = (bool *)TempAlloc(numObjects * sizeof isVisible[0]);
+	ZeroBytes(isVisible, numObjects * sizeof isVisible[0]);
+	for (int i = 0; i < ListCount(visible); ++i)
+		if (visible[i] < numObjects)
+			isVisible[visible[i]] = true;
+
 	List(Object *) result = NULL;
 	ListSetAllocator((void **)&result, TempRealloc, TempFree);
-	Object **pointers = ListAllocate(&result, numObjects);
 	for (int i = 0; i < numObjects; ++i)
-		pointers[i] = &objects[i];
+		if (isVisible[drawOrder[i]])
+			ListAdd(&result, GetObject(drawOrder[i]));
 
-	Sort(pointers, numObjects, sizeof pointers[0], [](const void *left, const void *right)
-	{
-		Object *l = *(Object **)left;
-		Object *r = *(Object **)right;
-		float lz = GetFootPositionInScreenSpace(l).y + l->zOffset;
-		float rz = GetFootPositionInScreenSpace(r).y + r->zOffset;
-		if (lz > rz) return -1;
-		if (lz < rz) return +1;
-		return 0;
-	});
+	return result;
+}
+// Sets numObjectsDrawn and numObjectsCulled to how many of the objects are in the view. The objects can cover more than the view,
+// e.g. when static objects around it are drawn into tiles, and those shouldn't count as drawn.
+void CountDrawnObjects(List(Object *) objects, Camera2D view)
+{
+	Rectangle area = ExpandRectangle(GetCameraView(view), CULLING_MARGIN);
+	numObjectsDrawn = 0;
+	for (int i = 0; i < ListCount(objects); ++i)
+		if (CheckCollisionRecs(area, GetCullingRectangle(objects[i])))
+			++numObjectsDrawn;
+	numObjectsCulled = numObjects - numObjectsDrawn;
+}
+// Returns the objects that the camera can see, sorted by descending z. Also updates numObjectsDrawn and numObjectsCulled.
+List(Object *) GetVisibleZSortedObjects(Camera2D view)
+{
+	List(Object *) result = GetZSortedObjectsInArea(ExpandRectangle(GetCameraView(view), CULLING_MARGIN));
+	numObjectsDrawn = ListCount(result);
+	numObjectsCulled = numObjects - numObjectsDrawn;
 	return result;
 }
 Object *FindObjectAtPosition(Vector2 position)
 {
+	// We want the object that's drawn on top, which is the one with the biggest z.
 	Object *result = NULL;
+	float resultZ = -FLT_MAX;
 	int mark = TempMark();
 	{
-		List(Object *) sorted = GetZSortedObjects();
-		for (int i = 0; i < ListCount(sorted); ++i)
+		List(int) nearby = QuerySpatialGridPoint(&outlineGrid, position);
+		for (int i = 0; i < ListCount(nearby); ++i)
 		{
-			Object *object = sorted[i];
-			Rectangle outline = GetOutline(object);
-			if (CheckCollisionPointRec(position, outline))
+			Object *object = GetObject(nearby[i]);
+			if (not CheckCollisionPointRec(position, GetOutline(object)))
+				continue;
+
+			float z = object->sortingZ;
+			if (not result or z > resultZ or (z == resultZ and object < result))
 			{
 				result = object;
-				break;
+				resultZ = z;
 			}
 		}
 	}
@@ -342,27 +762,153 @@ Vector2 ScreenToGrid(Vector2 screenPoint)
 {
 	return WorldToGrid(GetScreenToWorld2D(screenPoint, camera));
 }
-Stair *GetStairAt(Vector2 gridPoint)
+
+// The stairs are baked into a sparse map of grid cells, so finding the stair under a point doesn't have to look at every stair.
+// The map is made of square chunks of cells, and only the chunks that some stair touches exist. Every cell holds the index of the
+// stair that covers it, so changing the elevation of a stair doesn't change the map, only adding, moving or removing stairs does.
+
+#define ELEVATION_CHUNK_SIZE 16
+
+STRUCT(ElevationChunk)
 {
-	int x = (int)floorf(gridPoint.x);
-	int y = (int)floorf(gridPoint.y);
-	for (int i = 0; i < numStairs; ++i)
+	int x; // In chunks.
+	int y;
+	int stairs[ELEVATION_CHUNK_SIZE * ELEVATION_CHUNK_SIZE]; // Index + 1 of the stair that covers each cell, 0 if there isn't one.
+};
+
+List(ElevationChunk) elevationChunks;
+List(int) elevationChunkTable; // Open addressed, index + 1 into elevationChunks. The size is always a power of 2.
+
+static int FloorDivide(int a, int b)
+{
+	return a >= 0 ? a / b : (a - b + 1) / b;
+}
+static unsigned HashElevationChunk(int x, int y)
+{
+	return (unsigned)x * 73856093u ^ (unsigned)y * 19349663u;
+}
+static ElevationChunk *FindElevationChunk(int x, int y)
+{
+	int tableSize = ListCount(elevationChunkTable);
+	if (tableSize == 0)
+		return NULL;
+	for (unsigned i = HashElevationChunk(x, y) & (tableSize - 1);; i = (i + 1) & (tableSize - 1))
+	{
+		int index = elevationChunkTable[i];
+		if (index == 0)
+			return NULL;
+		ElevationChunk *chunk = &elevationChunks[index - 1];
+		if (chunk->x == x and chunk->y == y)
+			return chunk;
+	}
+}
+static void AddToElevationChunkTable(int chunkIndex)
+{
+	int tableSize = ListCount(elevationChunkTable);
+	ElevationChunk *chunk = &elevationChunks[chunkIndex];
+	unsigned i = HashElevationChunk(chunk->x, chunk->y) & (tableSize - 1);
+	while (elevationChunkTable[i] != 0)
+		i = (i + 1) & (tableSize - 1);
+	elevationChunkTable[i] = chunkIndex + 1;
+}
+static ElevationChunk *GetOrAddElevationChunk(int x, int y)
+{
+	ElevationChunk *chunk = FindElevationChunk(x, y);
+	if (chunk)
+		return chunk;
+
+	chunk = ListAllocateItem(&elevationChunks);
+	ZeroBytes(chunk, sizeof chunk[0]);
+	chunk->x = x;
+	chunk->y = y;
+
+	// Keep the table at most half full.
+	int numChunks = ListCount(elevationChunks);
+	if (2 * numChunks > ListCount(elevationChunkTable))
+	{
+		int tableSize = ListCount(elevationChunkTable) ? 2 * ListCount(elevationChunkTable) : 64;
+		ListClear(elevationChunkTable);
+		SetInts(ListAllocate(&elevationChunkTable, tableSize), 0, tableSize);
+		for (int i = 0; i < numChunks; ++i)
+			AddToElevationChunkTable(i);
+	}
+	else
+		AddToElevationChunkTable(numChunks - 1);
+	return &elevationChunks[numChunks - 1];
+}
+// Sets every cell of the stair that's inside of the area [x0, x1) x [y0, y1).
+static void WriteStairCells(int stairIndex, int x0, int y0, int x1, int y1)
+{
+	Stair stair = stairs[stairIndex];
+	x0 = stair.x0 > x0 ? stair.x0 : x0;
+	y0 = stair.y0 > y0 ? stair.y0 : y0;
+	x1 = stair.x1 < x1 ? stair.x1 : x1;
+	y1 = stair.y1 < y1 ? stair.y1 : y1;
+	for (int y = y0; y < y1; ++y)
 	{
-		Stair *stair = &stairs[i];
-		if (x >= stair->x0 and
-			y >= stair->y0 and
-			x < stair->x1 and
-			y < stair->y1)
+		for (int x = x0; x < x1; ++x)
 		{
-			return stair;
+			int chunkX = FloorDivide(x, ELEVATION_CHUNK_SIZE);
+			int chunkY = FloorDivide(y, ELEVATION_CHUNK_SIZE);
+			ElevationChunk *chunk = GetOrAddElevationChunk(chunkX, chunkY);
+			int cellX = x - chunkX * ELEVATION_CHUNK_SIZE;
+			int cellY = y - chunkY * ELEVATION_CHUNK_SIZE;
+			chunk->stairs[cellY * ELEVATION_CHUNK_SIZE + cellX] = stairIndex + 1;
 		}
 	}
-	return NULL;
+}
+// Bakes the cells in the area [x0, x1) x [y0, y1) again. Call this with the old and the new area of every stair that was added, removed or moved.
+void UpdateElevationMap(int x0, int y0, int x1, int y1)
+{
+	for (int y = y0; y < y1; ++y)
+	{
+		for (int x = x0; x < x1; ++x)
+		{
+			int chunkX = FloorDivide(x, ELEVATION_CHUNK_SIZE);
+			int chunkY = FloorDivide(y, ELEVATION_CHUNK_SIZE);
+			ElevationChunk *chunk = FindElevationChunk(chunkX, chunkY);
+			if (chunk)
+				chunk->stairs[(y - chunkY * ELEVATION_CHUNK_SIZE) * ELEVATION_CHUNK_SIZE + (x - chunkX * ELEVATION_CHUNK_SIZE)] = 0;
+		}
+	}
+
+	// Where stairs overlap, the one that comes first wins, so they're written last.
+	for (int i = ListCount(stairs) - 1; i >= 0; --i)
+		WriteStairCells(i, x0, y0, x1, y1);
+
+	// Objects standing on these cells could be higher or lower now.
+	areObjectBoundsDirty = true;
+}
+void RebuildElevationMap(void)
+{
+	ListClear(elevationChunks);
+	ListClear(elevationChunkTable);
+	for (int i = ListCount(stairs) - 1; i >= 0; --i)
+		WriteStairCells(i, INT_MIN, INT_MIN, INT_MAX, INT_MAX);
+	areObjectBoundsDirty = true;
+}
+Stair *GetStairAt(Vector2 gridPoint)
+{
+	int x = (int)floorf(gridPoint.x);
+	int y = (int)floorf(gridPoint.y);
+	int chunkX = FloorDivide(x, ELEVATION_CHUNK_SIZE);
+	int chunkY = FloorDivide(y, ELEVATION_CHUNK_SIZE);
+	ElevationChunk *chunk = FindElevationChunk(chunkX, chunkY);
+	if (not chunk)
+		return NULL;
+	int index = chunk->stairs[(y - chunkY * ELEVATION_CHUNK_SIZE) * ELEVATION_CHUNK_SIZE + (x - chunkX * ELEVATION_CHUNK_SIZE)];
+	return index ? &stairs[index - 1] : NULL;
+}
+int GetElevationAt(Vector2 gridPoint)
+{
+	Stair *stair = GetStairAt(gridPoint);
+	return stair ? stair->elevation : 0;
 }
 
 void CenterCameraOn(Object *object)
 {
 	camera.target = object->position;
+	previousCameraTarget = camera.target;
 	camera.offset.x = WINDOW_CENTER_X;
 	camera.offset.y = WINDOW_CENTER_Y;
 	camera.zoom = 1;
@@ -386,32 +932,77 @@ void UpdateCameraShake()
 	}
 }
 
+// Every emitter gets its own seed, so two emitters with the same settings don't spit out the exact same particles.
+unsigned numParticleEmittersCreated;
+
+// The object takes over the settings' sprite.
+void SetObjectParticles(Object *object, ParticleEmitterSettings settings)
+{
+	if (object->particles)
+	{
+		if (object->particles->settings.sprite != settings.sprite)
+			ReleaseAsset(object->particles->settings.sprite);
+		SetParticleEmitterSettings(object->particles, settings);
+	}
+	else
+		object->particles = CreateParticleEmitter(settings, BitNoise1(0, (int)numParticleEmittersCreated++));
+}
+void RemoveObjectParticles(Object *object)
+{
+	if (not object->particles)
+		return;
+	ReleaseAsset(object->particles->settings.sprite);
+	DestroyParticleEmitter(object->particles);
+	object->particles = NULL;
+}
+// 'to' has to be a fresh object from AddObject or InsertObject, because it keeps its own details.
 void Clone(Object *from, Object *to)
 {
+	ObjectDetails *details = to->details;
 	CopyBytes(to, from, sizeof to[0]);
-	to->script = (Script *)CloneAsset(from->script);
-	to->collisionMap = (Image *)CloneAsset(from->collisionMap);
-	for (int i = 0; i < COUNTOF(from->expressions); ++i)
-		to->expressions[i].portrait = (Texture *)CloneAsset(from->expressions[i].portrait);
+	CopyBytes(details, from->details, sizeof details[0]);
+	to->details = details;
+	details->script = (Script *)CloneAsset(from->details->script);
+	to->collisionMap = (CollisionMap *)CloneAsset(from->collisionMap);
+	to->motionMaster.waypoints = NULL; // The path and the path request belong to the original.
+	to->motionMaster.pathRequest = 0;
+	for (int i = 0; i < COUNTOF(details->expressions); ++i)
+		details->expressions[i].portrait = (Sprite *)CloneAsset(from->details->expressions[i].portrait);
 	for (int direction = 0; direction < DIRECTION_ENUM_COUNT; ++direction)
 		to->sprites[direction] = (Sprite *)CloneAsset(from->sprites[direction]);
+	to->particles = NULL; // The clone starts without any particles of its own.
+	if (from->particles)
+	{
+		ParticleEmitterSettings settings = from->particles->settings;
+		settings.sprite = (Sprite *)CloneAsset(settings.sprite);
+		SetObjectParticles(to, settings);
+	}
 }
 void Destroy(Object *object)
 {
-	ReleaseAsset(object->script);
+	if (object->details)
+	{
+		ReleaseAsset(object->details->script);
+		for (int i = 0; i < COUNTOF(object->details->expressions); ++i)
+			ReleaseAsset(object->details->expressions[i].portrait);
+		MemFree(object->details);
+	}
 	ReleaseAsset(object->collisionMap);
-	for (int i = 0; i < COUNTOF(object->expressions); ++i)
-		ReleaseAsset(object->expressions[i].portrait);
 	for (int direction = 0; direction < DIRECTION_ENUM_COUNT; ++direction)
 		ReleaseAsset(object->sprites[direction]);
+	RemoveObjectParticles(object);
+	ListDestroy((void **)&object->motionMaster.waypoints);
+	CancelNavPath(&navGrid, object->motionMaster.pathRequest);
 	ZeroBytes(object, sizeof object[0]);
 }
+// This runs on the job threads, so it can only touch the object itself. See UpdateObjectRange.
 void Update(Object *object)
 {
 	// update sprites
 	Sprite *sprite = GetCurrentSprite(object);
-	if (sprite)
+	if (sprite and not object->isStatic)
 	{
+		int previousFrame = object->animationFrame;
 		float animationFrameTime = 1 / object->animationFps;
 		object->animationTimeAccumulator += FRAME_TIME;
 		while (object->animationTimeAccumulator > animationFrameTime)
@@ -419,6 +1010,10 @@ void Update(Object *object)
 			object->animationTimeAccumulator -= animationFrameTime;
 			object->animationFrame = (object->animationFrame + 1) % sprite->numFrames;
 		}
+
+		// Frames can have different sizes, which moves the feet.
+		if (object->animationFrame != previousFrame)
+			object->hasStaleBounds = true;
 	}
 
 	// update motion
@@ -429,153 +1024,896 @@ void Update(Object *object)
 		object->position = object->motionMaster.currentPoint;
 		auto dirVector = object->motionMaster.GetDirection();
 		object->direction = DirectionFromVector(dirVector);
+		object->hasStaleBounds = true;
 	}
 
+	// Static objects can still emit particles, those are drawn on their own anyway.
+	// The particles move every frame, so their part of the culling rectangle has to be updated too.
+	if (object->particles)
+	{
+		UpdateParticleEmitter(object->particles, Vector2{ object->position.x, object->position.y + object->elevationOffset }, FRAME_TIME);
+		object->hasStaleBounds = true;
+	}
 }
-void Render(Object *object)
+void UpdateObjectRange(int begin, int end, void *userData)
 {
-	Sprite *sprite = GetCurrentSprite(object);
-	if (not sprite)
-		return;
-
-	Vector2 position = object->position;
-	Vector2 feet = GetFootPositionInScreenSpace(object);
-	Stair *stair = GetStairAt(WorldToGrid(feet));
-	if (stair)
-		position.y += ELEVATION_TO_Y_OFFSET * stair->elevation;
-
-	if (sprite == object->sprites[object->direction])
-		DrawTextureCentered(sprite->frames[object->animationFrame], position, WHITE);
-	else
-		DrawTextureCenteredAndFlippedVertically(sprite->frames[object->animationFrame], position, WHITE);
+	UNUSED(userData);
+	for (int i = begin; i < end; ++i)
+		Update(GetObject(i));
 }
-
-void LoadScene(const char *path)
+// Interpolation is how far between the previous and the current position the object should be drawn, see GetRenderInterpolation.
+void Render(Object *object, float interpolation)
 {
-	unsigned dataSize;
-	unsigned char *data = LoadFileData(path, &dataSize);
-	if (not data)
+	Sprite *sprite = GetCurrentSprite(object);
+	if (sprite)
 	{
-		if (not FileExists(path))
-			LogError("Couldn't load scene from '%s' because that file doesn't exist.", path);
+		Vector2 position = Vector2Lerp(object->previousPosition, object->position, interpolation);
+		position.y += object->elevationOffset;
+
+		if (sprite == object->sprites[object->direction])
+			DrawSpriteFrameCentered(sprite->frames[object->animationFrame], position, WHITE);
 		else
-			LogError("Couldn't load scene from '%s' because we failed to load the file contents.", path);
-		return;
+			DrawSpriteFrameCenteredAndFlippedVertically(sprite->frames[object->animationFrame], position, WHITE);
 	}
 
-	BinaryStream stream = { 0 };
-	stream.buffer = data;
-	stream.size = (int)dataSize;
-	stream.cursor = 0;
+	// The particles are in front of the object, and sorted with it, so they're behind everything that's in front of it.
+	if (object->particles)
+		DrawParticles(object->particles, interpolation);
+}
 
-	const void *magic = ReadBytes(&stream, 4);
-	if (not BytesEqual(magic, SCENE_MAGIC, 4))
-	{
-		UnloadFileData(data);
-		LogError("Couldn't load scene from '%s' because it isn't a scene file.", path);
-		return;
-	}
+// Scene files start with a header and a directory of chunks, and each chunk has its own version.
+// That way a chunk's format can change without touching the others, and the loader only needs
+// to know how to migrate old versions of the chunk that changed.
+//
+// Every string in the scene goes into a single deduplicated string table, and everything else
+// refers to strings by their index. Objects and stairs are stored as fixed-stride records, all
+// 4-byte aligned, so they're read in place straight out of the file data without any parsing.
+// New fields can be appended to the end of a record, and records from older files that are
+// shorter than the current one just get their missing fields zeroed.
+
+#define SCENE_STRINGS_CHUNK "STRS"
+#define SCENE_STRINGS_VERSION 1
+#define SCENE_OBJECTS_CHUNK "OBJS"
+#define SCENE_OBJECTS_VERSION 1
+#define SCENE_STAIRS_CHUNK "STAI"
+#define SCENE_STAIRS_VERSION 1
+#define SCENE_DEPENDENCIES_CHUNK "DEPS"
+#define SCENE_DEPENDENCIES_VERSION 1
+#define SCENE_LIGHTING_CHUNK "LGHT"
+#define SCENE_LIGHTING_VERSION 1
+#define SCENE_NUM_CHUNKS 5
+
+STRUCT(SceneChunk)
+{
+	char id[4];
+	int version;
+	int offset; // From the start of the file.
+	int size;
+};
 
-	int version = ReadInt(&stream);
-	if (version != SCENE_VERSION)
-	{
-		UnloadFileData(data);
-		LogError("Couldn't load scene from '%s' because it's version is %d, but we only handle version %d.", path, version, SCENE_VERSION);
-		return;
-	}
+// All the ints that aren't enums are string table indices. Index 0 is always the empty string.
+STRUCT(SceneObjectRecord)
+{
+	int name;
+	Vector2 position;
+	float zOffset;
+	float animationFps;
+	float talkRange;
+	int autoTalkInRange;
+	int direction;
+	int script;
+	int collisionMap;
+	int sprites[DIRECTION_ENUM_COUNT];
+	int expressionNames[10];
+	int expressionPortraits[10];
+	int isStatic;
+	int particleBudget; // 0 if the object doesn't emit particles.
+	int particleSprite;
+	float particleRate;
+	float particleLifetime;
+	float particleLifetimeVariance;
+	float particleSpawnRadius;
+	Vector2 particleVelocity;
+	float particleVelocitySpread;
+	Vector2 particleAcceleration;
+	float particleTurbulence;
+	float particleTurbulenceScale;
+	float particleStartSize;
+	float particleEndSize;
+	Color particleStartColor;
+	Color particleEndColor;
+	float lightRadius;
+	Color lightColor;
+};
 
-	Object newObjects[COUNTOF(objects)];
-	ZeroBytes(newObjects, sizeof newObjects);
+// Lighting that belongs to the whole scene, and not to any object. There's always exactly one of these records.
+STRUCT(SceneLightingRecord)
+{
+	Color ambientLight;
+};
 
-	int newNumObjects = ReadInt(&stream);
-	for (int i = 0; i < newNumObjects; ++i)
-	{
-		Object *object = &newObjects[i];
-		const char *name = ReadString(&stream);
-		CopyString(object->name, name, sizeof object->name);
-		
-		object->position.x = ReadFloat(&stream);
-		object->position.y = ReadFloat(&stream);
-		object->zOffset = ReadFloat(&stream);
-		object->animationFps = ReadFloat(&stream);
-		object->talkRange = ReadFloat(&stream);
-		object->autoTalkInRange = ReadBool(&stream);
-		object->direction = (Direction)ReadInt(&stream);
-		object->script = AcquireScript(ReadString(&stream), roboto, robotoBold, robotoItalic, robotoBoldItalic);
-		object->collisionMap = AcquireCollisionMap(ReadString(&stream));
-		for (int dir = 0; dir < DIRECTION_ENUM_COUNT; ++dir)
-			object->sprites[dir] = AcquireSprite(ReadString(&stream));
-		for (int j = 0; j < COUNTOF(object->expressions); ++j)
-		{
-			Expression *expression = &object->expressions[j];
-			const char *expressionName = ReadString(&stream);
-			CopyString(expression->name, expressionName, sizeof expression->name);
-			expression->portrait = AcquireTexture(ReadString(&stream));
-		}
-	}
+// The dependency manifest lists every asset that the scene needs, so it can be prefetched without loading the scene.
+ENUM(SceneDependencyKind)
+{
+	SCENE_DEPENDENCY_SCRIPT,
+	SCENE_DEPENDENCY_COLLISION_MAP,
+	SCENE_DEPENDENCY_SPRITE,
+};
 
-	for (int i = 0; i < numObjects; ++i)
-		Destroy(&objects[i]);
+STRUCT(SceneDependencyRecord)
+{
+	int path;
+	int kind;
+	int size; // Of the file, or of all files in the directory, in bytes.
+};
 
-	numObjects = newNumObjects;
-	CopyBytes(objects, newObjects, newNumObjects * sizeof objects[0]);
-	numStairs = ReadInt(&stream);
-	ReadBytesInto(&stream, stairs, numStairs * sizeof stairs[0]);
+STRUCT(SceneStringTable)
+{
+	int numStrings;
+	const int *offsets; // From the start of the string data.
+	const char *strings;
+	int stringsSize;
+};
 
-	UnloadFileData(data);
-	LogInfo("Successfully loaded scene '%s'.", path);
-	CopyString(options.scene, path, sizeof options.scene);
-	
-	if (GetCurrentGameState() == GAMESTATE_TALKING)
-		PopGameState();
-	
-	CenterCameraOn(&objects[0]);
+static const SceneChunk *FindSceneChunk(const SceneChunk chunks[], int numChunks, const char *id)
+{
+	for (int i = 0; i < numChunks; ++i)
+		if (BytesEqual(chunks[i].id, id, 4))
+			return &chunks[i];
+	return NULL;
 }
-void SaveScene(const char *path)
+
+static const char *GetSceneString(const SceneStringTable *table, int index)
 {
-	int maxBytes = 32 * 1024; // 32kB should be plenty!
-	void *data = TempAlloc(maxBytes);
+	if (index <= 0 or index >= table->numStrings)
+		return "";
+	int offset = table->offsets[index];
+	if (offset < 0 or offset >= table->stringsSize)
+		return "";
+	return table->strings + offset;
+}
 
-	BinaryStream stream = { 0 };
-	stream.buffer = data;
-	stream.size = maxBytes;
+static bool ReadSceneStringTable(BinaryStream *stream, const SceneChunk *chunk, SceneStringTable *table)
+{
+	ZeroBytes(table, sizeof table[0]);
+	if (not chunk)
+		return true; // A scene without any strings is weird, but fine.
+	if (chunk->version != SCENE_STRINGS_VERSION)
+		return false;
+
+	BinaryStream chunkStream = { 0 };
+	chunkStream.buffer = (char *)stream->buffer + chunk->offset;
+	chunkStream.size = chunk->size;
+	table->numStrings = ReadInt(&chunkStream);
+	if (table->numStrings < 0 or table->numStrings > chunk->size / (int)sizeof(int))
+		return false;
+	table->offsets = (const int *)ReadBytes(&chunkStream, table->numStrings * sizeof(int));
+	if (not table->offsets)
+		return false;
+	table->strings = (const char *)chunkStream.buffer + chunkStream.cursor;
+	table->stringsSize = chunkStream.size - chunkStream.cursor;
+
+	// Every string ends on a 0, so a 0 at the very end means none of them can run past the chunk.
+	return table->stringsSize == 0 or table->strings[table->stringsSize - 1] == 0;
+}
+
+// Returns a pointer to record 'index' of a fixed-stride chunk. If the records in the file are older and
+// shorter than the ones we know about, the record is copied into 'scratch' and the missing fields are zeroed.
+static const void *GetSceneRecord(BinaryStream *chunkStream, int firstRecordOffset, int stride, int index, void *scratch, int recordSize)
+{
+	const char *record = (const char *)chunkStream->buffer + firstRecordOffset + index * stride;
+	if (stride >= recordSize)
+		return record;
+
+	ZeroBytes(scratch, recordSize);
+	CopyBytes(scratch, record, stride);
+	return scratch;
+}
+
+static bool ReadSceneRecordsHeader(BinaryStream *chunkStream, int *numRecords, int *stride)
+{
+	*numRecords = ReadInt(chunkStream);
+	*stride = ReadInt(chunkStream);
+	if (*numRecords < 0 or *stride <= 0 or *stride % 4 != 0)
+		return false;
+	return (chunkStream->size - chunkStream->cursor) / *stride >= *numRecords;
+}
+
+// Objects are loaded into a separate list first, so that a broken scene file doesn't destroy the current scene.
+static Object *AddStagedObject(List(Object) *newObjects)
+{
+	Object *object = ListAllocateItem(newObjects);
+	ZeroBytes(object, sizeof object[0]);
+	object->details = CreateObjectDetails();
+	return object;
+}
+
+static bool ReadSceneChunks(BinaryStream *stream, const SceneChunk **outChunks, int *outNumChunks)
+{
+	int numChunks = ReadInt(stream);
+	const SceneChunk *chunks = (const SceneChunk *)ReadBytes(stream, numChunks * sizeof(SceneChunk));
+	if (numChunks < 0 or not chunks)
+		return false;
+	for (int i = 0; i < numChunks; ++i)
+	{
+		const SceneChunk *chunk = &chunks[i];
+		if (chunk->offset < 0 or chunk->size < 0 or chunk->offset % 4 != 0 or chunk->offset > stream->size - chunk->size)
+			return false;
+	}
+	*outChunks = chunks;
+	*outNumChunks = numChunks;
+	return true;
+}
+
+static bool LoadSceneObjectsV6(BinaryStream *stream, List(Object) *newObjects, List(Stair) *newStairs, Color *newAmbientLight)
+{
+	const SceneChunk *chunks;
+	int numChunks;
+	if (not ReadSceneChunks(stream, &chunks, &numChunks))
+		return false;
+
+	SceneStringTable strings;
+	if (not ReadSceneStringTable(stream, FindSceneChunk(chunks, numChunks, SCENE_STRINGS_CHUNK), &strings))
+		return false;
+
+	const SceneChunk *objectsChunk = FindSceneChunk(chunks, numChunks, SCENE_OBJECTS_CHUNK);
+	if (objectsChunk)
+	{
+		if (objectsChunk->version != SCENE_OBJECTS_VERSION)
+			return false;
+
+		BinaryStream chunkStream = { 0 };
+		chunkStream.buffer = (char *)stream->buffer + objectsChunk->offset;
+		chunkStream.size = objectsChunk->size;
+		int numRecords, stride;
+		if (not ReadSceneRecordsHeader(&chunkStream, &numRecords, &stride))
+			return false;
+
+		for (int i = 0; i < numRecords; ++i)
+		{
+			SceneObjectRecord scratch;
+			const SceneObjectRecord *record = (const SceneObjectRecord *)GetSceneRecord(&chunkStream, chunkStream.cursor, stride, i, &scratch, sizeof scratch);
+			Object *object = AddStagedObject(newObjects);
+			ObjectDetails *details = object->details;
+			CopyString(details->name, GetSceneString(&strings, record->name), sizeof details->name);
+			object->position = record->position;
+			object->zOffset = record->zOffset;
+			object->animationFps = record->animationFps;
+			object->talkRange = record->talkRange;
+			object->autoTalkInRange = record->autoTalkInRange != 0;
+			object->direction = (Direction)ClampInt(record->direction, 0, DIRECTION_ENUM_COUNT - 1);
+			object->isStatic = record->isStatic != 0;
+			object->lightRadius = record->lightRadius;
+			object->lightColor = record->lightColor;
+			details->script = AcquireScript(GetSceneString(&strings, record->script), roboto, robotoBold, robotoItalic, robotoBoldItalic);
+			object->collisionMap = AcquireCollisionMap(GetSceneString(&strings, record->collisionMap));
+			for (int dir = 0; dir < DIRECTION_ENUM_COUNT; ++dir)
+				object->sprites[dir] = AcquireSprite(GetSceneString(&strings, record->sprites[dir]));
+			for (int j = 0; j < COUNTOF(details->expressions) and j < COUNTOF(record->expressionNames); ++j)
+			{
+				Expression *expression = &details->expressions[j];
+				CopyString(expression->name, GetSceneString(&strings, record->expressionNames[j]), sizeof expression->name);
+				expression->portrait = AcquireSprite(GetSceneString(&strings, record->expressionPortraits[j]));
+			}
+			if (record->particleBudget > 0)
+			{
+				ParticleEmitterSettings settings;
+				settings.sprite = AcquireSprite(GetSceneString(&strings, record->particleSprite));
+				settings.budget = record->particleBudget;
+				settings.rate = record->particleRate;
+				settings.lifetime = record->particleLifetime;
+				settings.lifetimeVariance = record->particleLifetimeVariance;
+				settings.spawnRadius = record->particleSpawnRadius;
+				settings.velocity = record->particleVelocity;
+				settings.velocitySpread = record->particleVelocitySpread;
+				settings.acceleration = record->particleAcceleration;
+				settings.turbulence = record->particleTurbulence;
+				settings.turbulenceScale = record->particleTurbulenceScale;
+				settings.startSize = record->particleStartSize;
+				settings.endSize = record->particleEndSize;
+				settings.startColor = record->particleStartColor;
+				settings.endColor = record->particleEndColor;
+				SetObjectParticles(object, settings);
+			}
+		}
+	}
+
+	const SceneChunk *stairsChunk = FindSceneChunk(chunks, numChunks, SCENE_STAIRS_CHUNK);
+	if (stairsChunk)
+	{
+		if (stairsChunk->version != SCENE_STAIRS_VERSION)
+			return false;
+
+		BinaryStream chunkStream = { 0 };
+		chunkStream.buffer = (char *)stream->buffer + stairsChunk->offset;
+		chunkStream.size = stairsChunk->size;
+		int numRecords, stride;
+		if (not ReadSceneRecordsHeader(&chunkStream, &numRecords, &stride))
+			return false;
+
+		for (int i = 0; i < numRecords; ++i)
+		{
+			Stair scratch;
+			const Stair *record = (const Stair *)GetSceneRecord(&chunkStream, chunkStream.cursor, stride, i, &scratch, sizeof scratch);
+			ListAdd(newStairs, *record);
+		}
+	}
+
+	const SceneChunk *lightingChunk = FindSceneChunk(chunks, numChunks, SCENE_LIGHTING_CHUNK);
+	if (lightingChunk)
+	{
+		if (lightingChunk->version != SCENE_LIGHTING_VERSION)
+			return false;
+
+		BinaryStream chunkStream = { 0 };
+		chunkStream.buffer = (char *)stream->buffer + lightingChunk->offset;
+		chunkStream.size = lightingChunk->size;
+		int numRecords, stride;
+		if (not ReadSceneRecordsHeader(&chunkStream, &numRecords, &stride) or numRecords != 1)
+			return false;
+
+		SceneLightingRecord scratch;
+		const SceneLightingRecord *record = (const SceneLightingRecord *)GetSceneRecord(&chunkStream, chunkStream.cursor, stride, 0, &scratch, sizeof scratch);
+		*newAmbientLight = record->ambientLight;
+	}
+
+	return true;
+}
+
+// This is the old format that was just everything written out one after the other.
+// We still load it so that old scenes keep working, but we always save in the new format.
+static bool LoadSceneObjectsV5(BinaryStream *stream, List(Object) *newObjects, List(Stair) *newStairs)
+{
+	// Every object takes up way more than 1 byte, so this catches garbage counts before we try to load them.
+	int numObjects = ReadInt(stream);
+	if (numObjects < 0 or numObjects > stream->size - stream->cursor)
+		return false;
 
-	WriteBytes(&stream, SCENE_MAGIC, 4);
-	WriteInt(&stream, SCENE_VERSION);
-	WriteInt(&stream, numObjects);
 	for (int i = 0; i < numObjects; ++i)
 	{
-		Object *object = &objects[i];
+		Object *object = AddStagedObject(newObjects);
+		ObjectDetails *details = object->details;
+		const char *name = ReadString(stream);
+		CopyString(details->name, name, sizeof details->name);
 		
-		WriteString(&stream, object->name);
-		WriteFloat(&stream, object->position.x);
-		WriteFloat(&stream, object->position.y);
-		WriteFloat(&stream, object->zOffset);
-		WriteFloat(&stream, object->animationFps);
-		WriteFloat(&stream, object->talkRange);
-		WriteBool(&stream, object->autoTalkInRange);
-		WriteInt(&stream, object->direction);
-		WriteString(&stream, GetAssetPath(object->script));
-		WriteString(&stream, GetAssetPath(object->collisionMap));
+		object->position.x = ReadFloat(stream);
+		object->position.y = ReadFloat(stream);
+		object->zOffset = ReadFloat(stream);
+		object->animationFps = ReadFloat(stream);
+		object->talkRange = ReadFloat(stream);
+		object->autoTalkInRange = ReadBool(stream);
+		object->direction = (Direction)ReadInt(stream);
+		details->script = AcquireScript(ReadString(stream), roboto, robotoBold, robotoItalic, robotoBoldItalic);
+		object->collisionMap = AcquireCollisionMap(ReadString(stream));
 		for (int dir = 0; dir < DIRECTION_ENUM_COUNT; ++dir)
-			WriteString(&stream, GetAssetPath(object->sprites[dir]));
-		for (int j = 0; j < COUNTOF(object->expressions); ++j)
+			object->sprites[dir] = AcquireSprite(ReadString(stream));
+		for (int j = 0; j < COUNTOF(details->expressions); ++j)
+		{
+			Expression *expression = &details->expressions[j];
+			const char *expressionName = ReadString(stream);
+			CopyString(expression->name, expressionName, sizeof expression->name);
+			expression->portrait = AcquireSprite(ReadString(stream));
+		}
+	}
+
+	int numStairs = ReadInt(stream);
+	if (numStairs < 0 or numStairs > (stream->size - stream->cursor) / (int)sizeof(Stair))
+		return false;
+	ReadBytesInto(stream, ListAllocate(newStairs, numStairs), numStairs * sizeof(Stair));
+	return true;
+}
+
+// Reads the objects, stairs and lighting of a scene file, without touching the current scene.
+// The lists should use temporary storage. If this fails, nothing is left in the lists that has to be released.
+static bool LoadSceneFile(const char *path, List(Object) *newObjects, List(Stair) *newStairs, Color *newAmbientLight)
+{
+	*newAmbientLight = WHITE; // Scenes from before lighting are fully lit.
+
+	unsigned dataSize;
+	unsigned char *data = LoadFileData(path, &dataSize);
+	if (not data)
+	{
+		if (not ResourceExists(path))
+			LogError("Couldn't load scene from '%s' because that file doesn't exist.", path);
+		else
+			LogError("Couldn't load scene from '%s' because we failed to load the file contents.", path);
+		return false;
+	}
+
+	BinaryStream stream = { 0 };
+	stream.buffer = data;
+	stream.size = (int)dataSize;
+	stream.cursor = 0;
+
+	const void *magic = ReadBytes(&stream, 4);
+	if (not magic or not BytesEqual(magic, SCENE_MAGIC, 4))
+	{
+		UnloadFileData(data);
+		LogError("Couldn't load scene from '%s' because it isn't a scene file.", path);
+		return false;
+	}
+
+	int version = ReadInt(&stream);
+	if (version != SCENE_VERSION and version != 5)
+	{
+		UnloadFileData(data);
+		LogError("Couldn't load scene from '%s' because it's version is %d, but we only handle versions 5 to %d.", path, version, SCENE_VERSION);
+		return false;
+	}
+
+	bool success;
+	if (version == 5)
+		success = LoadSceneObjectsV5(&stream, newObjects, newStairs);
+	else
+		success = LoadSceneObjectsV6(&stream, newObjects, newStairs, newAmbientLight);
+
+	UnloadFileData(data);
+	if (not success)
+	{
+		// Some of the objects might have acquired assets before we noticed, so we have to release those.
+		for (int i = 0; i < ListCount(*newObjects); ++i)
+			Destroy(&(*newObjects)[i]);
+		ListClear(*newObjects);
+		ListClear(*newStairs);
+		LogError("Couldn't load scene from '%s' because the file is corrupted.", path);
+		return false;
+	}
+	return true;
+}
+
+void LoadScene(const char *path);
+bool PrefetchScene(const char *path);
+
+// Prefetched assets are held until the next scene is loaded, so they can't be unloaded before the scene gets to use them.
+static List(void *) prefetchedAssets;
+
+static void ReleasePrefetchedAssets(void)
+{
+	for (int i = 0; i < ListCount(prefetchedAssets); ++i)
+		ReleaseAsset(prefetchedAssets[i]);
+	ListClear(prefetchedAssets);
+}
+
+#ifdef __EMSCRIPTEN__
+static void OnPrefetchPackFetched(const char *packPath, bool success, void *userData)
+{
+	char *path = (char *)userData;
+	if (success)
+		PrefetchScene(path);
+	else
+		LogError("Couldn't prefetch scene '%s' because its pack '%s' couldn't be downloaded.", path, packPath);
+	MemFree(path);
+}
+#endif
+
+#ifdef __EMSCRIPTEN__
+static void OnScenePackFetched(const char *packPath, bool success, void *userData)
+{
+	char *path = (char *)userData;
+	if (success)
+		LoadScene(path);
+	else
+		LogError("Couldn't load scene from '%s' because its pack '%s' couldn't be downloaded.", path, packPath);
+	MemFree(path);
+}
+#endif
+
+void LoadScene(const char *path)
+{
+	// The scene could have just been saved, and still be waiting to be written.
+	if (IsSavingFiles())
+		WaitForSavedFiles();
+
+	// On the web, the assets that only one scene uses are in that scene's own pack, which is downloaded the first time the scene is loaded.
+	#ifdef __EMSCRIPTEN__
+	{
+		const char *packPath = TempFormat("%s%s", path, SCENE_PACK_EXTENSION);
+		if (not ResourceExists(path) and not IsPackMounted(packPath))
+		{
+			int length = StringLength(path);
+			char *pathCopy = (char *)MemAlloc(length + 1);
+			CopyBytes(pathCopy, path, length + 1);
+			FetchPack(packPath, OnScenePackFetched, pathCopy);
+			return;
+		}
+	}
+	#endif
+
+	List(Object) newObjects = NULL;
+	List(Stair) newStairs = NULL;
+	ListSetAllocator((void **)&newObjects, TempRealloc, TempFree);
+	ListSetAllocator((void **)&newStairs, TempRealloc, TempFree);
+	Color newAmbientLight;
+	if (not LoadSceneFile(path, &newObjects, &newStairs, &newAmbientLight))
+	{
+		ListDestroy((void **)&newObjects);
+		ListDestroy((void **)&newStairs);
+		return;
+	}
+
+	RemoveAllObjects();
+	for (int i = 0; i < ListCount(newObjects); ++i)
+	{
+		Object *object = InsertObjectSlot(numObjects);
+		CopyBytes(object, &newObjects[i], sizeof object[0]);
+		object->previousPosition = object->position;
+	}
+	EnsurePlayer();
+	ListClear(stairs);
+	CopyBytes(ListAllocate(&stairs, ListCount(newStairs)), newStairs, ListCount(newStairs) * sizeof stairs[0]);
+	ListDestroy((void **)&newObjects);
+	ListDestroy((void **)&newStairs);
+	RebuildElevationMap();
+	areObjectBoundsDirty = true;
+	isNavGridDirty = true;
+	ambientLight = newAmbientLight;
+	areOccludersDirty = true;
+
+	// The new objects hold their own references now.
+	ReleasePrefetchedAssets();
+
+	LogMessage(LOG_CATEGORY_SCENES, LOG_INFO, "Successfully loaded scene '%s'.", path);
+	CopyString(options.scene, path, sizeof options.scene);
+	
+	if (GetCurrentGameState() == GAMESTATE_TALKING)
+		PopGameState();
+	
+	CenterCameraOn(player);
+}
+
+// Starts loading all assets in the scene's dependency manifest, without loading the scene itself. With asset streaming on,
+// sprites and collision maps are decoded in the background, so by the time the scene is loaded they're usually ready.
+// Returns false if the scene couldn't be read, or doesn't have a manifest because it was saved before scenes had them.
+bool PrefetchScene(const char *path)
+{
+	#ifdef __EMSCRIPTEN__
+	{
+		const char *packPath = TempFormat("%s%s", path, SCENE_PACK_EXTENSION);
+		if (not ResourceExists(path) and not IsPackMounted(packPath))
 		{
-			Expression *expression = &object->expressions[j];
-			WriteString(&stream, expression->name);
-			WriteString(&stream, GetAssetPath(expression->portrait));
+			int length = StringLength(path);
+			char *pathCopy = (char *)MemAlloc(length + 1);
+			CopyBytes(pathCopy, path, length + 1);
+			FetchPack(packPath, OnPrefetchPackFetched, pathCopy);
+			return true;
 		}
 	}
-	WriteInt(&stream, numStairs);
-	WriteBytes(&stream, stairs, numStairs * sizeof stairs[0]);
+	#endif
 
-	if (SaveFileData(path, stream.buffer, (unsigned)stream.cursor))
+	unsigned dataSize;
+	unsigned char *data = LoadFileData(path, &dataSize);
+	if (not data)
 	{
-		LogInfo("Successfully saved current scene to '%s'.", path);
-		CopyString(options.scene, path, sizeof options.scene);
+		LogError("Couldn't prefetch scene '%s' because we failed to load the file.", path);
+		return false;
 	}
+
+	BinaryStream stream = { 0 };
+	stream.buffer = data;
+	stream.size = (int)dataSize;
+
+	bool success = false;
+	const char *error = "the file is corrupted";
+	const void *magic = ReadBytes(&stream, 4);
+	if (not magic or not BytesEqual(magic, SCENE_MAGIC, 4))
+		error = "it isn't a scene file";
+	else if (ReadInt(&stream) != SCENE_VERSION)
+		error = "it's from an older version without a dependency manifest, save it again to fix this";
 	else
-		LogInfo("Couldn't save current scene to '%s'.", path);
+	{
+		const SceneChunk *chunks;
+		int numChunks;
+		SceneStringTable strings;
+		if (ReadSceneChunks(&stream, &chunks, &numChunks) and ReadSceneStringTable(&stream, FindSceneChunk(chunks, numChunks, SCENE_STRINGS_CHUNK), &strings))
+		{
+			const SceneChunk *chunk = FindSceneChunk(chunks, numChunks, SCENE_DEPENDENCIES_CHUNK);
+			if (not chunk)
+				error = "it doesn't have a dependency manifest, save it again to fix this";
+			else if (chunk->version == SCENE_DEPENDENCIES_VERSION)
+			{
+				BinaryStream chunkStream = { 0 };
+				chunkStream.buffer = (char *)stream.buffer + chunk->offset;
+				chunkStream.size = chunk->size;
+				int numRecords, stride;
+				if (ReadSceneRecordsHeader(&chunkStream, &numRecords, &stride))
+				{
+					// Images stream in on the job threads, but scripts aren't streamed, so AcquireScript parses them right here on the main thread.
+					// They go last, so the job threads are already busy decoding the images while we parse.
+					int totalSize = 0;
+					for (int k = 0; k < 2 * numRecords; ++k)
+					{
+						int i = k % numRecords;
+						SceneDependencyRecord scratch;
+						const SceneDependencyRecord *record = (const SceneDependencyRecord *)GetSceneRecord(&chunkStream, chunkStream.cursor, stride, i, &scratch, sizeof scratch);
+						if ((record->kind == SCENE_DEPENDENCY_SCRIPT) != (k >= numRecords))
+							continue;
+						const char *dependencyPath = GetSceneString(&strings, record->path);
+						void *asset = NULL;
+						switch (record->kind)
+						{
+							case SCENE_DEPENDENCY_SCRIPT:        asset = AcquireScript(dependencyPath, roboto, robotoBold, robotoItalic, robotoBoldItalic); break;
+							case SCENE_DEPENDENCY_COLLISION_MAP: asset = AcquireCollisionMap(dependencyPath); break;
+							case SCENE_DEPENDENCY_SPRITE:        asset = AcquireSprite(dependencyPath); break;
+							default: break; // Something newer that we don't know how to prefetch yet.
+						}
+						if (not asset)
+							continue;
+
+						// Prefetching the same scene twice doesn't need twice the references.
+						bool isAlreadyHeld = false;
+						for (int j = 0; j < ListCount(prefetchedAssets) and not isAlreadyHeld; ++j)
+							isAlreadyHeld = prefetchedAssets[j] == asset;
+						if (isAlreadyHeld)
+							ReleaseAsset(asset);
+						else
+							ListAdd(&prefetchedAssets, asset);
+						totalSize += record->size;
+					}
+					LogMessage(LOG_CATEGORY_SCENES, LOG_INFO, "Prefetching %d assets (%d kB) of scene '%s'.", numRecords, totalSize / 1024, path);
+					success = true;
+				}
+			}
+		}
+	}
+
+	UnloadFileData(data);
+	if (not success)
+		LogError("Couldn't prefetch scene '%s' because %s.", path, error);
+	return success;
+}
+
+STRUCT(SceneStringTableBuilder)
+{
+	List(const char *) strings;
+	List(unsigned) hashes;
+	List(int) dependencyKinds; // One bit per SceneDependencyKind that was already added for the string.
+	int *table; // Open addressed string indices, -1 if empty. Never more than half full.
+	int tableCapacity;
+};
+
+static void InsertIntoSceneStringTable(SceneStringTableBuilder *builder, int index)
+{
+	for (int i = (int)(builder->hashes[index] & (unsigned)(builder->tableCapacity - 1));; i = (i + 1) & (builder->tableCapacity - 1))
+	{
+		if (builder->table[i] < 0)
+		{
+			builder->table[i] = index;
+			return;
+		}
+	}
+}
+
+static int AddSceneString(SceneStringTableBuilder *builder, const char *string)
+{
+	if (not string or not string[0])
+		return 0;
+
+	unsigned hash = HashString(string);
+	for (int i = (int)(hash & (unsigned)(builder->tableCapacity - 1)); builder->tableCapacity > 0; i = (i + 1) & (builder->tableCapacity - 1))
+	{
+		int index = builder->table[i];
+		if (index < 0)
+			break;
+		if (builder->hashes[index] == hash and StringsEqual(builder->strings[index], string))
+			return index;
+	}
+
+	ListAdd(&builder->strings, string);
+	ListAdd(&builder->hashes, hash);
+	ListAdd(&builder->dependencyKinds, 0);
+	int numStrings = ListCount(builder->strings);
+
+	if (2 * numStrings > builder->tableCapacity)
+	{
+		// The table comes from temp memory like the lists, so the old one is just left behind.
+		builder->tableCapacity = builder->tableCapacity ? 2 * builder->tableCapacity : 256;
+		builder->table = (int *)TempAlloc(builder->tableCapacity * (int)sizeof builder->table[0]);
+		for (int i = 0; i < builder->tableCapacity; ++i)
+			builder->table[i] = -1;
+		for (int i = 1; i < numStrings; ++i)
+			InsertIntoSceneStringTable(builder, i);
+	}
+	else InsertIntoSceneStringTable(builder, numStrings - 1);
+	return numStrings - 1;
+}
+
+// Returns the size of the file, or of all the files inside of the directory. Resources that are only inside of a pack count as 0.
+// This stats every file on the main thread while saving, which is fine for the editor, but don't use it in the game.
+static int GetResourceFileSize(const char *path)
+{
+	if (not FileExists(path))
+		return 0;
+	if (IsPathFile(path))
+		return GetFileLength(path);
+
+	int size = 0;
+	FilePathList files = LoadDirectoryFiles(path);
+	for (unsigned i = 0; i < files.count; ++i)
+		size += GetFileLength(files.paths[i]);
+	UnloadDirectoryFiles(files);
+	return size;
+}
+
+static void AddSceneDependency(List(SceneDependencyRecord) *dependencies, SceneStringTableBuilder *strings, const char *path, SceneDependencyKind kind)
+{
+	int pathIndex = AddSceneString(strings, path);
+	if (pathIndex == 0)
+		return;
+	if (strings->dependencyKinds[pathIndex] & (1 << kind))
+		return;
+	strings->dependencyKinds[pathIndex] |= 1 << kind;
+
+	SceneDependencyRecord *record = ListAllocateItem(dependencies);
+	record->path = pathIndex;
+	record->kind = kind;
+	record->size = GetResourceFileSize(path);
+}
+
+static void BeginSceneChunk(BinaryStream *stream, SceneChunk *chunk, const char *id, int version)
+{
+	WritePadding(stream, 4);
+	CopyBytes(chunk->id, id, 4);
+	chunk->version = version;
+	chunk->offset = stream->cursor;
+}
+
+static void EndSceneChunk(BinaryStream *stream, SceneChunk *chunk)
+{
+	chunk->size = stream->cursor - chunk->offset;
+}
+
+// Writes the whole scene into a growable stream. Free the buffer with MemFree, even if hasFailed is set.
+BinaryStream SerializeScene(void)
+{
+	BinaryStream stream = { 0 };
+	stream.canGrow = true;
+
+	SceneStringTableBuilder strings = { 0 };
+	ListSetAllocator((void **)&strings.strings, TempRealloc, TempFree);
+	ListSetAllocator((void **)&strings.hashes, TempRealloc, TempFree);
+	ListSetAllocator((void **)&strings.dependencyKinds, TempRealloc, TempFree);
+	ListAdd(&strings.strings, ""); // The empty string is always index 0, and never looked up.
+	ListAdd(&strings.hashes, HashString(""));
+	ListAdd(&strings.dependencyKinds, 0);
+
+	List(SceneDependencyRecord) dependencies = NULL;
+	ListSetAllocator((void **)&dependencies, TempRealloc, TempFree);
+
+	SceneChunk chunks[SCENE_NUM_CHUNKS];
+	ZeroBytes(chunks, sizeof chunks);
+
+	WriteBytes(&stream, SCENE_MAGIC, 4);
+	WriteInt(&stream, SCENE_VERSION);
+	WriteInt(&stream, SCENE_NUM_CHUNKS);
+	int chunksOffset = stream.cursor;
+	WriteBytes(&stream, chunks, sizeof chunks); // Filled in at the end once we know where everything is.
+
+	BeginSceneChunk(&stream, &chunks[0], SCENE_OBJECTS_CHUNK, SCENE_OBJECTS_VERSION);
+	{
+		WriteInt(&stream, numObjects);
+		WriteInt(&stream, sizeof(SceneObjectRecord));
+		for (int i = 0; i < numObjects; ++i)
+		{
+			Object *object = GetObject(i);
+			ObjectDetails *details = object->details;
+			SceneObjectRecord record;
+			ZeroBytes(&record, sizeof record);
+			record.name = AddSceneString(&strings, details->name);
+			record.position = object->position;
+			record.zOffset = object->zOffset;
+			record.animationFps = object->animationFps;
+			record.talkRange = object->talkRange;
+			record.autoTalkInRange = object->autoTalkInRange;
+			record.direction = object->direction;
+			record.isStatic = object->isStatic;
+			record.lightRadius = object->lightRadius;
+			record.lightColor = object->lightColor;
+			record.script = AddSceneString(&strings, GetAssetPath(details->script));
+			record.collisionMap = AddSceneString(&strings, GetAssetPath(object->collisionMap));
+			for (int dir = 0; dir < DIRECTION_ENUM_COUNT; ++dir)
+				record.sprites[dir] = AddSceneString(&strings, GetAssetPath(object->sprites[dir]));
+			for (int j = 0; j < COUNTOF(details->expressions) and j < COUNTOF(record.expressionNames); ++j)
+			{
+				Expression *expression = &details->expressions[j];
+				record.expressionNames[j] = AddSceneString(&strings, expression->name);
+				record.expressionPortraits[j] = AddSceneString(&strings, GetAssetPath(expression->portrait));
+				AddSceneDependency(&dependencies, &strings, GetAssetPath(expression->portrait), SCENE_DEPENDENCY_SPRITE);
+			}
+			if (object->particles)
+			{
+				ParticleEmitterSettings *settings = &object->particles->settings;
+				record.particleBudget = settings->budget > 0 ? settings->budget : 1;
+				record.particleSprite = AddSceneString(&strings, GetAssetPath(settings->sprite));
+				record.particleRate = settings->rate;
+				record.particleLifetime = settings->lifetime;
+				record.particleLifetimeVariance = settings->lifetimeVariance;
+				record.particleSpawnRadius = settings->spawnRadius;
+				record.particleVelocity = settings->velocity;
+				record.particleVelocitySpread = settings->velocitySpread;
+				record.particleAcceleration = settings->acceleration;
+				record.particleTurbulence = settings->turbulence;
+				record.particleTurbulenceScale = settings->turbulenceScale;
+				record.particleStartSize = settings->startSize;
+				record.particleEndSize = settings->endSize;
+				record.particleStartColor = settings->startColor;
+				record.particleEndColor = settings->endColor;
+				AddSceneDependency(&dependencies, &strings, GetAssetPath(settings->sprite), SCENE_DEPENDENCY_SPRITE);
+			}
+			AddSceneDependency(&dependencies, &strings, GetAssetPath(details->script), SCENE_DEPENDENCY_SCRIPT);
+			AddSceneDependency(&dependencies, &strings, GetAssetPath(object->collisionMap), SCENE_DEPENDENCY_COLLISION_MAP);
+			for (int dir = 0; dir < DIRECTION_ENUM_COUNT; ++dir)
+				AddSceneDependency(&dependencies, &strings, GetAssetPath(object->sprites[dir]), SCENE_DEPENDENCY_SPRITE);
+			WriteBytes(&stream, &record, sizeof record);
+		}
+	}
+	EndSceneChunk(&stream, &chunks[0]);
+
+	BeginSceneChunk(&stream, &chunks[1], SCENE_STAIRS_CHUNK, SCENE_STAIRS_VERSION);
+	{
+		WriteInt(&stream, ListCount(stairs));
+		WriteInt(&stream, sizeof(Stair));
+		WriteBytes(&stream, stairs, ListCount(stairs) * sizeof stairs[0]);
+	}
+	EndSceneChunk(&stream, &chunks[1]);
+
+	BeginSceneChunk(&stream, &chunks[2], SCENE_DEPENDENCIES_CHUNK, SCENE_DEPENDENCIES_VERSION);
+	{
+		WriteInt(&stream, ListCount(dependencies));
+		WriteInt(&stream, sizeof(SceneDependencyRecord));
+		WriteBytes(&stream, dependencies, ListCount(dependencies) * sizeof dependencies[0]);
+	}
+	EndSceneChunk(&stream, &chunks[2]);
+
+	BeginSceneChunk(&stream, &chunks[3], SCENE_LIGHTING_CHUNK, SCENE_LIGHTING_VERSION);
+	{
+		SceneLightingRecord record;
+		ZeroBytes(&record, sizeof record);
+		record.ambientLight = ambientLight;
+		WriteInt(&stream, 1);
+		WriteInt(&stream, sizeof(SceneLightingRecord));
+		WriteBytes(&stream, &record, sizeof record);
+	}
+	EndSceneChunk(&stream, &chunks[3]);
+
+	// This has to come last, all the other chunks add their strings to it.
+	BeginSceneChunk(&stream, &chunks[4], SCENE_STRINGS_CHUNK, SCENE_STRINGS_VERSION);
+	{
+		int numStrings = ListCount(strings.strings);
+		WriteInt(&stream, numStrings);
+		int offset = 0;
+		for (int i = 0; i < numStrings; ++i)
+		{
+			WriteInt(&stream, offset);
+			offset += StringLength(strings.strings[i]) + 1;
+		}
+		for (int i = 0; i < numStrings; ++i)
+			WriteString(&stream, strings.strings[i]);
+	}
+	EndSceneChunk(&stream, &chunks[4]);
+
+	if (not stream.hasFailed)
+		CopyBytes((char *)stream.buffer + chunksOffset, chunks, sizeof chunks);
+	ListDestroy((void **)&strings.strings);
+	ListDestroy((void **)&strings.hashes);
+	ListDestroy((void **)&strings.dependencyKinds);
+	ListDestroy((void **)&dependencies);
+	return stream;
+}
+
+// The scene is serialized right away, but written to disk in the background, so saving doesn't hitch the editor.
+void SaveScene(const char *path)
+{
+	BinaryStream stream = SerializeScene();
+	if (stream.hasFailed)
+	{
+		LogError("Couldn't save current scene to '%s' because it doesn't fit into memory.", path);
+		MemFree(stream.buffer);
+		return;
+	}
+
+	LogMessage(LOG_CATEGORY_SCENES, LOG_INFO, "Saving current scene to '%s'.", path);
+	SaveFileDataInBackground(path, stream.buffer, stream.cursor);
+	CopyString(options.scene, path, sizeof options.scene);
 }
 
 Vector2 SnapToGrid(Vector2 position)
@@ -608,14 +1946,221 @@ Vector2 RoundUpToGridCell(Vector2 position)
 }
 
 // Motion
-void MoveToPoint(Object* object, Vector2 point)
+NavCell WorldToNavCell(Vector2 worldPoint)
 {
-	object->motionMaster.MoveToPoint(object->position, point);
+	Vector2 gridPoint = WorldToGrid(worldPoint);
+	NavCell cell = {
+		(int)floorf(gridPoint.x * NAV_CELLS_PER_TILE),
+		(int)floorf(gridPoint.y * NAV_CELLS_PER_TILE),
+	};
+	return cell;
 }
-
-// Console commands.
-
-bool HandlePlayerTeleportCommand(List(const char *) args)
+// Returns a corner of the cell, (0, 0) is the top corner and (1, 1) is the bottom corner of the diamond.
+Vector2 NavCellToWorld(NavCell cell, float cornerX, float cornerY)
+{
+	Vector2 gridPoint = {
+		(cell.x + cornerX) / NAV_CELLS_PER_TILE,
+		(cell.y + cornerY) / NAV_CELLS_PER_TILE,
+	};
+	return GridToWorld(gridPoint);
+}
+void GetNavCellRange(Rectangle area, NavCell *outMin, NavCell *outMax)
+{
+	// Rectangles in world space are diamonds in grid space, so all of the corners can end up at the edges.
+	Vector2 corners[] = {
+		{ area.x, area.y },
+		{ area.x + area.width, area.y },
+		{ area.x, area.y + area.height },
+		{ area.x + area.width, area.y + area.height },
+	};
+	*outMin = *outMax = WorldToNavCell(corners[0]);
+	for (int i = 1; i < COUNTOF(corners); ++i)
+	{
+		NavCell cell = WorldToNavCell(corners[i]);
+		outMin->x = cell.x < outMin->x ? cell.x : outMin->x;
+		outMin->y = cell.y < outMin->y ? cell.y : outMin->y;
+		outMax->x = cell.x > outMax->x ? cell.x : outMax->x;
+		outMax->y = cell.y > outMax->y ? cell.y : outMax->y;
+	}
+}
+bool IsNavCellSolid(NavCell cell, List(int) nearbyColliders)
+{
+	// Anything that crosses one of the diagonals of the cell blocks it, which also catches walls thinner than a cell.
+	Vector2 top = NavCellToWorld(cell, 0, 0);
+	Vector2 bottom = NavCellToWorld(cell, 1, 1);
+	Vector2 left = NavCellToWorld(cell, 0, 1);
+	Vector2 right = NavCellToWorld(cell, 1, 0);
+	Rectangle bounds = { left.x, top.y, right.x - left.x, bottom.y - top.y };
+	for (int i = 0; i < ListCount(nearbyColliders); ++i)
+	{
+		Object *object = GetObject(nearbyColliders[i]);
+		Rectangle collision = GetCollisionRectangle(object);
+		if (not object->collisionMap or not CheckCollisionRecs(bounds, collision))
+			continue;
+
+		Vector2 topLeft = { collision.x, collision.y };
+		if (CheckCollisionMapSegment(*object->collisionMap, top - topLeft, bottom - topLeft) or
+			CheckCollisionMapSegment(*object->collisionMap, left - topLeft, right - topLeft))
+			return true;
+	}
+	return false;
+}
+void RasterizeNavArea(Rectangle area)
+{
+	NavCell min, max;
+	GetNavCellRange(area, &min, &max);
+	min.x = ClampInt(min.x, navGrid.x0, navGrid.x0 + navGrid.width - 1);
+	min.y = ClampInt(min.y, navGrid.y0, navGrid.y0 + navGrid.height - 1);
+	max.x = ClampInt(max.x, navGrid.x0, navGrid.x0 + navGrid.width - 1);
+	max.y = ClampInt(max.y, navGrid.y0, navGrid.y0 + navGrid.height - 1);
+
+	// The cells at the edges stick out of the area a bit, so we need the colliders around it too.
+	float margin = GRID_RESOLUTION_X / NAV_CELLS_PER_TILE;
+	Rectangle queryArea = { area.x - margin, area.y - margin, area.width + 2 * margin, area.height + 2 * margin };
+	List(int) nearby = QuerySpatialGrid(&collisionGrid, queryArea);
+	for (int y = min.y; y <= max.y; ++y)
+	{
+		for (int x = min.x; x <= max.x; ++x)
+		{
+			NavCell cell = { x, y };
+			SetNavCellBlocked(&navGrid, x, y, IsNavCellSolid(cell, nearby));
+		}
+	}
+}
+void RebuildNavGrid(void)
+{
+	// The grid only has to cover the collision maps, everything outside of it is walkable.
+	bool isEmpty = true;
+	NavCell min = { 0 }, max = { 0 };
+	for (int i = 0; i < numObjects; ++i)
+	{
+		Object *object = GetObject(i);
+		if (not object->collisionMap)
+			continue;
+
+		NavCell objectMin, objectMax;
+		GetNavCellRange(GetCollisionRectangle(object), &objectMin, &objectMax);
+		if (isEmpty)
+		{
+			min = objectMin;
+			max = objectMax;
+			isEmpty = false;
+		}
+		min.x = objectMin.x < min.x ? objectMin.x : min.x;
+		min.y = objectMin.y < min.y ? objectMin.y : min.y;
+		max.x = objectMax.x > max.x ? objectMax.x : max.x;
+		max.y = objectMax.y > max.y ? objectMax.y : max.y;
+	}
+
+	if (isEmpty)
+		ResizeNavGrid(&navGrid, 0, 0, 0, 0);
+	else
+	{
+		min.x -= NAV_GRID_MARGIN;
+		min.y -= NAV_GRID_MARGIN;
+		max.x += NAV_GRID_MARGIN;
+		max.y += NAV_GRID_MARGIN;
+		ResizeNavGrid(&navGrid, min.x, min.y, max.x - min.x + 1, max.y - min.y + 1);
+		for (int i = 0; i < numObjects; ++i)
+			if (GetObject(i)->collisionMap)
+				RasterizeNavArea(GetCollisionRectangle(GetObject(i)));
+	}
+
+	ListClear(dirtyNavAreas);
+	isNavGridDirty = false;
+	navGridCollisionMapGeneration = GetCollisionMapGeneration();
+}
+// Call this after UpdateAllObjectBoundsIfDirty, because the object bounds tell us which parts of the grid changed.
+void UpdateNavGridIfDirty(void)
+{
+	if (isNavGridDirty)
+	{
+		RebuildNavGrid();
+		return;
+	}
+
+	// Hot reloaded or streamed in collision maps can change without moving, so their cells have to be rasterized again.
+	// If they also changed size, UpdateObjectBounds already marked the old and the new area.
+	if (navGridCollisionMapGeneration != GetCollisionMapGeneration())
+	{
+		for (int i = 0; i < numObjects; ++i)
+		{
+			Object *object = GetObject(i);
+			if (object->collisionMap and object->collisionMap->generation > navGridCollisionMapGeneration)
+				ListAdd(&dirtyNavAreas, GetCollisionRectangle(object));
+		}
+		navGridCollisionMapGeneration = GetCollisionMapGeneration();
+	}
+
+	for (int i = 0; i < ListCount(dirtyNavAreas); ++i)
+	{
+		// If a collision map moved outside of the grid, the grid has to grow.
+		NavCell min, max;
+		GetNavCellRange(dirtyNavAreas[i], &min, &max);
+		bool isInside =
+			min.x >= navGrid.x0 and max.x < navGrid.x0 + navGrid.width and
+			min.y >= navGrid.y0 and max.y < navGrid.y0 + navGrid.height;
+		if (not isInside)
+		{
+			RebuildNavGrid();
+			return;
+		}
+	}
+
+	for (int i = 0; i < ListCount(dirtyNavAreas); ++i)
+		RasterizeNavArea(dirtyNavAreas[i]);
+	ListClear(dirtyNavAreas);
+}
+// Starts moving the objects whose paths were found.
+void FollowFinishedNavPaths(void)
+{
+	for (int i = 0; i < numObjects; ++i)
+	{
+		Object *object = GetObject(i);
+		MotionMaster *motion = &object->motionMaster;
+		if (not motion->pathRequest)
+			continue;
+
+		List(NavCell) cells = NULL;
+		NavPathStatus status = GetNavPath(&navGrid, motion->pathRequest, &cells);
+		if (status == NAV_PATH_PENDING)
+			continue;
+
+		// Paths are found for the feet, since that's what collides, but the motion moves the object's position.
+		Vector2 feetOffset = GetFootPositionInScreenSpace(object) - object->position;
+		List(Vector2) path = NULL;
+		for (int j = 0; j < ListCount(cells); ++j)
+			ListAdd(&path, NavCellToWorld(cells[j], 0.5f, 0.5f) - feetOffset);
+		if (status == NAV_PATH_FOUND)
+		{
+			// The last cell is only roughly where we wanted to go.
+			if (ListCount(path) > 0)
+				path[ListCount(path) - 1] = motion->pathTarget;
+			else
+				ListAdd(&path, motion->pathTarget);
+		}
+
+		motion->pathRequest = 0;
+		motion->MoveAlongPath(object->position, path);
+		ListDestroy((void **)&cells);
+	}
+}
+// Finds a path around the collision maps to the point, and starts moving along it once it's found.
+// Until then, the object keeps doing whatever it was doing.
+void MoveToPoint(Object* object, Vector2 point)
+{
+	MotionMaster *motion = &object->motionMaster;
+	CancelNavPath(&navGrid, motion->pathRequest);
+
+	Vector2 feet = GetFootPositionInScreenSpace(object);
+	Vector2 feetOffset = feet - object->position;
+	motion->pathRequest = RequestNavPath(&navGrid, WorldToNavCell(feet), WorldToNavCell(point + feetOffset));
+	motion->pathTarget = point;
+}
+
+// Console commands.
+
+bool HandlePlayerTeleportCommand(List(const char *) args)
 {
 	// tp x y
 	if (ListCount(args) < 2 or ListCount(args) > 2)
@@ -630,6 +2175,8 @@ bool HandlePlayerTeleportCommand(List(const char *) args)
 
 	player->position.x = x;
 	player->position.y = y;
+	player->previousPosition = player->position; // Teleports shouldn't be interpolated.
+	UpdateObjectBounds(player);
 	return true;
 }
 bool HandleToggleDevModeCommand(List(const char *) args)
@@ -674,92 +2221,1016 @@ bool HandleCameraShakeCommand(List(const char *) args)
 	cameraTraumaFalloff = falloff;
 	return true;
 }
-bool HandleSoundCommand(List(const char *) args)
+bool HandleSoundCommand(List(const char *) args)
+{
+	// sound filename:string [volume:float] [pitch:float]
+	if (ListCount(args) > 3)
+		return false;
+
+	const char *path = args[0];
+	float volume = 1;
+	float pitch = 1;
+
+	bool success1 = true;
+	bool success2 = true;
+	if (ListCount(args) >= 2)
+		volume = ParseCommandFloatArg(args[1], &success1);
+	if (ListCount(args) >= 3)
+		pitch = ParseCommandFloatArg(args[2], &success2);
+
+	if (not success1 or not success2)
+		return false;
+
+	PlayTemporarySoundEx(path, volume, pitch);
+
+	return true;
+}
+bool HandleMusicCommand(List(const char *) args)
+{
+	// music [filename:string] [volume:float]
+	if (ListCount(args) > 2)
+		return false;
+
+	if (ListCount(args) == 0)
+	{
+		StopMusic();
+		return true;
+	}
+
+	float volume = 1;
+	bool success = true;
+	if (ListCount(args) >= 2)
+		volume = ParseCommandFloatArg(args[1], &success);
+	if (not success)
+		return false;
+
+	PlayMusic(args[0], volume);
+	return true;
+}
+bool HandleLogCommand(List(const char *) args)
+{
+	// log category:string [level:string]
+	if (ListCount(args) < 1 or ListCount(args) > 2)
+		return false;
+
+	static const char *const levelNames[] = { "all", "trace", "debug", "info", "warning", "error", "fatal", "none" };
+	LogCategory category = LOG_CATEGORY_ENUM_COUNT;
+	for (int i = 0; i < LOG_CATEGORY_ENUM_COUNT; ++i)
+		if (StringsEqualNocase(args[0], GetLogCategoryName((LogCategory)i)))
+			category = (LogCategory)i;
+	if (category == LOG_CATEGORY_ENUM_COUNT)
+		return false;
+
+	if (ListCount(args) == 1)
+	{
+		LogInfo("Log level of '%s' is '%s'.", GetLogCategoryName(category), levelNames[GetLogCategoryLevel(category)]);
+		return true;
+	}
+
+	for (int i = 0; i < COUNTOF(levelNames); ++i)
+	{
+		if (StringsEqualNocase(args[1], levelNames[i]))
+		{
+			SetLogCategoryLevel(category, i);
+			return true;
+		}
+	}
+	return false;
+}
+bool HandleMoveBy(List(const char*) args)
+{
+	if (ListCount(args) != 2)
+		return false;
+	
+	bool success1 = true;
+	bool success2 = true;
+	Vector2 delta = {
+		ParseCommandFloatArg(args[0], &success1),
+		ParseCommandFloatArg(args[1], &success2)
+	};
+	if (not success1 or not success2)
+		return false;
+
+	Object *object = player;
+	Vector2 target = object->position + delta;
+	MoveToPoint(object, target);
+
+	return true;
+}
+bool HandleMoveTo(List(const char *) args)
+{
+	if (ListCount(args) != 2)
+		return false;
+
+	bool success1 = true;
+	bool success2 = true;
+	Vector2 target = {
+		ParseCommandFloatArg(args[0], &success1),
+		ParseCommandFloatArg(args[1], &success2)
+	};
+	if (not success1 or not success2)
+		return false;
+
+	Object *object = player;
+	MoveToPoint(object, target);
+
+	return true;
+}
+bool HandleSaveCommand(List(const char *) args)
+{
+	// save [filename:string]
+	if (ListCount(args) > 1)
+		return false;
+
+	const char *path = options.scene;
+	if (ListCount(args) == 1)
+		path = args[0];
+	SaveScene(path);
+	return true;
+}
+#define DEFAULT_RECORDING_PATH "walkthrough.recording"
+char recordingPath[256];
+bool HandleRecordCommand(List(const char *) args)
+{
+	// record [filename:string]
+	if (ListCount(args) > 1)
+		return false;
+
+	if (IsRecordingInput())
+	{
+		StopInputRecording(recordingPath);
+		return true;
+	}
+
+	CopyString(recordingPath, ListCount(args) == 1 ? args[0] : DEFAULT_RECORDING_PATH, sizeof recordingPath);
+
+	// Recordings start from a freshly loaded scene, and replays load it the same way, without streaming.
+	SetAssetStreaming(false);
+	LoadScene(options.scene);
+	SetAssetStreaming(true);
+	StartInputRecording(TempFormat("load %s", options.scene));
+	LogInfo("Recording input to '%s', run 'record' again to stop.", recordingPath);
+	return true;
+}
+bool HandleLoadCommand(List(const char *) args)
+{
+	// load [filename:string]
+	if (ListCount(args) > 1)
+		return false;
+
+	const char *path = options.scene;
+	if (ListCount(args) == 1)
+		path = args[0];
+	LoadScene(path);
+	return true;
+}
+bool HandlePrefetchCommand(List(const char *) args)
+{
+	// prefetch filename:string
+	if (ListCount(args) != 1)
+		return false;
+
+	PrefetchScene(args[0]);
+	return true;
+}
+STRUCT(PackedFile)
+{
+	const char *path;
+	int owner; // The only scene that uses the file, or -1 if more than one scene (or no scene at all) uses it.
+	bool isUsed;
+};
+
+// Big sprite images get their compressed textures baked here, so they can go into the same pack as the image.
+static void AddSpriteAssetPaths(const char *spritePath, List(const char *) *paths)
+{
+	if (not spritePath)
+		return;
+
+	ListAdd(paths, TempString(spritePath));
+	if (BakeCompressedTexture(spritePath))
+		ListAdd(paths, TempFormat("%s.dds", spritePath));
+}
+
+// Adds the paths of all assets that the scene's objects use, without touching the current scene.
+static void AddSceneAssetPaths(const char *scenePath, List(const char *) *paths)
+{
+	List(Object) sceneObjects = NULL;
+	List(Stair) sceneStairs = NULL;
+	ListSetAllocator((void **)&sceneObjects, TempRealloc, TempFree);
+	ListSetAllocator((void **)&sceneStairs, TempRealloc, TempFree);
+	Color sceneAmbientLight;
+	if (LoadSceneFile(scenePath, &sceneObjects, &sceneStairs, &sceneAmbientLight))
+	{
+		for (int i = 0; i < ListCount(sceneObjects); ++i)
+		{
+			Object *object = &sceneObjects[i];
+			ObjectDetails *details = object->details;
+			const char *scriptPath = GetAssetPath(details->script);
+			if (scriptPath)
+			{
+				ListAdd(paths, TempString(scriptPath));
+				ListAdd(paths, TempFormat("%s.compiled", scriptPath));
+			}
+			if (GetAssetPath(object->collisionMap))
+				ListAdd(paths, TempString(GetAssetPath(object->collisionMap)));
+			for (int dir = 0; dir < DIRECTION_ENUM_COUNT; ++dir)
+				AddSpriteAssetPaths(GetAssetPath(object->sprites[dir]), paths);
+			for (int j = 0; j < COUNTOF(details->expressions); ++j)
+				AddSpriteAssetPaths(GetAssetPath(details->expressions[j].portrait), paths);
+			if (object->particles)
+				AddSpriteAssetPaths(GetAssetPath(object->particles->settings.sprite), paths);
+			Destroy(object);
+		}
+	}
+	ListDestroy((void **)&sceneObjects);
+	ListDestroy((void **)&sceneStairs);
+}
+
+// Marks the file, or all files inside of the directory, as used by the scene.
+static void MarkPackedFilesUsed(List(PackedFile) files, char *path, int sceneIndex)
+{
+	ReplaceChar(path, '\\', '/');
+	if (path[0] == '.' and path[1] == '/')
+		path += 2;
+	int length = StringLength(path);
+	for (int i = 0; i < ListCount(files); ++i)
+	{
+		PackedFile *file = &files[i];
+		bool isInside = StringsEqual(file->path, path) or (BytesEqual(file->path, path, length) and file->path[length] == '/');
+		if (not isInside)
+			continue;
+
+		if (not file->isUsed)
+			file->owner = sceneIndex;
+		else if (file->owner != sceneIndex)
+			file->owner = -1;
+		file->isUsed = true;
+	}
+}
+
+// Writes the packs for the web build into the directory. Every scene gets a pack with the files that only it uses,
+// and everything else goes into the base pack, which the web build preloads.
+static bool BakeResourcePacks(const char *directory)
+{
+	// Loading the scenes also brings the script caches and compressed textures up to date, so that has to happen before we list the files.
+	FilePathList scenes = LoadDirectoryFilesEx(".", ".scene", true);
+	List(List(const char *)) sceneAssetPaths = NULL;
+	ListSetAllocator((void **)&sceneAssetPaths, TempRealloc, TempFree);
+	for (unsigned i = 0; i < scenes.count; ++i)
+	{
+		List(const char *) paths = NULL;
+		ListSetAllocator((void **)&paths, TempRealloc, TempFree);
+		AddSceneAssetPaths(scenes.paths[i], &paths);
+		ListAdd(&sceneAssetPaths, paths);
+	}
+
+	FilePathList allFiles = LoadDirectoryFilesEx(".", NULL, true);
+	List(PackedFile) files = NULL;
+	ListSetAllocator((void **)&files, TempRealloc, TempFree);
+	for (unsigned i = 0; i < allFiles.count; ++i)
+	{
+		char *path = allFiles.paths[i];
+		ReplaceChar(path, '\\', '/');
+		if (path[0] == '.' and path[1] == '/')
+			path += 2;
+		if (path[0] == '.' or IsFileExtension(path, SCENE_PACK_EXTENSION))
+			continue; // Skip things like .options, and the packs themselves.
+		if (IsFileExtension(path, ".autosave") or IsFileExtension(path, ".tmp"))
+			continue; // Old autosaves, and files that SaveFileDataInBackground didn't get to finish writing.
+
+		PackedFile file = { path, -1, false };
+		ListAdd(&files, file);
+	}
+
+	for (unsigned i = 0; i < scenes.count; ++i)
+	{
+		MarkPackedFilesUsed(files, scenes.paths[i], (int)i);
+		for (int j = 0; j < ListCount(sceneAssetPaths[i]); ++j)
+			MarkPackedFilesUsed(files, (char *)sceneAssetPaths[i][j], (int)i);
+	}
+
+	bool success = true;
+	List(const char *) packPaths = NULL;
+	ListSetAllocator((void **)&packPaths, TempRealloc, TempFree);
+	for (int owner = -1; owner < (int)scenes.count; ++owner)
+	{
+		ListClear(packPaths);
+		for (int i = 0; i < ListCount(files); ++i)
+			if (files[i].owner == owner)
+				ListAdd(&packPaths, files[i].path);
+
+		const char *scenePath = owner >= 0 ? scenes.paths[owner] : NULL;
+		if (scenePath and scenePath[0] == '.' and scenePath[1] == '/')
+			scenePath += 2;
+		const char *packPath = scenePath ? TempFormat("%s/%s%s", directory, scenePath, SCENE_PACK_EXTENSION) : TempFormat("%s/%s", directory, BASE_PACK_PATH);
+		if (not BuildPack(packPath, packPaths, ListCount(packPaths)))
+			success = false;
+	}
+
+	UnloadDirectoryFiles(allFiles);
+	UnloadDirectoryFiles(scenes);
+	return success;
+}
+bool HandlePackCommand(List(const char *) args)
+{
+	// pack [directory:string]
+	if (ListCount(args) > 1)
+		return false;
+
+	const char *directory = "../bin/web";
+	if (ListCount(args) == 1)
+		directory = args[0];
+	if (not DirectoryExists(directory))
+	{
+		LogError("Couldn't bake resource packs into '%s' because that directory doesn't exist.", directory);
+		return true;
+	}
+	BakeResourcePacks(directory);
+	return true;
+}
+
+//
+// Static layers
+//
+
+// Objects that are marked static never move or animate, so instead of drawing them one by one every frame,
+// every run of static objects between two dynamic ones in the draw order is drawn into tiles of render textures,
+// and then we just draw the tiles. Each tile remembers a hash of everything that went into it (which objects, where,
+// with which frame, and the asset generation), so it's only drawn again once something in it changes, e.g. because
+// an object was moved in the editor, or one of the sprites was hot reloaded.
+//
+// The tiles have to be blended with premultiplied alpha. Blending straight alpha into a transparent texture and then
+// blending that onto the screen doesn't give the same result as drawing the sprites straight onto the screen.
+
+STRUCT(StaticTile)
+{
+	RenderTexture target;
+	int x; // In tiles.
+	int y;
+	uint64_t hash; // Of what's drawn in the tile, 0 if the tile isn't used.
+	int lastUsedFrame;
+};
+
+// Either an object that's drawn on its own, or a tile of a static layer.
+STRUCT(RenderItem)
+{
+	Object *object;
+	StaticTile *tile;
+};
+
+const char *premultiplyFragmentShader = GLSL_FRAGMENT_HEADER R"(
+IN vec2 fragTexCoord;
+IN vec4 fragColor;
+uniform sampler2D texture0;
+uniform vec4 colDiffuse;
+void main()
+{
+	vec4 color = TEXTURE(texture0, fragTexCoord) * colDiffuse * fragColor;
+	OUT_COLOR = vec4(color.rgb * color.a, color.a);
+}
+)";
+Shader premultiplyShader;
+StaticTile staticTiles[MAX_STATIC_TILES];
+int staticTileFrame;
+bool areStaticLayersEnabled = true;
+int numStaticTilesDrawn; // In the last rendered frame.
+int numStaticTilesRendered; // Into their render textures, in the last rendered frame.
+
+static uint64_t MixHash(uint64_t hash, const void *bytes, int numBytes)
+{
+	// FNV-1a, 64 bit so that two different tiles practically never look the same.
+	const unsigned char *b = (const unsigned char *)bytes;
+	for (int i = 0; i < numBytes; ++i)
+		hash = (hash ^ b[i]) * 1099511628211ull;
+	return hash;
+}
+static uint64_t HashStaticObject(uint64_t hash, const Object *object)
+{
+	const Sprite *sprite = GetCurrentSprite(object);
+	bool isFlipped = sprite != object->sprites[object->direction];
+	hash = MixHash(hash, &object, sizeof object);
+	hash = MixHash(hash, &object->position, sizeof object->position);
+	hash = MixHash(hash, &object->elevationOffset, sizeof object->elevationOffset);
+	hash = MixHash(hash, &sprite, sizeof sprite);
+	hash = MixHash(hash, &object->animationFrame, sizeof object->animationFrame);
+	hash = MixHash(hash, &isFlipped, sizeof isFlipped);
+	return hash;
+}
+// Where Render draws the object, which is a bit away from its outline when it's on stairs.
+static Rectangle GetDrawnRectangle(const Object *object)
+{
+	Rectangle rectangle = GetOutline(object);
+	rectangle.y += object->elevationOffset;
+	return rectangle;
+}
+// Returns the tile aligned area that covers the view.
+Rectangle GetStaticTileArea(Rectangle view)
+{
+	float x0 = STATIC_TILE_SIZE * floorf(view.x / STATIC_TILE_SIZE);
+	float y0 = STATIC_TILE_SIZE * floorf(view.y / STATIC_TILE_SIZE);
+	float x1 = STATIC_TILE_SIZE * ceilf((view.x + view.width) / STATIC_TILE_SIZE);
+	float y1 = STATIC_TILE_SIZE * ceilf((view.y + view.height) / STATIC_TILE_SIZE);
+	Rectangle area = { x0, y0, x1 - x0, y1 - y0 };
+	return area;
+}
+static StaticTile *FindStaticTile(int x, int y, uint64_t hash)
+{
+	for (int i = 0; i < MAX_STATIC_TILES; ++i)
+	{
+		StaticTile *tile = &staticTiles[i];
+		if (tile->hash == hash and tile->x == x and tile->y == y)
+			return tile;
+	}
+	return NULL;
+}
+// Returns the tile that was used the longest time ago, or NULL if all of them are needed this frame.
+static StaticTile *AllocateStaticTile(void)
+{
+	StaticTile *result = NULL;
+	for (int i = 0; i < MAX_STATIC_TILES; ++i)
+	{
+		StaticTile *tile = &staticTiles[i];
+		if (tile->hash == 0)
+			return tile;
+		if (tile->lastUsedFrame == staticTileFrame)
+			continue;
+		if (not result or tile->lastUsedFrame < result->lastUsedFrame)
+			result = tile;
+	}
+	return result;
+}
+static void RenderStaticTile(StaticTile *tile, Object *const run[], int runLength)
+{
+	if (not tile->target.id)
+	{
+		tile->target = LoadRenderTexture(STATIC_TILE_SIZE, STATIC_TILE_SIZE);
+		SetTextureFilter(tile->target.texture, TEXTURE_FILTER_BILINEAR);
+		SetTextureWrap(tile->target.texture, TEXTURE_WRAP_CLAMP);
+	}
+	if (not premultiplyShader.id)
+		premultiplyShader = LoadShaderFromMemory(NULL, premultiplyFragmentShader);
+
+	Rectangle area = { (float)(tile->x * STATIC_TILE_SIZE), (float)(tile->y * STATIC_TILE_SIZE), STATIC_TILE_SIZE, STATIC_TILE_SIZE };
+	Camera2D tileCamera = { 0 };
+	tileCamera.target = Vector2{ area.x, area.y };
+	tileCamera.zoom = 1;
+
+	BeginRenderTexture(tile->target);
+	ClearBackground(BLANK);
+	BeginMode2D(tileCamera);
+	BeginShaderMode(premultiplyShader);
+	BeginBlendMode(BLEND_ALPHA_PREMULTIPLY);
+	{
+		for (int i = 0; i < runLength; ++i)
+			if (CheckCollisionRecs(area, GetDrawnRectangle(run[i])))
+				Render(run[i], 1);
+	}
+	EndBlendMode();
+	EndShaderMode();
+	EndMode2D();
+	EndRenderTexture();
+	++numStaticTilesRendered;
+}
+// Adds the tiles of one run of static objects (in draw order) to the items, rendering the tiles that aren't cached yet.
+static void AddStaticRun(List(RenderItem) *items, Object *const run[], int runLength, Rectangle tileArea)
+{
+	int tileX0 = (int)floorf(tileArea.x / STATIC_TILE_SIZE);
+	int tileY0 = (int)floorf(tileArea.y / STATIC_TILE_SIZE);
+	int numTilesX = (int)(tileArea.width / STATIC_TILE_SIZE);
+	int numTilesY = (int)(tileArea.height / STATIC_TILE_SIZE);
+	int numTiles = numTilesX * numTilesY;
+
+	// Everything that goes into a tile, in order, goes into its hash.
+	uint64_t seed = 14695981039346656037ull;
+	unsigned assetGeneration = GetAssetGeneration();
+	seed = MixHash(seed, &assetGeneration, sizeof assetGeneration);
+	uint64_t *hashes = (uint64_t *)TempAlloc(numTiles * (int)sizeof hashes[0]);
+	for (int i = 0; i < numTiles; ++i)
+		hashes[i] = seed;
+	for (int i = 0; i < runLength; ++i)
+	{
+		Rectangle drawn = GetDrawnRectangle(run[i]);
+		int x0 = ClampInt((int)floorf(drawn.x / STATIC_TILE_SIZE) - tileX0, 0, numTilesX);
+		int y0 = ClampInt((int)floorf(drawn.y / STATIC_TILE_SIZE) - tileY0, 0, numTilesY);
+		int x1 = ClampInt((int)floorf((drawn.x + drawn.width) / STATIC_TILE_SIZE) - tileX0 + 1, 0, numTilesX);
+		int y1 = ClampInt((int)floorf((drawn.y + drawn.height) / STATIC_TILE_SIZE) - tileY0 + 1, 0, numTilesY);
+		for (int y = y0; y < y1; ++y)
+			for (int x = x0; x < x1; ++x)
+				hashes[y * numTilesX + x] = HashStaticObject(hashes[y * numTilesX + x], run[i]);
+	}
+
+	// Find out up front if all the tiles fit into the cache, because once we start drawing tiles we can't go back.
+	StaticTile **tiles = (StaticTile **)TempAlloc(numTiles * (int)sizeof tiles[0]);
+	int numMissing = 0;
+	for (int i = 0; i < numTiles; ++i)
+	{
+		tiles[i] = NULL;
+		if (hashes[i] == seed)
+			continue; // Nothing in the tile.
+		if (hashes[i] == 0)
+			hashes[i] = 1; // 0 marks unused tiles.
+		tiles[i] = FindStaticTile(tileX0 + i % numTilesX, tileY0 + i / numTilesX, hashes[i]);
+		if (tiles[i])
+			tiles[i]->lastUsedFrame = staticTileFrame;
+		else
+			++numMissing;
+	}
+	int numAvailable = 0;
+	for (int i = 0; i < MAX_STATIC_TILES; ++i)
+		if (staticTiles[i].hash == 0 or staticTiles[i].lastUsedFrame != staticTileFrame)
+			++numAvailable;
+
+	if (numMissing > numAvailable)
+	{
+		// The view needs more tiles than we have (a lot of layers, or zoomed far out), so these objects are just drawn directly.
+		for (int i = 0; i < runLength; ++i)
+		{
+			RenderItem *item = ListAllocateItem(items);
+			item->object = run[i];
+			item->tile = NULL;
+		}
+	}
+	else for (int i = 0; i < numTiles; ++i)
+	{
+		if (hashes[i] == seed)
+			continue;
+		StaticTile *tile = tiles[i];
+		if (not tile)
+		{
+			tile = AllocateStaticTile();
+			tile->x = tileX0 + i % numTilesX;
+			tile->y = tileY0 + i / numTilesX;
+			tile->hash = hashes[i];
+			tile->lastUsedFrame = staticTileFrame;
+			RenderStaticTile(tile, run, runLength);
+		}
+		RenderItem *item = ListAllocateItem(items);
+		item->object = NULL;
+		item->tile = tile;
+	}
+}
+// Returns what to draw, in order, for the objects sorted by descending z. Static objects are grouped into the tiles that cover the tile area.
+// This renders into the tiles' render textures, so it can't be called between BeginMode2D and EndMode2D.
+List(RenderItem) GetRenderItems(List(Object *) sorted, Rectangle tileArea)
+{
+	++staticTileFrame;
+	numStaticTilesRendered = 0;
+
+	List(RenderItem) items = NULL;
+	ListSetAllocator((void **)&items, TempRealloc, TempFree);
+
+	// Back to front, so the runs are in the order they're drawn in.
+	Object **run = (Object **)TempAlloc((ListCount(sorted) + 1) * (int)sizeof run[0]);
+	int runLength = 0;
+	for (int i = ListCount(sorted) - 1; i >= -1; --i)
+	{
+		Object *object = i >= 0 ? sorted[i] : NULL;
+		if (object and object->isStatic and not object->particles and areStaticLayersEnabled)
+		{
+			run[runLength++] = object;
+			continue;
+		}
+
+		if (runLength > 0)
+			AddStaticRun(&items, run, runLength, tileArea);
+		runLength = 0;
+		if (object)
+		{
+			RenderItem *item = ListAllocateItem(&items);
+			item->object = object;
+			item->tile = NULL;
+		}
+	}
+
+	numStaticTilesDrawn = 0;
+	for (int i = 0; i < ListCount(items); ++i)
+		if (items[i].tile)
+			++numStaticTilesDrawn;
+	return items;
+}
+void UnloadStaticTiles(void)
+{
+	for (int i = 0; i < MAX_STATIC_TILES; ++i)
+		if (staticTiles[i].target.id)
+			UnloadRenderTexture(staticTiles[i].target);
+	ZeroBytes(staticTiles, sizeof staticTiles);
+	if (premultiplyShader.id)
+		UnloadShader(premultiplyShader);
+	premultiplyShader = Shader{ 0 };
+}
+void DrawRenderItems(List(RenderItem) items, float interpolation)
+{
+	for (int i = 0; i < ListCount(items);)
+	{
+		if (items[i].object)
+		{
+			Render(items[i].object, interpolation);
+			++i;
+			continue;
+		}
+
+		// Consecutive tiles share the blend mode, so switching it doesn't split the batch more than necessary.
+		BeginBlendMode(BLEND_ALPHA_PREMULTIPLY);
+		for (; i < ListCount(items) and items[i].tile; ++i)
+		{
+			StaticTile *tile = items[i].tile;
+			Rectangle source = { 0, 0, STATIC_TILE_SIZE, -STATIC_TILE_SIZE }; // Render textures are upside down.
+			Rectangle destination = { (float)(tile->x * STATIC_TILE_SIZE), (float)(tile->y * STATIC_TILE_SIZE), STATIC_TILE_SIZE, STATIC_TILE_SIZE };
+			DrawTexturePro(tile->target.texture, source, destination, Vector2{ 0, 0 }, 0, WHITE);
+		}
+		EndBlendMode();
+	}
+}
+
+//
+// Lighting
+//
+
+// Lights are added up in a light buffer that only has a fraction of the screen's resolution, and then the finished frame
+// is multiplied by the light buffer in a single pass. Light is smooth enough that the low resolution barely shows.
+//
+// Shadows come from the collision maps. Every collision map gets an occluder texture, which is built once after the scene
+// is loaded (or once the map shows up or changes). The occluders around the view are drawn into an occlusion buffer that's
+// as big as the light buffer, and the light shader walks from the light towards every pixel through it. The walk only
+// starts counting once it's out of whatever the light is in, so lights aren't shadowed by their own object's collision map.
+
+#define MAX_LIGHTS_PER_FRAME 64 // Every light is its own draw call, so this keeps the GPU time bounded in scenes with lots of lights.
+#define MAX_SHADOW_STEPS 32 // Has to match the loop in the light shader.
+#define LIGHTING_MARGIN 512.0f // Lights and occluders this far outside of the view can still light or shadow what's in it.
+
+STRUCT(Occluder)
+{
+	const CollisionMap *collisionMap;
+	const uint32_t *bits; // What the texture was built from, so we notice when the map is hot reloaded or finishes streaming in.
+	int width;
+	int height;
+	Texture texture;
+};
+
+const char *lightFragmentShader = GLSL_FRAGMENT_HEADER R"(
+IN vec2 fragTexCoord; // Where the pixel is relative to the light, in light radii.
+IN vec4 fragColor;
+uniform sampler2D occlusionBuffer;
+uniform vec2 bufferSize;
+uniform vec2 lightCenter; // In pixels of the buffers.
+uniform int numSteps;
+void main()
+{
+	float falloff = 1.0 - clamp(length(fragTexCoord), 0.0, 1.0);
+	falloff *= falloff;
+
+	vec2 pixel = gl_FragCoord.xy / bufferSize;
+	vec2 light = lightCenter / bufferSize;
+	float transmittance = 1.0;
+	bool isOutOfStart = false;
+	for (int i = 0; i < 32; ++i)
+	{
+		if (i >= numSteps)
+			break;
+		float occlusion = TEXTURE(occlusionBuffer, mix(light, pixel, (float(i) + 0.5) / float(numSteps))).a;
+		isOutOfStart = isOutOfStart || occlusion < 0.5;
+		if (isOutOfStart)
+			transmittance *= 1.0 - occlusion;
+	}
+	OUT_COLOR = vec4(fragColor.rgb * fragColor.a * falloff * transmittance, 1.0);
+}
+)";
+Shader lightShader;
+int lightOcclusionBufferLocation;
+int lightBufferSizeLocation;
+int lightCenterLocation;
+int lightNumStepsLocation;
+RenderTexture lightBuffer;
+RenderTexture occlusionBuffer;
+List(Occluder) occluders;
+// Maps collision maps to their index in occluders, so finding the occluder of a collider doesn't have to look through all of them.
+// Empty entries are -1. The capacity is a power of 2 and at most half full.
+int *occluderTable;
+int occluderTableCapacity;
+int numLightsDrawn; // In the last rendered frame.
+
+static Texture BuildOccluderTexture(const CollisionMap *map)
+{
+	// Gray and alpha, so that drawing the texture only covers the solid pixels.
+	unsigned char *pixels = (unsigned char *)MemAlloc(2 * map->width * map->height);
+	for (int y = 0; y < map->height; ++y)
+	{
+		for (int x = 0; x < map->width; ++x)
+		{
+			unsigned char *pixel = &pixels[2 * (y * map->width + x)];
+			pixel[0] = 255;
+			pixel[1] = IsCollisionMapPixelSolid(*map, x, y) ? 255 : 0;
+		}
+	}
+
+	Image image = { 0 };
+	image.data = pixels;
+	image.width = map->width;
+	image.height = map->height;
+	image.mipmaps = 1;
+	image.format = PIXELFORMAT_UNCOMPRESSED_GRAY_ALPHA;
+	Texture texture = LoadTextureFromImage(image);
+	SetTextureFilter(texture, TEXTURE_FILTER_BILINEAR);
+	MemFree(pixels);
+	return texture;
+}
+static unsigned HashPointer(const void *pointer)
+{
+	// The low bits of pointers are mostly the same, so they have to be mixed with the high ones.
+	uint64_t bits = (uint64_t)(uintptr_t)pointer;
+	bits ^= bits >> 33;
+	bits *= 0xff51afd7ed558ccdull;
+	bits ^= bits >> 33;
+	return (unsigned)bits;
+}
+// Returns the entry of the table that has the collision map's occluder, or the empty entry where it would go.
+static int FindOccluderTableEntry(const CollisionMap *map)
+{
+	unsigned mask = (unsigned)occluderTableCapacity - 1;
+	for (unsigned i = HashPointer(map) & mask;; i = (i + 1) & mask)
+		if (occluderTable[i] < 0 or occluders[occluderTable[i]].collisionMap == map)
+			return (int)i;
+}
+static void AddOccluderToTable(int index)
+{
+	if (2 * ListCount(occluders) <= occluderTableCapacity)
+	{
+		occluderTable[FindOccluderTableEntry(occluders[index].collisionMap)] = index;
+		return;
+	}
+
+	// All the occluders have to go to new entries anyway, so growing is just building the table again.
+	int capacity = occluderTableCapacity > 0 ? occluderTableCapacity : 64;
+	while (2 * ListCount(occluders) > capacity)
+		capacity *= 2;
+	MemFree(occluderTable);
+	occluderTable = (int *)MemAlloc(capacity * (int)sizeof occluderTable[0]);
+	occluderTableCapacity = capacity;
+	for (int i = 0; i < capacity; ++i)
+		occluderTable[i] = -1;
+	for (int i = 0; i < ListCount(occluders); ++i)
+		occluderTable[FindOccluderTableEntry(occluders[i].collisionMap)] = i;
+}
+static void ClearOccluders(void)
 {
-	// sound filename:string [volume:float] [pitch:float]
-	if (ListCount(args) > 3)
-		return false;
-
-	const char *path = args[0];
-	float volume = 1;
-	float pitch = 1;
-
-	bool success1 = true;
-	bool success2 = true;
-	if (ListCount(args) >= 2)
-		volume = ParseCommandFloatArg(args[1], &success1);
-	if (ListCount(args) >= 3)
-		pitch = ParseCommandFloatArg(args[2], &success2);
+	for (int i = 0; i < ListCount(occluders); ++i)
+		if (occluders[i].texture.id)
+			UnloadTexture(occluders[i].texture);
+	ListClear(occluders);
+	for (int i = 0; i < occluderTableCapacity; ++i)
+		occluderTable[i] = -1;
+}
+// Returns the occluder of the collision map, building its texture if it doesn't have an up to date one yet.
+static Occluder *GetOccluder(const CollisionMap *map)
+{
+	Occluder *occluder = NULL;
+	if (occluderTableCapacity > 0)
+	{
+		int index = occluderTable[FindOccluderTableEntry(map)];
+		if (index >= 0)
+			occluder = &occluders[index];
+	}
 
-	if (not success1 or not success2)
-		return false;
+	if (occluder and occluder->bits == map->bits and occluder->width == map->width and occluder->height == map->height)
+		return occluder;
 
-	PlayTemporarySoundEx(path, volume, pitch);
+	if (occluder)
+		UnloadTexture(occluder->texture);
+	else
+	{
+		occluder = ListAllocateItem(&occluders);
+		occluder->collisionMap = map;
+		AddOccluderToTable(ListCount(occluders) - 1);
+	}
+	occluder->bits = map->bits;
+	occluder->width = map->width;
+	occluder->height = map->height;
+	occluder->texture = map->width > 0 and map->height > 0 ? BuildOccluderTexture(map) : Texture{ 0 };
+	return occluder;
+}
+// Builds the occluders of all collision maps in the scene after it was loaded, so that they don't get built in the middle of playing.
+static void UpdateOccluders(void)
+{
+	if (not areOccludersDirty)
+		return;
 
-	return true;
+	ClearOccluders();
+	for (int i = 0; i < numObjects; ++i)
+		if (GetObject(i)->collisionMap)
+			GetOccluder(GetObject(i)->collisionMap);
+	areOccludersDirty = false;
 }
-bool HandleMoveBy(List(const char*) args)
+static void UnloadLighting(void)
 {
-	if (ListCount(args) != 2)
+	ClearOccluders();
+	ListDestroy((void **)&occluders);
+	MemFree(occluderTable);
+	occluderTable = NULL;
+	occluderTableCapacity = 0;
+	areOccludersDirty = true;
+	if (lightBuffer.id)
+		UnloadRenderTexture(lightBuffer);
+	if (occlusionBuffer.id)
+		UnloadRenderTexture(occlusionBuffer);
+	if (lightShader.id)
+		UnloadShader(lightShader);
+	lightBuffer = RenderTexture{ 0 };
+	occlusionBuffer = RenderTexture{ 0 };
+	lightShader = Shader{ 0 };
+}
+// Renders the light buffer for the view. Returns false if the scene isn't lit, then there's nothing to draw with DrawLightBuffer.
+// This renders into render textures, so it can't be called between BeginMode2D and EndMode2D.
+bool RenderLightBuffer(Camera2D view, float interpolation)
+{
+	numLightsDrawn = 0;
+	if (options.lightingQuality == LIGHTING_OFF)
 		return false;
-	
-	bool success1 = true;
-	bool success2 = true;
-	Vector2 delta = {
-		ParseCommandFloatArg(args[0], &success1),
-		ParseCommandFloatArg(args[1], &success2)
-	};
-	if (not success1 or not success2)
+	// Lights can't make anything brighter than it's drawn, so there's nothing to do while the ambient light is white.
+	if (ambientLight.r == 255 and ambientLight.g == 255 and ambientLight.b == 255)
 		return false;
 
-	Object *object = player;
-	Vector2 target = object->position + delta;
-	MoveToPoint(object, target);
+	int divisor = options.lightingQuality == LIGHTING_HALF_RESOLUTION ? 2 : 4;
+	int numSteps = options.lightingQuality == LIGHTING_HALF_RESOLUTION ? MAX_SHADOW_STEPS : MAX_SHADOW_STEPS / 2;
+	int width = ClampInt(GetScreenWidth() / divisor, 1, INT_MAX);
+	int height = ClampInt(GetScreenHeight() / divisor, 1, INT_MAX);
+	if (lightBuffer.texture.width != width or lightBuffer.texture.height != height)
+	{
+		if (lightBuffer.id)
+			UnloadRenderTexture(lightBuffer);
+		if (occlusionBuffer.id)
+			UnloadRenderTexture(occlusionBuffer);
+		lightBuffer = LoadRenderTexture(width, height);
+		occlusionBuffer = LoadRenderTexture(width, height);
+		SetTextureFilter(lightBuffer.texture, TEXTURE_FILTER_BILINEAR);
+		SetTextureWrap(lightBuffer.texture, TEXTURE_WRAP_CLAMP);
+		SetTextureWrap(occlusionBuffer.texture, TEXTURE_WRAP_CLAMP);
+	}
+	if (not lightShader.id)
+	{
+		lightShader = LoadShaderFromMemory(NULL, lightFragmentShader);
+		lightOcclusionBufferLocation = GetShaderLocation(lightShader, "occlusionBuffer");
+		lightBufferSizeLocation = GetShaderLocation(lightShader, "bufferSize");
+		lightCenterLocation = GetShaderLocation(lightShader, "lightCenter");
+		lightNumStepsLocation = GetShaderLocation(lightShader, "numSteps");
+	}
+	UpdateOccluders();
+
+	// The same view, just with fewer pixels.
+	Camera2D lowResolutionView = view;
+	lowResolutionView.offset = Vector2Scale(view.offset, 1.0f / divisor);
+	lowResolutionView.zoom = view.zoom / divisor;
+	Rectangle area = ExpandRectangle(GetCameraView(view), LIGHTING_MARGIN);
+
+	BeginRenderTexture(occlusionBuffer);
+	ClearBackground(BLANK);
+	BeginMode2D(lowResolutionView);
+	{
+		List(int) colliders = QuerySpatialGrid(&collisionGrid, area);
+		for (int i = 0; i < ListCount(colliders); ++i)
+		{
+			if (colliders[i] >= numObjects)
+				continue;
+			Object *object = GetObject(colliders[i]);
+			if (not object->collisionMap)
+				continue;
+
+			Occluder *occluder = GetOccluder(object->collisionMap);
+			Rectangle destination = GetCollisionRectangle(object);
+			Vector2 interpolated = Vector2Lerp(object->previousPosition, object->position, interpolation);
+			destination.x += interpolated.x - object->position.x;
+			destination.y += interpolated.y - object->position.y;
+			Rectangle source = { 0, 0, (float)occluder->width, (float)occluder->height };
+			DrawTexturePro(occluder->texture, source, destination, Vector2{ 0, 0 }, 0, WHITE);
+		}
+	}
+	EndMode2D();
+	EndRenderTexture();
+
+	Color ambient = ambientLight;
+	ambient.a = 255;
+	Vector2 bufferSize = { (float)width, (float)height };
+	BeginRenderTexture(lightBuffer);
+	ClearBackground(ambient);
+	BeginMode2D(lowResolutionView);
+	BeginShaderMode(lightShader);
+	BeginBlendMode(BLEND_ADDITIVE);
+	{
+		SetShaderValue(lightShader, lightBufferSizeLocation, &bufferSize, SHADER_UNIFORM_VEC2);
+		SetShaderValue(lightShader, lightNumStepsLocation, &numSteps, SHADER_UNIFORM_INT);
+		for (int i = 0; i < numObjects and numLightsDrawn < MAX_LIGHTS_PER_FRAME; ++i)
+		{
+			Object *object = GetObject(i);
+			float radius = object->lightRadius;
+			if (radius <= 0)
+				continue;
+
+			Vector2 position = Vector2Lerp(object->previousPosition, object->position, interpolation);
+			position.y += object->elevationOffset;
+			Rectangle bounds = { position.x - radius, position.y - radius, 2 * radius, 2 * radius };
+			if (not CheckCollisionRecs(bounds, area))
+				continue;
+
+			// gl_FragCoord starts at the bottom of the buffer.
+			Vector2 center = GetWorldToScreen2D(position, lowResolutionView);
+			center.y = height - center.y;
+			SetShaderValue(lightShader, lightCenterLocation, &center, SHADER_UNIFORM_VEC2);
+			SetShaderValueTexture(lightShader, lightOcclusionBufferLocation, occlusionBuffer.texture);
+
+			float x0 = bounds.x;
+			float y0 = bounds.y;
+			float x1 = bounds.x + bounds.width;
+			float y1 = bounds.y + bounds.height;
+			rlBegin(RL_QUADS);
+			{
+				rlColor(object->lightColor);
+				rlTexCoord2f(-1, -1); rlVertex2f(x0, y0);
+				rlTexCoord2f(-1, +1); rlVertex2f(x0, y1);
+				rlTexCoord2f(+1, +1); rlVertex2f(x1, y1);
+				rlTexCoord2f(+1, -1); rlVertex2f(x1, y0);
+			}
+			rlEnd();
 
+			// Uniforms aren't part of the batch, so every light has to be drawn before the next one sets its own.
+			rlDrawRenderBatchActive();
+			++numLightsDrawn;
+		}
+	}
+	EndBlendMode();
+	EndShaderMode();
+	EndMode2D();
+	EndRenderTexture();
 	return true;
 }
-bool HandleMoveTo(List(const char *) args)
+// Multiplies everything that's been rendered into the render target (the screen or the world target) with the light buffer from RenderLightBuffer.
+void DrawLightBuffer(void)
 {
-	if (ListCount(args) != 2)
-		return false;
+	Rectangle source = { 0, 0, (float)lightBuffer.texture.width, -(float)lightBuffer.texture.height }; // Render textures are upside down.
+	Rectangle destination = { 0, 0, (float)GetRenderTargetWidth(), (float)GetRenderTargetHeight() };
+	BeginBlendMode(BLEND_MULTIPLIED);
+	DrawTexturePro(lightBuffer.texture, source, destination, Vector2{ 0, 0 }, 0, WHITE);
+	EndBlendMode();
+}
 
-	bool success1 = true;
-	bool success2 = true;
-	Vector2 target = {
-		ParseCommandFloatArg(args[0], &success1),
-		ParseCommandFloatArg(args[1], &success2)
-	};
-	if (not success1 or not success2)
-		return false;
+//
+// World target
+//
 
-	Object *object = player;
-	MoveToPoint(object, target);
+// While frames take too long, the world is rendered into this at GetResolutionScale of the resolution, and then stretched
+// over the screen. Everything drawn after EndWorld, like the dialog box and ImGui, is still drawn at the full resolution.
+RenderTexture worldTarget;
+bool isRenderingWorldTarget;
 
-	return true;
-}
-bool HandleSaveCommand(List(const char *) args)
+// Starts rendering the world. Returns the view to use for BeginMode2D until EndWorld, which is the given view scaled down to the
+// world target. Anything that works in world units, like culling or the light buffer, should keep using the given view.
+// This renders into a render texture, so it can't be called between BeginMode2D and EndMode2D.
+Camera2D BeginWorld(Camera2D view)
 {
-	// save [filename:string]
-	if (ListCount(args) > 1)
-		return false;
+	// At the full resolution we draw straight into the render target, so the world keeps its MSAA and doesn't pay for the extra copy.
+	float scale = GetResolutionScale();
+	isRenderingWorldTarget = scale < 1;
+	if (not isRenderingWorldTarget)
+		return view;
+
+	int width = ClampInt((int)(scale * GetRenderTargetWidth() + 0.5f), 1, INT_MAX);
+	int height = ClampInt((int)(scale * GetRenderTargetHeight() + 0.5f), 1, INT_MAX);
+	if (worldTarget.texture.width != width or worldTarget.texture.height != height)
+	{
+		if (worldTarget.id)
+			UnloadRenderTexture(worldTarget);
+		worldTarget = LoadRenderTexture(width, height);
+		SetTextureFilter(worldTarget.texture, TEXTURE_FILTER_BILINEAR);
+		SetTextureWrap(worldTarget.texture, TEXTURE_WRAP_CLAMP);
+	}
+	BeginRenderTexture(worldTarget);
 
-	const char *path = options.scene;
-	if (ListCount(args) == 1)
-		path = args[0];
-	SaveScene(path);
-	return true;
+	Camera2D scaledView = view;
+	scaledView.offset = Vector2Scale(view.offset, scale);
+	scaledView.zoom = view.zoom * scale;
+	return scaledView;
 }
-bool HandleLoadCommand(List(const char *) args)
+// Stops rendering the world, and stretches it over the render target if it was rendered at a lower resolution.
+void EndWorld(void)
 {
-	// load [filename:string]
-	if (ListCount(args) > 1)
-		return false;
+	if (not isRenderingWorldTarget)
+		return;
+	EndRenderTexture();
+	isRenderingWorldTarget = false;
 
-	const char *path = options.scene;
-	if (ListCount(args) == 1)
-		path = args[0];
-	LoadScene(path);
-	return true;
+	// The world target covers everything, so its pixels are copied as they are, like the game state snapshot.
+	rlSetBlendFactors(1, 0, 0x8006); // GL_ONE, GL_ZERO, GL_FUNC_ADD
+	BeginBlendMode(BLEND_CUSTOM);
+	{
+		Rectangle source = { 0, 0, (float)worldTarget.texture.width, -(float)worldTarget.texture.height }; // Render textures are upside down.
+		Rectangle destination = { 0, 0, (float)GetRenderTargetWidth(), (float)GetRenderTargetHeight() };
+		DrawTexturePro(worldTarget.texture, source, destination, Vector2{ 0, 0 }, 0, WHITE);
+	}
+	EndBlendMode();
+}
+static void UnloadWorldTarget(void)
+{
+	if (worldTarget.id)
+		UnloadRenderTexture(worldTarget);
+	worldTarget = RenderTexture{ 0 };
 }
 
 //
@@ -768,32 +3239,51 @@ bool HandleLoadCommand(List(const char *) args)
 
 void Playing_Update()
 {
+	#ifdef DEV_GUI_ENABLED
 	if (input.console.wasPressed)
 	{
 		PushGameState(GAMESTATE_EDITOR, NULL);
 		return;
 	}
+	#endif
 	if (input.pause.wasPressed)
 	{
 		PushGameState(GAMESTATE_PAUSED, NULL);
 		return;
 	}
 
-	for (int i = 1; i < numObjects; ++i)
+	UpdateAllObjectBoundsIfDirty();
+
+	PROFILE_BEGIN("Pathfinding");
+	UpdateNavGridIfDirty();
+	UpdateNavPaths(&navGrid, NAV_STEPS_PER_UPDATE);
+	FollowFinishedNavPaths();
+	PROFILE_END();
+
+	// The grid returns the objects in no particular order, but we want the first object in the scene to win.
+	Object *talkObject = NULL;
+	int talkObjectIndex = INT_MAX;
+	List(int) inTalkRange = QuerySpatialGridPoint(&talkGrid, GetFootPositionInScreenSpace(player));
+	for (int i = 0; i < ListCount(inTalkRange); ++i)
 	{
-		Object *object = &objects[i];
-		if (not object->script)
+		Object *object = GetObject(inTalkRange[i]);
+		if (object == player or not object->details->script)
+			continue;
+		if (inTalkRange[i] > talkObjectIndex)
+			continue;
+		if (not (input.interact.wasPressed or object->autoTalkInRange))
 			continue;
 		if (DistanceBetween(player, object) < object->talkRange)
 		{
-			if (input.interact.wasPressed or object->autoTalkInRange)
-			{
-
-				PushGameState(GAMESTATE_TALKING, object);
-				return;
-			}
+			talkObject = object;
+			talkObjectIndex = inTalkRange[i];
 		}
 	}
+	if (talkObject)
+	{
+		PushGameState(GAMESTATE_TALKING, talkObject);
+		return;
+	}
 
 	float moveSpeed = 5;
 	if (input.sprint.isDown)
@@ -816,18 +3306,33 @@ void Playing_Update()
 		playerVelocity = deltaPos;
 
 		// In the isometric perspective, the y direction is squished down a little bit.
-		Texture *texture = GetCurrentTexture(player);
-		if (texture)
+		SpriteFrame *frame = GetCurrentFrame(player);
+		if (frame)
 		{
 			Vector2 feetPos = player->position;
-			feetPos.y += 0.5f * GetCurrentTexture(player)->height;
+			feetPos.y += 0.5f * frame->source.height;
 			Vector2 newFeetPos = MovePointWithCollisions(feetPos, deltaPos);
 			player->position = player->position + (newFeetPos - feetPos);
+			UpdateObjectBounds(player);
 		}
 	}
 
+	PROFILE_BEGIN("Objects");
+	ParallelFor(numObjects, 64, UpdateObjectRange, NULL);
+	PROFILE_END();
+
+	// The spatial grids aren't thread safe, so they get updated afterwards.
+	PROFILE_BEGIN("Object bounds");
 	for (int i = 0; i < numObjects; i++)
-		Update(&objects[i]);
+	{
+		Object *object = GetObject(i);
+		if (object->hasStaleBounds)
+		{
+			UpdateObjectBounds(object);
+			object->hasStaleBounds = false;
+		}
+	}
+	PROFILE_END();
 
 	Vector2 targetCameraOffset = options.cameraOffset * playerVelocity;
 	cameraOffset1 = Vector2Lerp(cameraOffset1, targetCameraOffset, options.cameraAcceleration);
@@ -837,36 +3342,69 @@ void Playing_Update()
 	camera.offset.y = WINDOW_CENTER_Y;
 	camera.zoom = 1;
 	UpdateCameraShake();
-
-	ImGui::Begin("Camera");
-	{
-		ImGui::SliderFloat("trauma", &cameraTrauma, 0, 1);
-		ImGui::SliderFloat("acceleration", &options.cameraAcceleration, 0, 0.2f);
-		ImGui::SliderFloat("speed", &options.cameraSpeed, 0, 0.2f);
-		ImGui::SliderFloat("offset", &options.cameraOffset, 10, 50);
-	}
-	ImGui::End();
 }
 void Playing_Render()
 {
-	ClearBackground(BLACK);
+	// Updates don't run every frame, so all of the ImGui windows have to be built while rendering, otherwise they would flicker.
+	// Other game states also render this one underneath themselves, but they don't want our windows.
+	#ifdef DEV_GUI_ENABLED
+	if (IsDevGuiVisible() and not IsRenderingPreviousGameState())
+	{
+		ImGui::Begin("Camera");
+		{
+			ImGui::SliderFloat("trauma", &cameraTrauma, 0, 1);
+			ImGui::SliderFloat("acceleration", &options.cameraAcceleration, 0, 0.2f);
+			ImGui::SliderFloat("speed", &options.cameraSpeed, 0, 0.2f);
+			ImGui::SliderFloat("offset", &options.cameraOffset, 10, 50);
+			ImGui::Text("%d objects drawn, %d culled", numObjectsDrawn, numObjectsCulled);
+			ImGui::Checkbox("Static layers", &areStaticLayersEnabled);
+			ImGui::Text("%d static tiles drawn, %d rendered", numStaticTilesDrawn, numStaticTilesRendered);
+			const char *lightingQualities[] = { "Off", "Quarter resolution", "Half resolution" };
+			ImGui::Combo("Lighting", (int *)&options.lightingQuality, lightingQualities, COUNTOF(lightingQualities));
+			ImGui::Text("%d lights drawn", numLightsDrawn);
+			if (ImGui::Checkbox("Dynamic resolution", &options.isResolutionDynamic))
+				SetDynamicResolution(options.isResolutionDynamic);
+			ImGui::Text("World rendered at %.0f%%, %.2fms per frame", 100 * GetResolutionScale(), 1000 * GetAverageFrameTime());
+		}
+		ImGui::End();
+		ShowAssetWindow();
+
+		#ifdef PROFILER_ENABLED
+		ShowProfilerWindow();
+		#endif
+	}
+	#endif
+
+	float interpolation = GetRenderInterpolation();
 
 	float shake = Clamp01(cameraTrauma);
 	shake *= shake;
 
 	Camera2D shakyCam = camera;
+	shakyCam.target = Vector2Lerp(previousCameraTarget, camera.target, interpolation);
 	float shakyTime = 100 * (float)GetTime();
 	shakyCam.rotation += MAX_SHAKE_ROTATION * RAD2DEG * shake * PerlinNoise1(0, shakyTime);
 	shakyCam.offset.x += MAX_SHAKE_TRANSLATION * shake * PerlinNoise1(1, shakyTime);
 	shakyCam.offset.y += MAX_SHAKE_TRANSLATION * shake * PerlinNoise1(2, shakyTime);
-	BeginMode2D(shakyCam);
+	// Static objects that overlap the visible tiles have to be drawn into the tiles even if they're off screen,
+	// otherwise the tiles would have to be drawn again as soon as those objects come into view.
+	Rectangle tileArea = GetStaticTileArea(GetCameraView(shakyCam));
+	List(Object *) sorted = areStaticLayersEnabled ? GetZSortedObjectsInArea(ExpandRectangle(tileArea, CULLING_MARGIN)) : GetVisibleZSortedObjects(shakyCam);
+	if (areStaticLayersEnabled)
+		CountDrawnObjects(sorted, shakyCam);
+	List(RenderItem) items = GetRenderItems(sorted, tileArea);
+	bool isLit = RenderLightBuffer(shakyCam, interpolation);
+	Camera2D worldView = BeginWorld(shakyCam);
+	ClearBackground(BLACK);
+	BeginMode2D(worldView);
 	{
 		// Draw objects back-to-front ordered by z ("Painter's algorithm").
-		List(Object *) sorted = GetZSortedObjects();
-		for (int i = ListCount(sorted) - 1; i >= 0; --i)
-			Render(sorted[i]);
+		DrawRenderItems(items, interpolation);
 	}
 	EndMode2D();
+	if (isLit)
+		DrawLightBuffer();
+	EndWorld();
 }
 REGISTER_GAME_STATE(GAMESTATE_PLAYING, NULL, NULL, Playing_Update, Playing_Render);
 
@@ -874,35 +3412,42 @@ REGISTER_GAME_STATE(GAMESTATE_PLAYING, NULL, NULL, Playing_Update, Playing_Rende
 // Talking
 //
 
-Object *talkingObject;
+ObjectHandle talkingObject; // A handle, since scripts can do anything to the scene while we talk, even remove whoever we're talking to.
 int paragraphIndex;
 
 void Talking_Init(void *param)
 {
-	talkingObject = (Object *)param;
-	talkingObject->script->commandIndex = 0;
+	Object *object = (Object *)param;
+	talkingObject = GetObjectHandle(object);
+	object->details->script->commandIndex = 0;
 	paragraphIndex = 0;
 }
 void Talking_Update()
 {
+	Object *object = GetObjectFromHandle(talkingObject);
+	if (not object)
+	{
+		PopGameState();
+		return;
+	}
 	if (input.pause.wasPressed)
 	{
 		PushGameState(GAMESTATE_PAUSED, NULL);
 		return;
 	}
 
-	Script *script = talkingObject->script;
+	Script *script = object->details->script;
 	int prevParagraphIndex = paragraphIndex;
-	int numParagraphs = ListCount(script->paragraphs);
+	int numParagraphs = script->numParagraphs;
 	if (paragraphIndex >= numParagraphs)
 		paragraphIndex = numParagraphs - 1;
 
-	if (options.devMode and IsKeyPressed(KEY_LEFT))
+	if (options.devMode and input.previousParagraph.wasPressed)
 	{
 		paragraphIndex = ClampInt(paragraphIndex - 1, 0, numParagraphs - 1);
 		SetFrameNumberInCurrentGameState(0);
 	}
-	if (options.devMode and IsKeyPressed(KEY_RIGHT))
+	if (options.devMode and input.nextParagraph.wasPressed)
 	{
 		if (paragraphIndex == numParagraphs - 1)
 			SetFrameNumberInCurrentGameState(99999); // Should be enough to skip over to the end of the dialog.
@@ -924,7 +3469,7 @@ void Talking_Update()
 		else
 		{
 			++paragraphIndex;
-			if (paragraphIndex >= ListCount(script->paragraphs))
+			if (paragraphIndex >= script->numParagraphs)
 			{
 				PopGameState();
 				return;
@@ -940,13 +3485,22 @@ void Talking_Update()
 }
 void Talking_Render()
 {
-	CallPreviousGameStateRender();
+	// The world doesn't move while we talk, except for camera shakes that a script can start.
+	if (cameraTrauma > 0)
+	{
+		InvalidateGameStateSnapshot();
+		CallPreviousGameStateRender();
+	}
+	else CallPreviousGameStateRenderFrozen();
 
-	Script *script = talkingObject->script;
+	Object *object = GetObjectFromHandle(talkingObject);
+	if (not object)
+		return;
+	Script *script = object->details->script;
 	Paragraph paragraph = script->paragraphs[paragraphIndex];
 	const char *speaker = paragraph.speaker;
 	if (not paragraph.speaker)
-		speaker = talkingObject->name;
+		speaker = object->details->name;
 
 	float time = 20 * (float)GetTimeInCurrentGameState();
 	const char *expression = GetScriptExpression(*script, paragraphIndex, time);
@@ -963,8 +3517,8 @@ void Talking_Render()
 		Object *speakerObject = FindObjectByName(speaker);
 		if (speakerObject)
 		{
-			Texture *portrait = GetCharacterPortrait(speakerObject, expression);
-			if (portrait)
+			Sprite *portrait = GetCharacterPortrait(speakerObject, expression);
+			if (portrait and portrait->numFrames > 0)
 			{
 				Rectangle portraitBox = textbox;
 				portraitBox.x = 30;
@@ -978,7 +3532,7 @@ void Talking_Render()
 				DrawRectangleRounded(portraitBox, 0.1f, 5, WHITE);
 				DrawRectangleRounded(indented, 0.1f, 5, Darken(WHITE, 2));
 
-				DrawTextureCentered(*portrait, RectangleCenter(portraitBox), WHITE);
+				DrawSpriteFrameCentered(portrait->frames[0], RectangleCenter(portraitBox), WHITE);
 			}
 		}
 	}
@@ -1007,36 +3561,62 @@ REGISTER_GAME_STATE(GAMESTATE_TALKING, Talking_Init, NULL, Talking_Update, Talki
 // Editor
 //
 
-void DrawGrid()
+// The editor is all ImGui, so shipping builds don't have it.
+#ifdef DEV_GUI_ENABLED
+
+// The grid is a single quad over the whole screen, and the fragment shader works out where the lines are.
+// The texture coordinates of the quad are world positions, so the shader doesn't need to know about the camera.
+const char *gridFragmentShader = GLSL_FRAGMENT_HEADER R"(
+IN vec2 fragTexCoord;
+IN vec4 fragColor;
+uniform vec2 gridResolution;
+uniform float pixelsPerUnit;
+void main()
 {
-	Vector2 topLeftOnScreen = { 0, 0 };
-	Vector2 topLeftInWorld = GetScreenToWorld2D(topLeftOnScreen, camera);
-	Vector2 bottomRightOnScreen = { WINDOW_WIDTH, WINDOW_HEIGHT };
-	Vector2 bottomRightInWorld = GetScreenToWorld2D(bottomRightOnScreen, camera);
-
-	Vector2 cell0 = RoundDownToGridCell(topLeftInWorld);
-	Vector2 cell1 = { cell0.x, bottomRightInWorld.y };
-	cell1.y += GRID_RESOLUTION_Y - Wrap(cell1.y, 0, GRID_RESOLUTION_Y);
+	// Same as WorldToGrid. Grid lines are where either grid coordinate is a whole number.
+	vec2 world = fragTexCoord;
+	vec2 grid = vec2(world.x / gridResolution.x + world.y / gridResolution.y, world.y / gridResolution.y - world.x / gridResolution.x);
+
+	// The grid coordinates change this much per world unit, which turns distances in the grid into distances on the screen.
+	float gridPerUnit = length(1.0 / gridResolution);
+	vec2 pixelsToLine = abs(grid - floor(grid + 0.5)) / gridPerUnit * pixelsPerUnit;
+	float coverage = 1.0 - smoothstep(0.0, 1.0, min(pixelsToLine.x, pixelsToLine.y));
+	OUT_COLOR = vec4(fragColor.rgb, fragColor.a * coverage);
+}
+)";
+Shader gridShader;
+int gridResolutionLocation;
+int gridPixelsPerUnitLocation;
 
-	float dy0 = bottomRightInWorld.y - cell0.y;
-	float xIntercept0 = cell0.x - dy0 / Y_SQUISH;
-	for (float x0 = xIntercept0; x0 <= bottomRightInWorld.x; x0 += GRID_RESOLUTION_X)
+void DrawGrid()
+{
+	if (not gridShader.id)
 	{
-		float x1 = x0 + dy0 / Y_SQUISH;
-		Vector2 a0 = { x0, bottomRightInWorld.y };
-		Vector2 a1 = { x1, cell0.y };
-		DrawLineV(a0, a1, options.gridColor);
+		gridShader = LoadShaderFromMemory(NULL, gridFragmentShader);
+		gridResolutionLocation = GetShaderLocation(gridShader, "gridResolution");
+		gridPixelsPerUnitLocation = GetShaderLocation(gridShader, "pixelsPerUnit");
 	}
 
-	float dy1 = cell1.y - topLeftInWorld.y;
-	float xIntercept1 = cell1.x - dy1 / Y_SQUISH;
-	for (float x0 = xIntercept1; x0 <= bottomRightInWorld.x; x0 += GRID_RESOLUTION_X)
+	Rectangle view = GetCameraView(camera);
+	Vector2 min = { view.x, view.y };
+	Vector2 max = { view.x + view.width, view.y + view.height };
+
+	Vector2 gridResolution = { GRID_RESOLUTION_X, GRID_RESOLUTION_Y };
+	float pixelsPerUnit = camera.zoom;
+	SetShaderValue(gridShader, gridResolutionLocation, &gridResolution, SHADER_UNIFORM_VEC2);
+	SetShaderValue(gridShader, gridPixelsPerUnitLocation, &pixelsPerUnit, SHADER_UNIFORM_FLOAT);
+
+	BeginShaderMode(gridShader);
+	rlBegin(RL_QUADS);
 	{
-		float x1 = x0 + dy1 / Y_SQUISH;
-		Vector2 a0 = { x0, topLeftInWorld.y };
-		Vector2 a1 = { x1, cell1.y };
-		DrawLineV(a0, a1, options.gridColor);
+		rlColor(options.gridColor);
+		rlTexCoord2f(min.x, min.y); rlVertex2f(min.x, min.y);
+		rlTexCoord2f(min.x, max.y); rlVertex2f(min.x, max.y);
+		rlTexCoord2f(max.x, max.y); rlVertex2f(max.x, max.y);
+		rlTexCoord2f(max.x, min.y); rlVertex2f(max.x, min.y);
 	}
+	rlEnd();
+	EndShaderMode();
 }
 void DrawGridCell(Vector2 gridPoint, Color color)
 {
@@ -1052,7 +3632,13 @@ void DrawGridCell(Vector2 gridPoint, Color color)
 	Vector2 s11 = GridToWorld(g11);
 	DrawQuad(s00, s10, s11, s01, color);
 }
-void DrawStair(Stair stair, bool isSelected)
+STRUCT(StairQuad)
+{
+	Vector2 points[4];
+	Color colors[4];
+};
+// Returns the number of quads the stair is made of.
+int GetStairQuads(Stair stair, bool isSelected, StairQuad outQuads[3])
 {
 	float elevation = (float)stair.elevation;
 	if (not elevation)
@@ -1084,12 +3670,171 @@ void DrawStair(Stair stair, bool isSelected)
 	color0 = ColorAlpha(color0, 0.5f);
 	color1 = ColorAlpha(color1, 0.5f);
 
+	int numQuads = 0;
 	if (elevation > 0)
-		DrawQuad(s000, s100, s110, s010, color0);
-	DrawQuadGradient(s000, s100, s101, s001, color0, color0, color1, color1);
-	DrawQuadGradient(s000, s010, s011, s001, color0, color0, color1, color1);
+		outQuads[numQuads++] = StairQuad{ { s000, s100, s110, s010 }, { color0, color0, color0, color0 } };
+	outQuads[numQuads++] = StairQuad{ { s000, s100, s101, s001 }, { color0, color0, color1, color1 } };
+	outQuads[numQuads++] = StairQuad{ { s000, s010, s011, s001 }, { color0, color0, color1, color1 } };
 	if (elevation < 0)
-		DrawQuad(s001, s101, s111, s011, color1);
+		outQuads[numQuads++] = StairQuad{ { s001, s101, s111, s011 }, { color1, color1, color1, color1 } };
+	return numQuads;
+}
+void DrawStair(Stair stair, bool isSelected)
+{
+	StairQuad quads[3];
+	int numQuads = GetStairQuads(stair, isSelected, quads);
+	for (int i = 0; i < numQuads; ++i)
+	{
+		StairQuad *quad = &quads[i];
+		DrawQuadGradient(quad->points[0], quad->points[1], quad->points[2], quad->points[3], quad->colors[0], quad->colors[1], quad->colors[2], quad->colors[3]);
+	}
+}
+
+// All stairs are baked into one mesh, so they take a single draw call, and the mesh is only rebuilt when the stairs change.
+// The selected stair blinks, so it's hidden in the mesh by making its vertices transparent, and drawn on its own.
+// Only its color vertices are uploaded again when the selection changes.
+Mesh stairMesh;
+Material stairMaterial;
+List(Stair) stairMeshStairs; // The stairs the mesh was built from.
+List(int) stairMeshFirstVertices; // Where every stair's vertices start, with one more at the end for the vertex count.
+int stairMeshHiddenIndex = -1;
+
+void SetStairHiddenInMesh(int index, bool isHidden)
+{
+	if (index < 0 or index >= ListCount(stairMeshStairs))
+		return;
+
+	int firstVertex = stairMeshFirstVertices[index];
+	int numVertices = stairMeshFirstVertices[index + 1] - firstVertex;
+	if (numVertices == 0)
+		return;
+
+	// The mesh keeps its colors on the CPU, so showing the stair again is just uploading those.
+	const unsigned char *colors = stairMesh.colors + 4 * firstVertex;
+	if (isHidden)
+	{
+		unsigned char *transparent = (unsigned char *)TempAlloc(4 * numVertices);
+		ZeroBytes(transparent, 4 * numVertices);
+		colors = transparent;
+	}
+	UpdateMeshBuffer(stairMesh, 3, colors, 4 * numVertices, 4 * firstVertex);
+}
+void RebuildStairMesh(void)
+{
+	if (stairMesh.vaoId)
+		UnloadMesh(stairMesh);
+	ZeroBytes(&stairMesh, sizeof stairMesh);
+
+	ListClear(stairMeshStairs);
+	CopyBytes(ListAllocate(&stairMeshStairs, ListCount(stairs)), stairs, ListCount(stairs) * sizeof stairs[0]);
+	ListClear(stairMeshFirstVertices);
+	stairMeshHiddenIndex = -1;
+
+	int maxVertices = 3 * 6 * ListCount(stairs);
+	if (maxVertices == 0)
+		return;
+
+	// Unloading the mesh frees these.
+	stairMesh.vertices = (float *)MemAlloc(maxVertices * 3 * sizeof(float));
+	stairMesh.texcoords = (float *)MemAlloc(maxVertices * 2 * sizeof(float));
+	stairMesh.colors = (unsigned char *)MemAlloc(maxVertices * 4);
+	for (int i = 0; i < ListCount(stairs); ++i)
+	{
+		ListAdd(&stairMeshFirstVertices, stairMesh.vertexCount);
+
+		StairQuad quads[3];
+		int numQuads = GetStairQuads(stairs[i], false, quads);
+		for (int j = 0; j < numQuads; ++j)
+		{
+			static const int corners[6] = { 0, 1, 2, 0, 2, 3 };
+			for (int k = 0; k < 6; ++k)
+			{
+				int vertex = stairMesh.vertexCount++;
+				Vector2 point = quads[j].points[corners[k]];
+				Color color = quads[j].colors[corners[k]];
+				stairMesh.vertices[3 * vertex + 0] = point.x;
+				stairMesh.vertices[3 * vertex + 1] = point.y;
+				stairMesh.vertices[3 * vertex + 2] = 0;
+				CopyBytes(&stairMesh.colors[4 * vertex], &color, 4);
+			}
+		}
+	}
+	ListAdd(&stairMeshFirstVertices, stairMesh.vertexCount);
+	stairMesh.triangleCount = stairMesh.vertexCount / 3;
+	UploadMesh(&stairMesh, true);
+}
+void DrawStairs(const Stair *selected)
+{
+	bool isMeshUpToDate =
+		ListCount(stairMeshStairs) == ListCount(stairs) and
+		BytesEqual(stairMeshStairs, stairs, ListCount(stairs) * sizeof stairs[0]);
+	if (not isMeshUpToDate)
+		RebuildStairMesh();
+
+	int selectedIndex = selected ? (int)(selected - stairs) : -1;
+	if (selectedIndex != stairMeshHiddenIndex)
+	{
+		SetStairHiddenInMesh(stairMeshHiddenIndex, false);
+		SetStairHiddenInMesh(selectedIndex, true);
+		stairMeshHiddenIndex = selectedIndex;
+	}
+
+	if (stairMesh.vertexCount > 0)
+	{
+		if (not stairMaterial.shader.id)
+			stairMaterial = LoadMaterialDefault();
+
+		// The mesh is drawn right away, so everything before it that's still in the batch has to go first.
+		rlDrawRenderBatchActive();
+		rlDisableBackfaceCulling();
+		DrawMesh(stairMesh, stairMaterial, MatrixIdentity());
+		rlEnableBackfaceCulling();
+	}
+
+	if (selected)
+		DrawStair(*selected, true);
+}
+void UnloadEditorGraphics()
+{
+	if (stairMesh.vaoId)
+		UnloadMesh(stairMesh);
+	ZeroBytes(&stairMesh, sizeof stairMesh);
+	ListDestroy((void **)&stairMeshStairs);
+	ListDestroy((void **)&stairMeshFirstVertices);
+	stairMeshHiddenIndex = -1;
+
+	// raylib leaves its default shader and texture alone when unloading the default material.
+	if (stairMaterial.maps)
+		UnloadMaterial(stairMaterial);
+	ZeroBytes(&stairMaterial, sizeof stairMaterial);
+
+	if (gridShader.id)
+		UnloadShader(gridShader);
+	ZeroBytes(&gridShader, sizeof gridShader);
+}
+// While the editor is open, the scene is saved every so often, in case the game crashes. Autosaves go next to the res directory,
+// so that the file watcher doesn't report them and they don't end up in the resource packs.
+// Only the snapshot is taken on the main thread, and nothing gets written if the scene didn't change since the last autosave.
+#define AUTOSAVE_INTERVAL 30.0
+double lastAutosaveTime;
+uint64_t lastAutosaveHash;
+
+void AutosaveScene()
+{
+	BinaryStream stream = SerializeScene();
+	uint64_t hash = stream.hasFailed ? 0 : MixHash(14695981039346656037ull, stream.buffer, stream.cursor);
+	if (stream.hasFailed or hash == lastAutosaveHash)
+	{
+		MemFree(stream.buffer);
+		return;
+	}
+
+	lastAutosaveHash = hash;
+	// Scenes in subdirectories still get their autosave right next to res, since the subdirectories aren't there.
+	char *path = TempFormat("../%s.autosave", options.scene);
+	ReplaceChar(path + 3, '/', '_');
+	ReplaceChar(path + 3, '\\', '_');
+	SaveFileDataInBackground(path, stream.buffer, stream.cursor);
 }
 void Editor_Update()
 {
@@ -1100,17 +3845,44 @@ void Editor_Update()
 		PopGameState();
 		return;
 	}
+
+	if (GetTime() - lastAutosaveTime > AUTOSAVE_INTERVAL)
+	{
+		lastAutosaveTime = GetTime();
+		AutosaveScene();
+	}
+
+	// Objects don't move in the editor, but particles keep going, so that you can see what the emitter settings do.
+	for (int i = 0; i < numObjects; ++i)
+	{
+		Object *object = GetObject(i);
+		if (object->particles)
+		{
+			UpdateParticleEmitter(object->particles, Vector2{ object->position.x, object->position.y + object->elevationOffset }, FRAME_TIME);
+			UpdateObjectBounds(object);
+		}
+	}
 }
+bool isLightingPreviewed = true;
+
 void Editor_Render()
 {
+	#ifdef PROFILER_ENABLED
+	ShowProfilerWindow();
+	#endif
+
 	ClearBackground(BLACK);
 
 	BeginMode2D(camera);
 	{
-		static Object *pressedObject;
-		static Object *selectedObject;
-		static Object *draggedObject;
+		// Held as handles between frames, so that objects that were removed in the meantime (e.g. by a loaded scene) aren't selected anymore.
+		static ObjectHandle pressedHandle;
+		static ObjectHandle selectedHandle;
+		static ObjectHandle draggedHandle;
 		static Vector2 draggedObjectFreeformPosition;
+		Object *pressedObject = GetObjectFromHandle(pressedHandle);
+		Object *selectedObject = GetObjectFromHandle(selectedHandle);
+		Object *draggedObject = GetObjectFromHandle(draggedHandle);
 
 		bool isInObjectsTab = false;
 		bool isInStairsTab = false;
@@ -1120,14 +3892,18 @@ void Editor_Render()
 			{
 				if (ImGui::BeginTabItem("Console"))
 				{
+					// Commands can load scenes, and then the objects from the start of the frame could be gone.
 					ShowConsoleGui();
+					pressedObject = GetObjectFromHandle(pressedHandle);
+					selectedObject = GetObjectFromHandle(selectedHandle);
+					draggedObject = GetObjectFromHandle(draggedHandle);
 					ImGui::EndTabItem();
 				}
 				if (ImGui::BeginTabItem("Objects"))
 				{
 					isInObjectsTab = true;
 					ImGui::BeginTable("Columns", 2, ImGuiTableFlags_BordersInner | ImGuiTableFlags_Resizable);
-					ImGui::TableSetupColumn(TempFormat("Objects %d/%d", numObjects, (int)COUNTOF(objects)));
+					ImGui::TableSetupColumn(TempFormat("Objects %d", numObjects));
 					ImGui::TableSetupColumn("Properties");
 					ImGui::TableHeadersRow();
 					ImGui::TableNextRow();
@@ -1142,8 +3918,9 @@ void Editor_Render()
 									ImGui::TableNextRow();
 									ImGui::PushID(i);
 									{
-										Object *object = &objects[i];
-										bool selected = selectedObject == &objects[i];
+										Object *object = GetObject(i);
+										bool selected = selectedObject == object;
+										bool wasRemoved = false;
 
 										ImGui::TableNextColumn();
 										if (i == 0)
@@ -1153,43 +3930,49 @@ void Editor_Render()
 										ImGui::PushStyleColor(ImGuiCol_ButtonActive, IM_COL32(150, 20, 20, 255));
 										if (ImGui::Button("x") or (i > 0 and selected and IsKeyPressed(KEY_DELETE)))
 										{
-											if (i == numObjects - 1)
+											// The selection goes to the object that takes this one's place in the list, or the one before it.
+											if (selected)
 											{
-												if (numObjects <= 1)
-													selectedObject = NULL;
+												if (i + 1 < numObjects)
+													selectedObject = GetObject(i + 1);
 												else
-													selectedObject = &objects[i - 1];
+													selectedObject = i > 0 ? GetObject(i - 1) : NULL;
 											}
+											if (pressedObject == object)
+												pressedObject = NULL;
+											if (draggedObject == object)
+												draggedObject = NULL;
 
-											Destroy(&objects[i]);
-											CopyBytes(&objects[i], &objects[i + 1], (numObjects - i - 1) * sizeof objects[i]);
-											--numObjects;
-											selected = false;
-											object = &objects[i];
+											RemoveObject(i);
+											wasRemoved = true;
 										}
 										ImGui::PopStyleColor(3);
 										if (i == 0)
 											ImGui::EndDisabled();
 
+										if (wasRemoved)
+										{
+											// The next object moved into this index, so we show it on the next row instead.
+											ImGui::PopID();
+											--i;
+											continue;
+										}
+
 										ImGui::TableNextColumn();
-										if (ImGui::Selectable(object->name, &selected))
+										if (ImGui::Selectable(object->details->name, &selected))
 											selectedObject = object;
 
 										ImGui::TableNextColumn();
 										if (ImGui::Button("Clone"))
 										{
-											if (numObjects < COUNTOF(objects))
-											{
-												char cloneName[sizeof object->name];
-												CopyString(cloneName, object->name, sizeof cloneName);
-												for (int suffix = 2; suffix < 100 and FindObjectByName(cloneName); ++suffix)
-													FormatString(cloneName, sizeof cloneName, "%s%d", object->name, suffix);
-
-												CopyBytes(&objects[i + 2], &objects[i + 1], (numObjects - i - 1) * sizeof objects[i]);
-												++numObjects;
-												Clone(&objects[i], &objects[i + 1]);
-												CopyString(objects[i + 1].name, cloneName, sizeof objects[i + 1].name);
-											}
+											char cloneName[sizeof object->details->name];
+											CopyString(cloneName, object->details->name, sizeof cloneName);
+											for (int suffix = 2; suffix < 100 and FindObjectByName(cloneName); ++suffix)
+												FormatString(cloneName, sizeof cloneName, "%s%d", object->details->name, suffix);
+
+											Object *clone = InsertObject(i + 1);
+											Clone(object, clone);
+											CopyString(clone->details->name, cloneName, sizeof clone->details->name);
 										}
 									}
 									ImGui::PopID();
@@ -1198,12 +3981,10 @@ void Editor_Render()
 								ImGui::TableNextRow();
 								ImGui::TableNextColumn();
 								ImGui::TableNextColumn();
-								if (ImGui::Button("+", ImVec2(ImGui::GetContentRegionAvail().x, 0)) and numObjects < COUNTOF(objects))
+								if (ImGui::Button("+", ImVec2(ImGui::GetContentRegionAvail().x, 0)))
 								{
-									Object *object = &objects[numObjects++];
-									memset(object, 0, sizeof object[0]);
-									int index = numObjects;
-									FormatString(object->name, sizeof object->name, "Object%d", index);
+									Object *object = AddObject();
+									FormatString(object->details->name, sizeof object->details->name, "Object%d", numObjects);
 								}
 							}
 							ImGui::EndTable();
@@ -1214,7 +3995,7 @@ void Editor_Render()
 						{
 							if (selectedObject)
 							{
-								ImGui::InputText("Name", selectedObject->name, sizeof selectedObject->name);
+								ImGui::InputText("Name", selectedObject->details->name, sizeof selectedObject->details->name);
 								ImGui::DragFloat2("Position", &selectedObject->position.x);
 
 								const char *direction = GetDirectionString(selectedObject->direction);
@@ -1232,15 +4013,16 @@ void Editor_Render()
 								ImGui::DragFloat("Z Offset", &selectedObject->zOffset);
 
 								char scriptPath[256];
-								CopyString(scriptPath, GetAssetPath(selectedObject->script), sizeof scriptPath);
+								CopyString(scriptPath, GetAssetPath(selectedObject->details->script), sizeof scriptPath);
 								if (ImGui::InputText("Script", scriptPath, sizeof scriptPath, ImGuiInputTextFlags_EnterReturnsTrue))
 								{
-									ReleaseAsset(selectedObject->script);
-									selectedObject->script = AcquireScript(scriptPath, roboto, robotoBold, robotoItalic, robotoBoldItalic);
+									ReleaseAsset(selectedObject->details->script);
+									selectedObject->details->script = AcquireScript(scriptPath, roboto, robotoBold, robotoItalic, robotoBoldItalic);
 								}
 
 								ImGui::SliderFloat("Talk range", &selectedObject->talkRange, 1, 1000);
 								ImGui::Checkbox("Auto talk when in range", &selectedObject->autoTalkInRange);
+								ImGui::Checkbox("Static (never moves or animates)", &selectedObject->isStatic);
 
 								char collisionMapPath[256];
 								CopyString(collisionMapPath, GetAssetPath(selectedObject->collisionMap), sizeof collisionMapPath);
@@ -1248,6 +4030,7 @@ void Editor_Render()
 								{
 									ReleaseAsset(selectedObject->collisionMap);
 									selectedObject->collisionMap = AcquireCollisionMap(collisionMapPath);
+									isNavGridDirty = true;
 								}
 
 								if (ImGui::CollapsingHeader("Sprites"))
@@ -1267,13 +4050,13 @@ void Editor_Render()
 
 								if (ImGui::CollapsingHeader("Expressions"))
 								{
-									for (int i = 0; i < COUNTOF(selectedObject->expressions); ++i)
+									for (int i = 0; i < COUNTOF(selectedObject->details->expressions); ++i)
 									{
 										ImGui::PushID(i);
 										ImGui::BeginTable("ExpressionTable", 2, ImGuiTableFlags_SizingStretchProp);
 										ImGui::TableNextRow();
 										{
-											Expression *expression = &selectedObject->expressions[i];
+											Expression *expression = &selectedObject->details->expressions[i];
 
 											ImGui::TableNextColumn();
 											ImGui::InputText("Name", expression->name, sizeof expression->name);
@@ -1284,13 +4067,88 @@ void Editor_Render()
 											if (ImGui::InputText("Portrait", portraitPath, sizeof portraitPath, ImGuiInputTextFlags_EnterReturnsTrue))
 											{
 												ReleaseAsset(expression->portrait);
-												expression->portrait = AcquireTexture(portraitPath);
+												expression->portrait = AcquireSprite(portraitPath);
 											}
 										}
 										ImGui::EndTable();
 										ImGui::PopID();
 									}
 								}
+
+								if (ImGui::CollapsingHeader("Light"))
+								{
+									// New lights start out white, so that they show up as soon as they get a radius.
+									if (ImGui::DragFloat("Light radius", &selectedObject->lightRadius, 1, 0, 4000) and selectedObject->lightColor.a == 0)
+										selectedObject->lightColor = WHITE;
+									Vector4 lightColor = ColorNormalize(selectedObject->lightColor);
+									if (ImGui::ColorEdit4("Light color", &lightColor.x))
+										selectedObject->lightColor = ColorFromNormalized(lightColor);
+								}
+
+								if (ImGui::CollapsingHeader("Particles"))
+								{
+									if (not selectedObject->particles)
+									{
+										if (ImGui::Button("Add particle emitter"))
+										{
+											ParticleEmitterSettings settings = { 0 };
+											settings.budget = 256;
+											settings.rate = 30;
+											settings.lifetime = 2;
+											settings.lifetimeVariance = 0.5f;
+											settings.spawnRadius = 16;
+											settings.velocity = Vector2{ 0, -20 };
+											settings.velocitySpread = 10;
+											settings.turbulenceScale = 64;
+											settings.startSize = 4;
+											settings.endSize = 1;
+											settings.startColor = WHITE;
+											settings.endColor = ColorAlpha(WHITE, 0);
+											SetObjectParticles(selectedObject, settings);
+										}
+									}
+									else
+									{
+										// The emitter only reallocates when the budget changes, so the settings can be edited every frame.
+										ParticleEmitterSettings settings = selectedObject->particles->settings;
+										ImGui::Text("%d particles alive", selectedObject->particles->numParticles);
+										ImGui::SliderInt("Budget", &settings.budget, 1, MAX_PARTICLES_PER_EMITTER);
+										ImGui::DragFloat("Rate", &settings.rate, 1, 0, 10000);
+										ImGui::DragFloat("Lifetime", &settings.lifetime, 0.05f, 0.01f, 60);
+										ImGui::DragFloat("Lifetime variance", &settings.lifetimeVariance, 0.05f, 0, 60);
+										ImGui::DragFloat("Spawn radius", &settings.spawnRadius, 1, 0, 1000);
+										ImGui::DragFloat2("Velocity", &settings.velocity.x);
+										ImGui::DragFloat("Velocity spread", &settings.velocitySpread, 1, 0, 1000);
+										ImGui::DragFloat2("Acceleration", &settings.acceleration.x);
+										ImGui::DragFloat("Turbulence", &settings.turbulence, 1, 0, 10000);
+										ImGui::DragFloat("Turbulence scale", &settings.turbulenceScale, 1, 1, 2000);
+										ImGui::DragFloat("Start size", &settings.startSize, 0.05f, 0, 100);
+										ImGui::DragFloat("End size", &settings.endSize, 0.05f, 0, 100);
+
+										Vector4 startColor = ColorNormalize(settings.startColor);
+										Vector4 endColor = ColorNormalize(settings.endColor);
+										ImGui::ColorEdit4("Start color", &startColor.x);
+										ImGui::ColorEdit4("End color", &endColor.x);
+										settings.startColor = ColorFromNormalized(startColor);
+										settings.endColor = ColorFromNormalized(endColor);
+
+										char particleSpritePath[256];
+										CopyString(particleSpritePath, GetAssetPath(settings.sprite), sizeof particleSpritePath);
+										if (ImGui::InputText("Particle sprite", particleSpritePath, sizeof particleSpritePath, ImGuiInputTextFlags_EnterReturnsTrue))
+										{
+											// The object already holds a reference to its sprite, so entering the same path again mustn't add another one.
+											Sprite *sprite = AcquireSprite(particleSpritePath);
+											if (sprite == settings.sprite)
+												ReleaseAsset(sprite);
+											else
+												settings.sprite = sprite;
+										}
+										SetObjectParticles(selectedObject, settings);
+
+										if (ImGui::Button("Remove particle emitter"))
+											RemoveObjectParticles(selectedObject);
+									}
+								}
 							}
 						}
 					}
@@ -1306,26 +4164,31 @@ void Editor_Render()
 					options.gridColor = ColorFromNormalized(c);
 
 					Vector2 gridPoint = ScreenToGrid(GetMousePosition());
-					Stair *hoveredStair = GetStairAt(gridPoint);
-
-					int elevation = 0;
-					if (hoveredStair)
-						elevation = hoveredStair->elevation;
-
-					ImGui::Text("Elevation: %d", elevation);
+					ImGui::Text("Elevation: %d", GetElevationAt(gridPoint));
 						
 					ImGui::EndTabItem();
 				}
+				if (ImGui::BeginTabItem("Lighting"))
+				{
+					Vector4 ambient = ColorNormalize(ambientLight);
+					if (ImGui::ColorEdit3("Ambient light", &ambient.x))
+						ambientLight = ColorFromNormalized(ambient);
+					ImGui::Checkbox("Preview lighting", &isLightingPreviewed);
+					ImGui::EndTabItem();
+				}
 			}
 			ImGui::EndTabBar();
 		}
 		ImGui::End();
 
-		List(Object *) sorted = GetZSortedObjects();
+		// The editor can change pretty much anything about the objects, so we have to do this after the editor UI.
+		UpdateAllObjectBounds();
+
+		List(Object *) sorted = GetVisibleZSortedObjects(camera);
 		for (int i = ListCount(sorted) - 1; i >= 0; --i)
 		{
 			Object *object = sorted[i];
-			Render(object);
+			Render(object, 1);
 
 			// Draw an outline around the object.
 			Rectangle outline = GetOutline(object);
@@ -1357,18 +4220,9 @@ void Editor_Render()
 			mouseGridPosition.x = floorf(mouseGridPosition.x);
 			mouseGridPosition.y = floorf(mouseGridPosition.y);
 			DrawGridCell(mouseGridPosition, ColorAlpha(GRAY, 0.5f));
-			Stair *hoveredStair = GetStairAt(mouseGridPosition);
-			for (int i = 0; i < numStairs; ++i)
-			{
-				Stair *stair = &stairs[i];
-				DrawStair(*stair, stair == hoveredStair);
-			}
-		}
-		else
-		{
-			for (int i = 0; i < numStairs; ++i)
-				DrawStair(stairs[i], false);
+			DrawStairs(GetStairAt(mouseGridPosition));
 		}
+		else DrawStairs(NULL);
 
 
 		if (not ImGui::GetIO().WantCaptureMouse)
@@ -1400,6 +4254,7 @@ void Editor_Render()
 					draggedObject->position = draggedObjectFreeformPosition;
 					if (options.showGrid)
 						draggedObject->position = SnapToGrid(draggedObjectFreeformPosition);
+					UpdateObjectBounds(draggedObject);
 				}
 			}
 			else if (isInStairsTab)
@@ -1411,8 +4266,11 @@ void Editor_Render()
 					(int)IsMouseButtonPressed(MOUSE_BUTTON_RIGHT);
 				
 				if (stair and deltaElevation != 0)
+				{
 					stair->elevation += deltaElevation;
-				else if (not stair and numStairs < COUNTOF(stairs))
+					areObjectBoundsDirty = true;
+				}
+				else if (not stair)
 				{
 					int x = (int)floorf(gridPoint.x);
 					int y = (int)floorf(gridPoint.y);
@@ -1429,12 +4287,13 @@ void Editor_Render()
 						int x1 = (int)fmaxf((float)minX, (float)x);
 						int y0 = (int)fminf((float)minY, (float)y);
 						int y1 = (int)fmaxf((float)minY, (float)y);
-						stair = &stairs[numStairs++];
+						stair = ListAllocateItem(&stairs);
 						stair->x0 = x0;
 						stair->y0 = y0;
 						stair->x1 = x1 + 1;
 						stair->y1 = y1 + 1;
 						stair->elevation = 0;
+						UpdateElevationMap(stair->x0, stair->y0, stair->x1, stair->y1);
 					}
 				}
 			}
@@ -1471,8 +4330,13 @@ void Editor_Render()
 				Stair *stair = GetStairAt(gridPoint);
 				if (stair)
 				{
+					// The last stair moves into the removed one's place, so its cells need the new index too.
 					int i = (int)(stair - stairs);
-					SwapBytes(&stairs[i], &stairs[--numStairs], sizeof stairs[0]);
+					Stair removed = *stair;
+					Stair moved = stairs[ListCount(stairs) - 1];
+					ListSwapRemove(&stairs, i);
+					UpdateElevationMap(removed.x0, removed.y0, removed.x1, removed.y1);
+					UpdateElevationMap(moved.x0, moved.y0, moved.x1, moved.y1);
 				}
 			}
 		}
@@ -1483,13 +4347,27 @@ void Editor_Render()
 		if (IsKeyPressed(KEY_S) and controlIsDown)
 			SaveScene(options.scene);
 		if (IsKeyPressed(KEY_R) and controlIsDown)
+		{
 			LoadScene(options.scene);
+			selectedObject = GetObjectFromHandle(selectedHandle);
+			pressedObject = GetObjectFromHandle(pressedHandle);
+			draggedObject = GetObjectFromHandle(draggedHandle);
+		}
 		if (IsKeyPressed(KEY_G) and controlIsDown)
 			options.showGrid = not options.showGrid;
+
+		pressedHandle = GetObjectHandle(pressedObject);
+		selectedHandle = GetObjectHandle(selectedObject);
+		draggedHandle = GetObjectHandle(draggedObject);
 	}
 	EndMode2D();
+
+	// This darkens the outlines and the grid too, which is why it can be turned off.
+	if (isLightingPreviewed and RenderLightBuffer(camera, 1))
+		DrawLightBuffer();
 }
 REGISTER_GAME_STATE(GAMESTATE_EDITOR, NULL, NULL, Editor_Update, Editor_Render);
+#endif
 
 //
 // Paused
@@ -1505,7 +4383,7 @@ void Paused_Update(void)
 }
 void Paused_Render(void)
 {
-	CallPreviousGameStateRender();
+	CallPreviousGameStateRenderFrozen();
 	DrawRectangle(0, 0, WINDOW_WIDTH, WINDOW_HEIGHT, GrayscaleAlpha(0, 0.4f));
 	DrawFormatCentered(roboto, WINDOW_CENTER_X, WINDOW_CENTER_Y, 64, BLACK, "Paused");
 }
@@ -1516,7 +4394,10 @@ void GameInit(void)
 	SetConfigFlags(FLAG_MSAA_4X_HINT);
 	InitWindow(WINDOW_WIDTH, WINDOW_HEIGHT, "Who Stole The Sun");
 	InitAudioDevice();
-	SetTargetFPS(FPS);
+
+	// Updates always run at FPS, but we can render as fast as the monitor refreshes.
+	int refreshRate = GetMonitorRefreshRate(GetCurrentMonitor());
+	SetTargetFPS(refreshRate >= FPS ? refreshRate : FPS);
 	
 	// Options
 	{
@@ -1526,6 +4407,7 @@ void GameInit(void)
 		if (bytesToCopy > sizeof options)
 			bytesToCopy = sizeof options;
 		CopyBytes(&options, data, bytesToCopy);
+		SetDynamicResolution(options.isResolutionDynamic);
 	}
 
 	// Input mapping
@@ -1556,27 +4438,71 @@ void GameInit(void)
 		MapGamepadButtonToInputButton(GAMEPAD_BUTTON_MIDDLE_RIGHT, &input.pause);
 		
 		MapKeyToInputButton(KEY_F1, &input.console);
+
+		MapKeyToInputButton(KEY_LEFT, &input.previousParagraph);
+		MapKeyToInputButton(KEY_RIGHT, &input.nextParagraph);
 	}
 
-	roboto = LoadFontAscii("roboto.ttf", 32);
-	robotoBold = LoadFontAscii("roboto-bold.ttf", 32);
-	robotoItalic = LoadFontAscii("roboto-italic.ttf", 32);
-	robotoBoldItalic = LoadFontAscii("roboto-bold-italic.ttf", 32);
+	// Text is drawn at all kinds of sizes, so the fonts use distance fields.
+	roboto = LoadFontFace("roboto.ttf", true);
+	robotoBold = LoadFontFace("roboto-bold.ttf", true);
+	robotoItalic = LoadFontFace("roboto-italic.ttf", true);
+	robotoBoldItalic = LoadFontFace("roboto-bold-italic.ttf", true);
+
+	collisionGrid = CreateSpatialGrid(SPATIAL_GRID_CELL_SIZE);
+	outlineGrid = CreateSpatialGrid(SPATIAL_GRID_CELL_SIZE);
+	talkGrid = CreateSpatialGrid(SPATIAL_GRID_CELL_SIZE);
+	navGrid = CreateNavGrid();
 
+	// The player has to exist even if the scene fails to load.
 	LoadScene(options.scene);
+	EnsurePlayer();
+
+	// The first scene is loaded synchronously so we don't start on a screen full of placeholders.
+	// Every scene we load after that is streamed in so that switching scenes doesn't hitch.
+	SetAssetStreaming(true);
 
 	AddCommand("tp", HandlePlayerTeleportCommand, "tp x:float y:float  -  Teleport player");
 	AddCommand("dev", HandleToggleDevModeCommand, "dev [value:bool]  -  Toggle developer mode.");
 	AddCommand("shake", HandleCameraShakeCommand, "shake [trauma:float] [falloff:float]  -  Trigger camera shake.");
 	AddCommand("sound", HandleSoundCommand,       "sound filename:string [volume:float] [pitch:float]  -  Play a sound.");
+	AddCommand("music", HandleMusicCommand,       "music [filename:string] [volume:float]  -  Stream a music track, or stop the music.");
+	AddCommand("log", HandleLogCommand, "log category:string [level:string]  -  Show or set the log level of a category (general, assets, scripts, scenes, raylib), e.g. 'log scripts debug'.");
 	AddCommand("moveto", HandleMoveTo, "moveto dx:float dy:float  -  Start moving the player to a position.");
 	AddCommand("moveby", HandleMoveBy, "moveby dx:float dy:float  -  Start moving the player by a relative amount.");
 	AddCommand("save", HandleSaveCommand, "save [filename:string]  -  Saves current scene to a file.");
 	AddCommand("load", HandleLoadCommand, "load [filename:string]  -  Load a scene file.");
+	AddCommand("prefetch", HandlePrefetchCommand, "prefetch filename:string  -  Start loading the assets of a scene in the background, so loading it later is quick.");
+	AddCommand("record", HandleRecordCommand, "record [filename:string]  -  Start recording input from a freshly loaded scene, or stop and save the recording. Replay it with '--replay filename'.");
+	AddCommand("pack", HandlePackCommand, "pack [directory:string]  -  Bake the resource packs for the web build into a directory (../bin/web by default).");
 
 	SetCurrentGameState(GAMESTATE_PLAYING, NULL);
 }
+void GameBeginUpdate(void)
+{
+	for (int i = 0; i < numObjects; ++i)
+	{
+		Object *object = GetObject(i);
+		object->previousPosition = object->position;
+	}
+	previousCameraTarget = camera.target;
+}
+bool GameWantsDevGui(void)
+{
+	// The console lives in the editor.
+	return options.devMode or GetCurrentGameState() == GAMESTATE_EDITOR;
+}
 void GameDeinit(void)
 {
+	if (IsRecordingInput())
+		StopInputRecording(recordingPath);
 	SaveFileData(".options", &options, sizeof options);
+	UnloadTemporarySounds();
+	UnloadLighting();
+	UnloadStaticTiles();
+	#ifdef DEV_GUI_ENABLED
+	UnloadEditorGraphics();
+	#endif
+	UnloadWorldTarget();
+	WaitForSavedFiles();
 }